@@ -39,9 +39,11 @@
 #include "callback.h"
 #include "format.h"
 #include "metadata.h"
+#include "ogg_demuxer.h"
 #include "ordinals.h"
 #include "stream_decoder.h"
 #include "stream_encoder.h"
+#include "stream_splicer.h"
 
 /** \mainpage
  *
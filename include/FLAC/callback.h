@@ -39,8 +39,8 @@
 /** \file include/FLAC/callback.h
  *
  *  \brief
- *  This module defines the structures for describing I/O callbacks
- *  to the other FLAC interfaces.
+ *  This module defines the structures for describing I/O and memory
+ *  callbacks to the other FLAC interfaces.
  *
  *  See the detailed documentation for callbacks in the
  *  \link flac_callbacks callbacks \endlink module.
@@ -76,6 +76,12 @@
  *  or write a wrapper.  The same is true for feof() since this is usually
  *  implemented as a macro, not as a function whose address can be taken.
  *
+ *  The memory callbacks (FLAC__MemoryCallbacks) let the stream decoder
+ *  and encoder allocate their working memory from a caller-supplied
+ *  allocator instead of the C runtime heap.  See
+ *  FLAC__stream_decoder_set_memory_callbacks() and
+ *  FLAC__stream_encoder_set_memory_callbacks().
+ *
  * \{
  */
 
@@ -176,6 +182,50 @@ typedef struct {
 	FLAC__IOCallback_Close close;
 } FLAC__IOCallbacks;
 
+/** Signature for the memory allocation callback.
+ *  Semantics match malloc(), except that \a size is never \c 0.
+ *
+ * \param  size         The number of bytes to allocate.
+ * \param  client_data  The \a client_data member of the
+ *                      FLAC__MemoryCallbacks structure.
+ * \retval void*
+ *    The address of the new block, or \c NULL on failure.
+ */
+typedef void *(*FLAC__MemoryCallback_Malloc) (size_t size, void *client_data);
+
+/** Signature for the memory reallocation callback.
+ *  Semantics match realloc(); \a ptr may be \c NULL.
+ *
+ * \param  ptr          The block to resize, or \c NULL.
+ * \param  size         The new size of the block in bytes.
+ * \param  client_data  The \a client_data member of the
+ *                      FLAC__MemoryCallbacks structure.
+ * \retval void*
+ *    The address of the resized block, or \c NULL on failure, in which
+ *    case \a ptr must be left untouched.
+ */
+typedef void *(*FLAC__MemoryCallback_Realloc) (void *ptr, size_t size, void *client_data);
+
+/** Signature for the memory deallocation callback.
+ *  Semantics match free(); \a ptr is never \c NULL.
+ *
+ * \param  ptr          The block to free.
+ * \param  client_data  The \a client_data member of the
+ *                      FLAC__MemoryCallbacks structure.
+ */
+typedef void (*FLAC__MemoryCallback_Free) (void *ptr, void *client_data);
+
+/** A structure for holding a set of memory callbacks, e.g. for routing
+ *  the allocations of one decoder or encoder instance to an arena or a
+ *  pool.  All three callbacks are required.
+ */
+typedef struct {
+	FLAC__MemoryCallback_Malloc malloc;
+	FLAC__MemoryCallback_Realloc realloc;
+	FLAC__MemoryCallback_Free free;
+	void *client_data;
+} FLAC__MemoryCallbacks;
+
 /* \} */
 
 #ifdef __cplusplus
@@ -804,7 +804,16 @@ typedef struct {
 	/**< Length of binary picture data in bytes. */
 
 	FLAC__byte *data;
-	/**< Binary picture data. */
+	/**< Binary picture data.  \c NULL with a nonzero \a data_length when
+	 * the data was left in the stream; see \a data_offset.
+	 */
+
+	FLAC__uint64 data_offset;
+	/**< When \a data is \c NULL but \a data_length is not \c 0, the byte
+	 * offset in the stream where the picture data starts; the data can
+	 * then be read with FLAC__metadata_object_picture_load_data().
+	 * Otherwise \c 0.
+	 */
 
 } FLAC__StreamMetadata_Picture;
 
@@ -70,7 +70,10 @@
  *
  *  Level 0:
  *  Read-only access to the STREAMINFO, VORBIS_COMMENT, CUESHEET, and
- *  PICTURE blocks.
+ *  PICTURE blocks, and a fast probe for reading any set of blocks in
+ *  one pass.  The metadata indexer builds on the probe to read
+ *  whole libraries with a pool of workers, and the metadata arena
+ *  reads all the blocks of a file into a single allocation.
  *
  *  Level 1:
  *  Read-write access to all metadata blocks.  This level is write-
@@ -132,7 +135,8 @@ extern "C" {
  *  \brief
  *  The level 0 interface consists of individual routines to read the
  *  STREAMINFO, VORBIS_COMMENT, CUESHEET, and PICTURE blocks, requiring
- *  only a filename.
+ *  only a filename, and FLAC__metadata_probe() for reading whichever
+ *  blocks are wanted in a single pass, e.g. when scanning a library.
  *
  *  They try to skip any ID3v2 tag at the head of the file.
  *
@@ -152,9 +156,8 @@ extern "C" {
  *    \code streaminfo != NULL \endcode
  * \retval FLAC__bool
  *    \c true if a valid STREAMINFO block was read from \a filename.  Returns
- *    \c false if there was a memory allocation error, a file decoder error,
- *    or the file contained no STREAMINFO block.  (A memory allocation error
- *    is possible because this function must set up a file decoder.)
+ *    \c false if there was a memory allocation error, a read error, or the
+ *    file contained no STREAMINFO block.
  */
 FLAC_API FLAC__bool FLAC__metadata_get_streaminfo(const char *filename, FLAC__StreamMetadata *streaminfo);
 
@@ -236,6 +239,327 @@ FLAC_API FLAC__bool FLAC__metadata_get_cuesheet(const char *filename, FLAC__Stre
  */
 FLAC_API FLAC__bool FLAC__metadata_get_picture(const char *filename, FLAC__StreamMetadata **picture, FLAC__StreamMetadata_Picture_Type type, const char *mime_type, const FLAC__byte *description, unsigned max_width, unsigned max_height, unsigned max_depth, unsigned max_colors);
 
+/** The bit for \a type in the \a types argument of FLAC__metadata_probe().
+ *  Only the types below 32 have a bit, so blocks of higher types are
+ *  always skipped.
+ */
+#define FLAC__METADATA_PROBE_TYPE(type) (1u << (unsigned)(type))
+
+/** Signature for the callback passed to FLAC__metadata_probe().  It is
+ *  called once for every block of a requested type, in stream order.
+ *
+ * \param  metadata     The block.  It is owned by the probe and is
+ *                      deleted as soon as the callback returns, so use
+ *                      FLAC__metadata_object_clone() to keep it.
+ * \param  client_data  The \a client_data passed to
+ *                      FLAC__metadata_probe().
+ * \retval FLAC__bool
+ *    \c true to go on to the next requested block, \c false to stop.
+ */
+typedef FLAC__bool (*FLAC__MetadataProbeCallback)(const FLAC__StreamMetadata *metadata, void *client_data);
+
+/** Read the metadata blocks of the given types from a native FLAC file,
+ *  without setting up a decoder.  This function will try to skip any
+ *  ID3v2 tag at the head of the file.
+ *
+ *  The file is read through a 64 KiB window, so the block headers of a
+ *  typical file all come from the first read.  The payloads of the
+ *  blocks that were not asked for, like a large PICTURE or SEEKTABLE,
+ *  are skipped by seeking past them.  Only the blocks that were asked
+ *  for are parsed and passed to \a callback.  The probe stops after the
+ *  last metadata block, after \a callback returns \c false, or as soon
+ *  as every requested STREAMINFO, SEEKTABLE, VORBIS_COMMENT, and
+ *  CUESHEET block has been seen if no other types were requested,
+ *  since there can be only one of each of them.
+ *
+ *  For example, to read the stream properties and the tags:
+ *  \code
+ *  FLAC__metadata_probe(filename,
+ *      FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_STREAMINFO) |
+ *      FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_VORBIS_COMMENT),
+ *      my_callback, &my_track);
+ *  \endcode
+ *
+ * \param filename    The path to the FLAC file to read.
+ * \param types       The types to read, as an OR of
+ *                    FLAC__METADATA_PROBE_TYPE() values.
+ * \param callback    See #FLAC__MetadataProbeCallback.
+ * \param client_data This value will be supplied to \a callback.
+ * \assert
+ *    \code filename != NULL \endcode
+ *    \code callback != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the file could not be opened or read, is not a native
+ *    FLAC file, or has a malformed metadata block before the probe
+ *    stopped, or if there was a memory allocation error; else \c true,
+ *    even if none of the requested blocks were found.
+ */
+FLAC_API FLAC__bool FLAC__metadata_probe(const char *filename, unsigned types, FLAC__MetadataProbeCallback callback, void *client_data);
+
+/** Like FLAC__metadata_probe(), but reads the FLAC stream through an
+ *  I/O handle and callbacks instead of a filename.  The stream is read
+ *  from the beginning.
+ *
+ * \param handle      The I/O handle of the FLAC stream to read.  The
+ *                    handle will NOT be closed after the probe.
+ * \param callbacks   A set of callbacks to use for I/O.  The mandatory
+ *                    callbacks are \a read and \a seek.
+ * \param types       See FLAC__metadata_probe().
+ * \param callback    See FLAC__metadata_probe().
+ * \param client_data See FLAC__metadata_probe().
+ * \assert
+ *    \code callback != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__metadata_probe().  Also \c false if a mandatory callback
+ *    is missing.
+ */
+FLAC_API FLAC__bool FLAC__metadata_probe_with_callbacks(FLAC__IOHandle handle, FLAC__IOCallbacks callbacks, unsigned types, FLAC__MetadataProbeCallback callback, void *client_data);
+
+/* \} */
+
+
+/** \defgroup flac_metadata_indexer FLAC/metadata.h: metadata indexer interface
+ *  \ingroup flac_metadata
+ *
+ *  \brief
+ *  The metadata indexer reads the metadata of many files at once, e.g.
+ *  to build or refresh the index of a music library.
+ *
+ *  Add the files by name or as I/O handles, pick what to read with
+ *  FLAC__metadata_indexer_set_types() and
+ *  FLAC__metadata_indexer_set_tag_names(), then call
+ *  FLAC__metadata_indexer_run().  Each file is read with
+ *  FLAC__metadata_probe() and boiled down to a compact
+ *  FLAC__MetadataIndexEntry: the STREAMINFO, the selected tags, and the
+ *  size of the pictures, without their data.  The probe is used rather
+ *  than the level 1 or level 2 readers because it stops after the
+ *  wanted blocks and seeks past PICTURE data, where those readers build
+ *  a chain of every block, only to have it boiled down and thrown away.
+ *
+ *  The files are read by a fixed number of workers, so there are never
+ *  more than that many files open and being read at once, however many
+ *  are queued.  Keep it low (1 or 2) for a spinning disk, where reads of
+ *  several files at once only make the head seek back and forth, and
+ *  higher (8 to 16) for network file systems, where each read mostly
+ *  waits on the round trip.  Where libFLAC is built without thread
+ *  support, FLAC__metadata_indexer_run() reads the files one by one on
+ *  the calling thread; the application can instead call
+ *  FLAC__metadata_indexer_work() from threads of its own, e.g. thread
+ *  pool work items.  Windows Store and Phone apps cannot create threads,
+ *  so this is the case there; the Windows Runtime MetadataIndexer class
+ *  does it for them, with one thread pool work item per worker.
+ *
+ * \{
+ */
+
+/** Status of one entry of a metadata indexer. */
+typedef enum {
+
+	FLAC__METADATA_INDEX_STATUS_OK = 0,
+	/**< The file was read. */
+
+	FLAC__METADATA_INDEX_STATUS_NOT_READ,
+	/**< No worker has got to the file yet. */
+
+	FLAC__METADATA_INDEX_STATUS_ERROR_OPENING_FILE,
+	/**< The file could not be opened, or the handle could not be rewound. */
+
+	FLAC__METADATA_INDEX_STATUS_NOT_A_FLAC_FILE,
+	/**< The file is not a native FLAC file. */
+
+	FLAC__METADATA_INDEX_STATUS_READ_ERROR,
+	/**< The file could not be read or has a malformed metadata block. */
+
+	FLAC__METADATA_INDEX_STATUS_MEMORY_ALLOCATION_ERROR
+	/**< There was an error allocating memory. */
+
+} FLAC__MetadataIndexStatus;
+
+/** Maps a FLAC__MetadataIndexStatus to a C string.
+ *
+ *  Using a FLAC__MetadataIndexStatus as the index to this array
+ *  will give the string equivalent.  The contents should not be modified.
+ */
+extern FLAC_API const char * const FLAC__MetadataIndexStatusString[];
+
+/** The metadata of one file, as read by the metadata indexer.  All of
+ *  the memory belongs to the indexer.
+ */
+typedef struct {
+	FLAC__MetadataIndexStatus status;
+	/**< Whether the file was read.  If it is not
+	 *   #FLAC__METADATA_INDEX_STATUS_OK the rest is zero. */
+
+	FLAC__bool has_stream_info;
+	/**< \c true if STREAMINFO was asked for and read. */
+
+	FLAC__StreamMetadata_StreamInfo stream_info;
+	/**< The STREAMINFO block, if \a has_stream_info. */
+
+	unsigned num_tags;
+	/**< The number of entries in \a tags. */
+
+	const char * const *tags;
+	/**< The selected Vorbis comments, as NUL-terminated \c NAME=value
+	 *   strings in stream order, or \c NULL if there are none. */
+
+	unsigned num_pictures;
+	/**< The number of PICTURE blocks, if PICTURE was asked for. */
+
+	FLAC__StreamMetadata_Picture_Type picture_type;
+	/**< The type of the picture described below: the first front cover,
+	 *   or the first picture if there is no front cover. */
+
+	FLAC__uint32 picture_width;
+	/**< The width of that picture in pixels. */
+
+	FLAC__uint32 picture_height;
+	/**< The height of that picture in pixels. */
+
+	FLAC__uint32 picture_depth;
+	/**< The color depth of that picture in bits per pixel. */
+
+	FLAC__uint32 picture_data_length;
+	/**< The length of the data of that picture in bytes. */
+} FLAC__MetadataIndexEntry;
+
+/** The opaque structure definition for the metadata indexer type.
+ *  See the \link flac_metadata_indexer metadata indexer module \endlink
+ *  for a detailed description.
+ */
+struct FLAC__MetadataIndexer;
+typedef struct FLAC__MetadataIndexer FLAC__MetadataIndexer;
+
+/** Create a new metadata indexer instance.  By default it reads the
+ *  STREAMINFO and all the tags.
+ *
+ * \retval FLAC__MetadataIndexer*
+ *    \c NULL if there was an error allocating memory, else the new instance.
+ */
+FLAC_API FLAC__MetadataIndexer *FLAC__metadata_indexer_new(void);
+
+/** Free a metadata indexer instance.  Deletes the object pointed to by
+ *  \a indexer, and with it all the entries.  None of the added I/O
+ *  handles are closed.  It must not be running.
+ *
+ * \param indexer  A pointer to an existing indexer.
+ * \assert
+ *    \code indexer != NULL \endcode
+ */
+FLAC_API void FLAC__metadata_indexer_delete(FLAC__MetadataIndexer *indexer);
+
+/** Set the metadata types to read, as an OR of FLAC__METADATA_PROBE_TYPE()
+ *  values.  Only the STREAMINFO, VORBIS_COMMENT, and PICTURE bits have a
+ *  place in FLAC__MetadataIndexEntry; the other bits are ignored.  It
+ *  can only be set before the first file is added.
+ *
+ * \param indexer  A pointer to an existing indexer.
+ * \param types    The types to read.
+ * \assert
+ *    \code indexer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if files were already added, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__metadata_indexer_set_types(FLAC__MetadataIndexer *indexer, unsigned types);
+
+/** Set the names of the Vorbis comment fields to keep in the entries,
+ *  matched without regard to case like
+ *  FLAC__metadata_object_vorbiscomment_entry_matches() does.  The names
+ *  are copied.  It can only be set before the first file is added.
+ *
+ * \param indexer  A pointer to an existing indexer.
+ * \param names    A \c NULL-terminated array of field names, e.g.
+ *                 \c {"ARTIST","ALBUM","TITLE",NULL}, or \c NULL to
+ *                 keep all the comments (the default).
+ * \assert
+ *    \code indexer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if files were already added or there was an error
+ *    allocating memory, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__metadata_indexer_set_tag_names(FLAC__MetadataIndexer *indexer, const char * const names[]);
+
+/** Queue a file by name.  The entry for it gets the next index, starting
+ *  from 0.  Files cannot be added while the indexer is running.
+ *
+ * \param indexer   A pointer to an existing indexer.
+ * \param filename  The path to the FLAC file.  It is copied.
+ * \assert
+ *    \code indexer != NULL \endcode
+ *    \code filename != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if there was an error allocating memory, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__metadata_indexer_add_file(FLAC__MetadataIndexer *indexer, const char *filename);
+
+/** Queue a FLAC stream given as an I/O handle and callbacks.  The entry
+ *  for it gets the next index, starting from 0.  The stream is read from
+ *  the beginning, and the handle must stay valid until the indexer is
+ *  done with it; it is used by one worker only.
+ *
+ * \param indexer    A pointer to an existing indexer.
+ * \param handle     The I/O handle of the FLAC stream to read.
+ * \param callbacks  A set of callbacks to use for I/O.  The mandatory
+ *                   callbacks are \a read and \a seek.
+ * \assert
+ *    \code indexer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if a mandatory callback is missing or there was an error
+ *    allocating memory, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__metadata_indexer_add_stream(FLAC__MetadataIndexer *indexer, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks);
+
+/** Get the number of queued files.
+ *
+ * \param indexer  A pointer to an existing indexer.
+ * \assert
+ *    \code indexer != NULL \endcode
+ * \retval unsigned
+ *    The number of entries.
+ */
+FLAC_API unsigned FLAC__metadata_indexer_get_count(const FLAC__MetadataIndexer *indexer);
+
+/** Read queued files on the calling thread until there are none left
+ *  that no other worker has taken.  Where libFLAC is built with thread
+ *  support this can be called from any number of threads at once; each
+ *  call is one worker.
+ *
+ * \param indexer  A pointer to an existing indexer.
+ * \assert
+ *    \code indexer != NULL \endcode
+ */
+FLAC_API void FLAC__metadata_indexer_work(FLAC__MetadataIndexer *indexer);
+
+/** Read all the queued files with up to \a max_in_flight workers, and
+ *  return when they are done.  The calling thread is one of the
+ *  workers.  Files queued after a run are read by the next run.
+ *
+ * \param indexer        A pointer to an existing indexer.
+ * \param max_in_flight  The most files to read at once.  \c 0 is taken
+ *                       as \c 1.
+ * \assert
+ *    \code indexer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c true if every file was read, \c false if any entry has a status
+ *    other than #FLAC__METADATA_INDEX_STATUS_OK.  Look at the entries to
+ *    see which.
+ */
+FLAC_API FLAC__bool FLAC__metadata_indexer_run(FLAC__MetadataIndexer *indexer, unsigned max_in_flight);
+
+/** Get the entry for a queued file.  The entry is only complete once its
+ *  status is no longer #FLAC__METADATA_INDEX_STATUS_NOT_READ, so only
+ *  look at it after the workers are done.
+ *
+ * \param indexer  A pointer to an existing indexer.
+ * \param index    The index of the file, in the order it was added.
+ * \assert
+ *    \code indexer != NULL \endcode
+ *    \code index < FLAC__metadata_indexer_get_count(indexer) \endcode
+ * \retval const FLAC__MetadataIndexEntry*
+ *    The entry, owned by the indexer.
+ */
+FLAC_API const FLAC__MetadataIndexEntry *FLAC__metadata_indexer_get_entry(const FLAC__MetadataIndexer *indexer, unsigned index);
+
 /* \} */
 
 
@@ -651,6 +975,120 @@ FLAC_API FLAC__bool FLAC__metadata_simple_iterator_delete_block(FLAC__Metadata_S
 /* \} */
 
 
+/** \defgroup flac_metadata_arena FLAC/metadata.h: metadata arena interface
+ *  \ingroup flac_metadata
+ *
+ *  \brief
+ *  A metadata arena holds all the metadata blocks of a file, read-only,
+ *  in one contiguous allocation.
+ *
+ *  Reading a file into metadata objects, e.g. with a chain, takes an
+ *  allocation for every Vorbis comment, seek table, cue sheet track and
+ *  so on, and cloning or freeing the objects takes as many again.  An
+ *  arena is read with two allocations, one of them temporary, is freed
+ *  with one call to FLAC__metadata_arena_delete(), and is cloned with
+ *  FLAC__metadata_arena_clone() at the cost of one allocation and a copy.
+ *
+ *  The blocks of an arena are ordinary FLAC__StreamMetadata structures
+ *  and can be read as such, but they belong to the arena and must not be
+ *  modified or passed to FLAC__metadata_object_delete().  To get a block
+ *  that can be edited or outlives the arena, copy it with
+ *  FLAC__metadata_object_clone().
+ *
+ * \{
+ */
+
+/** The opaque structure definition for the metadata arena type.
+ *  See the \link flac_metadata_arena metadata arena module \endlink
+ *  for a detailed description.
+ */
+struct FLAC__MetadataArena;
+typedef struct FLAC__MetadataArena FLAC__MetadataArena;
+
+/** Read all the metadata blocks of a FLAC file into a new arena.
+ *
+ * \param filename  The path to the FLAC file to read.
+ * \param status    If not \c NULL, set to why the read failed, or to
+ *                  #FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK.  A block
+ *                  that does not parse gives
+ *                  #FLAC__METADATA_SIMPLE_ITERATOR_STATUS_BAD_METADATA.
+ * \assert
+ *    \code filename != NULL \endcode
+ * \retval FLAC__MetadataArena*
+ *    The new arena, or \c NULL on error.
+ */
+FLAC_API FLAC__MetadataArena *FLAC__metadata_arena_read(const char *filename, FLAC__Metadata_SimpleIteratorStatus *status);
+
+/** Like FLAC__metadata_arena_read(), but reads the FLAC stream through
+ *  I/O callbacks, from where the handle is, which must be the start of
+ *  the stream.
+ *
+ * \param handle     The I/O handle of the FLAC stream to read.  It is not
+ *                   closed.
+ * \param callbacks  A set of callbacks to use for I/O.  The mandatory
+ *                   callbacks are \a read and \a seek.
+ * \param status     See FLAC__metadata_arena_read().
+ * \retval FLAC__MetadataArena*
+ *    The new arena, or \c NULL on error.
+ */
+FLAC_API FLAC__MetadataArena *FLAC__metadata_arena_read_with_callbacks(FLAC__IOHandle handle, FLAC__IOCallbacks callbacks, FLAC__Metadata_SimpleIteratorStatus *status);
+
+/** Copy an arena.  This is a single allocation and copy, however many
+ *  blocks and entries the arena holds.
+ *
+ * \param arena  A pointer to an existing arena.
+ * \assert
+ *    \code arena != NULL \endcode
+ * \retval FLAC__MetadataArena*
+ *    The copy, or \c NULL if there was an error allocating memory.
+ */
+FLAC_API FLAC__MetadataArena *FLAC__metadata_arena_clone(const FLAC__MetadataArena *arena);
+
+/** Free an arena and all of its blocks.
+ *
+ * \param arena  A pointer to an existing arena.
+ * \assert
+ *    \code arena != NULL \endcode
+ */
+FLAC_API void FLAC__metadata_arena_delete(FLAC__MetadataArena *arena);
+
+/** Get the number of blocks in an arena.
+ *
+ * \param arena  A pointer to an existing arena.
+ * \assert
+ *    \code arena != NULL \endcode
+ * \retval unsigned
+ *    The number of blocks, in stream order; the last one has \a is_last
+ *    set.
+ */
+FLAC_API unsigned FLAC__metadata_arena_get_count(const FLAC__MetadataArena *arena);
+
+/** Get a block of an arena.
+ *
+ * \param arena  A pointer to an existing arena.
+ * \param index  The index of the block in the stream.
+ * \assert
+ *    \code arena != NULL \endcode
+ *    \code index < FLAC__metadata_arena_get_count(arena) \endcode
+ * \retval const FLAC__StreamMetadata*
+ *    The block, owned by the arena.
+ */
+FLAC_API const FLAC__StreamMetadata *FLAC__metadata_arena_get_block(const FLAC__MetadataArena *arena, unsigned index);
+
+/** Get the total size of an arena in bytes, i.e. what
+ *  FLAC__metadata_arena_clone() copies.
+ *
+ * \param arena  A pointer to an existing arena.
+ * \assert
+ *    \code arena != NULL \endcode
+ * \retval size_t
+ *    The size of the arena's allocation.
+ */
+FLAC_API size_t FLAC__metadata_arena_get_size(const FLAC__MetadataArena *arena);
+
+/* \} */
+
+
 /** \defgroup flac_metadata_level2 FLAC/metadata.h: metadata level 2 interface
  *  \ingroup flac_metadata
  *
@@ -818,6 +1256,71 @@ FLAC_API void FLAC__metadata_chain_delete(FLAC__Metadata_Chain *chain);
  */
 FLAC_API FLAC__Metadata_ChainStatus FLAC__metadata_chain_status(FLAC__Metadata_Chain *chain);
 
+/** Leave the data of PICTURE blocks in the file when reading the chain.
+ *
+ *  With lazy pictures on, the PICTURE blocks read into the chain by later
+ *  calls to FLAC__metadata_chain_read() or
+ *  FLAC__metadata_chain_read_with_callbacks() have \c NULL data, with the
+ *  offset of the data in the stream in \a data_offset; use
+ *  FLAC__metadata_object_picture_load_data() to read it if it is wanted.
+ *  Lazy pictures still in the chain are read in by the write calls before
+ *  anything is written, from the file for FLAC__metadata_chain_write()
+ *  and from \a handle for the callback versions, which then also need
+ *  the \a read callback.  Ogg FLAC chains always read picture data.
+ *
+ *  The setting is kept across reads of the chain.  The default is
+ *  \c false.
+ *
+ * \param chain  A pointer to an existing chain.
+ * \param value  Flag value (see above).
+ * \assert
+ *    \code chain != NULL \endcode
+ */
+FLAC_API void FLAC__metadata_chain_set_lazy_pictures(FLAC__Metadata_Chain *chain, FLAC__bool value);
+
+/** Let edits be taken up by a PADDING block that is not the last block.
+ *
+ *  By default the write calls only use padding to write in place when
+ *  the last block is a PADDING block, as described for
+ *  FLAC__metadata_chain_write().  With \a value \c true they use the last
+ *  PADDING block in the chain wherever it is, e.g. one left before an
+ *  APPLICATION block, and FLAC__metadata_chain_check_if_tempfile_needed()
+ *  follows the same rule.  The blocks keep their order either way.
+ *
+ *  The setting is kept across reads of the chain.  The default is
+ *  \c false.
+ *
+ * \param chain  A pointer to an existing chain.
+ * \param value  Flag value (see above).
+ * \assert
+ *    \code chain != NULL \endcode
+ */
+FLAC_API void FLAC__metadata_chain_set_any_padding(FLAC__Metadata_Chain *chain, FLAC__bool value);
+
+/** Set how much padding to leave when a write has to rewrite the file.
+ *
+ *  When \a use_padding is \c true and the edited metadata cannot be
+ *  written in place, the whole file gets rewritten anyway, so that is
+ *  the cheapest time to make room for later edits: the padding block
+ *  that takes up edits (see FLAC__metadata_chain_set_any_padding()) is
+ *  grown, or one added at the end, to at least \a minimum bytes and at least
+ *  \a percent percent of the length of the rest of the metadata, up to
+ *  the largest block the format allows.  Later edits that fit into that
+ *  padding are then written in place.  A padding block that is already
+ *  larger is left as it is.
+ *
+ *  The setting is kept across reads of the chain.  The default is
+ *  \c 0 and \c 0, i.e. no extra padding.
+ *
+ * \param chain    A pointer to an existing chain.
+ * \param minimum  The least padding to leave, in bytes.
+ * \param percent  The least padding to leave, as a percentage of the
+ *                 length of the other metadata blocks.
+ * \assert
+ *    \code chain != NULL \endcode
+ */
+FLAC_API void FLAC__metadata_chain_set_padding_headroom(FLAC__Metadata_Chain *chain, unsigned minimum, unsigned percent);
+
 /** Read all metadata from a FLAC file into the chain.
  *
  * \param chain    A pointer to an existing chain.
@@ -909,6 +1412,14 @@ FLAC_API FLAC__bool FLAC__metadata_chain_read_ogg_with_callbacks(FLAC__Metadata_
  *  writing with FLAC__metadata_chain_write(), the temporary file is
  *  handled internally.
  *
+ *  For a chain read from a file on Linux, this also counts the writes
+ *  that FLAC__metadata_chain_write() does by having the filesystem insert
+ *  room in front of the audio, so that \c false means the audio will not
+ *  be copied.  It goes by the type and block size of the filesystem, and
+ *  on ext2/ext3/ext4, which look alike to statfs(), by whether the file
+ *  uses extents; if the filesystem still refuses the insert the write
+ *  falls back to a temporary file after all.
+ *
  * \param chain    A pointer to an existing chain.
  * \param use_padding
  *                 Whether or not padding will be allowed to be used
@@ -937,10 +1448,19 @@ FLAC_API FLAC__bool FLAC__metadata_chain_check_if_tempfile_needed(FLAC__Metadata
  *  so that the overall size of the metadata is the same as the existing
  *  metadata, and then just rewrite the metadata.  Otherwise, if not all of
  *  the above conditions are met, the entire FLAC file must be rewritten.
+ *  On Linux, with \a use_padding \c true, the function first asks the
+ *  filesystem to insert whole blocks in front of the audio
+ *  (\c FALLOC_FL_INSERT_RANGE, supported by ext4, XFS and F2FS), with the
+ *  padding taking up the rounding, so that the audio does not have to be
+ *  copied; it falls back to rewriting the file if that fails.  Whenever
+ *  the file is rewritten one way or the other, the padding is grown as
+ *  set with FLAC__metadata_chain_set_padding_headroom().
  *  If you want to use padding this way it is a good idea to call
  *  FLAC__metadata_chain_sort_padding() first so that you have the maximum
  *  amount of padding to work with, unless you need to preserve ordering
- *  of the PADDING blocks for some reason.
+ *  of the PADDING blocks for some reason, in which case
+ *  FLAC__metadata_chain_set_any_padding() lets the last PADDING block
+ *  be used wherever it is.
  *
  *  If the current chain is shorter than the existing metadata, and
  *  \a use_padding is \c true, and the final block is a PADDING block, the padding
@@ -2154,6 +2674,42 @@ FLAC_API FLAC__bool FLAC__metadata_object_picture_set_description(FLAC__StreamMe
  */
 FLAC_API FLAC__bool FLAC__metadata_object_picture_set_data(FLAC__StreamMetadata *object, FLAC__byte *data, FLAC__uint32 length, FLAC__bool copy);
 
+/** Read the data of a lazily read PICTURE block from the stream it came
+ *  from.  A PICTURE block read by a decoder with
+ *  FLAC__stream_decoder_set_lazy_pictures(), or by a chain with
+ *  FLAC__metadata_chain_set_lazy_pictures(), has \c NULL data and the
+ *  offset of the data in \a data_offset; this reads the \a data_length
+ *  bytes at that offset into the object.  If the object already has its
+ *  data, or has none to read, this does nothing.
+ *
+ * \param object     A pointer to an existing PICTURE object.
+ * \param handle     The I/O handle of the FLAC stream the block was read
+ *                   from.
+ * \param callbacks  A set of callbacks to use for I/O.  The mandatory
+ *                   callbacks are \a read and \a seek.
+ * \assert
+ *    \code object != NULL \endcode
+ *    \code object->type == FLAC__METADATA_TYPE_PICTURE \endcode
+ * \retval FLAC__bool
+ *    \c false if malloc(), seeking or reading fails, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__metadata_object_picture_load_data(FLAC__StreamMetadata *object, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks);
+
+/** Like FLAC__metadata_object_picture_load_data(), but reads from the
+ *  named file.
+ *
+ * \param object    A pointer to an existing PICTURE object.
+ * \param filename  The path to the FLAC file the block was read from.
+ * \assert
+ *    \code object != NULL \endcode
+ *    \code object->type == FLAC__METADATA_TYPE_PICTURE \endcode
+ *    \code filename != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the file cannot be opened, or malloc(), seeking or
+ *    reading fails, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__metadata_object_picture_load_data_from_file(FLAC__StreamMetadata *object, const char *filename);
+
 /** Check a PICTURE block to see if it conforms to the FLAC specification.
  *  See the format specification for limits on the contents of the
  *  PICTURE block.
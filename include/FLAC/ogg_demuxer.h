@@ -0,0 +1,352 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2001-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLAC__OGG_DEMUXER_H
+#define FLAC__OGG_DEMUXER_H
+
+#include <stdio.h> /* for FILE */
+#include "export.h"
+#include "stream_decoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** \file include/FLAC/ogg_demuxer.h
+ *
+ *  \brief
+ *  This module contains the functions which implement the Ogg FLAC
+ *  demuxer.
+ *
+ *  See the detailed documentation in the
+ *  \link flac_ogg_demuxer Ogg demuxer \endlink module.
+ */
+
+/** \defgroup flac_ogg_demuxer FLAC/ogg_demuxer.h: Ogg demuxer interface
+ *  \ingroup flac_decoder
+ *
+ *  \brief
+ *  This module contains the functions which implement the Ogg FLAC
+ *  demuxer.
+ *
+ * A stream decoder initialized for Ogg FLAC decodes one logical stream,
+ * picked by serial number, and skips the pages of all the others.  To
+ * get at every FLAC stream in a multiplexed or chained Ogg file with
+ * stream decoders alone, the file has to be read once per stream.  The
+ * demuxer reads the file once and hands the pages of each FLAC stream
+ * to a stream decoder of its own.
+ *
+ * The basic usage of the demuxer is as follows:
+ * - The program creates an instance of a demuxer using
+ *   FLAC__ogg_demuxer_new().
+ * - The program initializes the instance with FLAC__ogg_demuxer_init_stream()
+ *   or FLAC__ogg_demuxer_init_FILE(), giving it a new stream callback.
+ * - The program calls FLAC__ogg_demuxer_process_single() or
+ *   FLAC__ogg_demuxer_process_until_end_of_stream().  Each time the
+ *   start of a FLAC stream is found the demuxer creates a stream decoder
+ *   for it and calls the new stream callback, which may set options on
+ *   the decoder and must supply the write, metadata and error callbacks
+ *   for it, or skip the stream.  The decoders then call those callbacks
+ *   as their streams are decoded, all in the one pass over the input.
+ * - The program finishes the demuxing with FLAC__ogg_demuxer_finish().
+ * - The instance may be used again or deleted with
+ *   FLAC__ogg_demuxer_delete().
+ *
+ * The stream decoders belong to the demuxer.  Each is finished and
+ * deleted when its stream ends; the callbacks may call the
+ * FLAC__stream_decoder_get_*() functions on the decoder they are passed
+ * but must not call the process, seek, flush, reset or finish functions.
+ * The demuxer cannot seek.
+ *
+ * \{
+ */
+
+
+struct FLAC__OggDemuxer;
+/** The opaque structure definition for the Ogg demuxer type.
+ *  See the \link flac_ogg_demuxer Ogg demuxer module \endlink
+ *  for a detailed description.
+ */
+typedef struct FLAC__OggDemuxer FLAC__OggDemuxer;
+
+/** State values for a FLAC__OggDemuxer.
+ *
+ * The demuxer's state can be obtained by calling FLAC__ogg_demuxer_get_state().
+ */
+typedef enum {
+
+	FLAC__OGG_DEMUXER_OK = 0,
+	/**< The demuxer is ready to process more data. */
+
+	FLAC__OGG_DEMUXER_END_OF_STREAM,
+	/**< The demuxer has reached the end of the input and of every
+	 *   stream in it. */
+
+	FLAC__OGG_DEMUXER_READ_ERROR,
+	/**< The read callback returned an error. */
+
+	FLAC__OGG_DEMUXER_DECODER_ERROR,
+	/**< A stream decoder failed to initialize or returned a fatal
+	 *   error; the new stream callback may have returned \c false to
+	 *   end the demuxing, or a write callback may have aborted. */
+
+	FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR,
+	/**< An error occurred allocating memory. */
+
+	FLAC__OGG_DEMUXER_UNSUPPORTED_CONTAINER,
+	/**< The library was not compiled with support for Ogg FLAC. */
+
+	FLAC__OGG_DEMUXER_UNINITIALIZED
+	/**< The demuxer is in the uninitialized state; one of the
+	 *   FLAC__ogg_demuxer_init_*() functions must be called before it
+	 *   can be used. */
+
+} FLAC__OggDemuxerState;
+
+/** Maps a FLAC__OggDemuxerState to a C string.
+ *
+ *  Using a FLAC__OggDemuxerState as the index to this array
+ *  will give the string equivalent.  The contents should not be modified.
+ */
+extern FLAC_API const char * const FLAC__OggDemuxerStateString[];
+
+
+/** Signature for the read callback.
+ *  See FLAC__ogg_demuxer_init_stream(); this works like the read
+ *  callback of the stream decoder, see FLAC__StreamDecoderReadCallback.
+ *
+ * \param  demuxer      The demuxer instance calling the callback.
+ * \param  buffer       A pointer to a location for the callee to store
+ *                      data to be demuxed.
+ * \param  bytes        A pointer to the size of the buffer.  On entry
+ *                      to the callback, it contains the maximum number
+ *                      of bytes that may be stored in \a buffer.  The
+ *                      callee must set it to the actual number of bytes
+ *                      stored (0 in case of error or end-of-stream) before
+ *                      returning.
+ * \param  client_data  The callee's client data set through
+ *                      FLAC__ogg_demuxer_init_*().
+ * \retval FLAC__StreamDecoderReadStatus
+ *    The callee's return status.
+ */
+typedef FLAC__StreamDecoderReadStatus (*FLAC__OggDemuxerReadCallback)(const FLAC__OggDemuxer *demuxer, FLAC__byte buffer[], size_t *bytes, void *client_data);
+
+/** The callbacks a stream decoder created by the demuxer will call for
+ *  its stream; see FLAC__OggDemuxerNewStreamCallback.
+ */
+typedef struct {
+	FLAC__StreamDecoderWriteCallback write_callback;
+	/**< Required; see FLAC__stream_decoder_init_stream(). */
+
+	FLAC__StreamDecoderMetadataCallback metadata_callback;
+	/**< Optional, may be \c NULL; see FLAC__stream_decoder_init_stream(). */
+
+	FLAC__StreamDecoderErrorCallback error_callback;
+	/**< Required; see FLAC__stream_decoder_init_stream(). */
+
+	void *client_data;
+	/**< This value will be supplied to the three callbacks above. */
+
+} FLAC__OggDemuxerStreamCallbacks;
+
+/** Signature for the new stream callback.
+ *  See FLAC__ogg_demuxer_init_stream().
+ *
+ *  The demuxer calls this each time it finds the first page of an Ogg
+ *  FLAC stream.  \a decoder is a new, uninitialized stream decoder for
+ *  it; the callee may set options on it, like with
+ *  FLAC__stream_decoder_set_md5_checking() or
+ *  FLAC__stream_decoder_set_metadata_respond(), and then either fills
+ *  in \a callbacks and returns \c true, or sets
+ *  \a callbacks->write_callback to \c NULL and returns \c true to skip
+ *  the stream.  The demuxer initializes the decoder itself.
+ *
+ * \param  demuxer        The demuxer instance calling the callback.
+ * \param  serial_number  The serial number of the new stream.
+ * \param  decoder        The stream decoder for the new stream.
+ * \param  callbacks      Where to store the callbacks for the stream.
+ *                        Set to all \c NULL on entry.
+ * \param  client_data    The callee's client data set through
+ *                        FLAC__ogg_demuxer_init_*().
+ * \retval FLAC__bool
+ *    \c false to stop the demuxing, which puts the demuxer in the
+ *    \c FLAC__OGG_DEMUXER_DECODER_ERROR state, else \c true.
+ */
+typedef FLAC__bool (*FLAC__OggDemuxerNewStreamCallback)(const FLAC__OggDemuxer *demuxer, long serial_number, FLAC__StreamDecoder *decoder, FLAC__OggDemuxerStreamCallbacks *callbacks, void *client_data);
+
+
+/***********************************************************************
+ *
+ * Class constructor/destructor
+ *
+ ***********************************************************************/
+
+/** Create a new Ogg demuxer instance.
+ *
+ * \retval FLAC__OggDemuxer*
+ *    \c NULL if there was an error allocating memory, else the new instance.
+ */
+FLAC_API FLAC__OggDemuxer *FLAC__ogg_demuxer_new(void);
+
+/** Free a demuxer instance.  Deletes the object pointed to by \a demuxer.
+ *
+ * \param demuxer  A pointer to an existing demuxer.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ */
+FLAC_API void FLAC__ogg_demuxer_delete(FLAC__OggDemuxer *demuxer);
+
+
+/***********************************************************************
+ *
+ * Public class method prototypes
+ *
+ ***********************************************************************/
+
+/** Get the current demuxer state.
+ *
+ * \param  demuxer  A demuxer instance to query.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ * \retval FLAC__OggDemuxerState
+ *    The current demuxer state.
+ */
+FLAC_API FLAC__OggDemuxerState FLAC__ogg_demuxer_get_state(const FLAC__OggDemuxer *demuxer);
+
+/** Get the number of streams the demuxer is decoding at the moment,
+ *  i.e. the ones that have started and not yet ended.
+ *
+ * \param  demuxer  A demuxer instance to query.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ * \retval unsigned
+ *    See above.
+ */
+FLAC_API unsigned FLAC__ogg_demuxer_get_stream_count(const FLAC__OggDemuxer *demuxer);
+
+/** Initialize the demuxer instance to demux Ogg FLAC streams.
+ *
+ *  This flavor of initialization sets up the demuxer to read from the
+ *  client via a read callback.  Pages of streams that are not FLAC, or
+ *  whose first page was not seen, are skipped.
+ *
+ * \param  demuxer              An uninitialized demuxer instance.
+ * \param  read_callback        See FLAC__OggDemuxerReadCallback.  This
+ *                              pointer must not be \c NULL.
+ * \param  new_stream_callback  See FLAC__OggDemuxerNewStreamCallback.
+ *                              This pointer must not be \c NULL.
+ * \param  client_data          This value will be supplied to callbacks
+ *                              in their \a client_data argument.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the demuxer is already initialized or if
+ *    initialization failed, in which case FLAC__ogg_demuxer_get_state()
+ *    tells why; else \c true.
+ */
+FLAC_API FLAC__bool FLAC__ogg_demuxer_init_stream(FLAC__OggDemuxer *demuxer, FLAC__OggDemuxerReadCallback read_callback, FLAC__OggDemuxerNewStreamCallback new_stream_callback, void *client_data);
+
+/** Initialize the demuxer instance to demux Ogg FLAC streams from a file.
+ *
+ *  This is FLAC__ogg_demuxer_init_stream() with the read callback
+ *  supplied internally.
+ *
+ * \param  demuxer              An uninitialized demuxer instance.
+ * \param  file                 An open Ogg FLAC file.  The file should have been
+ *                              opened with mode \c "rb" and rewound.  The file
+ *                              becomes owned by the demuxer and should not be
+ *                              manipulated by the client while demuxing.
+ *                              Unless \a file is \c stdin, it will be closed
+ *                              when FLAC__ogg_demuxer_finish() is called.
+ * \param  new_stream_callback  See FLAC__OggDemuxerNewStreamCallback.
+ *                              This pointer must not be \c NULL.
+ * \param  client_data          This value will be supplied to callbacks
+ *                              in their \a client_data argument.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ *    \code file != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__ogg_demuxer_init_stream().
+ */
+FLAC_API FLAC__bool FLAC__ogg_demuxer_init_FILE(FLAC__OggDemuxer *demuxer, FILE *file, FLAC__OggDemuxerNewStreamCallback new_stream_callback, void *client_data);
+
+/** Finish the demuxing process.
+ *  Finishes and deletes the stream decoders of streams that have not
+ *  ended, closes the file if the demuxer was initialized with
+ *  FLAC__ogg_demuxer_init_FILE(), and puts the demuxer back in the
+ *  uninitialized state.
+ *
+ * \param  demuxer  An initialized demuxer instance.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if MD5 checking was on for a stream and its signature did
+ *    not match (see FLAC__stream_decoder_finish()), else \c true.
+ */
+FLAC_API FLAC__bool FLAC__ogg_demuxer_finish(FLAC__OggDemuxer *demuxer);
+
+/** Demux one round.
+ *  Each stream that is being decoded processes at most one metadata
+ *  block or audio frame, like with FLAC__stream_decoder_process_single(),
+ *  reading from the input as much as that needs; the pages of the other
+ *  streams read meanwhile are kept for them.  If no stream is being
+ *  decoded, one page is read instead, which may start new streams.
+ *
+ * \param  demuxer  An initialized demuxer instance.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if any fatal read, write, or memory allocation error
+ *    occurred (meaning demuxing must stop), else \c true; for more
+ *    information about the demuxer, check the demuxer state with
+ *    FLAC__ogg_demuxer_get_state().
+ */
+FLAC_API FLAC__bool FLAC__ogg_demuxer_process_single(FLAC__OggDemuxer *demuxer);
+
+/** Demux until the end of the input and of every stream in it.
+ *
+ * \param  demuxer  An initialized demuxer instance.
+ * \assert
+ *    \code demuxer != NULL \endcode
+ * \retval FLAC__bool
+ *    See FLAC__ogg_demuxer_process_single().
+ */
+FLAC_API FLAC__bool FLAC__ogg_demuxer_process_until_end_of_stream(FLAC__OggDemuxer *demuxer);
+
+/* \} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
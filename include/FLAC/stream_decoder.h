@@ -34,6 +34,7 @@
 #define FLAC__STREAM_DECODER_H
 
 #include <stdio.h> /* for FILE */
+#include "callback.h"
 #include "export.h"
 #include "format.h"
 
@@ -448,6 +449,64 @@ typedef enum {
 extern FLAC_API const char * const FLAC__StreamDecoderErrorStatusString[];
 
 
+/** The memory held by a decoder or encoder instance, in bytes, broken
+ *  down by subsystem.  Filled in by FLAC__stream_decoder_get_memory_usage()
+ *  and FLAC__stream_encoder_get_memory_usage().  The figures count the
+ *  requested sizes and are approximate: allocator overhead is not
+ *  included.
+ */
+typedef struct {
+	size_t instance;
+	/**< The instance structures themselves. */
+
+	size_t io;
+	/**< The decoder's input buffer or the encoder's frame buffer. */
+
+	size_t samples;
+	/**< The per-channel sample, residual and window buffers. */
+
+	size_t entropy;
+	/**< The residual partition tables. */
+
+	size_t metadata;
+	/**< The decoder's seek table and the metadata block being passed to
+	 * the metadata callback, or the encoder's copy of the metadata array.
+	 */
+
+	size_t md5;
+	/**< The MD5 working buffer. */
+
+	size_t ogg;
+	/**< The Ogg sync and stream state. */
+
+	size_t verify;
+	/**< The encoder's verify FIFO and verify decoder. */
+
+	size_t total;
+	/**< The sum of all of the above. */
+
+} FLAC__MemoryUsage;
+
+
+/** An entry in the Ogg page index of the decoder; see
+ *  FLAC__stream_decoder_set_ogg_page_indexing().
+ */
+typedef struct {
+	FLAC__uint64 stream_offset;
+	/**< The offset in bytes of the first byte of the page, from the
+	 *   start of the stream. */
+
+	FLAC__int64 granule_position;
+	/**< The granule position of the page, which for FLAC is the number
+	 *   of samples up to the end of the last packet that finishes on the
+	 *   page, or \c -1 if no packet finishes on it. */
+
+	long serial_number;
+	/**< The serial number of the logical stream the page belongs to. */
+
+} FLAC__OggPageIndexEntry;
+
+
 /***********************************************************************
  *
  * class FLAC__StreamDecoder
@@ -775,6 +834,36 @@ FLAC_API void FLAC__stream_decoder_delete(FLAC__StreamDecoder *decoder);
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_set_ogg_serial_number(FLAC__StreamDecoder *decoder, long serial_number);
 
+/** Direct the decoder to keep an index of the Ogg pages it reads.
+ *
+ *  For every page that goes by while decoding (including the pages read
+ *  while seeking) the decoder notes its byte offset, granule position
+ *  and serial number.  FLAC__stream_decoder_seek_absolute() then starts
+ *  from the indexed page just before the target instead of searching
+ *  the stream for it, so seeking back to a part of the stream that has
+ *  been played, or anywhere after FLAC__stream_decoder_scan_ogg_page_index(),
+ *  takes a single seek of the input.  The decoder needs a tell callback
+ *  to know the offsets; without one no pages are indexed, and if it
+ *  fails where the decoder starts reading, after init or a flush, no
+ *  pages are indexed until the next flush.
+ *
+ *  Entries added with FLAC__stream_decoder_add_ogg_page_index() or by
+ *  FLAC__stream_decoder_scan_ogg_page_index() are used for seeking
+ *  whether or not this is set.
+ *
+ * \note
+ * This does not need to be set for native FLAC decoding.
+ *
+ * \default \c false
+ * \param  decoder  A decoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_ogg_page_indexing(FLAC__StreamDecoder *decoder, FLAC__bool value);
+
 /** Set the "MD5 signature checking" flag.  If \c true, the decoder will
  *  compute the MD5 signature of the unencoded audio data while decoding
  *  and compare it to the signature from the STREAMINFO block, if it
@@ -797,6 +886,178 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_ogg_serial_number(FLAC__StreamDecod
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *decoder, FLAC__bool value);
 
+/** Set the mask of channels the decoder should restore.  Bit \c N of
+ *  \a mask corresponds to channel \c N of each frame, in the channel
+ *  order given by the FLAC specification.
+ *
+ *  The subframes of channels that are not in the mask are still parsed
+ *  (so that the frame CRC can be verified and the stream stays in sync)
+ *  but their residuals are skipped without being stored and no
+ *  prediction is run for them.  Their buffers passed to the write
+ *  callback are filled with zeroes.  Subframes that are needed to undo
+ *  stereo decorrelation of a requested channel are always restored, so
+ *  e.g. requesting only the right channel of a mid/side frame still
+ *  decodes both subframes.
+ *
+ *  Since the MD5 signature covers all channels, MD5 checking is turned
+ *  off when the mask does not cover every channel of the stream.
+ *
+ * \default \c 0xFF (all channels)
+ * \param  decoder  A decoder instance to set.
+ * \param  mask     See above.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_channel_mask(FLAC__StreamDecoder *decoder, FLAC__uint32 mask);
+
+/** Keep the decoder's working buffers allocated across
+ *  FLAC__stream_decoder_finish() so that a decoder instance can be
+ *  reused for many short streams without hitting the heap each time.
+ *
+ *  When set, FLAC__stream_decoder_finish() keeps the input buffer, the
+ *  per-channel output and residual buffers, the seek table and (for Ogg
+ *  FLAC) the Ogg sync and stream state, and the next
+ *  FLAC__stream_decoder_init_*() call reuses them.  Buffers only grow,
+ *  so once the decoder has seen the largest block size and channel count
+ *  it is going to see, a complete init/process/finish cycle with the
+ *  default settings makes no further allocations.  MD5 checking and the
+ *  metadata blocks passed to the metadata callback still allocate per
+ *  stream.
+ *
+ *  Unlike the other settings, this one is \b not reset to the default
+ *  by FLAC__stream_decoder_finish().  Setting it to \c false frees any
+ *  buffers that are being kept; FLAC__stream_decoder_delete() always
+ *  frees them.
+ *
+ * \default \c false
+ * \param  decoder  A decoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_retain_buffers(FLAC__StreamDecoder *decoder, FLAC__bool value);
+
+/** Set the allocator the decoder uses for its working memory.
+ *
+ *  Everything the decoder allocates for decoding a stream goes through
+ *  \a callbacks: the input buffer, the output and residual buffers, the
+ *  residual partition tables, the seek table, the MD5 buffer and the
+ *  metadata blocks passed to the metadata callback.  The decoder object
+ *  itself and the metadata filter list are still allocated from the C
+ *  runtime heap, as is the Ogg sync and stream state of Ogg FLAC (see
+ *  \c _ogg_malloc in ogg/os_types.h).
+ *
+ *  Unless FLAC__stream_decoder_set_retain_buffers() is set, all memory
+ *  obtained through \a callbacks is returned by the time
+ *  FLAC__stream_decoder_finish() returns, so e.g. an arena can be
+ *  released in one shot after finish().  The callbacks are called only
+ *  from the thread calling into the decoder.
+ *
+ *  Like FLAC__stream_decoder_set_retain_buffers() this setting is \b not
+ *  reset by FLAC__stream_decoder_finish().  Changing it frees any buffers
+ *  that are being kept.
+ *
+ * \default \c NULL (the C runtime heap)
+ * \param  decoder    A decoder instance to set.
+ * \param  callbacks  The allocator to use, copied by the decoder, or
+ *                    \c NULL to go back to the C runtime heap.  If not
+ *                    \c NULL, all three callbacks must be set.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized or \a callbacks is
+ *    incomplete, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_memory_callbacks(FLAC__StreamDecoder *decoder, const FLAC__MemoryCallbacks *callbacks);
+
+/** Set a limit on the memory the decoder may hold, as reported by
+ *  FLAC__stream_decoder_get_memory_usage().
+ *
+ *  Before a buffer is grown (the sample buffers when a frame with a
+ *  larger block size or more channels comes along, the seek table, the
+ *  residual partition tables and any metadata block to be passed to the
+ *  metadata callback) the decoder checks that the new total would stay
+ *  within \a limit.  If not, it does not allocate and the state becomes
+ *  \c FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR, just as if the
+ *  allocation had failed.  The Ogg sync and stream state are counted but
+ *  not checked since libogg sizes them itself; they are bounded by the
+ *  Ogg page size.
+ *
+ * \default \c 0 (no limit)
+ * \param  decoder  A decoder instance to set.
+ * \param  limit    The limit in bytes, or \c 0 for no limit.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_memory_limit(FLAC__StreamDecoder *decoder, size_t limit);
+
+/** Set the size of the read buffer.
+ *
+ *  Normally the read callback is called whenever the decoder's input
+ *  buffer runs low, and is asked for whatever space is free in it,
+ *  which is at most a few kilobytes at a time.  With a non-zero
+ *  \a bytes the decoder instead asks the read callback for chunks of
+ *  \a bytes and serves its own input from that buffer, so a callback
+ *  with a high fixed cost per call (network or asynchronous I/O) is
+ *  called far less often.  A good value is somewhere from 64k to 1M.
+ *
+ *  The read callback is still called synchronously on the decoding
+ *  thread, when the buffer is empty, so on its own this cuts the number
+ *  of calls but does not overlap I/O with decoding.  Clients that want
+ *  that must prefetch behind their own read callback, as the Windows
+ *  Runtime StreamDecoder does for an IRandomAccessStream.
+ *
+ *  The read buffer is discarded whenever the seek callback moves the
+ *  stream or fails, but kept when it returns
+ *  \c FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED, and the tell and EOF
+ *  callbacks are adjusted for the data still in it, so the client
+ *  callbacks need no changes.  If the client moves the stream position
+ *  itself it must call FLAC__stream_decoder_flush() afterwards, as it
+ *  would otherwise.
+ *
+ * \default \c 0 (no read buffer)
+ * \param  decoder  A decoder instance to set.
+ * \param  bytes    The read chunk size in bytes, or \c 0 to read
+ *                  straight into the input buffer.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_read_buffer_size(FLAC__StreamDecoder *decoder, unsigned bytes);
+
+/** Leave the data of PICTURE blocks in the stream.
+ *
+ *  With lazy pictures on, a PICTURE block passed to the metadata
+ *  callback has everything but the picture itself: its \a data is
+ *  \c NULL and its \a data_offset is where the \a data_length bytes
+ *  start in the stream, to be read later only if they are wanted, e.g.
+ *  with FLAC__metadata_object_picture_load_data() on a clone of the
+ *  block.  The decoder seeks past the data if it can, and otherwise
+ *  reads past it without keeping it.  Cover art is often megabytes, so
+ *  this saves a lot of memory, and often I/O, when the metadata is only
+ *  being browsed.
+ *
+ *  Offsets are only known for native FLAC streams with a tell
+ *  callback; in Ogg FLAC streams, or without a tell callback, the
+ *  picture data is read as usual.
+ *
+ * \default \c false
+ * \param  decoder  A decoder instance to set.
+ * \param  value    Flag value (see above).
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the decoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_set_lazy_pictures(FLAC__StreamDecoder *decoder, FLAC__bool value);
+
 /** Direct the decoder to pass on all metadata blocks of type \a type.
  *
  * \default By default, only the \c STREAMINFO block is returned via the
@@ -913,6 +1174,85 @@ FLAC_API const char *FLAC__stream_decoder_get_resolved_state_string(const FLAC__
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_get_md5_checking(const FLAC__StreamDecoder *decoder);
 
+/** Get the mask of channels the decoder restores.
+ *  See FLAC__stream_decoder_set_channel_mask().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__uint32
+ *    See above.
+ */
+FLAC_API FLAC__uint32 FLAC__stream_decoder_get_channel_mask(const FLAC__StreamDecoder *decoder);
+
+/** Get the "Ogg page indexing" flag.
+ *  See FLAC__stream_decoder_set_ogg_page_indexing().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See above.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_ogg_page_indexing(const FLAC__StreamDecoder *decoder);
+
+/** Get the "retain buffers" flag.
+ *  See FLAC__stream_decoder_set_retain_buffers().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See above.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_retain_buffers(const FLAC__StreamDecoder *decoder);
+
+/** Get the memory limit.
+ *  See FLAC__stream_decoder_set_memory_limit().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval size_t
+ *    See above.
+ */
+FLAC_API size_t FLAC__stream_decoder_get_memory_limit(const FLAC__StreamDecoder *decoder);
+
+/** Get the read buffer size.
+ *  See FLAC__stream_decoder_set_read_buffer_size().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval unsigned
+ *    See above.
+ */
+FLAC_API unsigned FLAC__stream_decoder_get_read_buffer_size(const FLAC__StreamDecoder *decoder);
+
+/** Get the lazy pictures flag.
+ *  See FLAC__stream_decoder_set_lazy_pictures().
+ *
+ * \param  decoder  A decoder instance to query.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    See above.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_get_lazy_pictures(const FLAC__StreamDecoder *decoder);
+
+/** Get the memory currently held by the decoder, broken down by
+ *  subsystem.  This may be called at any time, including from inside
+ *  the decoder callbacks and after FLAC__stream_decoder_finish() (when
+ *  it shows what FLAC__stream_decoder_set_retain_buffers() is keeping).
+ *
+ * \param  decoder  A decoder instance to query.
+ * \param  usage    Address at which to return the figures.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code usage != NULL \endcode
+ */
+FLAC_API void FLAC__stream_decoder_get_memory_usage(const FLAC__StreamDecoder *decoder, FLAC__MemoryUsage *usage);
+
 /** Get the total number of samples in the stream being decoded.
  *  Will only be valid after decoding has started and will contain the
  *  value from the \c STREAMINFO block.  A value of \c 0 means "unknown".
@@ -1551,6 +1891,124 @@ FLAC_API FLAC__bool FLAC__stream_decoder_skip_single_frame(FLAC__StreamDecoder *
  */
 FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(FLAC__StreamDecoder *decoder, FLAC__uint64 sample);
 
+/** Decode exactly the samples \a start to \a start + \a samples - 1
+ *  into \a buffer, trimming the frames at both ends.  The write
+ *  callback is not called for them.
+ *
+ *  Sample \c i of channel \c c goes to
+ *  \code buffer[c][i * stride] \endcode
+ *  so interleaved output uses \code buffer[c] = out + c \endcode and a
+ *  \a stride of the channel count, and planar output uses one array per
+ *  channel and a \a stride of \c 1.  \a buffer must have an entry for
+ *  each channel in the STREAMINFO.
+ *
+ *  If \a start is inside or right after the last frame decoded, e.g.
+ *  because the previous call ended there, decoding continues from the
+ *  current input position; otherwise this seeks first, and the client
+ *  must support seeking the input.  MD5 checking is turned off for the
+ *  rest of the stream, as after FLAC__stream_decoder_seek_absolute().
+ *
+ * \param  decoder  An initialized decoder instance.
+ * \param  start    The first sample to decode.
+ * \param  samples  The number of samples per channel to decode.
+ * \param  buffer   Where to put the first sample of each channel.
+ * \param  stride   The distance in samples between consecutive samples of
+ *                  a channel.
+ * \param  decoded  Address at which to return the number of samples per
+ *                  channel written to \a buffer.  This is less than
+ *                  \a samples if the stream ends first.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code buffer != NULL || samples == 0 \endcode
+ *    \code decoded != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the seek failed, a frame has a different channel count
+ *    than the STREAMINFO (the decoder is then aborted), or another error
+ *    occurred, else \c true; for more information about the decoder,
+ *    check the decoder state with FLAC__stream_decoder_get_state().
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_decode_range(FLAC__StreamDecoder *decoder, FLAC__uint64 start, unsigned samples, FLAC__int32 * const buffer[], unsigned stride, unsigned *decoded);
+
+/** Build the Ogg page index of an Ogg FLAC stream in one pass.
+ *
+ *  This hops from page header to page header through the whole stream,
+ *  reading only the headers, and adds every page to the index (see
+ *  FLAC__stream_decoder_set_ogg_page_indexing()).  The page checksums
+ *  are not verified; an entry is only a hint, and a seek that finds the
+ *  stream does not match it falls back to searching.  Afterwards the
+ *  input is put back where it was, so this may be called at any point
+ *  after init.  The client must support seeking the input.
+ *
+ * \param  decoder  An initialized decoder instance.
+ * \assert
+ *    \code decoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the stream is not Ogg FLAC, the input cannot be seeked,
+ *    or a read or memory allocation error occurred, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_scan_ogg_page_index(FLAC__StreamDecoder *decoder);
+
+/** Get the Ogg page index, e.g. to save it for the next time the
+ *  stream is opened.
+ *
+ * \param  decoder  An initialized decoder instance.
+ * \param  entries  Address at which to return a pointer to the entries,
+ *                  sorted by stream offset.  They are owned by the
+ *                  decoder and valid until the next call that decodes,
+ *                  seeks, or changes the index.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code entries != NULL \endcode
+ * \retval unsigned
+ *    The number of entries; \c 0 if the stream is not Ogg FLAC.
+ */
+FLAC_API unsigned FLAC__stream_decoder_get_ogg_page_index(const FLAC__StreamDecoder *decoder, const FLAC__OggPageIndexEntry **entries);
+
+/** Add entries to the Ogg page index, e.g. ones saved from
+ *  FLAC__stream_decoder_get_ogg_page_index() the last time the stream
+ *  was opened.  Entries at the same stream offset as existing ones
+ *  replace them.  The index is cleared by every init.
+ *
+ * \param  decoder  An initialized decoder instance.
+ * \param  entries  The entries to add, in any order.
+ * \param  count    The number of entries.
+ * \assert
+ *    \code decoder != NULL \endcode
+ *    \code entries != NULL || count == 0 \endcode
+ * \retval FLAC__bool
+ *    \c false if the stream is not Ogg FLAC or memory allocation
+ *    failed, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_decoder_add_ogg_page_index(FLAC__StreamDecoder *decoder, const FLAC__OggPageIndexEntry entries[], unsigned count);
+
+/** Convert decoded samples to interleaved 32-bit float, e.g. from the
+ *  write callback with the frame header's values:
+ *  \code
+ *  FLAC__stream_decoder_interleave_float(buffer, frame->header.channels,
+ *      frame->header.blocksize, frame->header.bits_per_sample, gain, output);
+ *  \endcode
+ *  Full scale maps to [-1.0, 1.0) before \a gain is applied, and the gain
+ *  (a ReplayGain factor or a volume) is fused into the same multiply, so
+ *  the samples are read and written once.  Nothing is clipped, so with a
+ *  \a gain above \c 1.0 the output can exceed full scale.
+ *
+ *  This does not need a decoder instance and may be called from any
+ *  thread.  Mono and stereo use SSE2 or NEON where the build target has
+ *  them.
+ *
+ * \param  buffer           One array of \a samples samples per channel.
+ * \param  channels         The number of channels in \a buffer.
+ * \param  samples          The number of samples per channel to convert.
+ * \param  bits_per_sample  The resolution of the samples in \a buffer.
+ * \param  gain             Linear factor to apply; \c 1.0 for none.
+ * \param  output           Room for \a channels * \a samples floats.
+ * \assert
+ *    \code buffer != NULL \endcode
+ *    \code output != NULL || samples == 0 \endcode
+ *    \code bits_per_sample >= FLAC__MIN_BITS_PER_SAMPLE && bits_per_sample <= 32 \endcode
+ */
+FLAC_API void FLAC__stream_decoder_interleave_float(const FLAC__int32 * const buffer[], unsigned channels, unsigned samples, unsigned bits_per_sample, float gain, float output[]);
+
 /* \} */
 
 #ifdef __cplusplus
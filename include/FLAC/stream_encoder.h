@@ -727,6 +727,51 @@ FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder);
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_serial_number(FLAC__StreamEncoder *encoder, long serial_number);
 
+/** Set the number of bytes of audio to aim for in each Ogg page.
+ *
+ *  A page is finished once it holds at least this many bytes of FLAC
+ *  frames and at least four frames, or 255 frames, so bigger pages mean
+ *  less Ogg overhead in the stream and fewer pages to write, and smaller
+ *  pages mean less latency for a listener at the other end of a socket.
+ *  The metadata always goes out in pages of its own as soon as it is
+ *  written.
+ *
+ * \note
+ * This does not need to be set for native FLAC encoding.
+ *
+ * \default \c 0, which leaves it to libogg (about 4096 bytes)
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_page_size(FLAC__StreamEncoder *encoder, unsigned value);
+
+/** Set the number of bytes of Ogg pages to collect before calling the
+ *  write callback.
+ *
+ *  Each page is always passed to the write callback in one piece,
+ *  header and body together.  With a nonzero value, finished pages are
+ *  kept back until at least this many bytes are waiting and are then
+ *  passed in a single call, which saves calls (and, for file and socket
+ *  outputs, system calls) at the cost of latency and a buffer of about
+ *  this size.  Whatever is waiting is written when the last frame is.
+ *
+ * \note
+ * This does not need to be set for native FLAC encoding.
+ *
+ * \default \c 0, which writes each page as soon as it is finished
+ * \param  encoder  An encoder instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_write_size(FLAC__StreamEncoder *encoder, unsigned value);
+
 /** Set the "verify" flag.  If \c true, the encoder will verify it's own
  *  encoded output by feeding it through an internal decoder and comparing
  *  the original signal against the decoded signal.  If a mismatch occurs,
@@ -1181,6 +1226,56 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_total_samples_estimate(FLAC__Stream
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_set_metadata(FLAC__StreamEncoder *encoder, FLAC__StreamMetadata **metadata, unsigned num_blocks);
 
+/** Set the allocator the encoder uses for its working memory.
+ *
+ *  The sample and residual buffers, the apodization windows, the output
+ *  frame buffer, the MD5 buffer and the verify FIFO all go through
+ *  \a callbacks, as does the working memory of the verify decoder (see
+ *  FLAC__stream_decoder_set_memory_callbacks()).  The encoder object
+ *  itself and the copy of the metadata array made by
+ *  FLAC__stream_encoder_set_metadata() are still allocated from the C
+ *  runtime heap, as is the Ogg stream state of Ogg FLAC.  All memory
+ *  obtained through \a callbacks is returned by the time
+ *  FLAC__stream_encoder_finish() returns.
+ *
+ *  Unlike the other settings, this one is \b not reset by
+ *  FLAC__stream_encoder_finish().
+ *
+ * \default \c NULL (the C runtime heap)
+ * \param  encoder    An encoder instance to set.
+ * \param  callbacks  The allocator to use, copied by the encoder, or
+ *                    \c NULL to go back to the C runtime heap.  If not
+ *                    \c NULL, all three callbacks must be set.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized or \a callbacks is
+ *    incomplete, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_memory_callbacks(FLAC__StreamEncoder *encoder, const FLAC__MemoryCallbacks *callbacks);
+
+/** Set a limit on the memory the encoder may hold, as reported by
+ *  FLAC__stream_encoder_get_memory_usage().
+ *
+ *  The encoder sizes its buffers from the block size, the channel count
+ *  and the other settings when it is initialized; if the estimated total
+ *  (including the MD5 buffer, the verify FIFO and the verify decoder)
+ *  would exceed \a limit, the init call fails with
+ *  \c FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR and the state
+ *  becomes \c FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR.  The frame
+ *  buffer can still grow while encoding, up to the size of the largest
+ *  frame.
+ *
+ * \default \c 0 (no limit)
+ * \param  encoder  An encoder instance to set.
+ * \param  limit    The limit in bytes, or \c 0 for no limit.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the encoder is already initialized, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_encoder_set_memory_limit(FLAC__StreamEncoder *encoder, size_t limit);
+
 /** Get the current encoder state.
  *
  * \param  encoder  An encoder instance to query.
@@ -1245,6 +1340,26 @@ FLAC_API void FLAC__stream_encoder_get_verify_decoder_error_stats(const FLAC__St
  */
 FLAC_API FLAC__bool FLAC__stream_encoder_get_verify(const FLAC__StreamEncoder *encoder);
 
+/** Get the Ogg page size.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_encoder_set_ogg_page_size().
+ */
+FLAC_API unsigned FLAC__stream_encoder_get_ogg_page_size(const FLAC__StreamEncoder *encoder);
+
+/** Get the Ogg write size.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval unsigned
+ *    See FLAC__stream_encoder_set_ogg_write_size().
+ */
+FLAC_API unsigned FLAC__stream_encoder_get_ogg_write_size(const FLAC__StreamEncoder *encoder);
+
 /** Get the <A HREF="../format.html#subset>Subset</A> flag.
  *
  * \param  encoder  An encoder instance to query.
@@ -1408,6 +1523,28 @@ FLAC_API unsigned FLAC__stream_encoder_get_rice_parameter_search_dist(const FLAC
  */
 FLAC_API FLAC__uint64 FLAC__stream_encoder_get_total_samples_estimate(const FLAC__StreamEncoder *encoder);
 
+/** Get the memory limit.
+ *  See FLAC__stream_encoder_set_memory_limit().
+ *
+ * \param  encoder  An encoder instance to query.
+ * \assert
+ *    \code encoder != NULL \endcode
+ * \retval size_t
+ *    See above.
+ */
+FLAC_API size_t FLAC__stream_encoder_get_memory_limit(const FLAC__StreamEncoder *encoder);
+
+/** Get the memory currently held by the encoder, broken down by
+ *  subsystem.  See FLAC__MemoryUsage.
+ *
+ * \param  encoder  An encoder instance to query.
+ * \param  usage    Address at which to return the figures.
+ * \assert
+ *    \code encoder != NULL \endcode
+ *    \code usage != NULL \endcode
+ */
+FLAC_API void FLAC__stream_encoder_get_memory_usage(const FLAC__StreamEncoder *encoder, FLAC__MemoryUsage *usage);
+
 /** Initialize the encoder instance to encode native FLAC streams.
  *
  *  This flavor of initialization sets up the encoder to encode to a
@@ -0,0 +1,267 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2001-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLAC__STREAM_SPLICER_H
+#define FLAC__STREAM_SPLICER_H
+
+#include "export.h"
+#include "callback.h"
+#include "format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** \file include/FLAC/stream_splicer.h
+ *
+ *  \brief
+ *  This module contains the functions which implement the stream
+ *  splicer.
+ *
+ *  See the detailed documentation in the
+ *  \link flac_stream_splicer stream splicer \endlink module.
+ */
+
+/** \defgroup flac_stream_splicer FLAC/stream_splicer.h: stream splicer interface
+ *  \ingroup flac
+ *
+ *  \brief
+ *  This module contains the functions which implement the stream
+ *  splicer.
+ *
+ * The splicer cuts sample ranges out of native FLAC streams and joins
+ * them into a new stream without decoding and encoding all of the
+ * audio.  The frames that lie wholly inside a range are copied as they
+ * are, only with their frame or sample number and CRCs rewritten.  The
+ * frames cut by a range boundary are decoded, trimmed and encoded
+ * again, together with their neighbour across the join, so at most a
+ * few frames per range go through the encoder.  The STREAMINFO block is
+ * rebuilt for the new stream, and a new SEEKTABLE with a point every
+ * 10 seconds is written.
+ *
+ * The basic usage of the splicer is as follows:
+ * - The program creates an instance of a splicer using
+ *   FLAC__stream_splicer_new().
+ * - The program optionally sets options with
+ *   FLAC__stream_splicer_set_md5() and
+ *   FLAC__stream_splicer_set_compression_level().
+ * - The program adds the ranges, in output order, with
+ *   FLAC__stream_splicer_add_segment().
+ * - The program calls FLAC__stream_splicer_splice() to write the new
+ *   stream.
+ * - The instance may be deleted with FLAC__stream_splicer_delete().
+ *
+ * All the ranges must have the same sample rate, number of channels and
+ * bits per sample, and their sources must have the total number of
+ * samples in STREAMINFO.  The metadata of the first source other than
+ * STREAMINFO, SEEKTABLE and CUESHEET is copied to the new stream; a cue
+ * sheet would no longer match the audio.
+ *
+ * When every source has a fixed blocksize and every range starts, and
+ * all but the last end, on a frame boundary, the new stream has the
+ * same fixed blocksize.  Otherwise it uses variable blocksize frame
+ * headers, since the frames around the joins are shorter; a frame at a
+ * join may have fewer than 16 samples.
+ *
+ * \{
+ */
+
+
+struct FLAC__StreamSplicer;
+/** The opaque structure definition for the stream splicer type.
+ *  See the \link flac_stream_splicer stream splicer module \endlink
+ *  for a detailed description.
+ */
+typedef struct FLAC__StreamSplicer FLAC__StreamSplicer;
+
+/** Status values for a FLAC__StreamSplicer.
+ *
+ * The splicer's status can be obtained by calling FLAC__stream_splicer_get_status().
+ */
+typedef enum {
+
+	FLAC__STREAM_SPLICER_OK = 0,
+	/**< No error. */
+
+	FLAC__STREAM_SPLICER_INVALID_SEGMENT,
+	/**< There are no ranges, a range starts at or past the end of its
+	 *   source, or the source does not know its total number of
+	 *   samples. */
+
+	FLAC__STREAM_SPLICER_FORMAT_MISMATCH,
+	/**< The sources differ in sample rate, number of channels or bits
+	 *   per sample. */
+
+	FLAC__STREAM_SPLICER_READ_ERROR,
+	/**< A source could not be read. */
+
+	FLAC__STREAM_SPLICER_BAD_FRAME,
+	/**< A frame of a source could not be found where STREAMINFO and the
+	 *   previous frame said it would be. */
+
+	FLAC__STREAM_SPLICER_DECODER_ERROR,
+	/**< A source could not be decoded, e.g. it is not a native FLAC
+	 *   stream. */
+
+	FLAC__STREAM_SPLICER_ENCODER_ERROR,
+	/**< The frames at a boundary could not be encoded. */
+
+	FLAC__STREAM_SPLICER_WRITE_ERROR,
+	/**< The output could not be written. */
+
+	FLAC__STREAM_SPLICER_SEEK_ERROR,
+	/**< A source or the output could not be seeked. */
+
+	FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR
+	/**< An error occurred allocating memory. */
+
+} FLAC__StreamSplicerStatus;
+
+/** Maps a FLAC__StreamSplicerStatus to a C string.
+ *
+ *  Using a FLAC__StreamSplicerStatus as the index to this array
+ *  will give the string equivalent.  The contents should not be modified.
+ */
+extern FLAC_API const char * const FLAC__StreamSplicerStatusString[];
+
+
+/***********************************************************************
+ *
+ * Class constructor/destructor
+ *
+ ***********************************************************************/
+
+/** Create a new stream splicer instance.
+ *
+ * \retval FLAC__StreamSplicer*
+ *    \c NULL if there was an error allocating memory, else the new instance.
+ */
+FLAC_API FLAC__StreamSplicer *FLAC__stream_splicer_new(void);
+
+/** Free a splicer instance.  Deletes the object pointed to by
+ *  \a splicer.  None of the I/O handles is closed.
+ *
+ * \param splicer  A pointer to an existing splicer.
+ * \assert
+ *    \code splicer != NULL \endcode
+ */
+FLAC_API void FLAC__stream_splicer_delete(FLAC__StreamSplicer *splicer);
+
+
+/***********************************************************************
+ *
+ * Public class method prototypes
+ *
+ ***********************************************************************/
+
+/** Set whether the MD5 signature of the new stream is computed.  This
+ *  needs every copied frame to be decoded as well, so with \c false the
+ *  splice only reads and writes; the signature is then left as all
+ *  zeroes, meaning unknown.
+ *
+ * \default \c true
+ * \param  splicer  A splicer instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code splicer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_splicer_set_md5(FLAC__StreamSplicer *splicer, FLAC__bool value);
+
+/** Set the compression level the boundary frames are encoded with; see
+ *  FLAC__stream_encoder_set_compression_level().
+ *
+ * \default \c 5
+ * \param  splicer  A splicer instance to set.
+ * \param  value    See above.
+ * \assert
+ *    \code splicer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_splicer_set_compression_level(FLAC__StreamSplicer *splicer, unsigned value);
+
+/** Add a range of a source to the end of the new stream.  The source
+ *  is only read by FLAC__stream_splicer_splice(); its callbacks must
+ *  support reading, seeking and telling, and the handle must stay valid
+ *  until then.  The same source may be added more than once.
+ *
+ * \param splicer       A pointer to an existing splicer.
+ * \param handle        The I/O handle of the source.
+ * \param callbacks     The callbacks to use on the handle.
+ * \param start_sample  The first sample of the range.
+ * \param samples       The number of samples in the range, or \c 0 for
+ *                      all of them up to the end of the source.  A
+ *                      range running past the end is cut there.
+ * \assert
+ *    \code splicer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if the callbacks are missing or memory allocation
+ *    failed, else \c true.
+ */
+FLAC_API FLAC__bool FLAC__stream_splicer_add_segment(FLAC__StreamSplicer *splicer, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks, FLAC__uint64 start_sample, FLAC__uint64 samples);
+
+/** Write the new stream made of the added ranges.  The output callbacks
+ *  must support writing and seeking, as STREAMINFO and SEEKTABLE are
+ *  written again once all of the frames are.  The output is written
+ *  from its current position.
+ *
+ * \param splicer    A pointer to an existing splicer.
+ * \param handle     The I/O handle of the output.
+ * \param callbacks  The callbacks to use on the handle.
+ * \assert
+ *    \code splicer != NULL \endcode
+ * \retval FLAC__bool
+ *    \c false if an error occurred, else \c true; see
+ *    FLAC__stream_splicer_get_status().
+ */
+FLAC_API FLAC__bool FLAC__stream_splicer_splice(FLAC__StreamSplicer *splicer, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks);
+
+/** Get the status of the last FLAC__stream_splicer_splice() call.
+ *
+ * \param splicer  A pointer to an existing splicer.
+ * \assert
+ *    \code splicer != NULL \endcode
+ * \retval FLAC__StreamSplicerStatus
+ *    The current status.
+ */
+FLAC_API FLAC__StreamSplicerStatus FLAC__stream_splicer_get_status(const FLAC__StreamSplicer *splicer);
+
+/* \} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -32,6 +32,9 @@
 #ifndef FLACRT__DECODER_H
 #define FLACRT__DECODER_H
 
+#include <atomic>
+#include <memory>
+
 #include "FLAC/stream_decoder.h"
 #include "FLAC_winrt/format.h"
 #include "FLAC_winrt/deferral.h"
@@ -73,6 +76,11 @@
 * are used.
 */
 
+class StreamCache;
+class PcmFifo;
+class DecodeQueue;
+class PlaylistDecoder;
+
 namespace FLAC {
 
 	namespace WindowsRuntime {
@@ -325,8 +333,8 @@ namespace FLAC {
 					}
 
 				internal:
-					StreamDecoderReadEventArgs(FLAC__byte *buffer, size_t *bytes)
-						: buffer_(buffer), bytes_(bytes), deferral_manager_(DeferralManager()) { }
+					StreamDecoderReadEventArgs(FLAC__byte *buffer, size_t *bytes, ::CompletionLatch *latch)
+						: buffer_(buffer), bytes_(bytes), deferral_manager_(latch) { }
 
 					property ::FLAC__StreamDecoderReadStatus Result {
 						::FLAC__StreamDecoderReadStatus get() {
@@ -403,8 +411,8 @@ namespace FLAC {
 					}
 
 				internal:
-					StreamDecoderSeekEventArgs(const FLAC__uint64 &absoluteByteOffset)
-						: absoluteByteOffset_(absoluteByteOffset), deferral_manager_(DeferralManager()) { }
+					StreamDecoderSeekEventArgs(const FLAC__uint64 &absoluteByteOffset, ::CompletionLatch *latch)
+						: absoluteByteOffset_(absoluteByteOffset), deferral_manager_(latch) { }
 
 					property ::FLAC__StreamDecoderSeekStatus Result {
 						::FLAC__StreamDecoderSeekStatus get() {
@@ -479,8 +487,8 @@ namespace FLAC {
 					}
 
 				internal:
-					StreamDecoderTellEventArgs(FLAC__uint64 *absoluteByteOffset)
-						: absolute_byte_offset_(absoluteByteOffset), deferral_manager_(DeferralManager()) { }
+					StreamDecoderTellEventArgs(FLAC__uint64 *absoluteByteOffset, ::CompletionLatch *latch)
+						: absolute_byte_offset_(absoluteByteOffset), deferral_manager_(latch) { }
 
 					property ::FLAC__StreamDecoderTellStatus Result {
 						::FLAC__StreamDecoderTellStatus get() {
@@ -555,8 +563,8 @@ namespace FLAC {
 					}
 
 				internal:
-					StreamDecoderLengthEventArgs(FLAC__uint64 *streamLength)
-						: stream_length_(streamLength), deferral_manager_(DeferralManager()) { }
+					StreamDecoderLengthEventArgs(FLAC__uint64 *streamLength, ::CompletionLatch *latch)
+						: stream_length_(streamLength), deferral_manager_(latch) { }
 
 					property ::FLAC__StreamDecoderLengthStatus Result {
 						::FLAC__StreamDecoderLengthStatus get() {
@@ -616,8 +624,8 @@ namespace FLAC {
 					}
 
 				internal:
-					StreamDecoderEofEventArgs()
-						: deferral_manager_(DeferralManager()) { }
+					StreamDecoderEofEventArgs(::CompletionLatch *latch)
+						: deferral_manager_(latch) { }
 
 					property ::FLAC__bool Result {
 						::FLAC__bool get() {
@@ -670,12 +678,40 @@ namespace FLAC {
 						return deferral_manager_.GetDeferral();
 					}
 
+					/// The full frame structure.  It is built on first access, so
+					/// handlers that only need the samples and the values below
+					/// do not pay for it.
 					property Format::Frame^ Frame {
-						Format::Frame^ get() { return frame_; }
+						Format::Frame^ get() { return frame_ ? frame_ : (frame_ = ref new Format::Frame(native_frame_)); }
+					}
+
+					/// Same as Frame->Header->Blocksize
+					property unsigned Blocksize {
+						unsigned get() { return native_frame_->header.blocksize; }
+					}
+
+					/// Same as Frame->Header->SampleNumber
+					property FLAC__uint64 SampleNumber {
+						FLAC__uint64 get() { return (FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER == native_frame_->header.number_type) ? native_frame_->header.number.sample_number : 0; }
+					}
+
+					/// Same as Frame->Header->Channels
+					property unsigned Channels {
+						unsigned get() { return native_frame_->header.channels; }
+					}
+
+					/// Same as Frame->Header->BitsPerSample
+					property unsigned BitsPerSample {
+						unsigned get() { return native_frame_->header.bits_per_sample; }
 					}
 
 					Windows::Storage::Streams::IBuffer^ GetBuffer();
 
+					/// The frame as interleaved 32-bit float, full scale being
+					/// [-1, 1) before \a gain; see FLAC__stream_decoder_interleave_float().
+					/// A new buffer is made on every call.
+					Windows::Storage::Streams::IBuffer^ GetFloatBuffer(float gain);
+
 					Platform::Array<FLAC__int32>^ GetData(unsigned index);
 
 					void SetResult(StreamDecoderWriteStatus result) {
@@ -684,10 +720,8 @@ namespace FLAC {
 					}
 
 				internal:
-					StreamDecoderWriteEventArgs(const FLAC__int32 *const *data, const ::FLAC__Frame *frame)
-						: data_(data), buffer_(nullptr), data_array_(nullptr), deferral_manager_(DeferralManager()) {
-						frame_ = ref new Format::Frame(frame);
-					}
+					StreamDecoderWriteEventArgs(const FLAC__int32 *const *data, const ::FLAC__Frame *frame, ::CompletionLatch *latch)
+						: data_(data), native_frame_(frame), frame_(nullptr), buffer_(nullptr), data_array_(nullptr), deferral_manager_(latch) { }
 
 					property ::FLAC__StreamDecoderWriteStatus Result {
 						::FLAC__StreamDecoderWriteStatus get() {
@@ -704,6 +738,7 @@ namespace FLAC {
 					DeferralManager deferral_manager_;
 
 					const FLAC__int32 *const *data_;
+					const ::FLAC__Frame *native_frame_;
 
 					Format::Frame^ frame_;
 					Windows::Storage::Streams::IBuffer^ buffer_;
@@ -819,16 +854,33 @@ namespace FLAC {
 				//@}
 
 				bool SetOggSerialNumber(int value);											///< See FLAC__stream_decoder_set_ogg_serial_number()
+				bool SetOggPageIndexing(bool value);										///< See FLAC__stream_decoder_set_ogg_page_indexing()
 				bool SetMd5Checking(bool value);											///< See FLAC__stream_decoder_set_md5_checking()
+				bool SetChannelMask(unsigned mask);											///< See FLAC__stream_decoder_set_channel_mask()
+				bool SetRetainBuffers(bool value);											///< See FLAC__stream_decoder_set_retain_buffers()
+				bool SetMemoryLimit(FLAC__uint64 limit);									///< See FLAC__stream_decoder_set_memory_limit()
+				bool SetReadBufferSize(unsigned bytes);											///< See FLAC__stream_decoder_set_read_buffer_size()
+				bool SetLazyPictures(bool value);											///< See FLAC__stream_decoder_set_lazy_pictures()
 				bool SetMetadataRespond(Format::MetadataType type);							///< See FLAC__stream_decoder_set_metadata_respond()
 				bool SetMetadataRespondApplication(const Platform::Array<FLAC__byte>^ id);	///< See FLAC__stream_decoder_set_metadata_respond_application()
 				bool SetMetadataRespondAll();												///< See FLAC__stream_decoder_set_metadata_respond_all()
 				bool SetMetadataIgnore(Format::MetadataType type);							///< See FLAC__stream_decoder_set_metadata_ignore()
 				bool SetMetadataIgnoreApplication(const Platform::Array<FLAC__byte>^ id);	///< See FLAC__stream_decoder_set_metadata_ignore_application()
 				bool SetMetadataIgnoreAll();												///< See FLAC__stream_decoder_set_metadata_ignore_all()
+				bool SetFloatOutput(bool value);											///< DecodeAsync() and DequeueAsync() buffers hold 32-bit float samples; see FLAC__stream_decoder_interleave_float()
+				bool SetOutputGain(float gain);												///< Linear gain applied to float output; \c 1.0 (the default) for none
 
 				StreamDecoderState GetState();								///< See FLAC__stream_decoder_get_state()
 				bool GetMd5Checking();										///< See FLAC__stream_decoder_get_md5_checking()
+				unsigned GetChannelMask();									///< See FLAC__stream_decoder_get_channel_mask()
+				bool GetOggPageIndexing();									///< See FLAC__stream_decoder_get_ogg_page_indexing()
+				bool GetRetainBuffers();									///< See FLAC__stream_decoder_get_retain_buffers()
+				FLAC__uint64 GetMemoryLimit();								///< See FLAC__stream_decoder_get_memory_limit()
+				FLAC__uint64 GetMemoryUsage();								///< Total from FLAC__stream_decoder_get_memory_usage()
+				unsigned GetReadBufferSize();									///< See FLAC__stream_decoder_get_read_buffer_size()
+				bool GetLazyPictures();										///< See FLAC__stream_decoder_get_lazy_pictures()
+				bool GetFloatOutput();
+				float GetOutputGain();
 				FLAC__uint64 GetTotalSamples();								///< See FLAC__stream_decoder_get_total_samples()
 				unsigned GetChannels();										///< See FLAC__stream_decoder_get_channels()
 				Format::Frames::ChannelAssignment GetChannelAssignment();	///< See FLAC__stream_decoder_get_channel_assignment()
@@ -853,6 +905,63 @@ namespace FLAC {
 				bool SkipSingleFrame();					///< See FLAC__stream_decoder_skip_single_frame()
 
 				bool SeekAbsolute(FLAC__uint64 sample);	///< See FLAC__stream_decoder_seek_absolute()
+				bool ScanOggPageIndex();				///< See FLAC__stream_decoder_scan_ogg_page_index()
+
+				/** Decodes exactly \a buffer->Length / GetChannels() samples per
+				 *  channel starting at \a start into \a buffer, interleaved or one
+				 *  channel after the other if \a planar.  Continues from the
+				 *  current position when the range follows the last one, else
+				 *  seeks.  WriteCallback is not raised for the range.  See
+				 *  FLAC__stream_decoder_decode_range()
+				 */
+				bool DecodeRange(FLAC__uint64 start, Platform::WriteOnlyArray<int>^ buffer, bool planar, unsigned *decoded);
+
+				/** Like DecodeRange(FLAC__uint64, Platform::WriteOnlyArray<int>^, bool, unsigned *)
+				 *  but returns the samples in one interleaved buffer, in the same
+				 *  layout as DecodeAsync().  The buffer is shorter than requested
+				 *  only at the end of the stream.
+				 */
+				Windows::Storage::Streams::IBuffer^ DecodeRange(FLAC__uint64 start, unsigned samples);
+
+				/** Decodes on a background thread until \a samples inter-channel
+				 *  samples are available and completes once with all of them in
+				 *  one interleaved buffer, in the same layout as
+				 *  Callbacks::StreamDecoderWriteEventArgs::GetBuffer(), or as
+				 *  GetFloatBuffer() after SetFloatOutput().  A frame
+				 *  that does not fit is kept for the next call.  The buffer is
+				 *  shorter than requested only at the end of the stream and
+				 *  empty once nothing is left.  Cancelling the operation stops it
+				 *  between frames.
+				 *
+				 *  Until the operation completes, decoded audio goes to its buffer
+				 *  instead of raising WriteCallback, and the methods that decode,
+				 *  seek, flush, reset or finish, including a second DecodeAsync(),
+				 *  throw \c E_ILLEGAL_METHOD_CALL.
+				 */
+				Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ DecodeAsync(unsigned samples);
+
+				/** Starts a worker that keeps up to \a depth buffers of
+				 *  \a samples inter-channel samples decoded ahead; a depth of 2
+				 *  double-buffers playback.  Take buffers with DequeueAsync().
+				 *  The worker owns the decoder until StopDecodeQueue() or
+				 *  Finish(); until then the methods that decode, seek, flush or
+				 *  reset throw \c E_ILLEGAL_METHOD_CALL, and decoded audio does
+				 *  not raise WriteCallback.
+				 */
+				void StartDecodeQueue(unsigned samples, unsigned depth);
+
+				/** Completes with the next buffer from the decode queue, or with an
+				 *  empty buffer once the stream has ended.  Cancelling the
+				 *  operation only gives up this wait: the queue keeps decoding,
+				 *  and the buffer goes to the next DequeueAsync().  Use
+				 *  StopDecodeQueue() to stop the queue.
+				 */
+				Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ DequeueAsync();
+
+				/** Stops the decode queue and drops the buffers it holds.  Waits for
+				 *  the frame being decoded to finish.
+				 */
+				void StopDecodeQueue();
 
 				/// see FLAC__StreamDecoderReadCallback
 				event Windows::Foundation::TypedEventHandler<Platform::Object^, Callbacks::StreamDecoderReadEventArgs^>^ ReadCallback;
@@ -880,7 +989,15 @@ namespace FLAC {
 
 			private:
 				::FLAC__StreamDecoder *decoder_;
-				Windows::Storage::Streams::IRandomAccessStream^ file_stream_;
+				::StreamCache *file_stream_;
+				::PcmFifo *pcm_fifo_;
+				std::shared_ptr< ::DecodeQueue> decode_queue_;
+				std::atomic<bool> batching_;	// a DecodeAsync() or the decode queue owns the decoder
+				bool float_output_;
+				float output_gain_;
+				::CompletionLatch *deferral_latch_;
+
+				void CheckNotBatching();
 
 				static ::FLAC__StreamDecoderReadStatus read_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
 				static ::FLAC__StreamDecoderSeekStatus seek_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
@@ -892,11 +1009,82 @@ namespace FLAC {
 				static void error_callback_(const ::FLAC__StreamDecoder *decoder, ::FLAC__StreamDecoderErrorStatus status, void *client_data);
 
 			private:
-				static inline void file_stream_read_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderReadEventArgs^ e);
-				static inline void file_stream_seek_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderSeekEventArgs^ e);
-				static inline void file_stream_tell_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderTellEventArgs^ e);
-				static inline void file_stream_length_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderLengthEventArgs^ e);
-				static inline void file_stream_eof_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderEofEventArgs^ e);
+				static inline void file_stream_read_(::StreamCache *file_stream, Callbacks::StreamDecoderReadEventArgs^ e);
+				static inline void file_stream_seek_(::StreamCache *file_stream, Callbacks::StreamDecoderSeekEventArgs^ e);
+				static inline void file_stream_tell_(::StreamCache *file_stream, Callbacks::StreamDecoderTellEventArgs^ e);
+				static inline void file_stream_length_(::StreamCache *file_stream, Callbacks::StreamDecoderLengthEventArgs^ e);
+				static inline void file_stream_eof_(::StreamCache *file_stream, Callbacks::StreamDecoderEofEventArgs^ e);
+			};
+
+
+			/** Sample format of a PlaylistDecoder track, from its STREAMINFO.
+			*/
+			public value struct PlaylistTrackFormat {
+				unsigned Index;					///< The track's position in the order of Enqueue() calls, from 0
+				unsigned SampleRate;
+				unsigned Channels;
+				unsigned BitsPerSample;
+				FLAC__uint64 TotalSamples;		///< \c 0 if unknown
+			};
+
+			/** \ingroup flacpp_decoder
+			*  \brief
+			*  This class decodes a queue of FLAC streams gaplessly.
+			*
+			* While one track plays, the next one is opened, its metadata
+			* read and its first frames decoded on a background thread, so
+			* DecodeAsync() carries on across the boundary without waiting
+			* for it.  A buffer holds samples of two tracks only when their
+			* rate, channels and (for packed output) sample size match;
+			* otherwise it ends at the boundary.  GetCurrentFormat() tells
+			* which format the last buffer is in, and GetNextFormat() tells
+			* the next track's format before its samples arrive.  A track
+			* that cannot be opened is skipped.
+			*
+			* The streams must stay open until their track has played or
+			* Clear() is called.
+			*/
+			public ref class PlaylistDecoder sealed {
+			public:
+				PlaylistDecoder();
+				virtual ~PlaylistDecoder();
+
+				//@{
+				/** Call after construction to check the that the object was created
+				 *  successfully.
+				 */
+				property bool IsValid { bool get(); }
+				//@}
+
+				unsigned Enqueue(Windows::Storage::Streams::IRandomAccessStream^ fileStream);		///< Appends a FLAC track; returns its index
+				unsigned EnqueueOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream);	///< Appends an Ogg FLAC track; returns its index
+				void Clear();																		///< Drops every track, including the one playing
+
+				bool SetFloatOutput(bool value);		///< Buffers hold 32-bit float samples; see StreamDecoder::SetFloatOutput()
+				bool SetOutputGain(float gain);			///< Linear gain applied to float output; \c 1.0 (the default) for none
+				bool GetFloatOutput();
+				float GetOutputGain();
+
+				bool GetCurrentFormat(PlaylistTrackFormat *format);	///< Format of the track the last buffer ended in; \c false before the first buffer
+				bool GetNextFormat(PlaylistTrackFormat *format);		///< Format of the track that follows; \c false until it has been opened
+
+				/** Completes with up to \a samples inter-channel samples in one
+				 *  interleaved buffer, in the same layout as
+				 *  StreamDecoder::DecodeAsync().  The buffer is shorter than
+				 *  requested only before a track of another format or at the end
+				 *  of the queue, and empty once every track has played;
+				 *  enqueueing more tracks resumes playback.  Cancelling the
+				 *  operation stops it between frames.
+				 *
+				 *  Operations run one after another, and Clear(), SetFloatOutput()
+				 *  and SetOutputGain() wait for the one running to complete.
+				 */
+				Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ DecodeAsync(unsigned samples);
+
+			private:
+				::PlaylistDecoder *playlist_;
+				bool float_output_;
+				float output_gain_;
 			};
 		}
 	}
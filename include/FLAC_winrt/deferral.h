@@ -33,9 +33,18 @@
 #define FLACRT__DEFERRAL_H
 
 #include <atomic>
-#include <concrt.h>
 
 
+/** \file include/FLAC_winrt/deferral.h
+ *
+ *  Deferrals let an event handler finish its work asynchronously: the
+ *  decoder does not return from the libFLAC callback until every deferral
+ *  taken from the event arguments has been completed.  The counting is
+ *  done by one CompletionLatch per decoder, reused for every callback.
+ */
+
+class CompletionLatch;
+
 namespace FLAC {
 
 	namespace WindowsRuntime {
@@ -50,117 +59,38 @@ namespace FLAC {
 				};
 
 
-				class CountdownEvent
-				{
-				public:
-					CountdownEvent(int count) :
-						count_(count)
-					{
-					}
-
-					void AddCount()
-					{
-						if (!ModifyCount(1)) {
-							throw ref new Platform::COMException(E_NOT_VALID_STATE);
-						}
-					}
-
-					void Signal()
-					{
-						if (!ModifyCount(-1)) {
-							throw ref new Platform::COMException(E_NOT_VALID_STATE);
-						}
-					}
-
-					void Wait()
-					{
-						event_.wait();
-					}
-
-				private:
-					bool ModifyCount(int signalCount)
-					{
-						int oldCount = (int)count_;
-						if (0 == oldCount) {
-							return false;
-						}
-
-						int newCount = oldCount + signalCount;
-						if (newCount < 0) {
-							return false;
-						}
-
-						count_ = newCount;
-						if (0 == newCount) {
-							event_.set();
-						}
-
-						return true;
-					}
-
-					Concurrency::event event_;
-					std::atomic<int> count_;
-				};
-
-
 				ref class Deferral sealed : public IDeferral
 				{
 				internal:
-					Deferral(CountdownEvent *count) : count_(count)
+					Deferral(::CompletionLatch *latch, unsigned token) : latch_(latch), token_(token)
 					{
 					}
 
 				public:
-					virtual void Complete()
-					{
-						if (nullptr != count_) {
-							count_->Signal();
-							count_ = nullptr;
-						}
-					}
+					virtual void Complete();
 
 				private:
-					CountdownEvent *count_;
+					std::atomic< ::CompletionLatch *> latch_;
+					unsigned token_;
 				};
 
 
 				class DeferralManager
 				{
 				public:
-					DeferralManager() : count_(nullptr)
-					{
-					}
+					/// Starts a new round on \a latch for one callback.
+					explicit DeferralManager(::CompletionLatch *latch);
 
-					IDeferral^ GetDeferral()
-					{
-						if (nullptr == count_) {
-							count_ = new CountdownEvent(1);
-						}
+					IDeferral^ GetDeferral();
 
-						IDeferral^ deferral = ref new Deferral(count_);
-						count_->AddCount();
-
-						return deferral;
-					}
-
-					void SignalAndWait()
-					{
-						if (nullptr != count_) {
-							count_->Signal();
-							count_->Wait();
-						}
-					}
-
-					virtual ~DeferralManager()
-					{
-						if (nullptr != count_) {
-							delete count_;
-							count_ = nullptr;
-						}
-					}
+					void SignalAndWait();
 
 				private:
-					CountdownEvent *count_;
+					DeferralManager(const DeferralManager &);
+					DeferralManager &operator=(const DeferralManager &);
+
+					::CompletionLatch *latch_;
+					unsigned token_;
 				};
 
 			}
@@ -0,0 +1,444 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__ENCODER_H
+#define FLACRT__ENCODER_H
+
+#include "FLAC/stream_encoder.h"
+
+
+/** \file include/FLAC_winrt/encoder.h
+*
+*  \brief
+*  This module contains the class which wraps the stream encoder.
+*
+*  See the detailed documentation in the
+*  \link flacrt_encoder encoder \endlink module.
+*/
+
+/** \defgroup flacrt_encoder FLAC_winrt/encoder.h: encoder class
+*  \ingroup flacpp
+*
+*  \brief
+*  This module describes the encoder layer provided by libFLAC_winrt.
+*
+* The StreamEncoder class is an object wrapper around FLAC__StreamEncoder;
+* make sure to read the \link flac_stream_encoder libFLAC encoder module \endlink.
+*
+* Audio is passed in as interleaved little-endian PCM bytes, in the same
+* layout the decoder produces from
+* Decoder::Callbacks::StreamDecoderWriteEventArgs::GetBuffer(), and the
+* encoded stream goes either to an IRandomAccessStream or IOutputStream,
+* or to the WriteCallback event.
+*/
+
+class EncoderWriteCache;
+class PcmEncoder;
+class EncodeQueue;
+class EncoderMetadata;
+
+namespace FLAC {
+
+	namespace WindowsRuntime {
+
+		namespace Encoder {
+
+			/** State values for a FLAC__StreamEncoder.
+			*
+			* The encoder's state can be obtained by calling FLAC__stream_encoder_get_state().
+			*/
+			public enum class StreamEncoderState {
+
+				OK = FLAC__STREAM_ENCODER_OK,
+				/**< The encoder is in the normal OK state and samples can be processed. */
+
+				Uninitialized = FLAC__STREAM_ENCODER_UNINITIALIZED,
+				/**< The encoder is in the uninitialized state; one of the
+				* FLAC__stream_encoder_init_*() functions must be called before samples
+				* can be processed.
+				*/
+
+				OggError = FLAC__STREAM_ENCODER_OGG_ERROR,
+				/**< An error occurred in the underlying Ogg layer. */
+
+				VerifyDecoderError = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR,
+				/**< An error occurred in the underlying verify stream decoder. */
+
+				VerifyMismatchInAudioData = FLAC__STREAM_ENCODER_VERIFY_MISMATCH_IN_AUDIO_DATA,
+				/**< The verify decoder detected a mismatch between the original
+				* audio signal and the decoded audio signal.
+				*/
+
+				ClientError = FLAC__STREAM_ENCODER_CLIENT_ERROR,
+				/**< One of the callbacks returned a fatal error. */
+
+				IOError = FLAC__STREAM_ENCODER_IO_ERROR,
+				/**< An I/O error occurred while writing the output. */
+
+				FramingError = FLAC__STREAM_ENCODER_FRAMING_ERROR,
+				/**< An error occurred while writing the stream. */
+
+				MemoryAllocationError = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR
+				/**< Memory allocation failed. */
+
+			};
+
+
+			/** This class is a wrapper around FLAC__StreamEncoderInitStatus.
+			*/
+			public enum class StreamEncoderInitStatus {
+
+				OK = FLAC__STREAM_ENCODER_INIT_STATUS_OK,
+				/**< Initialization was successful. */
+
+				EncoderError = FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR,
+				/**< General failure to set up encoder; call GetState() for cause. */
+
+				UnsupportedContainer = FLAC__STREAM_ENCODER_INIT_STATUS_UNSUPPORTED_CONTAINER,
+				/**< The library was not compiled with support for the given container format. */
+
+				InvalidCallbacks = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_CALLBACKS,
+				/**< A required callback was not supplied. */
+
+				InvalidNumberOfChannels = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_NUMBER_OF_CHANNELS,
+				/**< The encoder has an invalid setting for number of channels. */
+
+				InvalidBitsPerSample = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_BITS_PER_SAMPLE,
+				/**< The encoder has an invalid setting for bits-per-sample. */
+
+				InvalidSampleRate = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_SAMPLE_RATE,
+				/**< The encoder has an invalid setting for the input sample rate. */
+
+				InvalidBlockSize = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_BLOCK_SIZE,
+				/**< The encoder has an invalid setting for the block size. */
+
+				InvalidMaxLpcOrder = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_MAX_LPC_ORDER,
+				/**< The encoder has an invalid setting for the maximum LPC order. */
+
+				InvalidQlpCoeffPrecision = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_QLP_COEFF_PRECISION,
+				/**< The encoder has an invalid setting for the precision of the quantized linear predictor coefficients. */
+
+				BlockSizeTooSmallForLpcOrder = FLAC__STREAM_ENCODER_INIT_STATUS_BLOCK_SIZE_TOO_SMALL_FOR_LPC_ORDER,
+				/**< The specified block size is less than the maximum LPC order. */
+
+				NotStreamable = FLAC__STREAM_ENCODER_INIT_STATUS_NOT_STREAMABLE,
+				/**< The encoder is bound to the Subset but other settings violate it. */
+
+				InvalidMetadata = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_METADATA,
+				/**< The metadata input to the encoder is invalid. */
+
+				AlreadyInitialized = FLAC__STREAM_ENCODER_INIT_STATUS_ALREADY_INITIALIZED
+				/**< Init() was called when the encoder was already initialized,
+				* usually because Finish() was not called.
+				*/
+			};
+
+
+			namespace Callbacks {
+
+				/** Return values for the FLAC__StreamEncoder write callback.
+				*/
+				public enum class StreamEncoderWriteStatus {
+
+					OK = FLAC__STREAM_ENCODER_WRITE_STATUS_OK,
+					/**< The write was OK and encoding can continue. */
+
+					FatalError = FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR
+					/**< An unrecoverable error occurred.  The encoder will return from the process call. */
+
+				};
+
+
+				/** Return values for the FLAC__StreamEncoder seek callback.
+				*/
+				public enum class StreamEncoderSeekStatus {
+
+					OK = FLAC__STREAM_ENCODER_SEEK_STATUS_OK,
+					/**< The seek was OK and encoding can continue. */
+
+					Error = FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR,
+					/**< An unrecoverable error occurred. */
+
+					Unsupported = FLAC__STREAM_ENCODER_SEEK_STATUS_UNSUPPORTED
+					/**< Client does not support seeking. */
+
+				};
+
+
+				/** Return values for the FLAC__StreamEncoder tell callback.
+				*/
+				public enum class StreamEncoderTellStatus {
+
+					OK = FLAC__STREAM_ENCODER_TELL_STATUS_OK,
+					/**< The tell was OK and encoding can continue. */
+
+					Error = FLAC__STREAM_ENCODER_TELL_STATUS_ERROR,
+					/**< An unrecoverable error occurred. */
+
+					Unsupported = FLAC__STREAM_ENCODER_TELL_STATUS_UNSUPPORTED
+					/**< Client does not support telling the position. */
+
+				};
+
+
+				/** Arguments of the write event; see FLAC__StreamEncoderWriteCallback.
+				*
+				*  One instance is reused for every write of an encoder, and
+				*  GetBuffer() wraps the encoder's own memory, so the handler must
+				*  consume the bytes before it returns.  Unlike the decoder's
+				*  events there is no deferral: the encoder cannot wait.
+				*/
+				public ref class StreamEncoderWriteEventArgs sealed {
+				public:
+					Platform::Array<FLAC__byte>^ GetBuffer() {
+						return Platform::ArrayReference<FLAC__byte>(const_cast<FLAC__byte *>(buffer_), (unsigned int)bytes_);
+					}
+
+					property size_t Bytes {
+						size_t get() { return bytes_; }
+					}
+
+					/// The number of samples encoded in this write, 0 for metadata.
+					property unsigned Samples {
+						unsigned get() { return samples_; }
+					}
+
+					property unsigned CurrentFrame {
+						unsigned get() { return current_frame_; }
+					}
+
+					void SetResult(StreamEncoderWriteStatus result) {
+						result_ = (::FLAC__StreamEncoderWriteStatus)(int)result;
+						handled_ = true;
+					}
+
+				internal:
+					StreamEncoderWriteEventArgs()
+						: buffer_(nullptr), bytes_(0), samples_(0), current_frame_(0), handled_(false) { }
+
+					void Reset(const FLAC__byte *buffer, size_t bytes, unsigned samples, unsigned current_frame) {
+						buffer_ = buffer;
+						bytes_ = bytes;
+						samples_ = samples;
+						current_frame_ = current_frame;
+						handled_ = false;
+					}
+
+					property ::FLAC__StreamEncoderWriteStatus Result {
+						::FLAC__StreamEncoderWriteStatus get() {
+							if (handled_) return result_;
+							throw ref new Platform::COMException(E_NOT_SET);
+						}
+					}
+
+				private:
+					const FLAC__byte *buffer_;
+					size_t bytes_;
+					unsigned samples_;
+					unsigned current_frame_;
+
+					bool handled_;
+					::FLAC__StreamEncoderWriteStatus result_;
+				};
+
+
+				/** Arguments of the seek event; see FLAC__StreamEncoderSeekCallback.
+				*
+				*  The encoder only seeks from Finish(), to rewrite STREAMINFO and
+				*  the seek table.  If no handler sets a result, seeking is
+				*  reported as unsupported.
+				*/
+				public ref class StreamEncoderSeekEventArgs sealed {
+				public:
+					property FLAC__uint64 AbsoluteByteOffset {
+						FLAC__uint64 get() { return absoluteByteOffset_; }
+					}
+
+					void SetResult(StreamEncoderSeekStatus result) {
+						result_ = (::FLAC__StreamEncoderSeekStatus)(int)result;
+					}
+
+				internal:
+					StreamEncoderSeekEventArgs(FLAC__uint64 absoluteByteOffset)
+						: absoluteByteOffset_(absoluteByteOffset), result_(FLAC__STREAM_ENCODER_SEEK_STATUS_UNSUPPORTED) { }
+
+					property ::FLAC__StreamEncoderSeekStatus Result {
+						::FLAC__StreamEncoderSeekStatus get() { return result_; }
+					}
+
+				private:
+					FLAC__uint64 absoluteByteOffset_;
+					::FLAC__StreamEncoderSeekStatus result_;
+				};
+
+
+				/** Arguments of the tell event; see FLAC__StreamEncoderTellCallback.
+				*
+				*  The encoder asks before every write, so like the write event
+				*  one instance is reused.  If no handler sets a result, telling
+				*  is reported as unsupported.
+				*/
+				public ref class StreamEncoderTellEventArgs sealed {
+				public:
+					void SetAbsoluteByteOffset(FLAC__uint64 absoluteByteOffset) {
+						absoluteByteOffset_ = absoluteByteOffset;
+					}
+
+					void SetResult(StreamEncoderTellStatus result) {
+						result_ = (::FLAC__StreamEncoderTellStatus)(int)result;
+					}
+
+				internal:
+					StreamEncoderTellEventArgs()
+						: absoluteByteOffset_(0), result_(FLAC__STREAM_ENCODER_TELL_STATUS_UNSUPPORTED) { }
+
+					void Reset() {
+						absoluteByteOffset_ = 0;
+						result_ = FLAC__STREAM_ENCODER_TELL_STATUS_UNSUPPORTED;
+					}
+
+					property FLAC__uint64 AbsoluteByteOffset {
+						FLAC__uint64 get() { return absoluteByteOffset_; }
+					}
+
+					property ::FLAC__StreamEncoderTellStatus Result {
+						::FLAC__StreamEncoderTellStatus get() { return result_; }
+					}
+
+				private:
+					FLAC__uint64 absoluteByteOffset_;
+					::FLAC__StreamEncoderTellStatus result_;
+				};
+
+			}
+
+
+			/** \ingroup flacrt_encoder
+			*  \brief
+			*  This class wraps the ::FLAC__StreamEncoder.
+			*
+			* Set the stream parameters and metadata, call one of the Init()
+			* overloads, feed interleaved PCM with ProcessInterleaved() and
+			* call Finish().  The Set*() calls only succeed before Init(), as
+			* in the C layer.
+			*
+			* Writes to a stream go through a 256 KiB write-behind block, so
+			* there is one asynchronous store per block rather than per frame.
+			* With SetEncodeQueueDepth() the encoding itself moves to a worker
+			* thread: ProcessInterleaved() then only copies the buffer into the
+			* queue, and any failure is reported by a later
+			* ProcessInterleaved() or by Finish().  The write, seek, tell and
+			* read events are then raised on the worker thread, and an
+			* exception thrown from a handler, or an unset result, fails the
+			* encoder the same way.
+			*/
+			public ref class StreamEncoder sealed {
+			public:
+				StreamEncoder();
+				virtual ~StreamEncoder();
+
+				//@{
+				/** Call after construction to check the that the object was created
+				 *  successfully.  If not, use GetState() to find out why not.
+				 */
+				property bool IsValid { bool get(); }
+				//@}
+
+				bool SetOggSerialNumber(int value);						///< See FLAC__stream_encoder_set_ogg_serial_number()
+				bool SetVerify(bool value);								///< See FLAC__stream_encoder_set_verify()
+				bool SetStreamableSubset(bool value);					///< See FLAC__stream_encoder_set_streamable_subset()
+				bool SetChannels(unsigned value);						///< See FLAC__stream_encoder_set_channels()
+				bool SetBitsPerSample(unsigned value);					///< See FLAC__stream_encoder_set_bits_per_sample(); 8, 16 and 24 bit input is accepted
+				bool SetSampleRate(unsigned value);						///< See FLAC__stream_encoder_set_sample_rate()
+				bool SetCompressionLevel(unsigned value);				///< See FLAC__stream_encoder_set_compression_level()
+				bool SetBlocksize(unsigned value);						///< See FLAC__stream_encoder_set_blocksize()
+				bool SetTotalSamplesEstimate(FLAC__uint64 value);		///< See FLAC__stream_encoder_set_total_samples_estimate()
+
+				bool AddMetadataComment(Platform::String^ name, Platform::String^ value);	///< Appends a NAME=value entry to the VORBIS_COMMENT block
+				bool SetMetadataPadding(unsigned length);									///< Appends a PADDING block of \a length bytes; 0 for none
+				bool SetMetadataSeekPointSpacing(unsigned samples);							///< Adds a SEEKTABLE with a point every \a samples samples; needs the total samples estimate
+				bool SetEncodeQueueDepth(unsigned depth);									///< Encodes on a worker thread with up to \a depth buffers queued; 0 (the default) encodes on the calling thread
+
+				StreamEncoderState GetState();							///< See FLAC__stream_encoder_get_state()
+				bool GetVerify();										///< See FLAC__stream_encoder_get_verify()
+				bool GetStreamableSubset();								///< See FLAC__stream_encoder_get_streamable_subset()
+				unsigned GetChannels();									///< See FLAC__stream_encoder_get_channels()
+				unsigned GetBitsPerSample();							///< See FLAC__stream_encoder_get_bits_per_sample()
+				unsigned GetSampleRate();								///< See FLAC__stream_encoder_get_sample_rate()
+				unsigned GetBlocksize();								///< See FLAC__stream_encoder_get_blocksize()
+				FLAC__uint64 GetTotalSamplesEstimate();					///< See FLAC__stream_encoder_get_total_samples_estimate()
+				unsigned GetEncodeQueueDepth();
+
+				StreamEncoderInitStatus Init();																	///< See FLAC__stream_encoder_init_stream(); output goes to the events
+				StreamEncoderInitStatus Init(Windows::Storage::Streams::IRandomAccessStream^ fileStream);		///< Encodes into \a fileStream, which is truncated once the encoder writes to it
+				StreamEncoderInitStatus InitOutputStream(Windows::Storage::Streams::IOutputStream^ outputStream);	///< Encodes without seeking; STREAMINFO keeps the values known at init
+				StreamEncoderInitStatus InitOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream);		///< See FLAC__stream_encoder_init_ogg_stream()
+
+				bool Finish();											///< See FLAC__stream_encoder_finish()
+
+				/** Encodes \a data, interleaved little-endian PCM of GetChannels()
+				 *  channels and GetBitsPerSample() bits (8 bit unsigned, 16 and 24
+				 *  bit signed).  A trailing partial sample is kept for the next call.
+				 *  See FLAC__stream_encoder_process_interleaved().
+				 */
+				bool ProcessInterleaved(const Platform::Array<FLAC__byte>^ data);
+
+				/// see FLAC__StreamEncoderWriteCallback
+				event Windows::Foundation::TypedEventHandler<Platform::Object^, Callbacks::StreamEncoderWriteEventArgs^>^ WriteCallback;
+
+				/// see FLAC__StreamEncoderSeekCallback
+				event Windows::Foundation::TypedEventHandler<Platform::Object^, Callbacks::StreamEncoderSeekEventArgs^>^ SeekCallback;
+
+				/// see FLAC__StreamEncoderTellCallback
+				event Windows::Foundation::TypedEventHandler<Platform::Object^, Callbacks::StreamEncoderTellEventArgs^>^ TellCallback;
+
+			private:
+				StreamEncoderInitStatus init_file_stream_(::EncoderWriteCache *file_stream, bool seekable, bool ogg);
+
+				::FLAC__StreamEncoder *encoder_;
+				::EncoderWriteCache *file_stream_;
+				::PcmEncoder *pcm_encoder_;
+				::EncodeQueue *encode_queue_;
+				::EncoderMetadata *metadata_;
+				unsigned encode_queue_depth_;
+				Callbacks::StreamEncoderWriteEventArgs^ write_args_;
+				Callbacks::StreamEncoderTellEventArgs^ tell_args_;
+
+				static ::FLAC__StreamEncoderReadStatus read_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+				static ::FLAC__StreamEncoderWriteStatus write_callback_(const ::FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
+				static ::FLAC__StreamEncoderSeekStatus seek_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data);
+				static ::FLAC__StreamEncoderTellStatus tell_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
+			};
+		}
+	}
+}
+
+#endif
@@ -1025,13 +1025,30 @@ namespace FLAC {
 					 * number of palette entries), or \c 0 for non-indexed (i.e. 2^depth).
 					 */
 
+					property FLAC__uint32 DataLength {
+						FLAC__uint32 get() { return source_.data_length; }
+					}
+					/**< Length of binary picture data in bytes. */
+
 					property Platform::Array<FLAC__byte>^ Data {
 						Platform::Array<FLAC__byte>^ get() {
+							if (!source_.data) {
+								return nullptr;
+							}
 							return data_ ? data_ : (data_ =
 								ref new Platform::Array<FLAC__byte>(source_.data, source_.data_length));
 						}
 					}
-					/**< Binary picture data. */
+					/**< Binary picture data, or \c nullptr if the data was left in
+					 * the stream (see StreamDecoder::SetLazyPictures()).
+					 */
+
+					property FLAC__uint64 DataOffset {
+						FLAC__uint64 get() { return source_.data_offset; }
+					}
+					/**< Where the picture data starts in the stream when Data is
+					 * \c nullptr, else \c 0.
+					 */
 
 				internal:
 					Picture(const FLAC__StreamMetadata_Picture &src) : source_(src) { }
@@ -0,0 +1,378 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__METADATA_H
+#define FLACRT__METADATA_H
+
+#include "FLAC/metadata.h"
+#include "FLAC/stream_splicer.h"
+#include "FLAC_winrt/format.h"
+
+
+/** \file include/FLAC_winrt/metadata.h
+*
+*  \brief
+*  This module contains the class which reads and edits FLAC metadata.
+*
+*  See the detailed documentation in the
+*  \link flacrt_metadata metadata \endlink module.
+*/
+
+/** \defgroup flacrt_metadata FLAC_winrt/metadata.h: metadata editor class
+*  \ingroup flacpp
+*
+*  \brief
+*  This module describes the metadata layer provided by libFLAC_winrt.
+*
+* The MetadataEditor class wraps a FLAC__Metadata_Chain read from an
+* IRandomAccessStream; make sure to read the
+* \link flac_metadata_level2 libFLAC level 2 metadata interface \endlink.
+*
+* Tags and pictures are read without decoding any audio, PICTURE data is
+* only read when asked for, and edits are written back in place whenever
+* they fit in the existing metadata and padding.
+*
+* The StreamSplicer class cuts and joins ranges of FLAC streams through
+* the \link flac_stream_splicer stream splicer \endlink, copying whole
+* frames instead of decoding and encoding them.
+*
+* The MetadataIndexer class reads the tags and STREAMINFO of many streams
+* at once through the \link flac_metadata_indexer metadata indexer \endlink,
+* with its workers on the thread pool.
+*/
+
+class MetadataEditor;
+class MetadataIndexer;
+class MetadataStream;
+class StreamSplicer;
+
+namespace FLAC {
+
+	namespace WindowsRuntime {
+
+		namespace Editor {
+
+			/** This class is a wrapper around FLAC__Metadata_ChainStatus.
+			*/
+			public enum class MetadataEditorStatus {
+
+				OK = FLAC__METADATA_CHAIN_STATUS_OK,
+				/**< The chain is in the normal OK state */
+
+				IllegalInput = FLAC__METADATA_CHAIN_STATUS_ILLEGAL_INPUT,
+				/**< The data passed into a function violated the function's usage criteria */
+
+				NotAFlacFile = FLAC__METADATA_CHAIN_STATUS_NOT_A_FLAC_FILE,
+				/**< The stream does not appear to be a FLAC stream. */
+
+				BadMetadata = FLAC__METADATA_CHAIN_STATUS_BAD_METADATA,
+				/**< The stream has invalid metadata. */
+
+				ReadError = FLAC__METADATA_CHAIN_STATUS_READ_ERROR,
+				/**< There was an error while reading from the stream. */
+
+				SeekError = FLAC__METADATA_CHAIN_STATUS_SEEK_ERROR,
+				/**< There was an error while seeking in the stream. */
+
+				WriteError = FLAC__METADATA_CHAIN_STATUS_WRITE_ERROR,
+				/**< There was an error while writing to the stream. */
+
+				MemoryAllocationError = FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR,
+				/**< Memory allocation failed. */
+
+				InternalError = FLAC__METADATA_CHAIN_STATUS_INTERNAL_ERROR,
+				/**< The caller violated an assertion or an unexpected error occurred. */
+
+				InvalidCallbacks = FLAC__METADATA_CHAIN_STATUS_INVALID_CALLBACKS,
+				/**< One or more of the required callbacks was NULL. */
+
+				ReadWriteMismatch = FLAC__METADATA_CHAIN_STATUS_READ_WRITE_MISMATCH,
+				/**< Write() was called on a chain read as Ogg FLAC, which cannot be written back. */
+
+				WrongWriteCall = FLAC__METADATA_CHAIN_STATUS_WRONG_WRITE_CALL
+				/**< The edit did not fit in place and no scratch stream was available. */
+
+			};
+
+			/** \ingroup flacrt_metadata
+			*  \brief
+			*  This class wraps the ::FLAC__Metadata_Chain.
+			*
+			* Call Read() or ReadOgg() with a stream that stays open for the
+			* life of the editor, query or edit the blocks, then Write().
+			* The StreamMetadata objects handed out point into the chain and
+			* are only valid until the next edit, Read() or Write().
+			*
+			* Write() keeps the audio where it is when the edited metadata
+			* fits in the old metadata plus padding, and removing a picture
+			* leaves padding behind so that later edits fit too.  Otherwise
+			* the stream is rebuilt in a file in the app's temporary folder
+			* and copied back, and the file is deleted afterwards.
+			*/
+			public ref class MetadataEditor sealed {
+			public:
+				MetadataEditor();
+				virtual ~MetadataEditor();
+
+				//@{
+				/** Call after construction to check the that the object was created
+				 *  successfully.
+				 */
+				property bool IsValid { bool get(); }
+				//@}
+
+				bool Read(Windows::Storage::Streams::IRandomAccessStream^ fileStream);		///< See FLAC__metadata_chain_read_with_callbacks()
+				bool ReadOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream);	///< See FLAC__metadata_chain_read_ogg_with_callbacks(); the result cannot be written back
+				bool Write();																///< See FLAC__metadata_chain_write_with_callbacks()
+				bool CanWriteInPlace();														///< See FLAC__metadata_chain_check_if_tempfile_needed()
+
+				MetadataEditorStatus GetStatus();											///< See FLAC__metadata_chain_status()
+				Format::StreamMetadata^ GetStreamInfo();									///< The STREAMINFO block
+				unsigned GetBlockCount();
+				Format::StreamMetadata^ GetBlock(unsigned index);							///< See FLAC__metadata_iterator_get_block(); PICTURE data may not be loaded
+
+				Platform::Array<Platform::String^>^ GetTag(Platform::String^ name);		///< The values of every \a name entry of the VORBIS_COMMENT block
+				bool SetTag(Platform::String^ name, Platform::String^ value);				///< Replaces every \a name entry with one NAME=value entry
+				bool AddTag(Platform::String^ name, Platform::String^ value);				///< Appends a NAME=value entry
+				int RemoveTag(Platform::String^ name);										///< See FLAC__metadata_object_vorbiscomment_remove_entries_matching()
+
+				unsigned GetPictureCount();
+				Format::StreamMetadata^ GetPicture(unsigned index);						///< The \a index th PICTURE block, with its data read from the stream
+				bool AddPicture(Format::Metadata::PictureType type, Platform::String^ mimeType, Platform::String^ description,
+					FLAC__uint32 width, FLAC__uint32 height, FLAC__uint32 depth, FLAC__uint32 colors, const Platform::Array<FLAC__byte>^ data);	///< Adds a PICTURE block before the padding
+				bool RemovePicture(unsigned index);										///< Replaces the \a index th PICTURE block with padding
+
+			private:
+				::MetadataEditor *editor_;
+				::MetadataStream *stream_;
+			};
+
+			/** This class is a wrapper around FLAC__StreamSplicerStatus.
+			*/
+			public enum class StreamSplicerStatus {
+
+				OK = FLAC__STREAM_SPLICER_OK,
+				/**< No error. */
+
+				InvalidSegment = FLAC__STREAM_SPLICER_INVALID_SEGMENT,
+				/**< There are no ranges, or a range starts at or past the end of its stream. */
+
+				FormatMismatch = FLAC__STREAM_SPLICER_FORMAT_MISMATCH,
+				/**< The streams differ in sample rate, number of channels or bits per sample. */
+
+				ReadError = FLAC__STREAM_SPLICER_READ_ERROR,
+				/**< A stream could not be read. */
+
+				BadFrame = FLAC__STREAM_SPLICER_BAD_FRAME,
+				/**< A frame of a stream could not be found where it should be. */
+
+				DecoderError = FLAC__STREAM_SPLICER_DECODER_ERROR,
+				/**< A stream could not be decoded, e.g. it is not a native FLAC stream. */
+
+				EncoderError = FLAC__STREAM_SPLICER_ENCODER_ERROR,
+				/**< The frames at a boundary could not be encoded. */
+
+				WriteError = FLAC__STREAM_SPLICER_WRITE_ERROR,
+				/**< The output could not be written. */
+
+				SeekError = FLAC__STREAM_SPLICER_SEEK_ERROR,
+				/**< A stream could not be seeked. */
+
+				MemoryAllocationError = FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR
+				/**< Memory allocation failed. */
+
+			};
+
+			/** \ingroup flacrt_metadata
+			*  \brief
+			*  This class wraps the ::FLAC__StreamSplicer.
+			*
+			* Add the ranges in output order with AddSegment(), then call
+			* Splice().  The streams must stay open until Splice() returns.
+			* Only the frames cut by a range boundary are decoded and encoded
+			* again, so a splice costs little more than copying the bytes.
+			*/
+			public ref class StreamSplicer sealed {
+			public:
+				StreamSplicer();
+				virtual ~StreamSplicer();
+
+				//@{
+				/** Call after construction to check the that the object was created
+				 *  successfully.
+				 */
+				property bool IsValid { bool get(); }
+				//@}
+
+				bool SetMd5(bool value);													///< See FLAC__stream_splicer_set_md5()
+				bool SetCompressionLevel(unsigned value);									///< See FLAC__stream_splicer_set_compression_level()
+				bool AddSegment(Windows::Storage::Streams::IRandomAccessStream^ fileStream, FLAC__uint64 startSample, FLAC__uint64 samples);	///< See FLAC__stream_splicer_add_segment()
+				bool Splice(Windows::Storage::Streams::IRandomAccessStream^ outputStream);	///< See FLAC__stream_splicer_splice(); \a outputStream is overwritten from its start
+				StreamSplicerStatus GetStatus();											///< See FLAC__stream_splicer_get_status()
+
+			private:
+				::StreamSplicer *splicer_;
+			};
+
+			/** This class is a wrapper around FLAC__MetadataIndexStatus.
+			*/
+			public enum class MetadataIndexStatus {
+
+				OK = FLAC__METADATA_INDEX_STATUS_OK,
+				/**< The stream was read. */
+
+				NotRead = FLAC__METADATA_INDEX_STATUS_NOT_READ,
+				/**< No worker has got to the stream yet. */
+
+				ErrorOpeningFile = FLAC__METADATA_INDEX_STATUS_ERROR_OPENING_FILE,
+				/**< The stream could not be rewound. */
+
+				NotAFlacFile = FLAC__METADATA_INDEX_STATUS_NOT_A_FLAC_FILE,
+				/**< The stream is not a native FLAC stream. */
+
+				ReadError = FLAC__METADATA_INDEX_STATUS_READ_ERROR,
+				/**< The stream could not be read or has a malformed metadata block. */
+
+				MemoryAllocationError = FLAC__METADATA_INDEX_STATUS_MEMORY_ALLOCATION_ERROR
+				/**< Memory allocation failed. */
+
+			};
+
+			/** \ingroup flacrt_metadata
+			*  \brief
+			*  This class wraps a ::FLAC__MetadataIndexEntry.
+			*
+			* It points into the indexer, and is only valid until the next
+			* AddStream() or until the indexer is deleted.
+			*/
+			public ref class MetadataIndexEntry sealed {
+			public:
+				property MetadataIndexStatus Status {
+					MetadataIndexStatus get() { return (MetadataIndexStatus)(int)source_->status; }
+				}
+
+				property Format::Metadata::StreamInfo^ StreamInfo {
+					Format::Metadata::StreamInfo^ get() {
+						return stream_info_ ? stream_info_ : (stream_info_ = source_->has_stream_info
+							? ref new Format::Metadata::StreamInfo(source_->stream_info) : nullptr);
+					}
+				}
+				/**< The STREAMINFO block, or \c nullptr if it was not asked for or read. */
+
+				property Platform::Array<Platform::String^>^ Tags {
+					Platform::Array<Platform::String^>^ get() {
+						return tags_ ? tags_ : (tags_ = InitializeTags());
+					}
+				}
+				/**< The selected Vorbis comments, as \c NAME=value strings in stream order. */
+
+				property unsigned PictureCount {
+					unsigned get() { return source_->num_pictures; }
+				}
+
+				property Format::Metadata::PictureType PictureType {
+					Format::Metadata::PictureType get() { return (Format::Metadata::PictureType)(int)source_->picture_type; }
+				}
+				/**< The type of the first front cover, or of the first picture if there is no front cover. */
+
+				property FLAC__uint32 PictureWidth {
+					FLAC__uint32 get() { return source_->picture_width; }
+				}
+
+				property FLAC__uint32 PictureHeight {
+					FLAC__uint32 get() { return source_->picture_height; }
+				}
+
+				property FLAC__uint32 PictureDepth {
+					FLAC__uint32 get() { return source_->picture_depth; }
+				}
+
+				property FLAC__uint32 PictureDataLength {
+					FLAC__uint32 get() { return source_->picture_data_length; }
+				}
+
+			internal:
+				MetadataIndexEntry(const FLAC__MetadataIndexEntry *src) : source_(src) { }
+
+			private:
+				inline Platform::Array<Platform::String^>^ InitializeTags() {
+					Platform::Array<Platform::String^>^ arr = ref new Platform::Array<Platform::String^>(source_->num_tags);
+					for (unsigned i = 0; i < arr->Length; i++) {
+						arr[i] = string_from_utf8(source_->tags[i]);
+					}
+					return arr;
+				}
+
+				const FLAC__MetadataIndexEntry *source_;
+
+				Format::Metadata::StreamInfo^ stream_info_;
+				Platform::Array<Platform::String^>^ tags_;
+			};
+
+			/** \ingroup flacrt_metadata
+			*  \brief
+			*  This class wraps the ::FLAC__MetadataIndexer.
+			*
+			* Pick what to read with SetTypes() and SetTagNames(), queue the
+			* streams with AddStream(), then call RunAsync().  libFLAC cannot
+			* start threads in a Store app, so RunAsync() runs each worker as a
+			* thread pool work item calling FLAC__metadata_indexer_work().
+			* The streams stay open until the indexer is deleted, and none
+			* can be added while it runs.
+			*/
+			public ref class MetadataIndexer sealed {
+			public:
+				MetadataIndexer();
+				virtual ~MetadataIndexer();
+
+				//@{
+				/** Call after construction to check the that the object was created
+				 *  successfully.
+				 */
+				property bool IsValid { bool get(); }
+				//@}
+
+				bool SetTypes(const Platform::Array<Format::MetadataType>^ types);			///< See FLAC__metadata_indexer_set_types()
+				bool SetTagNames(const Platform::Array<Platform::String^>^ names);			///< See FLAC__metadata_indexer_set_tag_names(); \c nullptr keeps all the tags
+				bool AddStream(Windows::Storage::Streams::IRandomAccessStream^ fileStream);	///< See FLAC__metadata_indexer_add_stream()
+				unsigned GetCount();														///< See FLAC__metadata_indexer_get_count()
+				Windows::Foundation::IAsyncOperation<bool>^ RunAsync(unsigned maxInFlight);	///< Reads with up to \a maxInFlight thread pool work items; see FLAC__metadata_indexer_run()
+				MetadataIndexEntry^ GetEntry(unsigned index);								///< See FLAC__metadata_indexer_get_entry()
+
+			private:
+				::MetadataIndexer *indexer_;
+			};
+
+		}
+	}
+}
+
+#endif
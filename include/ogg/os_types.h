@@ -18,11 +18,20 @@
 #define _OS_TYPES_H
 
 /* make it easy on the folks that want to compile the libs with a
-   different malloc than stdlib */
+   different malloc than stdlib; any of these may also be predefined
+   by the build */
+#ifndef _ogg_malloc
 #define _ogg_malloc  malloc
+#endif
+#ifndef _ogg_calloc
 #define _ogg_calloc  calloc
+#endif
+#ifndef _ogg_realloc
 #define _ogg_realloc realloc
+#endif
+#ifndef _ogg_free
 #define _ogg_free    free
+#endif
 
 #if defined(_WIN32)
 
@@ -40,6 +40,7 @@
 #include "private/bitreader.h"
 #include "private/crc.h"
 #include "private/macros.h"
+#include "private/memory.h"
 #include "FLAC/assert.h"
 #include "share/compat.h"
 #include "share/endswap.h"
@@ -89,6 +90,7 @@ struct FLAC__BitReader {
 	FLAC__BitReaderReadCallback read_callback;
 	void *client_data;
 	FLAC__CPUInfo cpu_info;
+	const FLAC__MemoryCallbacks *mem; /* for buffer */
 };
 
 static inline void crc16_update_word_(FLAC__BitReader *br, uint32_t word)
@@ -232,16 +234,20 @@ void FLAC__bitreader_delete(FLAC__BitReader *br)
  *
  ***********************************************************************/
 
-FLAC__bool FLAC__bitreader_init(FLAC__BitReader *br, FLAC__CPUInfo cpu, FLAC__BitReaderReadCallback rcb, void *cd)
+FLAC__bool FLAC__bitreader_init(FLAC__BitReader *br, const FLAC__MemoryCallbacks *mem, FLAC__CPUInfo cpu, FLAC__BitReaderReadCallback rcb, void *cd)
 {
 	FLAC__ASSERT(0 != br);
 
 	br->words = br->bytes = 0;
 	br->consumed_words = br->consumed_bits = 0;
-	br->capacity = FLAC__BITREADER_DEFAULT_CAPACITY;
-	br->buffer = malloc(sizeof(uint32_t) * br->capacity);
-	if(br->buffer == 0)
-		return false;
+	/* the buffer may have been kept from a previous init (see FLAC__stream_decoder_set_retain_buffers()) */
+	if(br->buffer == 0) {
+		br->mem = mem;
+		br->capacity = FLAC__BITREADER_DEFAULT_CAPACITY;
+		br->buffer = FLAC__memory_malloc(br->mem, sizeof(uint32_t) * br->capacity);
+		if(br->buffer == 0)
+			return false;
+	}
 	br->read_callback = rcb;
 	br->client_data = cd;
 	br->cpu_info = cpu;
@@ -254,7 +260,7 @@ void FLAC__bitreader_free(FLAC__BitReader *br)
 	FLAC__ASSERT(0 != br);
 
 	if(0 != br->buffer)
-		free(br->buffer);
+		FLAC__memory_free(br->mem, br->buffer);
 	br->buffer = 0;
 	br->capacity = 0;
 	br->words = br->bytes = 0;
@@ -263,6 +269,13 @@ void FLAC__bitreader_free(FLAC__BitReader *br)
 	br->client_data = 0;
 }
 
+size_t FLAC__bitreader_get_memory_usage(const FLAC__BitReader *br)
+{
+	FLAC__ASSERT(0 != br);
+
+	return sizeof(*br) + (0 != br->buffer? sizeof(uint32_t) * br->capacity : 0);
+}
+
 FLAC__bool FLAC__bitreader_clear(FLAC__BitReader *br)
 {
 	br->words = br->bytes = 0;
@@ -851,6 +864,60 @@ incomplete_lsbs:
 	return true;
 }
 
+/* like FLAC__bitreader_read_rice_signed_block() but only consumes the bits;
+ * unlike the *_no_crc() skippers the skipped data is still CRC'd, so it is
+ * safe to use inside a frame */
+FLAC__bool FLAC__bitreader_skip_rice_signed_block(FLAC__BitReader *br, unsigned nvals, unsigned parameter)
+{
+	unsigned msbs;
+	FLAC__uint32 lsbs;
+	uint32_t b;
+
+	FLAC__ASSERT(0 != br);
+	FLAC__ASSERT(0 != br->buffer);
+	/* WATCHOUT: code does not work with <32bit words; we can make things much faster with this assertion */
+	FLAC__ASSERT(FLAC__BITS_PER_WORD >= 32);
+	FLAC__ASSERT(parameter < 32);
+
+	while(nvals > 0) {
+		if(br->consumed_words >= br->words) {
+			/* at a partial tail word; let the slow readers deal with it, they also refill the buffer */
+			if(!FLAC__bitreader_read_unary_unsigned(br, &msbs))
+				return false;
+			if(!FLAC__bitreader_read_raw_uint32(br, &lsbs, parameter))
+				return false;
+			nvals--;
+			continue;
+		}
+
+		/* skip the unary MSBs and end bit; the value itself is of no interest */
+		b = br->buffer[br->consumed_words] << br->consumed_bits;
+		if(b == 0) {
+			/* didn't find stop bit in this word, have to keep going... */
+			crc16_update_word_(br, br->buffer[br->consumed_words]);
+			br->consumed_words++;
+			br->consumed_bits = 0;
+			continue;
+		}
+		br->consumed_bits += FLAC__clz_uint32(b) + 1;
+		if(br->consumed_bits >= FLAC__BITS_PER_WORD) { /* faster way of testing if(br->consumed_bits == FLAC__BITS_PER_WORD) */
+			crc16_update_word_(br, br->buffer[br->consumed_words]);
+			br->consumed_words++;
+			br->consumed_bits = 0;
+		}
+
+		/* skip the binary LSBs */
+		if(br->consumed_words < br->words && br->consumed_bits + parameter < FLAC__BITS_PER_WORD)
+			br->consumed_bits += parameter;
+		else if(!FLAC__bitreader_read_raw_uint32(br, &lsbs, parameter))
+			return false;
+
+		nvals--;
+	}
+
+	return true;
+}
+
 #if 0 /* UNUSED */
 FLAC__bool FLAC__bitreader_read_golomb_signed(FLAC__BitReader *br, int *val, unsigned parameter)
 {
@@ -39,6 +39,7 @@
 #include "private/bitwriter.h"
 #include "private/crc.h"
 #include "private/macros.h"
+#include "private/memory.h"
 #include "FLAC/assert.h"
 #include "share/alloc.h"
 #include "share/compat.h"
@@ -76,6 +77,7 @@ struct FLAC__BitWriter {
 	unsigned capacity; /* capacity of buffer in words */
 	unsigned words; /* # of complete words in buffer */
 	unsigned bits; /* # of used bits in accum */
+	const FLAC__MemoryCallbacks *mem; /* for buffer */
 };
 
 /* * WATCHOUT: The current implementation only grows the buffer. */
@@ -107,7 +109,7 @@ FLAC__bool bitwriter_grow_(FLAC__BitWriter *bw, unsigned bits_to_add)
 	FLAC__ASSERT(new_capacity > bw->capacity);
 	FLAC__ASSERT(new_capacity >= bw->words + ((bw->bits + bits_to_add + FLAC__BITS_PER_WORD - 1) / FLAC__BITS_PER_WORD));
 
-	new_buffer = safe_realloc_mul_2op_(bw->buffer, sizeof(uint32_t), /*times*/new_capacity);
+	new_buffer = FLAC__memory_realloc_mul_2op(bw->mem, bw->buffer, sizeof(uint32_t), /*times*/new_capacity);
 	if(new_buffer == 0)
 		return false;
 	bw->buffer = new_buffer;
@@ -143,13 +145,14 @@ void FLAC__bitwriter_delete(FLAC__BitWriter *bw)
  *
  ***********************************************************************/
 
-FLAC__bool FLAC__bitwriter_init(FLAC__BitWriter *bw)
+FLAC__bool FLAC__bitwriter_init(FLAC__BitWriter *bw, const FLAC__MemoryCallbacks *mem)
 {
 	FLAC__ASSERT(0 != bw);
 
 	bw->words = bw->bits = 0;
+	bw->mem = mem;
 	bw->capacity = FLAC__BITWRITER_DEFAULT_CAPACITY;
-	bw->buffer = malloc(sizeof(uint32_t) * bw->capacity);
+	bw->buffer = FLAC__memory_malloc(bw->mem, sizeof(uint32_t) * bw->capacity);
 	if(bw->buffer == 0)
 		return false;
 
@@ -161,12 +164,19 @@ void FLAC__bitwriter_free(FLAC__BitWriter *bw)
 	FLAC__ASSERT(0 != bw);
 
 	if(0 != bw->buffer)
-		free(bw->buffer);
+		FLAC__memory_free(bw->mem, bw->buffer);
 	bw->buffer = 0;
 	bw->capacity = 0;
 	bw->words = bw->bits = 0;
 }
 
+size_t FLAC__bitwriter_get_memory_usage(const FLAC__BitWriter *bw)
+{
+	FLAC__ASSERT(0 != bw);
+
+	return sizeof(*bw) + (0 != bw->buffer? sizeof(uint32_t) * bw->capacity : 0);
+}
+
 void FLAC__bitwriter_clear(FLAC__BitWriter *bw)
 {
 	bw->words = bw->bits = 0;
@@ -41,6 +41,7 @@
 #include "FLAC/format.h"
 #include "share/compat.h"
 #include "private/format.h"
+#include "private/memory.h"
 #include "private/macros.h"
 
 /* VERSION should come from configure */
@@ -560,27 +561,27 @@ void FLAC__format_entropy_coding_method_partitioned_rice_contents_init(FLAC__Ent
 	object->capacity_by_order = 0;
 }
 
-void FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(FLAC__EntropyCodingMethod_PartitionedRiceContents *object)
+void FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(const FLAC__MemoryCallbacks *mem, FLAC__EntropyCodingMethod_PartitionedRiceContents *object)
 {
 	FLAC__ASSERT(0 != object);
 
 	if(0 != object->parameters)
-		free(object->parameters);
+		FLAC__memory_free(mem, object->parameters);
 	if(0 != object->raw_bits)
-		free(object->raw_bits);
+		FLAC__memory_free(mem, object->raw_bits);
 	FLAC__format_entropy_coding_method_partitioned_rice_contents_init(object);
 }
 
-FLAC__bool FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(FLAC__EntropyCodingMethod_PartitionedRiceContents *object, unsigned max_partition_order)
+FLAC__bool FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(const FLAC__MemoryCallbacks *mem, FLAC__EntropyCodingMethod_PartitionedRiceContents *object, unsigned max_partition_order)
 {
 	FLAC__ASSERT(0 != object);
 
 	FLAC__ASSERT(object->capacity_by_order > 0 || (0 == object->parameters && 0 == object->raw_bits));
 
 	if(object->capacity_by_order < max_partition_order) {
-		if(0 == (object->parameters = realloc(object->parameters, sizeof(unsigned)*(1 << max_partition_order))))
+		if(0 == (object->parameters = FLAC__memory_realloc(mem, object->parameters, sizeof(unsigned)*(1 << max_partition_order))))
 			return false;
-		if(0 == (object->raw_bits = realloc(object->raw_bits, sizeof(unsigned)*(1 << max_partition_order))))
+		if(0 == (object->raw_bits = FLAC__memory_realloc(mem, object->raw_bits, sizeof(unsigned)*(1 << max_partition_order))))
 			return false;
 		memset(object->raw_bits, 0, sizeof(unsigned)*(1 << max_partition_order));
 		object->capacity_by_order = max_partition_order;
@@ -588,3 +589,15 @@ FLAC__bool FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_s
 
 	return true;
 }
+
+size_t FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(const FLAC__EntropyCodingMethod_PartitionedRiceContents *object, unsigned max_partition_order)
+{
+	FLAC__ASSERT(0 != object);
+
+	if(0 != object->parameters && object->capacity_by_order > max_partition_order)
+		max_partition_order = object->capacity_by_order;
+	else if(0 == object->parameters && 0 == max_partition_order)
+		return 0;
+	/* parameters[] and raw_bits[], see ..._ensure_size() above */
+	return 2 * sizeof(unsigned) * ((size_t)1 << max_partition_order);
+}
@@ -34,6 +34,7 @@
 #define FLAC__PRIVATE__BITWRITER_H
 
 #include <stdio.h> /* for FILE */
+#include "FLAC/callback.h"
 #include "FLAC/ordinals.h"
 
 /*
@@ -47,8 +48,9 @@ typedef struct FLAC__BitWriter FLAC__BitWriter;
  */
 FLAC__BitWriter *FLAC__bitwriter_new(void);
 void FLAC__bitwriter_delete(FLAC__BitWriter *bw);
-FLAC__bool FLAC__bitwriter_init(FLAC__BitWriter *bw);
+FLAC__bool FLAC__bitwriter_init(FLAC__BitWriter *bw, const FLAC__MemoryCallbacks *mem);
 void FLAC__bitwriter_free(FLAC__BitWriter *bw); /* does not 'free(buffer)' */
+size_t FLAC__bitwriter_get_memory_usage(const FLAC__BitWriter *bw); /* in bytes, including the object itself */
 void FLAC__bitwriter_clear(FLAC__BitWriter *bw);
 void FLAC__bitwriter_dump(const FLAC__BitWriter *bw, FILE *out);
 
@@ -33,13 +33,15 @@
 #ifndef FLAC__PRIVATE__FORMAT_H
 #define FLAC__PRIVATE__FORMAT_H
 
+#include "FLAC/callback.h"
 #include "FLAC/format.h"
 
 unsigned FLAC__format_get_max_rice_partition_order(unsigned blocksize, unsigned predictor_order);
 unsigned FLAC__format_get_max_rice_partition_order_from_blocksize(unsigned blocksize);
 unsigned FLAC__format_get_max_rice_partition_order_from_blocksize_limited_max_and_predictor_order(unsigned limit, unsigned blocksize, unsigned predictor_order);
 void FLAC__format_entropy_coding_method_partitioned_rice_contents_init(FLAC__EntropyCodingMethod_PartitionedRiceContents *object);
-void FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(FLAC__EntropyCodingMethod_PartitionedRiceContents *object);
-FLAC__bool FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(FLAC__EntropyCodingMethod_PartitionedRiceContents *object, unsigned max_partition_order);
+void FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(const FLAC__MemoryCallbacks *mem, FLAC__EntropyCodingMethod_PartitionedRiceContents *object);
+FLAC__bool FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(const FLAC__MemoryCallbacks *mem, FLAC__EntropyCodingMethod_PartitionedRiceContents *object, unsigned max_partition_order);
+size_t FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(const FLAC__EntropyCodingMethod_PartitionedRiceContents *object, unsigned max_partition_order); /* in bytes, after growing to max_partition_order (0 for the current size) */
 
 #endif
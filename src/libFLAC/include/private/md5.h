@@ -26,6 +26,7 @@
  * Still in the public domain, with no warranty.
  */
 
+#include "FLAC/callback.h"
 #include "FLAC/ordinals.h"
 
 typedef struct {
@@ -34,9 +35,10 @@ typedef struct {
 	FLAC__uint32 bytes[2];
 	FLAC__byte *internal_buf;
 	size_t capacity;
+	const FLAC__MemoryCallbacks *mem; /* for internal_buf */
 } FLAC__MD5Context;
 
-void FLAC__MD5Init(FLAC__MD5Context *context);
+void FLAC__MD5Init(FLAC__MD5Context *context, const FLAC__MemoryCallbacks *mem);
 void FLAC__MD5Final(FLAC__byte digest[16], FLAC__MD5Context *context);
 
 FLAC__bool FLAC__MD5Accumulate(FLAC__MD5Context *ctx, const FLAC__int32 * const signal[], unsigned channels, unsigned samples, unsigned bytes_per_sample);
@@ -40,18 +40,35 @@
 #include <stdlib.h> /* for size_t */
 
 #include "private/float.h"
+#include "FLAC/callback.h" /* for FLAC__MemoryCallbacks */
 #include "FLAC/ordinals.h" /* for FLAC__bool */
 
-/* Returns the unaligned address returned by malloc.
- * Use free() on this address to deallocate.
+/* All of the following take an optional set of memory callbacks; if
+ * \a mem is NULL or its callbacks are not set, the C runtime heap is used.
+ * Memory obtained through these must be released with FLAC__memory_free()
+ * using the same \a mem.
+ *
+ * As with the safe_*() helpers in share/alloc.h, a request for 0 bytes
+ * allocates 1 byte and the multi-operand variants return NULL on overflow.
+ */
+void *FLAC__memory_malloc(const FLAC__MemoryCallbacks *mem, size_t size);
+void *FLAC__memory_calloc(const FLAC__MemoryCallbacks *mem, size_t nmemb, size_t size);
+void *FLAC__memory_malloc_add_2op(const FLAC__MemoryCallbacks *mem, size_t size1, size_t size2);
+void *FLAC__memory_malloc_mul_2op(const FLAC__MemoryCallbacks *mem, size_t size1, size_t size2);
+void *FLAC__memory_realloc(const FLAC__MemoryCallbacks *mem, void *ptr, size_t size);
+void *FLAC__memory_realloc_mul_2op(const FLAC__MemoryCallbacks *mem, void *ptr, size_t size1, size_t size2);
+void FLAC__memory_free(const FLAC__MemoryCallbacks *mem, void *ptr);
+
+/* Returns the unaligned address returned by FLAC__memory_malloc().
+ * Use FLAC__memory_free() on this address to deallocate.
  */
-void *FLAC__memory_alloc_aligned(size_t bytes, void **aligned_address);
-FLAC__bool FLAC__memory_alloc_aligned_int32_array(size_t elements, FLAC__int32 **unaligned_pointer, FLAC__int32 **aligned_pointer);
-FLAC__bool FLAC__memory_alloc_aligned_uint32_array(size_t elements, FLAC__uint32 **unaligned_pointer, FLAC__uint32 **aligned_pointer);
-FLAC__bool FLAC__memory_alloc_aligned_uint64_array(size_t elements, FLAC__uint64 **unaligned_pointer, FLAC__uint64 **aligned_pointer);
-FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(size_t elements, unsigned **unaligned_pointer, unsigned **aligned_pointer);
+void *FLAC__memory_alloc_aligned(const FLAC__MemoryCallbacks *mem, size_t bytes, void **aligned_address);
+FLAC__bool FLAC__memory_alloc_aligned_int32_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__int32 **unaligned_pointer, FLAC__int32 **aligned_pointer);
+FLAC__bool FLAC__memory_alloc_aligned_uint32_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__uint32 **unaligned_pointer, FLAC__uint32 **aligned_pointer);
+FLAC__bool FLAC__memory_alloc_aligned_uint64_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__uint64 **unaligned_pointer, FLAC__uint64 **aligned_pointer);
+FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(const FLAC__MemoryCallbacks *mem, size_t elements, unsigned **unaligned_pointer, unsigned **aligned_pointer);
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
-FLAC__bool FLAC__memory_alloc_aligned_real_array(size_t elements, FLAC__real **unaligned_pointer, FLAC__real **aligned_pointer);
+FLAC__bool FLAC__memory_alloc_aligned_real_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__real **unaligned_pointer, FLAC__real **aligned_pointer);
 #endif
 void *safe_malloc_mul_2op_p(size_t size1, size_t size2);
 
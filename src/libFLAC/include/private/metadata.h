@@ -43,4 +43,15 @@ void FLAC__metadata_object_delete_data(FLAC__StreamMetadata *object);
 
 void FLAC__metadata_object_cuesheet_track_delete_data(FLAC__StreamMetadata_CueSheet_Track *object);
 
+/* FLAC__metadata_probe_with_callbacks() from wherever the handle is,
+ * with the reason it stopped; with picture_data false, PICTURE blocks
+ * are passed with their data_length but without the data itself
+ */
+FLAC__Metadata_SimpleIteratorStatus FLAC__metadata_probe_stream(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, unsigned types, FLAC__bool picture_data, FLAC__MetadataProbeCallback callback, void *client_data);
+
+/* skips any ID3v2 tag and the "fLaC" marker, leaving the handle at the
+ * header of the first metadata block
+ */
+FLAC__Metadata_SimpleIteratorStatus FLAC__metadata_seek_to_first_block(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb);
+
 #endif
@@ -35,6 +35,7 @@
 
 #include <ogg/ogg.h>
 
+#include "FLAC/callback.h" /* for FLAC__MemoryCallbacks */
 #include "FLAC/ordinals.h"
 #include "FLAC/stream_decoder.h" /* for FLAC__StreamDecoderReadStatus */
 
@@ -42,26 +43,46 @@ typedef struct FLAC__OggDecoderAspect {
 	/* these are storage for values that can be set through the API */
 	FLAC__bool use_first_serial_number;
 	long serial_number;
+	FLAC__bool keep_index;
 
 	/* these are for internal state related to Ogg decoding */
-	ogg_stream_state stream_state;
+	const FLAC__MemoryCallbacks *mem;
 	ogg_sync_state sync_state;
+	FLAC__uint64 sync_offset; /* the stream offset of the first byte in sync_state not yet made into a page */
+	FLAC__bool sync_offset_known; /* false until the decoder tells us, and again after a flush */
+	FLAC__bool sync_offset_pending; /* true from init or a flush until the first read; only then can the decoder tell us */
+	FLAC__bool lost_sync; /* true while skipping bytes that are not a page, so we report it once per run like ogg_sync_pageout() */
+	FLAC__OggPageIndexEntry *index; /* sorted by stream_offset */
+	unsigned index_count, index_capacity;
 	unsigned version_major, version_minor;
 	FLAC__bool need_serial_number;
 	FLAC__bool end_of_stream;
+	long next_page_number; /* -1 if unknown, i.e. after a flush */
+	FLAC__bool packet_open; /* true if the last page ended in the middle of a packet */
+	size_t bytes_chunk; /* how much to ask of the client at a time; follows the page size */
 	FLAC__bool have_working_page; /* only if true will the following vars be valid */
-	ogg_page working_page;
-	FLAC__bool have_working_packet; /* only if true will the following vars be valid */
-	ogg_packet working_packet; /* as we work through the packet we will move working_packet.packet forward and working_packet.bytes down */
+	ogg_page working_page; /* WATCHOUT: points into sync_state, so only valid until the next ogg_sync_buffer() */
+	int working_segment; /* index into the lacing values of the first segment not yet in working_body */
+	const FLAC__byte *working_body; /* as we work through the page we will move working_body forward and working_bytes down */
+	size_t working_bytes; /* bytes of the current run of segments, i.e. of one packet or the part of it on this page */
 } FLAC__OggDecoderAspect;
 
 void FLAC__ogg_decoder_aspect_set_serial_number(FLAC__OggDecoderAspect *aspect, long value);
+void FLAC__ogg_decoder_aspect_set_page_indexing(FLAC__OggDecoderAspect *aspect, FLAC__bool value);
 void FLAC__ogg_decoder_aspect_set_defaults(FLAC__OggDecoderAspect *aspect);
-FLAC__bool FLAC__ogg_decoder_aspect_init(FLAC__OggDecoderAspect *aspect);
+FLAC__bool FLAC__ogg_decoder_aspect_init(FLAC__OggDecoderAspect *aspect, const FLAC__MemoryCallbacks *mem);
+size_t FLAC__ogg_decoder_aspect_get_memory_usage(const FLAC__OggDecoderAspect *aspect);
 void FLAC__ogg_decoder_aspect_finish(FLAC__OggDecoderAspect *aspect);
 void FLAC__ogg_decoder_aspect_flush(FLAC__OggDecoderAspect *aspect);
 void FLAC__ogg_decoder_aspect_reset(FLAC__OggDecoderAspect *aspect);
 
+/* the page index; offsets can only be recorded while the decoder keeps us told where the sync buffer starts */
+FLAC__bool FLAC__ogg_decoder_aspect_need_stream_offset(const FLAC__OggDecoderAspect *aspect);
+void FLAC__ogg_decoder_aspect_set_stream_offset(FLAC__OggDecoderAspect *aspect, FLAC__uint64 offset);
+FLAC__bool FLAC__ogg_decoder_aspect_add_index_entries(FLAC__OggDecoderAspect *aspect, const FLAC__OggPageIndexEntry entries[], unsigned count);
+unsigned FLAC__ogg_decoder_aspect_get_index(const FLAC__OggDecoderAspect *aspect, const FLAC__OggPageIndexEntry **entries);
+FLAC__bool FLAC__ogg_decoder_aspect_find_in_index(const FLAC__OggDecoderAspect *aspect, FLAC__uint64 target_sample, FLAC__uint64 *start_pos, FLAC__uint64 *right_pos, FLAC__uint64 *right_sample);
+
 typedef enum {
 	FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK = 0,
 	FLAC__OGG_DECODER_ASPECT_READ_STATUS_END_OF_STREAM,
@@ -35,6 +35,7 @@
 
 #include <ogg/ogg.h>
 
+#include "FLAC/callback.h" /* for FLAC__MemoryCallbacks */
 #include "FLAC/ordinals.h"
 #include "FLAC/stream_encoder.h" /* for FLAC__StreamEncoderWriteStatus */
 
@@ -42,10 +43,15 @@ typedef struct FLAC__OggEncoderAspect {
 	/* these are storage for values that can be set through the API */
 	long serial_number;
 	unsigned num_metadata;
+	unsigned page_size; /* 0 means ogg_stream_pageout()'s own choice */
+	unsigned write_size; /* 0 means write each page as soon as it is out */
 
 	/* these are for internal state related to Ogg encoding */
+	const FLAC__MemoryCallbacks *mem;
 	ogg_stream_state stream_state;
 	ogg_page page;
+	FLAC__byte *pending; /* whole pages waiting to be written */
+	size_t pending_bytes, pending_capacity;
 	FLAC__bool seen_magic; /* true if we've seen the fLaC magic in the write callback yet */
 	FLAC__bool is_first_packet;
 	FLAC__uint64 samples_written;
@@ -53,9 +59,12 @@ typedef struct FLAC__OggEncoderAspect {
 
 void FLAC__ogg_encoder_aspect_set_serial_number(FLAC__OggEncoderAspect *aspect, long value);
 FLAC__bool FLAC__ogg_encoder_aspect_set_num_metadata(FLAC__OggEncoderAspect *aspect, unsigned value);
+void FLAC__ogg_encoder_aspect_set_page_size(FLAC__OggEncoderAspect *aspect, unsigned value);
+void FLAC__ogg_encoder_aspect_set_write_size(FLAC__OggEncoderAspect *aspect, unsigned value);
 void FLAC__ogg_encoder_aspect_set_defaults(FLAC__OggEncoderAspect *aspect);
-FLAC__bool FLAC__ogg_encoder_aspect_init(FLAC__OggEncoderAspect *aspect);
+FLAC__bool FLAC__ogg_encoder_aspect_init(FLAC__OggEncoderAspect *aspect, const FLAC__MemoryCallbacks *mem);
 void FLAC__ogg_encoder_aspect_finish(FLAC__OggEncoderAspect *aspect);
+size_t FLAC__ogg_encoder_aspect_get_memory_usage(const FLAC__OggEncoderAspect *aspect);
 
 typedef FLAC__StreamEncoderWriteStatus (*FLAC__OggEncoderAspectWriteCallbackProxy)(const void *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
 
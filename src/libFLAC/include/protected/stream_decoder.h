@@ -46,6 +46,10 @@ typedef struct FLAC__StreamDecoderProtected {
 	unsigned sample_rate; /* in Hz */
 	unsigned blocksize; /* in samples (per channel) */
 	FLAC__bool md5_checking; /* if true, generate MD5 signature of decoded data and compare against signature in the STREAMINFO metadata block */
+	FLAC__uint32 channel_mask; /* bit N set means channel N of each frame is restored; the others are only parsed */
+	size_t memory_limit; /* in bytes, 0 for none; checked before buffers are grown */
+	unsigned read_buffer_size; /* in bytes, 0 for none; size of the chunks asked of the read callback */
+	FLAC__bool lazy_pictures; /* if true, PICTURE data is left in the stream and only its offset passed on */
 #if FLAC__HAS_OGG
 	FLAC__OggDecoderAspect ogg_decoder_aspect;
 #endif
@@ -103,6 +103,7 @@ typedef struct FLAC__StreamEncoderProtected {
 	FLAC__StreamMetadata **metadata;
 	unsigned num_metadata_blocks;
 	FLAC__uint64 streaminfo_offset, seektable_offset, audio_offset;
+	size_t memory_limit; /* in bytes, 0 for none; checked when the buffers are sized at init */
 #if FLAC__HAS_OGG
 	FLAC__OggEncoderAspect ogg_encoder_aspect;
 #endif
@@ -6,6 +6,7 @@
 #include <string.h>		/* for memcpy() */
 
 #include "private/md5.h"
+#include "private/memory.h"
 #include "share/alloc.h"
 
 /*
@@ -213,7 +214,7 @@ static void FLAC__MD5Update(FLAC__MD5Context *ctx, FLAC__byte const *buf, unsign
  * Start MD5 accumulation.  Set bit count to 0 and buffer to mysterious
  * initialization constants.
  */
-void FLAC__MD5Init(FLAC__MD5Context *ctx)
+void FLAC__MD5Init(FLAC__MD5Context *ctx, const FLAC__MemoryCallbacks *mem)
 {
 	ctx->buf[0] = 0x67452301;
 	ctx->buf[1] = 0xefcdab89;
@@ -225,6 +226,7 @@ void FLAC__MD5Init(FLAC__MD5Context *ctx)
 
 	ctx->internal_buf = 0;
 	ctx->capacity = 0;
+	ctx->mem = mem;
 }
 
 /*
@@ -260,7 +262,7 @@ void FLAC__MD5Final(FLAC__byte digest[16], FLAC__MD5Context *ctx)
 	byteSwap(ctx->buf, 4);
 	memcpy(digest, ctx->buf, 16);
 	if(0 != ctx->internal_buf) {
-		free(ctx->internal_buf);
+		FLAC__memory_free(ctx->mem, ctx->internal_buf);
 		ctx->internal_buf = 0;
 		ctx->capacity = 0;
 	}
@@ -402,10 +404,10 @@ FLAC__bool FLAC__MD5Accumulate(FLAC__MD5Context *ctx, const FLAC__int32 * const
 		return false;
 
 	if(ctx->capacity < bytes_needed) {
-		FLAC__byte *tmp = realloc(ctx->internal_buf, bytes_needed);
+		FLAC__byte *tmp = FLAC__memory_realloc(ctx->mem, ctx->internal_buf, bytes_needed);
 		if(0 == tmp) {
-			free(ctx->internal_buf);
-			if(0 == (ctx->internal_buf = safe_malloc_(bytes_needed)))
+			FLAC__memory_free(ctx->mem, ctx->internal_buf);
+			if(0 == (ctx->internal_buf = FLAC__memory_malloc(ctx->mem, bytes_needed)))
 				return false;
 		}
 		else
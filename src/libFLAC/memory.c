@@ -34,11 +34,81 @@
 #  include <config.h>
 #endif
 
+#include <string.h> /* for memset() */
 #include "private/memory.h"
 #include "FLAC/assert.h"
 #include "share/alloc.h"
 
-void *FLAC__memory_alloc_aligned(size_t bytes, void **aligned_address)
+static FLAC__bool has_callbacks_(const FLAC__MemoryCallbacks *mem)
+{
+	FLAC__ASSERT(0 == mem || (0 == mem->malloc) == (0 == mem->realloc));
+	FLAC__ASSERT(0 == mem || (0 == mem->malloc) == (0 == mem->free));
+	return 0 != mem && 0 != mem->malloc;
+}
+
+void *FLAC__memory_malloc(const FLAC__MemoryCallbacks *mem, size_t size)
+{
+	/* malloc(0) is undefined; FLAC src convention is to always allocate */
+	if(!size)
+		size++;
+	if(has_callbacks_(mem))
+		return mem->malloc(size, mem->client_data);
+	return malloc(size);
+}
+
+void *FLAC__memory_calloc(const FLAC__MemoryCallbacks *mem, size_t nmemb, size_t size)
+{
+	void *x;
+
+	if(!has_callbacks_(mem))
+		return safe_calloc_(nmemb, size);
+	if(nmemb && size > SIZE_MAX / nmemb)
+		return 0;
+	if(0 != (x = FLAC__memory_malloc(mem, nmemb * size)))
+		memset(x, 0, nmemb * size);
+	return x;
+}
+
+void *FLAC__memory_malloc_add_2op(const FLAC__MemoryCallbacks *mem, size_t size1, size_t size2)
+{
+	size2 += size1;
+	if(size2 < size1)
+		return 0;
+	return FLAC__memory_malloc(mem, size2);
+}
+
+void *FLAC__memory_malloc_mul_2op(const FLAC__MemoryCallbacks *mem, size_t size1, size_t size2)
+{
+	if(size1 && size2 > SIZE_MAX / size1)
+		return 0;
+	return FLAC__memory_malloc(mem, size1*size2);
+}
+
+void *FLAC__memory_realloc(const FLAC__MemoryCallbacks *mem, void *ptr, size_t size)
+{
+	if(has_callbacks_(mem))
+		return mem->realloc(ptr, size, mem->client_data);
+	return realloc(ptr, size);
+}
+
+void *FLAC__memory_realloc_mul_2op(const FLAC__MemoryCallbacks *mem, void *ptr, size_t size1, size_t size2)
+{
+	if(size1 && size2 > SIZE_MAX / size1)
+		return 0;
+	return FLAC__memory_realloc(mem, ptr, size1*size2);
+}
+
+void FLAC__memory_free(const FLAC__MemoryCallbacks *mem, void *ptr)
+{
+	if(0 == ptr)
+		return;
+	if(has_callbacks_(mem))
+		mem->free(ptr, mem->client_data);
+	else
+		free(ptr);
+}
+
+void *FLAC__memory_alloc_aligned(const FLAC__MemoryCallbacks *mem, size_t bytes, void **aligned_address)
 {
 	void *x;
 
@@ -46,7 +116,7 @@ void *FLAC__memory_alloc_aligned(size_t bytes, void **aligned_address)
 
 #ifdef FLAC__ALIGN_MALLOC_DATA
 	/* align on 32-byte (256-bit) boundary */
-	x = safe_malloc_add_2op_(bytes, /*+*/31);
+	x = FLAC__memory_malloc_add_2op(mem, bytes, /*+*/31);
 #ifdef SIZEOF_VOIDP
 #if SIZEOF_VOIDP == 4
 		/* could do  *aligned_address = x + ((unsigned) (32 - (((unsigned)x) & 31))) & 31; */
@@ -66,13 +136,13 @@ void *FLAC__memory_alloc_aligned(size_t bytes, void **aligned_address)
 		return 0;
 #endif
 #else
-	x = safe_malloc_(bytes);
+	x = FLAC__memory_malloc(mem, bytes);
 	*aligned_address = x;
 #endif
 	return x;
 }
 
-FLAC__bool FLAC__memory_alloc_aligned_int32_array(size_t elements, FLAC__int32 **unaligned_pointer, FLAC__int32 **aligned_pointer)
+FLAC__bool FLAC__memory_alloc_aligned_int32_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__int32 **unaligned_pointer, FLAC__int32 **aligned_pointer)
 {
 	FLAC__int32 *pu; /* unaligned pointer */
 	union { /* union needed to comply with C99 pointer aliasing rules */
@@ -88,20 +158,20 @@ FLAC__bool FLAC__memory_alloc_aligned_int32_array(size_t elements, FLAC__int32 *
 	if(elements > SIZE_MAX / sizeof(*pu)) /* overflow check */
 		return false;
 
-	pu = FLAC__memory_alloc_aligned(sizeof(*pu) * elements, &u.pv);
+	pu = FLAC__memory_alloc_aligned(mem, sizeof(*pu) * elements, &u.pv);
 	if(0 == pu) {
 		return false;
 	}
 	else {
 		if(*unaligned_pointer != 0)
-			free(*unaligned_pointer);
+			FLAC__memory_free(mem, *unaligned_pointer);
 		*unaligned_pointer = pu;
 		*aligned_pointer = u.pa;
 		return true;
 	}
 }
 
-FLAC__bool FLAC__memory_alloc_aligned_uint32_array(size_t elements, FLAC__uint32 **unaligned_pointer, FLAC__uint32 **aligned_pointer)
+FLAC__bool FLAC__memory_alloc_aligned_uint32_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__uint32 **unaligned_pointer, FLAC__uint32 **aligned_pointer)
 {
 	FLAC__uint32 *pu; /* unaligned pointer */
 	union { /* union needed to comply with C99 pointer aliasing rules */
@@ -117,20 +187,20 @@ FLAC__bool FLAC__memory_alloc_aligned_uint32_array(size_t elements, FLAC__uint32
 	if(elements > SIZE_MAX / sizeof(*pu)) /* overflow check */
 		return false;
 
-	pu = FLAC__memory_alloc_aligned(sizeof(*pu) * elements, &u.pv);
+	pu = FLAC__memory_alloc_aligned(mem, sizeof(*pu) * elements, &u.pv);
 	if(0 == pu) {
 		return false;
 	}
 	else {
 		if(*unaligned_pointer != 0)
-			free(*unaligned_pointer);
+			FLAC__memory_free(mem, *unaligned_pointer);
 		*unaligned_pointer = pu;
 		*aligned_pointer = u.pa;
 		return true;
 	}
 }
 
-FLAC__bool FLAC__memory_alloc_aligned_uint64_array(size_t elements, FLAC__uint64 **unaligned_pointer, FLAC__uint64 **aligned_pointer)
+FLAC__bool FLAC__memory_alloc_aligned_uint64_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__uint64 **unaligned_pointer, FLAC__uint64 **aligned_pointer)
 {
 	FLAC__uint64 *pu; /* unaligned pointer */
 	union { /* union needed to comply with C99 pointer aliasing rules */
@@ -146,20 +216,20 @@ FLAC__bool FLAC__memory_alloc_aligned_uint64_array(size_t elements, FLAC__uint64
 	if(elements > SIZE_MAX / sizeof(*pu)) /* overflow check */
 		return false;
 
-	pu = FLAC__memory_alloc_aligned(sizeof(*pu) * elements, &u.pv);
+	pu = FLAC__memory_alloc_aligned(mem, sizeof(*pu) * elements, &u.pv);
 	if(0 == pu) {
 		return false;
 	}
 	else {
 		if(*unaligned_pointer != 0)
-			free(*unaligned_pointer);
+			FLAC__memory_free(mem, *unaligned_pointer);
 		*unaligned_pointer = pu;
 		*aligned_pointer = u.pa;
 		return true;
 	}
 }
 
-FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(size_t elements, unsigned **unaligned_pointer, unsigned **aligned_pointer)
+FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(const FLAC__MemoryCallbacks *mem, size_t elements, unsigned **unaligned_pointer, unsigned **aligned_pointer)
 {
 	unsigned *pu; /* unaligned pointer */
 	union { /* union needed to comply with C99 pointer aliasing rules */
@@ -175,13 +245,13 @@ FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(size_t elements, unsigned *
 	if(elements > SIZE_MAX / sizeof(*pu)) /* overflow check */
 		return false;
 
-	pu = FLAC__memory_alloc_aligned(sizeof(*pu) * elements, &u.pv);
+	pu = FLAC__memory_alloc_aligned(mem, sizeof(*pu) * elements, &u.pv);
 	if(0 == pu) {
 		return false;
 	}
 	else {
 		if(*unaligned_pointer != 0)
-			free(*unaligned_pointer);
+			FLAC__memory_free(mem, *unaligned_pointer);
 		*unaligned_pointer = pu;
 		*aligned_pointer = u.pa;
 		return true;
@@ -190,7 +260,7 @@ FLAC__bool FLAC__memory_alloc_aligned_unsigned_array(size_t elements, unsigned *
 
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 
-FLAC__bool FLAC__memory_alloc_aligned_real_array(size_t elements, FLAC__real **unaligned_pointer, FLAC__real **aligned_pointer)
+FLAC__bool FLAC__memory_alloc_aligned_real_array(const FLAC__MemoryCallbacks *mem, size_t elements, FLAC__real **unaligned_pointer, FLAC__real **aligned_pointer)
 {
 	FLAC__real *pu; /* unaligned pointer */
 	union { /* union needed to comply with C99 pointer aliasing rules */
@@ -206,13 +276,13 @@ FLAC__bool FLAC__memory_alloc_aligned_real_array(size_t elements, FLAC__real **u
 	if(elements > SIZE_MAX / sizeof(*pu)) /* overflow check */
 		return false;
 
-	pu = FLAC__memory_alloc_aligned(sizeof(*pu) * elements, &u.pv);
+	pu = FLAC__memory_alloc_aligned(mem, sizeof(*pu) * elements, &u.pv);
 	if(0 == pu) {
 		return false;
 	}
 	else {
 		if(*unaligned_pointer != 0)
-			free(*unaligned_pointer);
+			FLAC__memory_free(mem, *unaligned_pointer);
 		*unaligned_pointer = pu;
 		*aligned_pointer = u.pa;
 		return true;
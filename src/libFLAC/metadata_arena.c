@@ -0,0 +1,603 @@
+/* libFLAC - Free Lossless Audio Codec
+ * Copyright (C) 2002-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h> /* for malloc() */
+#include <string.h> /* for memcpy() */
+#include "FLAC/assert.h"
+#include "FLAC/metadata.h"
+#include "share/alloc.h"
+#include "share/compat.h"
+#include "private/metadata.h"
+
+/* The arena is laid out as the FLAC__MetadataArena header, the array of
+ * blocks, and then everything the blocks point to, each piece aligned
+ * for the 64-bit fields of seek points and cue sheets.  The raw blocks
+ * are first read into one temporary buffer, then laid out in two passes
+ * over it: the first only adds up the size, the second fills in the
+ * allocation.
+ */
+#define FLAC__ARENA_ALIGN 8
+
+
+/***********************************************************************
+ *
+ * Private class data
+ *
+ ***********************************************************************/
+
+struct FLAC__MetadataArena {
+	size_t size; /* of the whole allocation, this header included */
+	unsigned num_blocks;
+	FLAC__StreamMetadata *blocks;
+};
+
+typedef struct {
+	FLAC__byte *base; /* NULL while sizing */
+	size_t used;
+} arena_cursor_;
+
+
+/***********************************************************************
+ *
+ * Private class method prototypes
+ *
+ ***********************************************************************/
+
+static FLAC__MetadataArena *arena_read_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, FLAC__Metadata_SimpleIteratorStatus *status);
+static FLAC__Metadata_SimpleIteratorStatus read_raw_blocks_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, FLAC__byte **raw, size_t *raw_length, unsigned *num_blocks);
+static FLAC__bool lay_out_(arena_cursor_ *cursor, const FLAC__byte *raw, unsigned num_blocks);
+static void *arena_alloc_(arena_cursor_ *cursor, size_t bytes);
+static void *arena_copy_(arena_cursor_ *cursor, const FLAC__byte *from, size_t bytes, FLAC__bool terminate);
+static FLAC__bool lay_out_block_(arena_cursor_ *cursor, FLAC__StreamMetadata *block, const FLAC__byte *data);
+static FLAC__bool lay_out_vorbis_comment_(arena_cursor_ *cursor, FLAC__StreamMetadata_VorbisComment *block, const FLAC__byte *data, unsigned length);
+static FLAC__bool lay_out_cuesheet_(arena_cursor_ *cursor, FLAC__StreamMetadata_CueSheet *block, const FLAC__byte *data, unsigned length);
+static FLAC__bool lay_out_picture_(arena_cursor_ *cursor, FLAC__StreamMetadata_Picture *block, const FLAC__byte *data, unsigned length);
+static void *relocate_(const void *pointer, const FLAC__byte *from, FLAC__byte *to);
+static FLAC__uint32 unpack_uint32_(const FLAC__byte *b, unsigned bytes);
+static FLAC__uint64 unpack_uint64_(const FLAC__byte *b, unsigned bytes);
+static FLAC__uint32 unpack_uint32_little_endian_(const FLAC__byte *b);
+static size_t fread_wrapper_(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle);
+static int fseek_wrapper_(FLAC__IOHandle handle, FLAC__int64 offset, int whence);
+
+
+/***********************************************************************
+ *
+ * Public class methods
+ *
+ ***********************************************************************/
+
+FLAC_API FLAC__MetadataArena *FLAC__metadata_arena_read(const char *filename, FLAC__Metadata_SimpleIteratorStatus *status)
+{
+	FLAC__MetadataArena *arena;
+	FILE *file;
+
+	FLAC__ASSERT(0 != filename);
+
+	if(0 == (file = flac_fopen(filename, "rb"))) {
+		if(0 != status)
+			*status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_ERROR_OPENING_FILE;
+		return 0;
+	}
+
+	arena = arena_read_((FLAC__IOHandle)file, fread_wrapper_, fseek_wrapper_, status);
+
+	fclose(file);
+	return arena;
+}
+
+FLAC_API FLAC__MetadataArena *FLAC__metadata_arena_read_with_callbacks(FLAC__IOHandle handle, FLAC__IOCallbacks callbacks, FLAC__Metadata_SimpleIteratorStatus *status)
+{
+	if(0 == callbacks.read || 0 == callbacks.seek) {
+		if(0 != status)
+			*status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_ILLEGAL_INPUT;
+		return 0;
+	}
+
+	return arena_read_(handle, callbacks.read, callbacks.seek, status);
+}
+
+FLAC_API FLAC__MetadataArena *FLAC__metadata_arena_clone(const FLAC__MetadataArena *arena)
+{
+	const FLAC__byte *from = (const FLAC__byte*)arena;
+	FLAC__MetadataArena *copy;
+	FLAC__byte *to;
+	unsigned i, j;
+
+	FLAC__ASSERT(0 != arena);
+
+	if(0 == (copy = malloc(arena->size)))
+		return 0;
+	memcpy(copy, arena, arena->size);
+	to = (FLAC__byte*)copy;
+
+	/* everything is where it was, relative to the start; only the pointers need moving */
+	copy->blocks = relocate_(arena->blocks, from, to);
+	for(i = 0; i < copy->num_blocks; i++) {
+		FLAC__StreamMetadata *block = copy->blocks + i;
+		switch(block->type) {
+			case FLAC__METADATA_TYPE_STREAMINFO:
+			case FLAC__METADATA_TYPE_PADDING:
+				break;
+			case FLAC__METADATA_TYPE_APPLICATION:
+				block->data.application.data = relocate_(block->data.application.data, from, to);
+				break;
+			case FLAC__METADATA_TYPE_SEEKTABLE:
+				block->data.seek_table.points = relocate_(block->data.seek_table.points, from, to);
+				break;
+			case FLAC__METADATA_TYPE_VORBIS_COMMENT:
+				block->data.vorbis_comment.vendor_string.entry = relocate_(block->data.vorbis_comment.vendor_string.entry, from, to);
+				block->data.vorbis_comment.comments = relocate_(block->data.vorbis_comment.comments, from, to);
+				for(j = 0; j < block->data.vorbis_comment.num_comments; j++)
+					block->data.vorbis_comment.comments[j].entry = relocate_(block->data.vorbis_comment.comments[j].entry, from, to);
+				break;
+			case FLAC__METADATA_TYPE_CUESHEET:
+				block->data.cue_sheet.tracks = relocate_(block->data.cue_sheet.tracks, from, to);
+				for(j = 0; j < block->data.cue_sheet.num_tracks; j++)
+					block->data.cue_sheet.tracks[j].indices = relocate_(block->data.cue_sheet.tracks[j].indices, from, to);
+				break;
+			case FLAC__METADATA_TYPE_PICTURE:
+				block->data.picture.mime_type = relocate_(block->data.picture.mime_type, from, to);
+				block->data.picture.description = relocate_(block->data.picture.description, from, to);
+				block->data.picture.data = relocate_(block->data.picture.data, from, to);
+				break;
+			default:
+				block->data.unknown.data = relocate_(block->data.unknown.data, from, to);
+				break;
+		}
+	}
+
+	return copy;
+}
+
+FLAC_API void FLAC__metadata_arena_delete(FLAC__MetadataArena *arena)
+{
+	FLAC__ASSERT(0 != arena);
+
+	free(arena);
+}
+
+FLAC_API unsigned FLAC__metadata_arena_get_count(const FLAC__MetadataArena *arena)
+{
+	FLAC__ASSERT(0 != arena);
+
+	return arena->num_blocks;
+}
+
+FLAC_API const FLAC__StreamMetadata *FLAC__metadata_arena_get_block(const FLAC__MetadataArena *arena, unsigned index)
+{
+	FLAC__ASSERT(0 != arena);
+	FLAC__ASSERT(index < arena->num_blocks);
+
+	return arena->blocks + index;
+}
+
+FLAC_API size_t FLAC__metadata_arena_get_size(const FLAC__MetadataArena *arena)
+{
+	FLAC__ASSERT(0 != arena);
+
+	return arena->size;
+}
+
+
+/***********************************************************************
+ *
+ * Private class methods
+ *
+ ***********************************************************************/
+
+FLAC__MetadataArena *arena_read_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, FLAC__Metadata_SimpleIteratorStatus *status)
+{
+	FLAC__MetadataArena *arena = 0;
+	arena_cursor_ cursor;
+	FLAC__byte *raw = 0;
+	size_t raw_length = 0;
+	unsigned num_blocks = 0;
+	FLAC__Metadata_SimpleIteratorStatus s;
+
+	if(FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK != (s = read_raw_blocks_(handle, read_cb, seek_cb, &raw, &raw_length, &num_blocks)))
+		goto done;
+
+	/* first pass: how big */
+	cursor.base = 0;
+	cursor.used = 0;
+	if(!lay_out_(&cursor, raw, num_blocks)) {
+		s = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_BAD_METADATA;
+		goto done;
+	}
+
+	/* second pass: fill it in */
+	if(0 == (arena = malloc(cursor.used))) {
+		s = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+		goto done;
+	}
+	arena->size = cursor.used;
+	cursor.base = (FLAC__byte*)arena;
+	cursor.used = 0;
+	(void)lay_out_(&cursor, raw, num_blocks);
+	FLAC__ASSERT(cursor.used == arena->size);
+
+done:
+	free(raw);
+	if(0 != status)
+		*status = s;
+	return arena;
+}
+
+/* reads the headers and data of all the metadata blocks, back to back, into one buffer */
+FLAC__Metadata_SimpleIteratorStatus read_raw_blocks_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, FLAC__byte **raw, size_t *raw_length, unsigned *num_blocks)
+{
+	FLAC__Metadata_SimpleIteratorStatus status;
+	size_t capacity = 0;
+	FLAC__bool is_last;
+
+	if(FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK != (status = FLAC__metadata_seek_to_first_block(handle, read_cb, seek_cb)))
+		return status;
+
+	do {
+		unsigned length;
+
+		if(*raw_length + FLAC__STREAM_METADATA_HEADER_LENGTH > capacity) {
+			FLAC__byte *p;
+			capacity = capacity? capacity * 2 : 4096;
+			if(0 == (p = realloc(*raw, capacity)))
+				return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+			*raw = p;
+		}
+		if(read_cb(*raw + *raw_length, 1, FLAC__STREAM_METADATA_HEADER_LENGTH, handle) != FLAC__STREAM_METADATA_HEADER_LENGTH)
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
+		is_last = (*raw)[*raw_length] & 0x80? true : false;
+		length = unpack_uint32_(*raw + *raw_length + 1, 3);
+		*raw_length += FLAC__STREAM_METADATA_HEADER_LENGTH;
+
+		if(*raw_length + length > capacity) {
+			FLAC__byte *p;
+			while(*raw_length + length > capacity)
+				capacity *= 2;
+			if(0 == (p = realloc(*raw, capacity)))
+				return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+			*raw = p;
+		}
+		if(read_cb(*raw + *raw_length, 1, length, handle) != length)
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
+		*raw_length += length;
+		(*num_blocks)++;
+	} while(!is_last);
+
+	return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
+}
+
+/* lays out the arena header, the block array and the blocks; returns false if a block is malformed */
+FLAC__bool lay_out_(arena_cursor_ *cursor, const FLAC__byte *raw, unsigned num_blocks)
+{
+	FLAC__MetadataArena *arena;
+	FLAC__StreamMetadata *blocks, scratch;
+	unsigned i;
+
+	arena = arena_alloc_(cursor, sizeof(FLAC__MetadataArena));
+	blocks = arena_alloc_(cursor, sizeof(FLAC__StreamMetadata) * num_blocks);
+	if(0 != arena) {
+		arena->num_blocks = num_blocks;
+		arena->blocks = blocks;
+	}
+
+	for(i = 0; i < num_blocks; i++) {
+		/* while sizing, the fields are parsed into a scratch block that is thrown away */
+		FLAC__StreamMetadata *block = blocks? blocks + i : &scratch;
+		memset(block, 0, sizeof(FLAC__StreamMetadata));
+		block->type = (FLAC__MetadataType)(raw[0] & 0x7f);
+		block->is_last = raw[0] & 0x80? true : false;
+		block->length = unpack_uint32_(raw + 1, 3);
+		raw += FLAC__STREAM_METADATA_HEADER_LENGTH;
+		if(!lay_out_block_(cursor, block, raw))
+			return false;
+		raw += block->length;
+	}
+
+	return true;
+}
+
+void *arena_alloc_(arena_cursor_ *cursor, size_t bytes)
+{
+	void *p;
+	cursor->used = (cursor->used + FLAC__ARENA_ALIGN - 1) & ~(size_t)(FLAC__ARENA_ALIGN - 1);
+	p = cursor->base? cursor->base + cursor->used : 0;
+	cursor->used += bytes;
+	return p;
+}
+
+/* copies 'bytes' bytes into the arena, adding a NUL if 'terminate'; NULL for no bytes and no NUL */
+void *arena_copy_(arena_cursor_ *cursor, const FLAC__byte *from, size_t bytes, FLAC__bool terminate)
+{
+	FLAC__byte *p;
+	if(0 == bytes && !terminate)
+		return 0;
+	if(0 != (p = arena_alloc_(cursor, bytes + (terminate? 1 : 0)))) {
+		if(bytes > 0)
+			memcpy(p, from, bytes);
+		if(terminate)
+			p[bytes] = '\0';
+	}
+	return p;
+}
+
+FLAC__bool lay_out_block_(arena_cursor_ *cursor, FLAC__StreamMetadata *block, const FLAC__byte *data)
+{
+	const unsigned length = block->length;
+	unsigned i;
+
+	switch(block->type) {
+		case FLAC__METADATA_TYPE_STREAMINFO:
+			if(length < FLAC__STREAM_METADATA_STREAMINFO_LENGTH)
+				return false;
+			{
+				FLAC__StreamMetadata_StreamInfo *info = &block->data.stream_info;
+				info->min_blocksize = unpack_uint32_(data, 2);
+				info->max_blocksize = unpack_uint32_(data + 2, 2);
+				info->min_framesize = unpack_uint32_(data + 4, 3);
+				info->max_framesize = unpack_uint32_(data + 7, 3);
+				info->sample_rate = (unpack_uint32_(data + 10, 3) >> 4);
+				info->channels = ((data[12] >> 1) & 7) + 1;
+				info->bits_per_sample = (((data[12] & 1) << 4) | (data[13] >> 4)) + 1;
+				info->total_samples = (((FLAC__uint64)(data[13] & 0x0f)) << 32) | unpack_uint64_(data + 14, 4);
+				memcpy(info->md5sum, data + 18, 16);
+			}
+			return true;
+		case FLAC__METADATA_TYPE_PADDING:
+			return true;
+		case FLAC__METADATA_TYPE_APPLICATION:
+			if(length < FLAC__STREAM_METADATA_APPLICATION_ID_LEN / 8)
+				return false;
+			memcpy(block->data.application.id, data, FLAC__STREAM_METADATA_APPLICATION_ID_LEN / 8);
+			block->data.application.data = arena_copy_(cursor, data + FLAC__STREAM_METADATA_APPLICATION_ID_LEN / 8, length - FLAC__STREAM_METADATA_APPLICATION_ID_LEN / 8, false);
+			return true;
+		case FLAC__METADATA_TYPE_SEEKTABLE:
+			{
+				FLAC__StreamMetadata_SeekTable *table = &block->data.seek_table;
+				table->num_points = length / FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
+				table->points = table->num_points? arena_alloc_(cursor, table->num_points * sizeof(FLAC__StreamMetadata_SeekPoint)) : 0;
+				if(0 != table->points) {
+					for(i = 0; i < table->num_points; i++, data += FLAC__STREAM_METADATA_SEEKPOINT_LENGTH) {
+						table->points[i].sample_number = unpack_uint64_(data, 8);
+						table->points[i].stream_offset = unpack_uint64_(data + 8, 8);
+						table->points[i].frame_samples = unpack_uint32_(data + 16, 2);
+					}
+				}
+			}
+			return true;
+		case FLAC__METADATA_TYPE_VORBIS_COMMENT:
+			return lay_out_vorbis_comment_(cursor, &block->data.vorbis_comment, data, length);
+		case FLAC__METADATA_TYPE_CUESHEET:
+			return lay_out_cuesheet_(cursor, &block->data.cue_sheet, data, length);
+		case FLAC__METADATA_TYPE_PICTURE:
+			return lay_out_picture_(cursor, &block->data.picture, data, length);
+		default:
+			block->data.unknown.data = arena_copy_(cursor, data, length, false);
+			return true;
+	}
+}
+
+FLAC__bool lay_out_vorbis_comment_(arena_cursor_ *cursor, FLAC__StreamMetadata_VorbisComment *block, const FLAC__byte *data, unsigned length)
+{
+	const FLAC__byte *end = data + length;
+	FLAC__uint32 entry_length;
+	unsigned i;
+
+	/* like the other readers, every entry gets a NUL after it for convenience */
+	if(end - data < 4 || (FLAC__uint32)(end - data - 4) < (entry_length = unpack_uint32_little_endian_(data)))
+		return false;
+	block->vendor_string.length = entry_length;
+	block->vendor_string.entry = arena_copy_(cursor, data + 4, entry_length, true);
+	data += 4 + entry_length;
+
+	if(end - data < 4)
+		return false;
+	block->num_comments = unpack_uint32_little_endian_(data);
+	data += 4;
+	/* each comment takes at least its 4-byte length */
+	if(block->num_comments > (FLAC__uint32)(end - data) / 4)
+		return false;
+
+	block->comments = block->num_comments? arena_alloc_(cursor, block->num_comments * sizeof(FLAC__StreamMetadata_VorbisComment_Entry)) : 0;
+	for(i = 0; i < block->num_comments; i++) {
+		FLAC__byte *entry;
+		if(end - data < 4 || (FLAC__uint32)(end - data - 4) < (entry_length = unpack_uint32_little_endian_(data)))
+			return false;
+		entry = arena_copy_(cursor, data + 4, entry_length, true);
+		if(0 != block->comments) {
+			block->comments[i].length = entry_length;
+			block->comments[i].entry = entry;
+		}
+		data += 4 + entry_length;
+	}
+
+	return true;
+}
+
+FLAC__bool lay_out_cuesheet_(arena_cursor_ *cursor, FLAC__StreamMetadata_CueSheet *block, const FLAC__byte *data, unsigned length)
+{
+	const unsigned header_length = (
+		FLAC__STREAM_METADATA_CUESHEET_MEDIA_CATALOG_NUMBER_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_LEAD_IN_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_IS_CD_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_RESERVED_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_NUM_TRACKS_LEN
+	) / 8;
+	const unsigned track_length = (
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_OFFSET_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_NUMBER_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_ISRC_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_TYPE_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_PRE_EMPHASIS_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_RESERVED_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_TRACK_NUM_INDICES_LEN
+	) / 8;
+	const unsigned index_length = (
+		FLAC__STREAM_METADATA_CUESHEET_INDEX_OFFSET_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_INDEX_NUMBER_LEN +
+		FLAC__STREAM_METADATA_CUESHEET_INDEX_RESERVED_LEN
+	) / 8;
+	const FLAC__byte *end = data + length;
+	unsigned i, j;
+
+	if(length < header_length)
+		return false;
+	memcpy(block->media_catalog_number, data, FLAC__STREAM_METADATA_CUESHEET_MEDIA_CATALOG_NUMBER_LEN / 8);
+	data += FLAC__STREAM_METADATA_CUESHEET_MEDIA_CATALOG_NUMBER_LEN / 8;
+	block->lead_in = unpack_uint64_(data, FLAC__STREAM_METADATA_CUESHEET_LEAD_IN_LEN / 8);
+	data += FLAC__STREAM_METADATA_CUESHEET_LEAD_IN_LEN / 8;
+	block->is_cd = data[0] & 0x80? true : false;
+	data += (FLAC__STREAM_METADATA_CUESHEET_IS_CD_LEN + FLAC__STREAM_METADATA_CUESHEET_RESERVED_LEN) / 8;
+	block->num_tracks = data[0];
+	data++;
+
+	block->tracks = block->num_tracks? arena_alloc_(cursor, block->num_tracks * sizeof(FLAC__StreamMetadata_CueSheet_Track)) : 0;
+	for(i = 0; i < block->num_tracks; i++) {
+		FLAC__StreamMetadata_CueSheet_Track track;
+		memset(&track, 0, sizeof(track));
+
+		if((unsigned)(end - data) < track_length)
+			return false;
+		track.offset = unpack_uint64_(data, FLAC__STREAM_METADATA_CUESHEET_TRACK_OFFSET_LEN / 8);
+		data += FLAC__STREAM_METADATA_CUESHEET_TRACK_OFFSET_LEN / 8;
+		track.number = data[0];
+		data += FLAC__STREAM_METADATA_CUESHEET_TRACK_NUMBER_LEN / 8;
+		memcpy(track.isrc, data, FLAC__STREAM_METADATA_CUESHEET_TRACK_ISRC_LEN / 8);
+		data += FLAC__STREAM_METADATA_CUESHEET_TRACK_ISRC_LEN / 8;
+		track.type = data[0] >> 7;
+		track.pre_emphasis = (data[0] >> 6) & 1;
+		data += (FLAC__STREAM_METADATA_CUESHEET_TRACK_TYPE_LEN + FLAC__STREAM_METADATA_CUESHEET_TRACK_PRE_EMPHASIS_LEN + FLAC__STREAM_METADATA_CUESHEET_TRACK_RESERVED_LEN) / 8;
+		track.num_indices = data[0];
+		data += FLAC__STREAM_METADATA_CUESHEET_TRACK_NUM_INDICES_LEN / 8;
+
+		if((unsigned)(end - data) < track.num_indices * index_length)
+			return false;
+		track.indices = track.num_indices? arena_alloc_(cursor, track.num_indices * sizeof(FLAC__StreamMetadata_CueSheet_Index)) : 0;
+		for(j = 0; j < track.num_indices; j++, data += index_length) {
+			if(0 != track.indices) {
+				track.indices[j].offset = unpack_uint64_(data, FLAC__STREAM_METADATA_CUESHEET_INDEX_OFFSET_LEN / 8);
+				track.indices[j].number = data[FLAC__STREAM_METADATA_CUESHEET_INDEX_OFFSET_LEN / 8];
+			}
+		}
+
+		if(0 != block->tracks)
+			block->tracks[i] = track;
+	}
+
+	return true;
+}
+
+FLAC__bool lay_out_picture_(arena_cursor_ *cursor, FLAC__StreamMetadata_Picture *block, const FLAC__byte *data, unsigned length)
+{
+	const FLAC__byte *end = data + length;
+	FLAC__uint32 n;
+
+	if(end - data < 8)
+		return false;
+	block->type = (FLAC__StreamMetadata_Picture_Type)unpack_uint32_(data, 4);
+	n = unpack_uint32_(data + 4, 4);
+	data += 8;
+	if((FLAC__uint32)(end - data) < n)
+		return false;
+	block->mime_type = arena_copy_(cursor, data, n, true);
+	data += n;
+
+	if(end - data < 4)
+		return false;
+	n = unpack_uint32_(data, 4);
+	data += 4;
+	if((FLAC__uint32)(end - data) < n)
+		return false;
+	block->description = arena_copy_(cursor, data, n, true);
+	data += n;
+
+	if(end - data < 20)
+		return false;
+	block->width = unpack_uint32_(data, 4);
+	block->height = unpack_uint32_(data + 4, 4);
+	block->depth = unpack_uint32_(data + 8, 4);
+	block->colors = unpack_uint32_(data + 12, 4);
+	block->data_length = unpack_uint32_(data + 16, 4);
+	data += 20;
+	if((FLAC__uint32)(end - data) < block->data_length)
+		return false;
+	block->data = arena_copy_(cursor, data, block->data_length, false);
+	block->data_offset = 0;
+
+	return true;
+}
+
+void *relocate_(const void *pointer, const FLAC__byte *from, FLAC__byte *to)
+{
+	return pointer? to + ((const FLAC__byte*)pointer - from) : 0;
+}
+
+FLAC__uint32 unpack_uint32_(const FLAC__byte *b, unsigned bytes)
+{
+	FLAC__uint32 ret = 0;
+	unsigned i;
+
+	for(i = 0; i < bytes; i++)
+		ret = (ret << 8) | (FLAC__uint32)(*b++);
+
+	return ret;
+}
+
+FLAC__uint64 unpack_uint64_(const FLAC__byte *b, unsigned bytes)
+{
+	FLAC__uint64 ret = 0;
+	unsigned i;
+
+	for(i = 0; i < bytes; i++)
+		ret = (ret << 8) | (FLAC__uint64)(*b++);
+
+	return ret;
+}
+
+FLAC__uint32 unpack_uint32_little_endian_(const FLAC__byte *b)
+{
+	return (FLAC__uint32)b[0] | ((FLAC__uint32)b[1] << 8) | ((FLAC__uint32)b[2] << 16) | ((FLAC__uint32)b[3] << 24);
+}
+
+size_t fread_wrapper_(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+{
+	return fread(ptr, size, nmemb, (FILE*)handle);
+}
+
+int fseek_wrapper_(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+{
+	return fseeko((FILE*)handle, (FLAC__off_t)offset, whence);
+}
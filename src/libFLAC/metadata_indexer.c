@@ -0,0 +1,577 @@
+/* libFLAC - Free Lossless Audio Codec
+ * Copyright (C) 2002-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h> /* for calloc() */
+#include <string.h> /* for memcpy(), memset() */
+#include "FLAC/assert.h"
+#include "FLAC/metadata.h"
+#include "share/alloc.h"
+#include "share/compat.h"
+#include "private/metadata.h"
+
+/* The workers only share the index of the next file to read, so a
+ * mutex is all they need.  FLAC__metadata_indexer_run() starts threads
+ * of its own where it can; Windows Store and Phone apps get no
+ * CreateThread(), so there it leaves the threading to the application.
+ */
+#if defined HAVE_PTHREAD
+#  include <pthread.h>
+#  define FLAC__INDEXER_HAS_LOCK 1
+#  define FLAC__INDEXER_HAS_THREADS 1
+#elif defined _WIN32
+#  include <windows.h>
+#  define FLAC__INDEXER_HAS_LOCK 1
+#  if !defined WINAPI_FAMILY_PARTITION
+#    define FLAC__INDEXER_HAS_THREADS 1
+#  elif WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+#    define FLAC__INDEXER_HAS_THREADS 1
+#  endif
+#endif
+
+
+/***********************************************************************
+ *
+ * Private class method prototypes
+ *
+ ***********************************************************************/
+
+static void index_one_(FLAC__MetadataIndexer *indexer, unsigned index);
+static FLAC__bool index_metadata_callback_(const FLAC__StreamMetadata *metadata, void *client_data);
+static FLAC__bool keep_tags_(FLAC__MetadataIndexer *indexer, FLAC__MetadataIndexEntry *entry, const FLAC__StreamMetadata_VorbisComment *vc);
+static FLAC__bool tag_is_wanted_(const FLAC__MetadataIndexer *indexer, const FLAC__StreamMetadata_VorbisComment_Entry *comment);
+static void clear_entry_(FLAC__MetadataIndexEntry *entry);
+static int fseek_wrapper_(FLAC__IOHandle handle, FLAC__int64 offset, int whence);
+#if FLAC__INDEXER_HAS_THREADS
+#  if defined HAVE_PTHREAD
+static void *worker_thread_(void *arg);
+#  else
+static DWORD WINAPI worker_thread_(LPVOID arg);
+#  endif
+#endif
+
+
+/***********************************************************************
+ *
+ * Private class data
+ *
+ ***********************************************************************/
+
+typedef struct {
+	char *filename; /* NULL for a stream added with its callbacks */
+	FLAC__IOHandle handle;
+	FLAC__IOCallbacks callbacks;
+} FLAC__MetadataIndexerItem;
+
+struct FLAC__MetadataIndexer {
+	unsigned types;
+	char **tag_names; /* NULL-terminated; NULL keeps all */
+	FLAC__MetadataIndexerItem *items;
+	FLAC__MetadataIndexEntry *entries;
+	unsigned count, capacity;
+	unsigned next; /* the first file no worker has taken; guarded by the lock */
+#if FLAC__INDEXER_HAS_LOCK
+#  if defined HAVE_PTHREAD
+	pthread_mutex_t lock;
+#  else
+	CRITICAL_SECTION lock;
+#  endif
+#endif
+};
+
+typedef struct {
+	FLAC__MetadataIndexer *indexer;
+	FLAC__MetadataIndexEntry *entry;
+	FLAC__bool got_error;
+} index_client_data;
+
+FLAC_API const char * const FLAC__MetadataIndexStatusString[] = {
+	"FLAC__METADATA_INDEX_STATUS_OK",
+	"FLAC__METADATA_INDEX_STATUS_NOT_READ",
+	"FLAC__METADATA_INDEX_STATUS_ERROR_OPENING_FILE",
+	"FLAC__METADATA_INDEX_STATUS_NOT_A_FLAC_FILE",
+	"FLAC__METADATA_INDEX_STATUS_READ_ERROR",
+	"FLAC__METADATA_INDEX_STATUS_MEMORY_ALLOCATION_ERROR"
+};
+
+
+/***********************************************************************
+ *
+ * Public class methods
+ *
+ ***********************************************************************/
+
+FLAC_API FLAC__MetadataIndexer *FLAC__metadata_indexer_new(void)
+{
+	FLAC__MetadataIndexer *indexer = calloc(1, sizeof(FLAC__MetadataIndexer));
+
+	if(0 == indexer)
+		return 0;
+
+	indexer->types =
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_STREAMINFO) |
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+
+#if FLAC__INDEXER_HAS_LOCK
+#  if defined HAVE_PTHREAD
+	if(0 != pthread_mutex_init(&indexer->lock, 0)) {
+		free(indexer);
+		return 0;
+	}
+#  else
+	if(!InitializeCriticalSectionEx(&indexer->lock, 0, 0)) {
+		free(indexer);
+		return 0;
+	}
+#  endif
+#endif
+
+	return indexer;
+}
+
+FLAC_API void FLAC__metadata_indexer_delete(FLAC__MetadataIndexer *indexer)
+{
+	unsigned i;
+
+	FLAC__ASSERT(0 != indexer);
+
+	for(i = 0; i < indexer->count; i++) {
+		if(0 != indexer->items[i].filename)
+			free(indexer->items[i].filename);
+		clear_entry_(&indexer->entries[i]);
+	}
+	if(0 != indexer->items)
+		free(indexer->items);
+	if(0 != indexer->entries)
+		free(indexer->entries);
+
+	if(0 != indexer->tag_names) {
+		for(i = 0; 0 != indexer->tag_names[i]; i++)
+			free(indexer->tag_names[i]);
+		free(indexer->tag_names);
+	}
+
+#if FLAC__INDEXER_HAS_LOCK
+#  if defined HAVE_PTHREAD
+	(void)pthread_mutex_destroy(&indexer->lock);
+#  else
+	DeleteCriticalSection(&indexer->lock);
+#  endif
+#endif
+
+	free(indexer);
+}
+
+FLAC_API FLAC__bool FLAC__metadata_indexer_set_types(FLAC__MetadataIndexer *indexer, unsigned types)
+{
+	FLAC__ASSERT(0 != indexer);
+
+	if(indexer->count > 0)
+		return false;
+
+	indexer->types = types & (
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_STREAMINFO) |
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_VORBIS_COMMENT) |
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_PICTURE)
+	);
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__metadata_indexer_set_tag_names(FLAC__MetadataIndexer *indexer, const char * const names[])
+{
+	char **copy = 0;
+	unsigned i, n = 0;
+
+	FLAC__ASSERT(0 != indexer);
+
+	if(indexer->count > 0)
+		return false;
+
+	if(0 != names) {
+		while(0 != names[n])
+			n++;
+		if(0 == (copy = safe_calloc_(n + 1, sizeof(char*))))
+			return false;
+		for(i = 0; i < n; i++) {
+			if(0 == (copy[i] = strdup(names[i]))) {
+				while(i > 0)
+					free(copy[--i]);
+				free(copy);
+				return false;
+			}
+		}
+	}
+
+	if(0 != indexer->tag_names) {
+		for(i = 0; 0 != indexer->tag_names[i]; i++)
+			free(indexer->tag_names[i]);
+		free(indexer->tag_names);
+	}
+	indexer->tag_names = copy;
+	return true;
+}
+
+static FLAC__bool add_item_(FLAC__MetadataIndexer *indexer, const FLAC__MetadataIndexerItem *item)
+{
+	if(indexer->count == indexer->capacity) {
+		const unsigned new_capacity = indexer->capacity == 0? 64 : indexer->capacity * 2;
+		FLAC__MetadataIndexerItem *new_items;
+		FLAC__MetadataIndexEntry *new_entries;
+
+		if(new_capacity < indexer->capacity)
+			return false;
+		if(0 == (new_items = safe_realloc_mul_2op_(indexer->items, new_capacity, sizeof(FLAC__MetadataIndexerItem))))
+			return false;
+		indexer->items = new_items;
+		if(0 == (new_entries = safe_realloc_mul_2op_(indexer->entries, new_capacity, sizeof(FLAC__MetadataIndexEntry))))
+			return false;
+		indexer->entries = new_entries;
+		indexer->capacity = new_capacity;
+	}
+
+	indexer->items[indexer->count] = *item;
+	memset(&indexer->entries[indexer->count], 0, sizeof(FLAC__MetadataIndexEntry));
+	indexer->entries[indexer->count].status = FLAC__METADATA_INDEX_STATUS_NOT_READ;
+	indexer->count++;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__metadata_indexer_add_file(FLAC__MetadataIndexer *indexer, const char *filename)
+{
+	FLAC__MetadataIndexerItem item;
+
+	FLAC__ASSERT(0 != indexer);
+	FLAC__ASSERT(0 != filename);
+
+	memset(&item, 0, sizeof(item));
+	if(0 == (item.filename = strdup(filename)))
+		return false;
+	if(!add_item_(indexer, &item)) {
+		free(item.filename);
+		return false;
+	}
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__metadata_indexer_add_stream(FLAC__MetadataIndexer *indexer, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks)
+{
+	FLAC__MetadataIndexerItem item;
+
+	FLAC__ASSERT(0 != indexer);
+
+	if(0 == callbacks.read || 0 == callbacks.seek)
+		return false;
+
+	item.filename = 0;
+	item.handle = handle;
+	item.callbacks = callbacks;
+	return add_item_(indexer, &item);
+}
+
+FLAC_API unsigned FLAC__metadata_indexer_get_count(const FLAC__MetadataIndexer *indexer)
+{
+	FLAC__ASSERT(0 != indexer);
+	return indexer->count;
+}
+
+FLAC_API void FLAC__metadata_indexer_work(FLAC__MetadataIndexer *indexer)
+{
+	FLAC__ASSERT(0 != indexer);
+
+	for(;;) {
+		unsigned index;
+
+#if FLAC__INDEXER_HAS_LOCK
+#  if defined HAVE_PTHREAD
+		pthread_mutex_lock(&indexer->lock);
+#  else
+		EnterCriticalSection(&indexer->lock);
+#  endif
+#endif
+		index = indexer->next;
+		if(index < indexer->count)
+			indexer->next++;
+#if FLAC__INDEXER_HAS_LOCK
+#  if defined HAVE_PTHREAD
+		pthread_mutex_unlock(&indexer->lock);
+#  else
+		LeaveCriticalSection(&indexer->lock);
+#  endif
+#endif
+
+		if(index >= indexer->count)
+			break;
+		index_one_(indexer, index);
+	}
+}
+
+FLAC_API FLAC__bool FLAC__metadata_indexer_run(FLAC__MetadataIndexer *indexer, unsigned max_in_flight)
+{
+	unsigned i;
+
+	FLAC__ASSERT(0 != indexer);
+
+#if FLAC__INDEXER_HAS_THREADS
+	{
+		/* the calling thread is a worker too, so start one less */
+		unsigned started = 0, extra = max_in_flight > 1? max_in_flight - 1 : 0;
+#  if defined HAVE_PTHREAD
+		pthread_t *threads;
+#  else
+		HANDLE *threads;
+#  endif
+
+		if(extra > indexer->count - indexer->next)
+			extra = indexer->count - indexer->next;
+		/* if the threads cannot be had the files are read all the same, just one by one */
+		if(extra > 0 && 0 != (threads = safe_calloc_(extra, sizeof(*threads)))) {
+			for(started = 0; started < extra; started++) {
+#  if defined HAVE_PTHREAD
+				if(0 != pthread_create(&threads[started], 0, worker_thread_, indexer))
+					break;
+#  else
+				if(0 == (threads[started] = CreateThread(0, 0, worker_thread_, indexer, 0, 0)))
+					break;
+#  endif
+			}
+			FLAC__metadata_indexer_work(indexer);
+			for(i = 0; i < started; i++) {
+#  if defined HAVE_PTHREAD
+				(void)pthread_join(threads[i], 0);
+#  else
+				(void)WaitForSingleObject(threads[i], INFINITE);
+				(void)CloseHandle(threads[i]);
+#  endif
+			}
+			free(threads);
+		}
+		else
+			FLAC__metadata_indexer_work(indexer);
+	}
+#else
+	(void)max_in_flight;
+	FLAC__metadata_indexer_work(indexer);
+#endif
+
+	for(i = 0; i < indexer->count; i++) {
+		if(indexer->entries[i].status != FLAC__METADATA_INDEX_STATUS_OK)
+			return false;
+	}
+	return true;
+}
+
+FLAC_API const FLAC__MetadataIndexEntry *FLAC__metadata_indexer_get_entry(const FLAC__MetadataIndexer *indexer, unsigned index)
+{
+	FLAC__ASSERT(0 != indexer);
+	FLAC__ASSERT(index < indexer->count);
+
+	return &indexer->entries[index];
+}
+
+
+/***********************************************************************
+ *
+ * Private class methods
+ *
+ ***********************************************************************/
+
+void index_one_(FLAC__MetadataIndexer *indexer, unsigned index)
+{
+	const FLAC__MetadataIndexerItem *item = &indexer->items[index];
+	FLAC__MetadataIndexEntry *entry = &indexer->entries[index];
+	FLAC__Metadata_SimpleIteratorStatus status;
+	index_client_data cd;
+
+	cd.indexer = indexer;
+	cd.entry = entry;
+	cd.got_error = false;
+
+	if(0 != item->filename) {
+		FILE *file = flac_fopen(item->filename, "rb");
+		if(0 == file) {
+			entry->status = FLAC__METADATA_INDEX_STATUS_ERROR_OPENING_FILE;
+			return;
+		}
+		status = FLAC__metadata_probe_stream((FLAC__IOHandle)file, (FLAC__IOCallback_Read)fread, fseek_wrapper_, indexer->types, /*picture_data=*/false, index_metadata_callback_, &cd);
+		fclose(file);
+	}
+	else {
+		if(0 != item->callbacks.seek(item->handle, 0, SEEK_SET)) {
+			entry->status = FLAC__METADATA_INDEX_STATUS_ERROR_OPENING_FILE;
+			return;
+		}
+		status = FLAC__metadata_probe_stream(item->handle, item->callbacks.read, item->callbacks.seek, indexer->types, /*picture_data=*/false, index_metadata_callback_, &cd);
+	}
+
+	if(cd.got_error)
+		status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+
+	switch(status) {
+		case FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK:
+			entry->status = FLAC__METADATA_INDEX_STATUS_OK;
+			return;
+		case FLAC__METADATA_SIMPLE_ITERATOR_STATUS_NOT_A_FLAC_FILE:
+			clear_entry_(entry);
+			entry->status = FLAC__METADATA_INDEX_STATUS_NOT_A_FLAC_FILE;
+			return;
+		case FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR:
+			clear_entry_(entry);
+			entry->status = FLAC__METADATA_INDEX_STATUS_MEMORY_ALLOCATION_ERROR;
+			return;
+		default:
+			clear_entry_(entry);
+			entry->status = FLAC__METADATA_INDEX_STATUS_READ_ERROR;
+			return;
+	}
+}
+
+FLAC__bool index_metadata_callback_(const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	index_client_data *cd = (index_client_data *)client_data;
+	FLAC__MetadataIndexEntry *entry = cd->entry;
+
+	switch(metadata->type) {
+		case FLAC__METADATA_TYPE_STREAMINFO:
+			entry->has_stream_info = true;
+			entry->stream_info = metadata->data.stream_info;
+			break;
+		case FLAC__METADATA_TYPE_VORBIS_COMMENT:
+			if(!keep_tags_(cd->indexer, entry, &metadata->data.vorbis_comment)) {
+				cd->got_error = true;
+				return false;
+			}
+			break;
+		case FLAC__METADATA_TYPE_PICTURE:
+			entry->num_pictures++;
+			if(entry->num_pictures == 1 || (metadata->data.picture.type == FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER && entry->picture_type != FLAC__STREAM_METADATA_PICTURE_TYPE_FRONT_COVER)) {
+				entry->picture_type = metadata->data.picture.type;
+				entry->picture_width = metadata->data.picture.width;
+				entry->picture_height = metadata->data.picture.height;
+				entry->picture_depth = metadata->data.picture.depth;
+				entry->picture_data_length = metadata->data.picture.data_length;
+			}
+			break;
+		default:
+			break;
+	}
+
+	return true;
+}
+
+/*
+ * Copies the wanted comments, pointers and strings alike, into a
+ * single allocation so that an entry costs one free() however many
+ * tags it has
+ */
+FLAC__bool keep_tags_(FLAC__MetadataIndexer *indexer, FLAC__MetadataIndexEntry *entry, const FLAC__StreamMetadata_VorbisComment *vc)
+{
+	unsigned i, n = 0;
+	size_t bytes = 0;
+	char **tags, *p;
+
+	if(0 != entry->tags) /* only the first VORBIS_COMMENT counts */
+		return true;
+
+	for(i = 0; i < vc->num_comments; i++) {
+		if(tag_is_wanted_(indexer, &vc->comments[i])) {
+			n++;
+			bytes += vc->comments[i].length + 1;
+		}
+	}
+	if(n == 0)
+		return true;
+
+	if(0 == (tags = safe_malloc_mul2add_(n, sizeof(char*), /*+*/bytes)))
+		return false;
+
+	p = (char*)(tags + n);
+	n = 0;
+	for(i = 0; i < vc->num_comments; i++) {
+		if(tag_is_wanted_(indexer, &vc->comments[i])) {
+			tags[n++] = p;
+			memcpy(p, vc->comments[i].entry, vc->comments[i].length);
+			p += vc->comments[i].length;
+			*p++ = '\0';
+		}
+	}
+
+	entry->tags = (const char * const *)tags;
+	entry->num_tags = n;
+	return true;
+}
+
+FLAC__bool tag_is_wanted_(const FLAC__MetadataIndexer *indexer, const FLAC__StreamMetadata_VorbisComment_Entry *comment)
+{
+	unsigned i;
+
+	if(0 == comment->entry)
+		return false;
+	if(0 == indexer->tag_names)
+		return true;
+	for(i = 0; 0 != indexer->tag_names[i]; i++) {
+		if(FLAC__metadata_object_vorbiscomment_entry_matches(*comment, indexer->tag_names[i], (unsigned)strlen(indexer->tag_names[i])))
+			return true;
+	}
+	return false;
+}
+
+void clear_entry_(FLAC__MetadataIndexEntry *entry)
+{
+	if(0 != entry->tags)
+		free((void*)entry->tags);
+	memset(entry, 0, sizeof(*entry));
+}
+
+int fseek_wrapper_(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+{
+	return fseeko((FILE*)handle, (FLAC__off_t)offset, whence);
+}
+
+#if FLAC__INDEXER_HAS_THREADS
+#  if defined HAVE_PTHREAD
+void *worker_thread_(void *arg)
+{
+	FLAC__metadata_indexer_work((FLAC__MetadataIndexer *)arg);
+	return 0;
+}
+#  else
+DWORD WINAPI worker_thread_(LPVOID arg)
+{
+	FLAC__metadata_indexer_work((FLAC__MetadataIndexer *)arg);
+	return 0;
+}
+#  endif
+#endif
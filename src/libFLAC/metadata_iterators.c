@@ -34,6 +34,10 @@
 #  include <config.h>
 #endif
 
+#if defined __linux__ && !defined _GNU_SOURCE
+#define _GNU_SOURCE /* for fallocate() */
+#endif
+
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +46,17 @@
 
 #include <sys/stat.h> /* for stat(), maybe chmod() */
 
+#ifdef __linux__
+#include <fcntl.h> /* for fallocate() */
+#ifdef FALLOC_FL_INSERT_RANGE
+#include <sys/ioctl.h> /* for ioctl() */
+#include <sys/vfs.h> /* for statfs() */
+#include <unistd.h> /* for close() */
+#include <linux/fs.h> /* for FS_IOC_GETFLAGS, FS_EXTENT_FL */
+#define FLAC__HAS_INSERT_RANGE 1
+#endif
+#endif
+
 #include "private/metadata.h"
 
 #include "FLAC/assert.h"
@@ -81,7 +96,9 @@ static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_vorbis_comme
 static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_vorbis_comment_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_VorbisComment *block);
 static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_cuesheet_track_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_CueSheet_Track *track);
 static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_cuesheet_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_CueSheet *block);
+static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_header_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Picture *block);
 static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Picture *block);
+static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_info_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, FLAC__StreamMetadata_Picture *block);
 static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_unknown_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Unknown *block, unsigned block_length);
 
 static FLAC__bool write_metadata_block_header_(FILE *file, FLAC__Metadata_SimpleIteratorStatus *status, const FLAC__StreamMetadata *block);
@@ -146,52 +163,42 @@ static size_t local__fwrite(const void *ptr, size_t size, size_t nmemb, FILE *st
  *
  ***************************************************************************/
 
-static FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
-static void metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
-static void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
+/* how much of the file the probe reads at a time; most files have all
+ * their metadata but the PICTURE data in the first read
+ */
+#define FLAC__METADATA_PROBE_BUFFER_SIZE (64u * 1024u)
 
+/* a read-ahead window over the client's handle, so that hopping from
+ * block header to block header usually costs no I/O at all
+ */
 typedef struct {
-	FLAC__bool got_error;
-	FLAC__StreamMetadata *object;
-} level0_client_data;
+	FLAC__IOHandle handle;
+	FLAC__IOCallback_Read read_cb;
+	FLAC__IOCallback_Seek seek_cb;
+	FLAC__byte *buffer;
+	size_t bytes; /* number of valid bytes in buffer */
+	FLAC__int64 buffer_offset; /* stream offset of buffer[0] */
+	FLAC__int64 offset; /* current logical position; may be past the buffer */
+	FLAC__int64 file_offset; /* where the handle is now */
+} probe_reader_;
+
+static size_t probe_read_cb_(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle);
+static int probe_seek_cb_(FLAC__IOHandle handle, FLAC__int64 offset, int whence);
+static FLAC__bool get_one_metadata_block_callback_(const FLAC__StreamMetadata *metadata, void *client_data);
 
 static FLAC__StreamMetadata *get_one_metadata_block_(const char *filename, FLAC__MetadataType type)
 {
-	level0_client_data cd;
-	FLAC__StreamDecoder *decoder;
+	FLAC__StreamMetadata *object = 0;
 
 	FLAC__ASSERT(0 != filename);
 
-	cd.got_error = false;
-	cd.object = 0;
-
-	decoder = FLAC__stream_decoder_new();
-
-	if(0 == decoder)
-		return 0;
-
-	FLAC__stream_decoder_set_md5_checking(decoder, false);
-	FLAC__stream_decoder_set_metadata_ignore_all(decoder);
-	FLAC__stream_decoder_set_metadata_respond(decoder, type);
-
-	if(FLAC__stream_decoder_init_file(decoder, filename, write_callback_, metadata_callback_, error_callback_, &cd) != FLAC__STREAM_DECODER_INIT_STATUS_OK || cd.got_error) {
-		(void)FLAC__stream_decoder_finish(decoder);
-		FLAC__stream_decoder_delete(decoder);
+	if(!FLAC__metadata_probe(filename, FLAC__METADATA_PROBE_TYPE(type), get_one_metadata_block_callback_, &object)) {
+		if(0 != object)
+			FLAC__metadata_object_delete(object);
 		return 0;
 	}
 
-	if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder) || cd.got_error) {
-		(void)FLAC__stream_decoder_finish(decoder);
-		FLAC__stream_decoder_delete(decoder);
-		if(0 != cd.object)
-			FLAC__metadata_object_delete(cd.object);
-		return 0;
-	}
-
-	(void)FLAC__stream_decoder_finish(decoder);
-	FLAC__stream_decoder_delete(decoder);
-
-	return cd.object;
+	return object;
 }
 
 FLAC_API FLAC__bool FLAC__metadata_get_streaminfo(const char *filename, FLAC__StreamMetadata *streaminfo)
@@ -234,37 +241,6 @@ FLAC_API FLAC__bool FLAC__metadata_get_cuesheet(const char *filename, FLAC__Stre
 	return 0 != *cuesheet;
 }
 
-FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
-{
-	(void)decoder, (void)frame, (void)buffer, (void)client_data;
-
-	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
-}
-
-void metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
-{
-	level0_client_data *cd = (level0_client_data *)client_data;
-	(void)decoder;
-
-	/*
-	 * we assume we only get here when the one metadata block we were
-	 * looking for was passed to us
-	 */
-	if(!cd->got_error && 0 == cd->object) {
-		if(0 == (cd->object = FLAC__metadata_object_clone(metadata)))
-			cd->got_error = true;
-	}
-}
-
-void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
-{
-	level0_client_data *cd = (level0_client_data *)client_data;
-	(void)decoder;
-
-	if(status != FLAC__STREAM_DECODER_ERROR_STATUS_LOST_SYNC)
-		cd->got_error = true;
-}
-
 FLAC_API FLAC__bool FLAC__metadata_get_picture(const char *filename, FLAC__StreamMetadata **picture, FLAC__StreamMetadata_Picture_Type type, const char *mime_type, const FLAC__byte *description, unsigned max_width, unsigned max_height, unsigned max_depth, unsigned max_colors)
 {
 	FLAC__Metadata_SimpleIterator *it;
@@ -315,6 +291,227 @@ FLAC_API FLAC__bool FLAC__metadata_get_picture(const char *filename, FLAC__Strea
 	return (0 != *picture);
 }
 
+FLAC_API FLAC__bool FLAC__metadata_probe(const char *filename, unsigned types, FLAC__MetadataProbeCallback callback, void *client_data)
+{
+	FILE *file;
+	FLAC__bool ret;
+
+	FLAC__ASSERT(0 != filename);
+	FLAC__ASSERT(0 != callback);
+
+	if(0 == (file = flac_fopen(filename, "rb")))
+		return false;
+
+	ret = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK == FLAC__metadata_probe_stream((FLAC__IOHandle)file, (FLAC__IOCallback_Read)fread, fseek_wrapper_, types, /*picture_data=*/true, callback, client_data);
+
+	fclose(file);
+
+	return ret;
+}
+
+FLAC_API FLAC__bool FLAC__metadata_probe_with_callbacks(FLAC__IOHandle handle, FLAC__IOCallbacks callbacks, unsigned types, FLAC__MetadataProbeCallback callback, void *client_data)
+{
+	FLAC__ASSERT(0 != callback);
+
+	if(0 == callbacks.read || 0 == callbacks.seek)
+		return false;
+
+	/* rewind */
+	if(0 != callbacks.seek(handle, 0, SEEK_SET))
+		return false;
+
+	return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK == FLAC__metadata_probe_stream(handle, callbacks.read, callbacks.seek, types, /*picture_data=*/true, callback, client_data);
+}
+
+FLAC__Metadata_SimpleIteratorStatus FLAC__metadata_seek_to_first_block(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb)
+{
+	switch(seek_to_first_metadata_block_cb_(handle, read_cb, seek_cb)) {
+		case 0:
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
+		case 1:
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
+		case 2:
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_SEEK_ERROR;
+		case 3:
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_NOT_A_FLAC_FILE;
+		default:
+			FLAC__ASSERT(0);
+			return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_INTERNAL_ERROR;
+	}
+}
+
+FLAC__Metadata_SimpleIteratorStatus FLAC__metadata_probe_stream(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, unsigned types, FLAC__bool picture_data, FLAC__MetadataProbeCallback callback, void *client_data)
+{
+	/* the types there can be at most one of; once these are all seen
+	 * and nothing else was asked for, the rest of the metadata is not
+	 * even looked at
+	 */
+	const unsigned unique_types =
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_STREAMINFO) |
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_SEEKTABLE) |
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_VORBIS_COMMENT) |
+		FLAC__METADATA_PROBE_TYPE(FLAC__METADATA_TYPE_CUESHEET);
+	probe_reader_ reader;
+	FLAC__Metadata_SimpleIteratorStatus status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
+	FLAC__bool is_last;
+	FLAC__MetadataType type;
+	unsigned length;
+
+	reader.handle = handle;
+	reader.read_cb = read_cb;
+	reader.seek_cb = seek_cb;
+	reader.bytes = 0;
+	reader.buffer_offset = reader.offset = reader.file_offset = 0; /* we assume we're at the beginning of the file */
+	if(0 == (reader.buffer = malloc(FLAC__METADATA_PROBE_BUFFER_SIZE)))
+		return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+
+	switch(seek_to_first_metadata_block_cb_((FLAC__IOHandle)&reader, probe_read_cb_, probe_seek_cb_)) {
+		case 0:
+			break;
+		case 1:
+			status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
+			break;
+		case 2:
+			status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_SEEK_ERROR;
+			break;
+		case 3:
+			status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_NOT_A_FLAC_FILE;
+			break;
+		default:
+			FLAC__ASSERT(0);
+			status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_INTERNAL_ERROR;
+	}
+	if(FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK != status) {
+		free(reader.buffer);
+		return status;
+	}
+
+	do {
+		if(0 == types) /* everything asked for has been seen */
+			break;
+
+		if(!read_metadata_block_header_cb_((FLAC__IOHandle)&reader, probe_read_cb_, &is_last, &type, &length)) {
+			status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
+			break;
+		}
+
+		if((unsigned)type < 32 && (types & FLAC__METADATA_PROBE_TYPE(type))) {
+			const FLAC__int64 next = reader.offset + length;
+			FLAC__StreamMetadata *block = FLAC__metadata_object_new(type);
+			if(0 == block) {
+				status = FLAC__METADATA_SIMPLE_ITERATOR_STATUS_MEMORY_ALLOCATION_ERROR;
+				break;
+			}
+			block->is_last = is_last;
+			block->length = length;
+			status = (type == FLAC__METADATA_TYPE_PICTURE && !picture_data)?
+				read_metadata_block_data_picture_info_cb_((FLAC__IOHandle)&reader, probe_read_cb_, probe_seek_cb_, &block->data.picture) :
+				read_metadata_block_data_cb_((FLAC__IOHandle)&reader, probe_read_cb_, probe_seek_cb_, block)
+			;
+			if(FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK != status) {
+				FLAC__metadata_object_delete(block);
+				break;
+			}
+			if(type == FLAC__METADATA_TYPE_PICTURE && 0 == block->data.picture.data && block->data.picture.data_length > 0)
+				block->data.picture.data_offset = (FLAC__uint64)(next - block->data.picture.data_length);
+			/* the next header is where this one says, whatever the parser made of the block */
+			reader.offset = next;
+			if(!callback(block, client_data))
+				types = 0;
+			FLAC__metadata_object_delete(block);
+			types &= ~(unique_types & FLAC__METADATA_PROBE_TYPE(type));
+		}
+		else {
+			/* skip the payload without reading it */
+			reader.offset += length;
+		}
+	} while(!is_last);
+
+	free(reader.buffer);
+
+	return status;
+}
+
+size_t probe_read_cb_(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+{
+	probe_reader_ *reader = (probe_reader_ *)handle;
+	FLAC__byte *dest = (FLAC__byte *)ptr;
+	size_t wanted, got = 0;
+
+	if(0 == size || 0 == nmemb)
+		return 0;
+	if(nmemb > SIZE_MAX / size)
+		return 0;
+	wanted = size * nmemb;
+
+	while(got < wanted) {
+		if(reader->offset >= reader->buffer_offset && reader->offset < reader->buffer_offset + (FLAC__int64)reader->bytes) {
+			const size_t at = (size_t)(reader->offset - reader->buffer_offset);
+			const size_t n = flac_min(reader->bytes - at, wanted - got);
+			memcpy(dest + got, reader->buffer + at, n);
+			got += n;
+			reader->offset += n;
+			continue;
+		}
+
+		if(reader->offset != reader->file_offset) {
+			if(reader->seek_cb(reader->handle, reader->offset, SEEK_SET) < 0)
+				break;
+			reader->file_offset = reader->offset;
+		}
+
+		if(wanted - got >= FLAC__METADATA_PROBE_BUFFER_SIZE) {
+			/* too big to be worth the copy, so read it straight in */
+			const size_t n = reader->read_cb(dest + got, 1, wanted - got, reader->handle);
+			got += n;
+			reader->offset += n;
+			reader->file_offset += n;
+			break;
+		}
+		else {
+			const size_t n = reader->read_cb(reader->buffer, 1, FLAC__METADATA_PROBE_BUFFER_SIZE, reader->handle);
+			reader->buffer_offset = reader->offset;
+			reader->bytes = n;
+			reader->file_offset += n;
+			if(0 == n)
+				break;
+		}
+	}
+
+	return got / size;
+}
+
+int probe_seek_cb_(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+{
+	probe_reader_ *reader = (probe_reader_ *)handle;
+
+	switch(whence) {
+		case SEEK_SET:
+			break;
+		case SEEK_CUR:
+			offset += reader->offset;
+			break;
+		default:
+			return -1;
+	}
+	if(offset < 0)
+		return -1;
+	/* just move the window; the next read does the actual seek */
+	reader->offset = offset;
+	return 0;
+}
+
+FLAC__bool get_one_metadata_block_callback_(const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	FLAC__StreamMetadata **object = (FLAC__StreamMetadata **)client_data;
+
+	/* we only get here with the one metadata block we were looking for */
+	FLAC__ASSERT(0 == *object);
+	*object = FLAC__metadata_object_clone(metadata);
+
+	return false;
+}
+
 
 /****************************************************************************
  *
@@ -897,6 +1094,10 @@ struct FLAC__Metadata_Chain {
 	/* @@@ hacky, these are currently only needed by ogg reader */
 	FLAC__IOHandle handle;
 	FLAC__IOCallback_Read read_cb;
+	/* settings, kept across chain_clear_() */
+	FLAC__bool lazy_pictures;
+	FLAC__bool any_padding;
+	unsigned headroom_minimum, headroom_percent;
 };
 
 struct FLAC__Metadata_Iterator {
@@ -953,6 +1154,8 @@ static void chain_init_(FLAC__Metadata_Chain *chain)
 static void chain_clear_(FLAC__Metadata_Chain *chain)
 {
 	FLAC__Metadata_Node *node, *next;
+	const FLAC__bool lazy_pictures = chain->lazy_pictures, any_padding = chain->any_padding;
+	const unsigned headroom_minimum = chain->headroom_minimum, headroom_percent = chain->headroom_percent;
 
 	FLAC__ASSERT(0 != chain);
 
@@ -966,6 +1169,10 @@ static void chain_clear_(FLAC__Metadata_Chain *chain)
 		free(chain->filename);
 
 	chain_init_(chain);
+	chain->lazy_pictures = lazy_pictures;
+	chain->any_padding = any_padding;
+	chain->headroom_minimum = headroom_minimum;
+	chain->headroom_percent = headroom_percent;
 }
 
 static void chain_append_node_(FLAC__Metadata_Chain *chain, FLAC__Metadata_Node *node)
@@ -1092,6 +1299,70 @@ static FLAC__bool chain_merge_adjacent_padding_(FLAC__Metadata_Chain *chain, FLA
 		return false;
 }
 
+/* Returns the PADDING block that edits are absorbed by, or NULL if there
+ * is none: the last block if it is padding, or with
+ * FLAC__metadata_chain_set_any_padding() the last PADDING block anywhere.
+ */
+static FLAC__Metadata_Node *chain_find_padding_(FLAC__Metadata_Chain *chain)
+{
+	FLAC__Metadata_Node *node;
+	if(!chain->any_padding)
+		return (0 != chain->tail && chain->tail->data->type == FLAC__METADATA_TYPE_PADDING)? chain->tail : 0;
+	for(node = chain->tail; node; node = node->prev)
+		if(node->data->type == FLAC__METADATA_TYPE_PADDING)
+			return node;
+	return 0;
+}
+
+/* When the whole file has to be rewritten anyway, grows the padding to
+ * the headroom set with FLAC__metadata_chain_set_padding_headroom() so
+ * that later edits can be written in place.  Returns false on a memory
+ * allocation error.
+ */
+static FLAC__bool chain_add_headroom_(FLAC__Metadata_Chain *chain, FLAC__off_t *current_length)
+{
+	const FLAC__uint64 max_length = (1u << FLAC__STREAM_METADATA_LENGTH_LEN) - 1;
+	FLAC__Metadata_Node *node, *padding = chain_find_padding_(chain);
+	FLAC__uint64 target = 0;
+
+	if(0 == chain->headroom_minimum && 0 == chain->headroom_percent)
+		return true;
+
+	if(chain->headroom_percent > 0) {
+		for(node = chain->head; node; node = node->next)
+			if(node->data->type != FLAC__METADATA_TYPE_PADDING)
+				target += FLAC__STREAM_METADATA_HEADER_LENGTH + node->data->length;
+		target = target * chain->headroom_percent / 100;
+	}
+	if(target < chain->headroom_minimum)
+		target = chain->headroom_minimum;
+	if(target > max_length)
+		target = max_length;
+
+	if(0 != padding) {
+		if(padding->data->length < target)
+			padding->data->length = (unsigned)target;
+	}
+	else if(target > 0) {
+		FLAC__StreamMetadata *block;
+		if(0 == (block = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING))) {
+			chain->status = FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		block->length = (unsigned)target;
+		if(0 == (node = node_new_())) {
+			FLAC__metadata_object_delete(block);
+			chain->status = FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		node->data = block;
+		chain_append_node_(chain, node);
+	}
+
+	*current_length = chain_calculate_length_(chain);
+	return true;
+}
+
 /* Returns the new length of the chain, or 0 if there was an error. */
 /* WATCHOUT: This can get called multiple times before a write, so
  * it should still work when this happens.
@@ -1104,50 +1375,56 @@ static FLAC__off_t chain_prepare_for_write_(FLAC__Metadata_Chain *chain, FLAC__b
 	FLAC__off_t current_length = chain_calculate_length_(chain);
 
 	if(use_padding) {
-		/* if the metadata shrank and the last block is padding, we just extend the last padding block */
-		if(current_length < chain->initial_length && chain->tail->data->type == FLAC__METADATA_TYPE_PADDING) {
+		/* the padding block that absorbs the edit; see chain_find_padding_() */
+		FLAC__Metadata_Node *padding = chain_find_padding_(chain);
+		/* if the metadata shrank and there is padding, we just extend the padding block */
+		if(current_length < chain->initial_length && 0 != padding) {
 			const FLAC__off_t delta = chain->initial_length - current_length;
-			chain->tail->data->length += delta;
+			padding->data->length += delta;
 			current_length += delta;
 			FLAC__ASSERT(current_length == chain->initial_length);
 		}
 		/* if the metadata shrank more than 4 bytes then there's room to add another padding block */
 		else if(current_length + (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH <= chain->initial_length) {
-			FLAC__StreamMetadata *padding;
+			FLAC__StreamMetadata *block;
 			FLAC__Metadata_Node *node;
-			if(0 == (padding = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING))) {
+			if(0 == (block = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING))) {
 				chain->status = FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR;
 				return 0;
 			}
-			padding->length = chain->initial_length - (FLAC__STREAM_METADATA_HEADER_LENGTH + current_length);
+			block->length = chain->initial_length - (FLAC__STREAM_METADATA_HEADER_LENGTH + current_length);
 			if(0 == (node = node_new_())) {
-				FLAC__metadata_object_delete(padding);
+				FLAC__metadata_object_delete(block);
 				chain->status = FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR;
 				return 0;
 			}
-			node->data = padding;
+			node->data = block;
 			chain_append_node_(chain, node);
 			current_length = chain_calculate_length_(chain);
 			FLAC__ASSERT(current_length == chain->initial_length);
 		}
-		/* if the metadata grew but the last block is padding, try cutting the padding to restore the original length so we don't have to rewrite the whole file */
+		/* if the metadata grew but there is padding, try cutting the padding to restore the original length so we don't have to rewrite the whole file */
 		else if(current_length > chain->initial_length) {
 			const FLAC__off_t delta = current_length - chain->initial_length;
-			if(chain->tail->data->type == FLAC__METADATA_TYPE_PADDING) {
-				/* if the delta is exactly the size of the last padding block, remove the padding block */
-				if((FLAC__off_t)chain->tail->data->length + (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH == delta) {
-					chain_delete_node_(chain, chain->tail);
+			if(0 != padding) {
+				/* if the delta is exactly the size of the padding block, remove the padding block */
+				if((FLAC__off_t)padding->data->length + (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH == delta) {
+					chain_delete_node_(chain, padding);
 					current_length = chain_calculate_length_(chain);
 					FLAC__ASSERT(current_length == chain->initial_length);
 				}
 				/* if there is at least 'delta' bytes of padding, trim the padding down */
-				else if((FLAC__off_t)chain->tail->data->length >= delta) {
-					chain->tail->data->length -= delta;
+				else if((FLAC__off_t)padding->data->length >= delta) {
+					padding->data->length -= delta;
 					current_length -= delta;
 					FLAC__ASSERT(current_length == chain->initial_length);
 				}
 			}
 		}
+
+		/* the whole file has to be rewritten; leave room so that the next edit need not */
+		if(current_length != chain->initial_length && !chain_add_headroom_(chain, &current_length))
+			return 0;
 	}
 
 	return current_length;
@@ -1215,7 +1492,20 @@ static FLAC__bool chain_read_cb_(FLAC__Metadata_Chain *chain, FLAC__IOHandle han
 			node->data->is_last = is_last;
 			node->data->length = length;
 
-			chain->status = get_equivalent_status_(read_metadata_block_data_cb_(handle, read_cb, seek_cb, node->data));
+			if(type == FLAC__METADATA_TYPE_PICTURE && chain->lazy_pictures) {
+				const FLAC__int64 pos = tell_cb(handle);
+				if(pos < 0) {
+					node_delete_(node);
+					chain->status = FLAC__METADATA_CHAIN_STATUS_READ_ERROR;
+					return false;
+				}
+				chain->status = get_equivalent_status_(read_metadata_block_data_picture_info_cb_(handle, read_cb, seek_cb, &node->data->data.picture));
+				/* the picture data is the tail of the block */
+				if(chain->status == FLAC__METADATA_CHAIN_STATUS_OK && node->data->data.picture.data_length > 0)
+					node->data->data.picture.data_offset = (FLAC__uint64)pos + length - node->data->data.picture.data_length;
+			}
+			else
+				chain->status = get_equivalent_status_(read_metadata_block_data_cb_(handle, read_cb, seek_cb, node->data));
 			if(chain->status != FLAC__METADATA_CHAIN_STATUS_OK) {
 				node_delete_(node);
 				return false;
@@ -1377,6 +1667,165 @@ static FLAC__bool chain_rewrite_metadata_in_place_(FLAC__Metadata_Chain *chain)
 	return ret;
 }
 
+#ifdef FLAC__HAS_INSERT_RANGE
+/* Returns true if 'filename' is mapped by extents.  ext2, ext3 and ext4
+ * share a superblock magic, and only ext4 files with extents can have
+ * ranges inserted; ext2/ext3 mounts and files carried over from ext3
+ * have block maps instead.
+ */
+static FLAC__bool file_has_extents_(const char *filename)
+{
+#if defined FS_IOC_GETFLAGS && defined FS_EXTENT_FL
+	int flags = 0;
+	FLAC__bool has_extents;
+	const int fd = open(filename, O_RDONLY);
+
+	if(fd < 0)
+		return false;
+	has_extents = 0 == ioctl(fd, FS_IOC_GETFLAGS, &flags) && 0 != (flags & FS_EXTENT_FL);
+	(void)close(fd);
+	return has_extents;
+#else
+	(void)filename;
+	return false;
+#endif
+}
+
+/* Returns the block size in which the filesystem holding 'filename' can
+ * insert ranges, or 0 if it cannot.  fallocate() offers no way to ask
+ * short of trying, so this goes by the filesystems known to support
+ * FALLOC_FL_INSERT_RANGE, and on the ext family by the file's own flags.
+ */
+static FLAC__off_t insert_range_block_size_(const char *filename)
+{
+	struct statfs stats;
+
+	if(0 != statfs(filename, &stats) || stats.f_bsize <= 0)
+		return 0;
+	switch((unsigned long)stats.f_type) {
+		case 0xEF53: /* EXT2/3/4_SUPER_MAGIC alike */
+			if(!file_has_extents_(filename))
+				return 0;
+			/* fall through */
+		case 0x58465342: /* XFS_SUPER_MAGIC */
+		case 0xF2F52010: /* F2FS_SUPER_MAGIC */
+			return (FLAC__off_t)stats.f_bsize;
+		default:
+			return 0;
+	}
+}
+
+/* Works out how much to insert for metadata that grew by 'delta': whole
+ * blocks, with the padding taking up the rest.  Returns false if the
+ * padding block would get too long.
+ */
+static FLAC__bool insert_range_length_(FLAC__Metadata_Chain *chain, FLAC__off_t delta, FLAC__off_t block_size, FLAC__off_t *insert)
+{
+	const FLAC__off_t max_length = (1u << FLAC__STREAM_METADATA_LENGTH_LEN) - 1;
+	const FLAC__Metadata_Node *padding = chain_find_padding_(chain);
+	FLAC__off_t extra;
+
+	*insert = (delta + block_size - 1) / block_size * block_size;
+	extra = *insert - delta;
+	/* a new PADDING block needs at least its header */
+	if(0 == padding && extra > 0 && extra < (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH) {
+		*insert += block_size;
+		extra += block_size;
+	}
+	return 0 != padding? (FLAC__off_t)padding->data->length + extra <= max_length : extra <= max_length;
+}
+
+/* Makes room for metadata that grew by inserting whole filesystem blocks
+ * into the file in front of it, so that the audio is moved by the
+ * filesystem instead of being copied through a tempfile, and then writes
+ * the metadata in place, with the padding absorbing the rounding.  Sets
+ * '*done' and the new '*current_length' if the chain was written; if the
+ * filesystem cannot insert ranges, returns true without '*done' so the
+ * caller can fall back to chain_rewrite_file_().
+ */
+static FLAC__bool chain_rewrite_metadata_with_insert_range_(FLAC__Metadata_Chain *chain, FLAC__off_t *current_length, FLAC__bool *done)
+{
+	const FLAC__off_t delta = *current_length - chain->initial_length;
+	const FLAC__off_t block_size = insert_range_block_size_(chain->filename);
+	FLAC__off_t insert, offset;
+	FLAC__byte *prefix = 0;
+	size_t prefix_length;
+	FILE *file;
+
+	FLAC__ASSERT(0 != chain->filename);
+	FLAC__ASSERT(delta > 0);
+
+	*done = false;
+
+	/* FLAC__metadata_chain_check_if_tempfile_needed() makes the same two checks */
+	if(0 == block_size || !insert_range_length_(chain, delta, block_size, &insert))
+		return true;
+
+	if(0 == (file = flac_fopen(chain->filename, "r+b"))) {
+		chain->status = FLAC__METADATA_CHAIN_STATUS_ERROR_OPENING_FILE;
+		return false;
+	}
+
+	/* the range starts at a block boundary at or before the metadata; what the file has there before the metadata is put back afterwards */
+	offset = chain->first_offset / block_size * block_size;
+	prefix_length = (size_t)(chain->first_offset - offset);
+	if(prefix_length > 0) {
+		if(0 == (prefix = malloc(prefix_length))) {
+			(void)fclose(file);
+			chain->status = FLAC__METADATA_CHAIN_STATUS_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		if(0 != fseeko(file, offset, SEEK_SET) || fread(prefix, 1, prefix_length, file) != prefix_length) {
+			free(prefix);
+			(void)fclose(file);
+			chain->status = FLAC__METADATA_CHAIN_STATUS_READ_ERROR;
+			return false;
+		}
+	}
+
+	if(0 != fflush(file) || 0 != fallocate(fileno(file), FALLOC_FL_INSERT_RANGE, offset, insert)) {
+		/* most likely EOPNOTSUPP or EINVAL: the filesystem cannot do it */
+		free(prefix);
+		(void)fclose(file);
+		return true;
+	}
+
+	/* from here on the file has changed, so any error is a real one */
+	chain->initial_length += insert;
+	*current_length = chain_prepare_for_write_(chain, /*use_padding=*/true);
+	if(0 == *current_length) {
+		free(prefix);
+		(void)fclose(file);
+		return false;
+	}
+	FLAC__ASSERT(*current_length == chain->initial_length);
+
+	if(prefix_length > 0) {
+		if(0 != fseeko(file, offset, SEEK_SET) || fwrite(prefix, 1, prefix_length, file) != prefix_length) {
+			free(prefix);
+			(void)fclose(file);
+			chain->status = FLAC__METADATA_CHAIN_STATUS_WRITE_ERROR;
+			return false;
+		}
+		free(prefix);
+	}
+
+	/* chain_rewrite_metadata_in_place_cb_() sets chain->status for us */
+	if(!chain_rewrite_metadata_in_place_cb_(chain, (FLAC__IOHandle)file, (FLAC__IOCallback_Write)fwrite, fseek_wrapper_)) {
+		(void)fclose(file);
+		return false;
+	}
+
+	if(0 != fclose(file)) {
+		chain->status = FLAC__METADATA_CHAIN_STATUS_WRITE_ERROR;
+		return false;
+	}
+
+	*done = true;
+	return true;
+}
+#endif
+
 static FLAC__bool chain_rewrite_file_(FLAC__Metadata_Chain *chain, const char *tempfile_path_prefix)
 {
 	FILE *f, *tempfile = NULL;
@@ -1606,29 +2055,85 @@ FLAC_API FLAC__bool FLAC__metadata_chain_check_if_tempfile_needed(FLAC__Metadata
 	FLAC__ASSERT(0 != chain);
 
 	if(use_padding) {
-		/* if the metadata shrank and the last block is padding, we just extend the last padding block */
-		if(current_length < chain->initial_length && chain->tail->data->type == FLAC__METADATA_TYPE_PADDING)
+		const FLAC__Metadata_Node *padding = chain_find_padding_(chain);
+		/* if the metadata shrank and there is padding, we just extend the padding block */
+		if(current_length < chain->initial_length && 0 != padding)
 			return false;
 		/* if the metadata shrank more than 4 bytes then there's room to add another padding block */
 		else if(current_length + (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH <= chain->initial_length)
 			return false;
-		/* if the metadata grew but the last block is padding, try cutting the padding to restore the original length so we don't have to rewrite the whole file */
+		/* if the metadata grew but there is padding, try cutting the padding to restore the original length so we don't have to rewrite the whole file */
 		else if(current_length > chain->initial_length) {
 			const FLAC__off_t delta = current_length - chain->initial_length;
-			if(chain->tail->data->type == FLAC__METADATA_TYPE_PADDING) {
-				/* if the delta is exactly the size of the last padding block, remove the padding block */
-				if((FLAC__off_t)chain->tail->data->length + (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH == delta)
+			if(0 != padding) {
+				/* if the delta is exactly the size of the padding block, remove the padding block */
+				if((FLAC__off_t)padding->data->length + (FLAC__off_t)FLAC__STREAM_METADATA_HEADER_LENGTH == delta)
 					return false;
 				/* if there is at least 'delta' bytes of padding, trim the padding down */
-				else if((FLAC__off_t)chain->tail->data->length >= delta)
+				else if((FLAC__off_t)padding->data->length >= delta)
+					return false;
+			}
+#ifdef FLAC__HAS_INSERT_RANGE
+			/* FLAC__metadata_chain_write() can have the filesystem make room in front of the audio */
+			if(0 != chain->filename) {
+				const FLAC__off_t block_size = insert_range_block_size_(chain->filename);
+				FLAC__off_t insert;
+				if(0 != block_size && insert_range_length_(chain, delta, block_size, &insert))
 					return false;
 			}
+#endif
 		}
 	}
 
 	return (current_length != chain->initial_length);
 }
 
+/* reads in the data of any lazy pictures, which the writes below would otherwise clobber or lose */
+static FLAC__bool chain_load_pictures_(FLAC__Metadata_Chain *chain, const char *filename, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks)
+{
+	FLAC__Metadata_Node *node;
+
+	FLAC__ASSERT(0 != chain);
+
+	for(node = chain->head; node; node = node->next) {
+		FLAC__StreamMetadata *block = node->data;
+		if(block->type != FLAC__METADATA_TYPE_PICTURE || 0 != block->data.picture.data || 0 == block->data.picture.data_length)
+			continue;
+		if(0 == filename && 0 == callbacks.read) {
+			chain->status = FLAC__METADATA_CHAIN_STATUS_INVALID_CALLBACKS;
+			return false;
+		}
+		if(!(filename? FLAC__metadata_object_picture_load_data_from_file(block, filename) : FLAC__metadata_object_picture_load_data(block, handle, callbacks))) {
+			chain->status = FLAC__METADATA_CHAIN_STATUS_READ_ERROR;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FLAC_API void FLAC__metadata_chain_set_lazy_pictures(FLAC__Metadata_Chain *chain, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != chain);
+
+	chain->lazy_pictures = value;
+}
+
+FLAC_API void FLAC__metadata_chain_set_any_padding(FLAC__Metadata_Chain *chain, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != chain);
+
+	chain->any_padding = value;
+}
+
+FLAC_API void FLAC__metadata_chain_set_padding_headroom(FLAC__Metadata_Chain *chain, unsigned minimum, unsigned percent)
+{
+	FLAC__ASSERT(0 != chain);
+
+	chain->headroom_minimum = minimum;
+	chain->headroom_percent = percent;
+}
+
 FLAC_API FLAC__bool FLAC__metadata_chain_write(FLAC__Metadata_Chain *chain, FLAC__bool use_padding, FLAC__bool preserve_file_stats)
 {
 	struct flac_stat_s stats;
@@ -1647,6 +2152,13 @@ FLAC_API FLAC__bool FLAC__metadata_chain_write(FLAC__Metadata_Chain *chain, FLAC
 		return false;
 	}
 
+	{
+		FLAC__IOCallbacks no_callbacks;
+		memset(&no_callbacks, 0, sizeof(no_callbacks));
+		if(!chain_load_pictures_(chain, chain->filename, 0, no_callbacks))
+			return false;
+	}
+
 	current_length = chain_prepare_for_write_(chain, use_padding);
 
 	/* a return value of 0 means there was an error; chain->status is already set */
@@ -1661,7 +2173,13 @@ FLAC_API FLAC__bool FLAC__metadata_chain_write(FLAC__Metadata_Chain *chain, FLAC
 			return false;
 	}
 	else {
-		if(!chain_rewrite_file_(chain, tempfile_path_prefix))
+		FLAC__bool inserted = false;
+#ifdef FLAC__HAS_INSERT_RANGE
+		/* if the metadata grew, try having the filesystem shift the audio instead of copying it */
+		if(use_padding && current_length > chain->initial_length && !chain_rewrite_metadata_with_insert_range_(chain, &current_length, &inserted))
+			return false;
+#endif
+		if(!inserted && !chain_rewrite_file_(chain, tempfile_path_prefix))
 			return false;
 
 		/* recompute lengths and offsets */
@@ -1706,6 +2224,9 @@ FLAC_API FLAC__bool FLAC__metadata_chain_write_with_callbacks(FLAC__Metadata_Cha
 		return false;
 	}
 
+	if(!chain_load_pictures_(chain, 0, handle, callbacks))
+		return false;
+
 	current_length = chain_prepare_for_write_(chain, use_padding);
 
 	/* a return value of 0 means there was an error; chain->status is already set */
@@ -1747,6 +2268,9 @@ FLAC_API FLAC__bool FLAC__metadata_chain_write_with_callbacks_and_tempfile(FLAC_
 		return false;
 	}
 
+	if(!chain_load_pictures_(chain, 0, handle, callbacks))
+		return false;
+
 	current_length = chain_prepare_for_write_(chain, use_padding);
 
 	/* a return value of 0 means there was an error; chain->status is already set */
@@ -2395,7 +2919,8 @@ static FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_cstr
 	return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
 }
 
-FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Picture *block)
+/* reads everything up to the picture data */
+FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_header_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Picture *block)
 {
 	FLAC__Metadata_SimpleIteratorStatus status;
 	FLAC__byte buffer[4]; /* asserted below that this is big enough */
@@ -2443,6 +2968,16 @@ FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_cb_(FLAC__I
 		return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
 	block->colors = unpack_uint32_(buffer, len);
 
+	return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
+}
+
+FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Picture *block)
+{
+	FLAC__Metadata_SimpleIteratorStatus status;
+
+	if((status = read_metadata_block_data_picture_header_cb_(handle, read_cb, block)) != FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK)
+		return status;
+
 	/* for convenience we use read_metadata_block_data_picture_cstring_cb_() even though it adds an extra terminating NUL we don't use */
 	if((status = read_metadata_block_data_picture_cstring_cb_(handle, read_cb, &(block->data), &(block->data_length), FLAC__STREAM_METADATA_PICTURE_DATA_LENGTH_LEN)) != FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK)
 		return status;
@@ -2450,6 +2985,30 @@ FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_cb_(FLAC__I
 	return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
 }
 
+/* like read_metadata_block_data_picture_cb_() but seeks past the picture
+ * data, leaving block->data NULL and only block->data_length set
+ */
+FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_picture_info_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__IOCallback_Seek seek_cb, FLAC__StreamMetadata_Picture *block)
+{
+	FLAC__Metadata_SimpleIteratorStatus status;
+	FLAC__byte buffer[4]; /* asserted below that this is big enough */
+	const unsigned len = FLAC__STREAM_METADATA_PICTURE_DATA_LENGTH_LEN / 8;
+
+	FLAC__ASSERT(sizeof(buffer) >= FLAC__STREAM_METADATA_PICTURE_DATA_LENGTH_LEN/8);
+
+	if((status = read_metadata_block_data_picture_header_cb_(handle, read_cb, block)) != FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK)
+		return status;
+
+	if(read_cb(buffer, 1, len, handle) != len)
+		return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_READ_ERROR;
+	block->data_length = unpack_uint32_(buffer, len);
+
+	if(0 != seek_cb(handle, block->data_length, SEEK_CUR))
+		return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_SEEK_ERROR;
+
+	return FLAC__METADATA_SIMPLE_ITERATOR_STATUS_OK;
+}
+
 FLAC__Metadata_SimpleIteratorStatus read_metadata_block_data_unknown_cb_(FLAC__IOHandle handle, FLAC__IOCallback_Read read_cb, FLAC__StreamMetadata_Unknown *block, unsigned block_length)
 {
 	if(block_length == 0) {
@@ -2760,6 +3319,10 @@ FLAC__bool write_metadata_block_data_picture_cb_(FLAC__IOHandle handle, FLAC__IO
 	FLAC__ASSERT(sizeof(buffer) >= FLAC__STREAM_METADATA_PICTURE_COLORS_LEN/8);
 	FLAC__ASSERT(sizeof(buffer) >= FLAC__STREAM_METADATA_PICTURE_DATA_LENGTH_LEN/8);
 
+	/* a lazy picture has to have its data loaded before it can be written */
+	if(0 == block->data && block->data_length > 0)
+		return false;
+
 	len = FLAC__STREAM_METADATA_PICTURE_TYPE_LEN/8;
 	pack_uint32_(block->type, buffer, len);
 	if(write_cb(buffer, 1, len, handle) != len)
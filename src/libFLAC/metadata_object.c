@@ -34,6 +34,7 @@
 #  include <config.h>
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -502,6 +503,7 @@ FLAC_API FLAC__StreamMetadata *FLAC__metadata_object_new(FLAC__MetadataType type
 				object->data.picture.colors = 0;
 				object->data.picture.data_length = 0;
 				object->data.picture.data = 0;
+				object->data.picture.data_offset = 0;
 				*/
 				/* now initialize mime_type and description with empty strings to make things easier on the client */
 				if(!copy_cstring_(&object->data.picture.mime_type, "")) {
@@ -617,7 +619,11 @@ FLAC_API FLAC__StreamMetadata *FLAC__metadata_object_clone(const FLAC__StreamMet
 				to->data.picture.depth = object->data.picture.depth;
 				to->data.picture.colors = object->data.picture.colors;
 				to->data.picture.data_length = object->data.picture.data_length;
-				if(!copy_bytes_((&to->data.picture.data), object->data.picture.data, object->data.picture.data_length)) {
+				to->data.picture.data_offset = object->data.picture.data_offset;
+				/* a lazy picture stays lazy; its data is loaded from the stream on demand */
+				if(0 == object->data.picture.data)
+					to->data.picture.data = 0;
+				else if(!copy_bytes_((&to->data.picture.data), object->data.picture.data, object->data.picture.data_length)) {
 					FLAC__metadata_object_delete(to);
 					return 0;
 				}
@@ -858,6 +864,8 @@ static FLAC__bool compare_block_data_picture_(const FLAC__StreamMetadata_Picture
 		return false;
 	if(block1->data != block2->data && (0 == block1->data || 0 == block2->data || memcmp(block1->data, block2->data, block1->data_length)))
 		return false;
+	if(0 == block1->data && block1->data_offset != block2->data_offset)
+		return false;
 	return true;
 }
 
@@ -1811,10 +1819,76 @@ FLAC_API FLAC__bool FLAC__metadata_object_picture_set_data(FLAC__StreamMetadata
 
 	object->length -= object->data.picture.data_length;
 	object->data.picture.data_length = length;
+	object->data.picture.data_offset = 0;
 	object->length += length;
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__metadata_object_picture_load_data(FLAC__StreamMetadata *object, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks)
+{
+	FLAC__byte *data;
+
+	FLAC__ASSERT(0 != object);
+	FLAC__ASSERT(object->type == FLAC__METADATA_TYPE_PICTURE);
+
+	if(0 != object->data.picture.data || 0 == object->data.picture.data_length)
+		return true;
+
+	if(0 == callbacks.read || 0 == callbacks.seek)
+		return false;
+
+	if(0 != callbacks.seek(handle, (FLAC__int64)object->data.picture.data_offset, SEEK_SET))
+		return false;
+
+	if(0 == (data = safe_malloc_(object->data.picture.data_length)))
+		return false;
+
+	if(callbacks.read(data, 1, object->data.picture.data_length, handle) != object->data.picture.data_length) {
+		free(data);
+		return false;
+	}
+
+	object->data.picture.data = data;
+	object->data.picture.data_offset = 0;
+	return true;
+}
+
+static size_t picture_fread_(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+{
+	return fread(ptr, size, nmemb, (FILE*)handle);
+}
+
+static int picture_fseek_(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+{
+	return fseeko((FILE*)handle, (FLAC__off_t)offset, whence);
+}
+
+FLAC_API FLAC__bool FLAC__metadata_object_picture_load_data_from_file(FLAC__StreamMetadata *object, const char *filename)
+{
+	FLAC__IOCallbacks callbacks;
+	FILE *file;
+	FLAC__bool ok;
+
+	FLAC__ASSERT(0 != object);
+	FLAC__ASSERT(object->type == FLAC__METADATA_TYPE_PICTURE);
+	FLAC__ASSERT(0 != filename);
+
+	if(0 != object->data.picture.data || 0 == object->data.picture.data_length)
+		return true;
+
+	if(0 == (file = flac_fopen(filename, "rb")))
+		return false;
+
+	memset(&callbacks, 0, sizeof(callbacks));
+	callbacks.read = picture_fread_;
+	callbacks.seek = picture_fseek_;
+
+	ok = FLAC__metadata_object_picture_load_data(object, (FLAC__IOHandle)file, callbacks);
+
+	fclose(file);
+	return ok;
+}
+
 FLAC_API FLAC__bool FLAC__metadata_object_picture_is_legal(const FLAC__StreamMetadata *object, const char **violation)
 {
 	FLAC__ASSERT(0 != object);
@@ -39,22 +39,49 @@
 #include "private/ogg_decoder_aspect.h"
 #include "private/ogg_mapping.h"
 #include "private/macros.h"
+#include "private/memory.h"
 
 
+/***********************************************************************
+ *
+ * Private static data
+ *
+ ***********************************************************************/
+
+/* the least to ask of the client at a time; we ask for more once we have seen bigger pages */
+static const size_t OGG_BYTES_CHUNK = 8192;
+
+/***********************************************************************
+ *
+ * Private class method prototypes
+ *
+ ***********************************************************************/
+
+static FLAC__bool add_index_entry_(FLAC__OggDecoderAspect *aspect, const FLAC__OggPageIndexEntry *entry);
+static void take_page_(FLAC__OggDecoderAspect *aspect, FLAC__bool *hole);
+static FLAC__bool next_packet_(FLAC__OggDecoderAspect *aspect, FLAC__bool *packet_start);
+
 /***********************************************************************
  *
  * Public class methods
  *
  ***********************************************************************/
 
-FLAC__bool FLAC__ogg_decoder_aspect_init(FLAC__OggDecoderAspect *aspect)
+FLAC__bool FLAC__ogg_decoder_aspect_init(FLAC__OggDecoderAspect *aspect, const FLAC__MemoryCallbacks *mem)
 {
-	/* we will determine the serial number later if necessary */
-	if(ogg_stream_init(&aspect->stream_state, aspect->serial_number) != 0)
-		return false;
+	FLAC__ASSERT(0 == aspect->index || aspect->mem == mem);
+	aspect->mem = mem;
 
-	if(ogg_sync_init(&aspect->sync_state) != 0)
-		return false;
+	/* we will determine the serial number later if necessary */
+	if(0 != aspect->sync_state.data) {
+		/* the state was kept from a previous init, just reset it */
+		if(ogg_sync_reset(&aspect->sync_state) != 0)
+			return false;
+	}
+	else {
+		if(ogg_sync_init(&aspect->sync_state) != 0)
+			return false;
+	}
 
 	aspect->version_major = ~(0u);
 	aspect->version_minor = ~(0u);
@@ -62,15 +89,32 @@ FLAC__bool FLAC__ogg_decoder_aspect_init(FLAC__OggDecoderAspect *aspect)
 	aspect->need_serial_number = aspect->use_first_serial_number;
 
 	aspect->end_of_stream = false;
+	aspect->next_page_number = -1;
+	aspect->packet_open = false;
+	aspect->bytes_chunk = OGG_BYTES_CHUNK;
 	aspect->have_working_page = false;
 
+	aspect->sync_offset_known = false;
+	aspect->sync_offset_pending = true;
+	aspect->lost_sync = false;
+	aspect->index_count = 0; /* the storage may have been kept from a previous init */
+
 	return true;
 }
 
 void FLAC__ogg_decoder_aspect_finish(FLAC__OggDecoderAspect *aspect)
 {
 	(void)ogg_sync_clear(&aspect->sync_state);
-	(void)ogg_stream_clear(&aspect->stream_state);
+	if(0 != aspect->index) {
+		FLAC__memory_free(aspect->mem, aspect->index);
+		aspect->index = 0;
+	}
+	aspect->index_count = aspect->index_capacity = 0;
+}
+
+size_t FLAC__ogg_decoder_aspect_get_memory_usage(const FLAC__OggDecoderAspect *aspect)
+{
+	return (0 != aspect->sync_state.data? (size_t)aspect->sync_state.storage : 0) + aspect->index_capacity * sizeof(FLAC__OggPageIndexEntry);
 }
 
 void FLAC__ogg_decoder_aspect_set_serial_number(FLAC__OggDecoderAspect *aspect, long value)
@@ -79,17 +123,27 @@ void FLAC__ogg_decoder_aspect_set_serial_number(FLAC__OggDecoderAspect *aspect,
 	aspect->serial_number = value;
 }
 
+void FLAC__ogg_decoder_aspect_set_page_indexing(FLAC__OggDecoderAspect *aspect, FLAC__bool value)
+{
+	aspect->keep_index = value;
+}
+
 void FLAC__ogg_decoder_aspect_set_defaults(FLAC__OggDecoderAspect *aspect)
 {
 	aspect->use_first_serial_number = true;
+	aspect->keep_index = false;
 }
 
 void FLAC__ogg_decoder_aspect_flush(FLAC__OggDecoderAspect *aspect)
 {
-	(void)ogg_stream_reset(&aspect->stream_state);
 	(void)ogg_sync_reset(&aspect->sync_state);
 	aspect->end_of_stream = false;
+	aspect->next_page_number = -1;
+	aspect->packet_open = false;
 	aspect->have_working_page = false;
+	aspect->sync_offset_known = false;
+	aspect->sync_offset_pending = true;
+	aspect->lost_sync = false;
 }
 
 void FLAC__ogg_decoder_aspect_reset(FLAC__OggDecoderAspect *aspect)
@@ -100,9 +154,78 @@ void FLAC__ogg_decoder_aspect_reset(FLAC__OggDecoderAspect *aspect)
 		aspect->need_serial_number = true;
 }
 
+FLAC__bool FLAC__ogg_decoder_aspect_need_stream_offset(const FLAC__OggDecoderAspect *aspect)
+{
+	return aspect->keep_index && aspect->sync_offset_pending;
+}
+
+void FLAC__ogg_decoder_aspect_set_stream_offset(FLAC__OggDecoderAspect *aspect, FLAC__uint64 offset)
+{
+	/*
+	 * only meaningful when nothing is buffered, i.e. right after init or a
+	 * flush; once a read has gone by without it the offset can't be
+	 * learned any more, so the index waits for the next flush
+	 */
+	if(aspect->sync_offset_pending && aspect->sync_state.fill == aspect->sync_state.returned) {
+		aspect->sync_offset = offset;
+		aspect->sync_offset_known = true;
+	}
+}
+
+FLAC__bool FLAC__ogg_decoder_aspect_add_index_entries(FLAC__OggDecoderAspect *aspect, const FLAC__OggPageIndexEntry entries[], unsigned count)
+{
+	unsigned i;
+
+	for(i = 0; i < count; i++) {
+		if(!add_index_entry_(aspect, &entries[i]))
+			return false;
+	}
+	return true;
+}
+
+unsigned FLAC__ogg_decoder_aspect_get_index(const FLAC__OggDecoderAspect *aspect, const FLAC__OggPageIndexEntry **entries)
+{
+	*entries = aspect->index;
+	return aspect->index_count;
+}
+
+/*
+ * Looks for the last page of our stream that ends at or before
+ * 'target_sample'; seeking to it lands on the frame containing the
+ * target or one before it.  Only returns true if the index also has a
+ * page past the target; if there is a page after that one as well,
+ * '*right_pos' and '*right_sample' are narrowed to bound the search from
+ * above, otherwise they are left alone.
+ */
+FLAC__bool FLAC__ogg_decoder_aspect_find_in_index(const FLAC__OggDecoderAspect *aspect, FLAC__uint64 target_sample, FLAC__uint64 *start_pos, FLAC__uint64 *right_pos, FLAC__uint64 *right_sample)
+{
+	const FLAC__OggPageIndexEntry *left = 0;
+	unsigned i;
+
+	for(i = 0; i < aspect->index_count; i++) {
+		const FLAC__OggPageIndexEntry *entry = &aspect->index[i];
+		if(entry->serial_number != aspect->serial_number || entry->granule_position < 0)
+			continue;
+		if((FLAC__uint64)entry->granule_position <= target_sample) {
+			left = entry;
+		}
+		else {
+			if(0 == left)
+				return false;
+			*start_pos = left->stream_offset;
+			/* frames read from the page after this one all start past the target */
+			if(i + 1 < aspect->index_count) {
+				*right_pos = aspect->index[i + 1].stream_offset;
+				*right_sample = (FLAC__uint64)entry->granule_position;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
 FLAC__OggDecoderAspectReadStatus FLAC__ogg_decoder_aspect_read_callback_wrapper(FLAC__OggDecoderAspect *aspect, FLAC__byte buffer[], size_t *bytes, FLAC__OggDecoderAspectReadCallbackProxy read_callback, const FLAC__StreamDecoder *decoder, void *client_data)
 {
-	static const size_t OGG_BYTES_CHUNK = 8192;
 	const size_t bytes_requested = *bytes;
 
 	/*
@@ -130,44 +253,38 @@ FLAC__OggDecoderAspectReadStatus FLAC__ogg_decoder_aspect_read_callback_wrapper(
 	 * requirement.  To limit the amount of callbacks, we will always try
 	 * to read in enough pages to return the full number of bytes
 	 * requested.
+	 *
+	 * Since the FLAC mapping makes the packets one continuous FLAC
+	 * stream, there is no need to reassemble them with an
+	 * ogg_stream_state, which would copy every page body once more.  We
+	 * copy straight from the page in the sync buffer to libFLAC, walking
+	 * the lacing values only to find where packets start.
 	 */
 	*bytes = 0;
 	while (*bytes < bytes_requested && !aspect->end_of_stream) {
 		if (aspect->have_working_page) {
-			if (aspect->have_working_packet) {
-				size_t n = bytes_requested - *bytes;
-				if ((size_t)aspect->working_packet.bytes <= n) {
-					/* the rest of the packet will fit in the buffer */
-					n = aspect->working_packet.bytes;
-					memcpy(buffer, aspect->working_packet.packet, n);
-					*bytes += n;
-					buffer += n;
-					aspect->have_working_packet = false;
-				}
-				else {
-					/* only n bytes of the packet will fit in the buffer */
-					memcpy(buffer, aspect->working_packet.packet, n);
-					*bytes += n;
-					buffer += n;
-					aspect->working_packet.packet += n;
-					aspect->working_packet.bytes -= n;
-				}
+			if (aspect->working_bytes > 0) {
+				const size_t n = flac_min(bytes_requested - *bytes, aspect->working_bytes);
+				memcpy(buffer, aspect->working_body, n);
+				*bytes += n;
+				buffer += n;
+				aspect->working_body += n;
+				aspect->working_bytes -= n;
 			}
 			else {
 				/* try and get another packet */
-				const int ret = ogg_stream_packetout(&aspect->stream_state, &aspect->working_packet);
-				if (ret > 0) {
-					aspect->have_working_packet = true;
+				FLAC__bool packet_start;
+				if (next_packet_(aspect, &packet_start)) {
 					/* if it is the first header packet, check for magic and a supported Ogg FLAC mapping version */
-					if (aspect->working_packet.bytes > 0 && aspect->working_packet.packet[0] == FLAC__OGG_MAPPING_FIRST_HEADER_PACKET_TYPE) {
-						const FLAC__byte *b = aspect->working_packet.packet;
+					if (packet_start && aspect->working_bytes > 0 && aspect->working_body[0] == FLAC__OGG_MAPPING_FIRST_HEADER_PACKET_TYPE) {
+						const FLAC__byte *b = aspect->working_body;
 						const unsigned header_length =
 							FLAC__OGG_MAPPING_PACKET_TYPE_LENGTH +
 							FLAC__OGG_MAPPING_MAGIC_LENGTH +
 							FLAC__OGG_MAPPING_VERSION_MAJOR_LENGTH +
 							FLAC__OGG_MAPPING_VERSION_MINOR_LENGTH +
 							FLAC__OGG_MAPPING_NUM_HEADERS_LENGTH;
-						if (aspect->working_packet.bytes < (long)header_length)
+						if (aspect->working_bytes < header_length)
 							return FLAC__OGG_DECODER_ASPECT_READ_STATUS_NOT_FLAC;
 						b += FLAC__OGG_MAPPING_PACKET_TYPE_LENGTH;
 						if (memcmp(b, FLAC__OGG_MAPPING_MAGIC, FLAC__OGG_MAPPING_MAGIC_LENGTH))
@@ -178,37 +295,50 @@ FLAC__OggDecoderAspectReadStatus FLAC__ogg_decoder_aspect_read_callback_wrapper(
 						aspect->version_minor = (unsigned)(*b);
 						if (aspect->version_major != 1)
 							return FLAC__OGG_DECODER_ASPECT_READ_STATUS_UNSUPPORTED_MAPPING_VERSION;
-						aspect->working_packet.packet += header_length;
-						aspect->working_packet.bytes -= header_length;
+						aspect->working_body += header_length;
+						aspect->working_bytes -= header_length;
 					}
 				}
-				else if (ret == 0) {
+				else {
 					aspect->have_working_page = false;
 				}
-				else { /* ret < 0 */
-					/* lost sync, we'll leave the working page for the next call */
-					return FLAC__OGG_DECODER_ASPECT_READ_STATUS_LOST_SYNC;
-				}
 			}
 		}
 		else {
-			/* try and get another page */
-			const int ret = ogg_sync_pageout(&aspect->sync_state, &aspect->working_page);
+			/* try and get another page; ogg_sync_pageseek() tells us how many bytes it skipped or took, so we can follow the stream offset */
+			const long ret = ogg_sync_pageseek(&aspect->sync_state, &aspect->working_page);
 			if (ret > 0) {
+				aspect->lost_sync = false;
 				/* got a page, grab the serial number if necessary */
 				if(aspect->need_serial_number) {
-					aspect->stream_state.serialno = aspect->serial_number = ogg_page_serialno(&aspect->working_page);
+					aspect->serial_number = ogg_page_serialno(&aspect->working_page);
 					aspect->need_serial_number = false;
 				}
-				if(ogg_stream_pagein(&aspect->stream_state, &aspect->working_page) == 0) {
-					aspect->have_working_page = true;
-					aspect->have_working_packet = false;
+				if(aspect->sync_offset_known) {
+					if(aspect->keep_index) {
+						FLAC__OggPageIndexEntry entry;
+						entry.stream_offset = aspect->sync_offset;
+						entry.granule_position = ogg_page_granulepos(&aspect->working_page);
+						entry.serial_number = ogg_page_serialno(&aspect->working_page);
+						/* the index is only a hint; if it can't grow we just stop adding to it */
+						(void)add_index_entry_(aspect, &entry);
+					}
+					aspect->sync_offset += (FLAC__uint64)ret;
+				}
+				aspect->bytes_chunk = flac_max(aspect->bytes_chunk, (size_t)(aspect->working_page.header_len + aspect->working_page.body_len));
+				/* skip pages from other streams, and from versions of the Ogg format we don't know */
+				if(ogg_page_serialno(&aspect->working_page) == aspect->serial_number && ogg_page_version(&aspect->working_page) == 0) {
+					FLAC__bool hole;
+					take_page_(aspect, &hole);
+					if(hole) {
+						/* lost sync, we'll leave the working page for the next call */
+						return FLAC__OGG_DECODER_ASPECT_READ_STATUS_LOST_SYNC;
+					}
 				}
-				/* else do nothing, could be a page from another stream */
 			}
 			else if (ret == 0) {
 				/* need more data */
-				const size_t ogg_bytes_to_read = flac_max(bytes_requested - *bytes, OGG_BYTES_CHUNK);
+				const size_t ogg_bytes_to_read = flac_max(bytes_requested - *bytes, aspect->bytes_chunk);
 				char *oggbuf = ogg_sync_buffer(&aspect->sync_state, ogg_bytes_to_read);
 
 				if(0 == oggbuf) {
@@ -217,6 +347,7 @@ FLAC__OggDecoderAspectReadStatus FLAC__ogg_decoder_aspect_read_callback_wrapper(
 				else {
 					size_t ogg_bytes_read = ogg_bytes_to_read;
 
+					aspect->sync_offset_pending = false;
 					switch(read_callback(decoder, (FLAC__byte*)oggbuf, &ogg_bytes_read, client_data)) {
 						case FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK:
 							break;
@@ -237,8 +368,12 @@ FLAC__OggDecoderAspectReadStatus FLAC__ogg_decoder_aspect_read_callback_wrapper(
 				}
 			}
 			else { /* ret < 0 */
-				/* lost sync, bail out */
-				return FLAC__OGG_DECODER_ASPECT_READ_STATUS_LOST_SYNC;
+				aspect->sync_offset += (FLAC__uint64)(-ret);
+				/* lost sync; ogg_sync_pageout() would report this once for each run of skipped bytes, and so do we */
+				if(!aspect->lost_sync) {
+					aspect->lost_sync = true;
+					return FLAC__OGG_DECODER_ASPECT_READ_STATUS_LOST_SYNC;
+				}
 			}
 		}
 	}
@@ -249,3 +384,112 @@ FLAC__OggDecoderAspectReadStatus FLAC__ogg_decoder_aspect_read_callback_wrapper(
 
 	return FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK;
 }
+
+
+/***********************************************************************
+ *
+ * Private class methods
+ *
+ ***********************************************************************/
+
+/*
+ * Inserts 'entry' in the index in stream offset order, replacing any
+ * entry at the same offset
+ */
+FLAC__bool add_index_entry_(FLAC__OggDecoderAspect *aspect, const FLAC__OggPageIndexEntry *entry)
+{
+	unsigned lo = 0, hi = aspect->index_count;
+
+	/* pages mostly go by in order, so check the end first */
+	if(hi > 0 && aspect->index[hi - 1].stream_offset < entry->stream_offset)
+		lo = hi;
+	while(lo < hi) {
+		const unsigned mid = lo + (hi - lo) / 2;
+		if(aspect->index[mid].stream_offset < entry->stream_offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if(lo < aspect->index_count && aspect->index[lo].stream_offset == entry->stream_offset) {
+		aspect->index[lo] = *entry;
+		return true;
+	}
+
+	if(aspect->index_count == aspect->index_capacity) {
+		const unsigned new_capacity = aspect->index_capacity == 0? 64 : aspect->index_capacity * 2;
+		FLAC__OggPageIndexEntry *new_index;
+		if(new_capacity < aspect->index_capacity)
+			return false;
+		if(0 == (new_index = FLAC__memory_realloc_mul_2op(aspect->mem, aspect->index, new_capacity, sizeof(FLAC__OggPageIndexEntry))))
+			return false;
+		aspect->index = new_index;
+		aspect->index_capacity = new_capacity;
+	}
+
+	memmove(&aspect->index[lo + 1], &aspect->index[lo], (aspect->index_count - lo) * sizeof(FLAC__OggPageIndexEntry));
+	aspect->index[lo] = *entry;
+	aspect->index_count++;
+	return true;
+}
+
+/*
+ * Makes the page just returned by ogg_sync_pageseek() the working page,
+ * doing the sequence checks ogg_stream_pagein() would: '*hole' is set
+ * if pages are missing before this one, and a packet continued from a
+ * page we did not see is skipped.
+ */
+void take_page_(FLAC__OggDecoderAspect *aspect, FLAC__bool *hole)
+{
+	const long page_number = ogg_page_pageno(&aspect->working_page);
+
+	*hole = (aspect->next_page_number != -1 && page_number != aspect->next_page_number);
+	if(page_number != aspect->next_page_number)
+		aspect->packet_open = false;
+	aspect->next_page_number = page_number + 1;
+
+	aspect->have_working_page = true;
+	aspect->working_segment = 0;
+	aspect->working_body = aspect->working_page.body;
+	aspect->working_bytes = 0;
+
+	if(ogg_page_continued(&aspect->working_page) && !aspect->packet_open) {
+		/* the start of the packet is gone, skip to the next one */
+		const int segments = aspect->working_page.header[26];
+		while(aspect->working_segment < segments) {
+			const unsigned val = aspect->working_page.header[27 + aspect->working_segment++];
+			aspect->working_body += val;
+			if(val < 255)
+				break;
+		}
+	}
+}
+
+/*
+ * Sets working_body/working_bytes to the next run of segments on the
+ * working page, up to the end of a packet or of the page.  Returns false
+ * if the page is used up.  '*packet_start' is false if the run
+ * continues a packet from the previous page.
+ */
+FLAC__bool next_packet_(FLAC__OggDecoderAspect *aspect, FLAC__bool *packet_start)
+{
+	const int segments = aspect->working_page.header[26];
+	size_t bytes = 0;
+
+	if(aspect->working_segment >= segments)
+		return false;
+
+	*packet_start = !(aspect->working_segment == 0 && ogg_page_continued(&aspect->working_page));
+
+	aspect->packet_open = true;
+	while(aspect->working_segment < segments) {
+		const unsigned val = aspect->working_page.header[27 + aspect->working_segment++];
+		bytes += val;
+		if(val < 255) {
+			aspect->packet_open = false;
+			break;
+		}
+	}
+	aspect->working_bytes = bytes;
+	return true;
+}
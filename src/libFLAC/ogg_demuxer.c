@@ -0,0 +1,595 @@
+/* libFLAC - Free Lossless Audio Codec
+ * Copyright (C) 2002-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h> /* for calloc() */
+#include <string.h> /* for memcpy(), memmove() */
+#include "FLAC/assert.h"
+#include "FLAC/ogg_demuxer.h"
+#include "share/alloc.h"
+#include "private/macros.h"
+#if FLAC__HAS_OGG
+#include <ogg/ogg.h>
+#include "private/ogg_mapping.h"
+#endif
+
+
+/***********************************************************************
+ *
+ * Private class data
+ *
+ ***********************************************************************/
+
+#if FLAC__HAS_OGG
+/* how much to ask of the client at a time */
+static const size_t OGG_BYTES_CHUNK = 8192;
+
+typedef struct {
+	FLAC__OggDemuxer *demuxer;
+	FLAC__StreamDecoder *decoder;
+	FLAC__OggDemuxerStreamCallbacks callbacks;
+	ogg_stream_state stream_state;
+	FLAC__bool got_first_packet;
+	/* the part of the last packet that did not fit in the decoder's buffer; it can't stay in stream_state since the next ogg_stream_pagein() may move it */
+	FLAC__byte *leftover;
+	size_t leftover_head, leftover_tail, leftover_capacity;
+} FLAC__OggDemuxerStream;
+#endif
+
+struct FLAC__OggDemuxer {
+	FLAC__OggDemuxerState state;
+	FLAC__OggDemuxerReadCallback read_callback;
+	FLAC__OggDemuxerNewStreamCallback new_stream_callback;
+	void *client_data;
+	FILE *file; /* only used if FLAC__ogg_demuxer_init_FILE() called, else NULL */
+	FLAC__bool md5_failed;
+#if FLAC__HAS_OGG
+	ogg_sync_state sync_state;
+	FLAC__bool end_of_input;
+	FLAC__OggDemuxerStream **streams; /* the streams being decoded, in the order they started */
+	unsigned stream_count, stream_capacity;
+#endif
+};
+
+FLAC_API const char * const FLAC__OggDemuxerStateString[] = {
+	"FLAC__OGG_DEMUXER_OK",
+	"FLAC__OGG_DEMUXER_END_OF_STREAM",
+	"FLAC__OGG_DEMUXER_READ_ERROR",
+	"FLAC__OGG_DEMUXER_DECODER_ERROR",
+	"FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR",
+	"FLAC__OGG_DEMUXER_UNSUPPORTED_CONTAINER",
+	"FLAC__OGG_DEMUXER_UNINITIALIZED"
+};
+
+/***********************************************************************
+ *
+ * Private class method prototypes
+ *
+ ***********************************************************************/
+
+static FLAC__StreamDecoderReadStatus file_read_callback_(const FLAC__OggDemuxer *demuxer, FLAC__byte buffer[], size_t *bytes, void *client_data);
+#if FLAC__HAS_OGG
+static FLAC__bool read_page_(FLAC__OggDemuxer *demuxer);
+static FLAC__bool route_page_(FLAC__OggDemuxer *demuxer, ogg_page *page);
+static FLAC__bool new_stream_(FLAC__OggDemuxer *demuxer, long serial_number, FLAC__OggDemuxerStream **stream);
+static void delete_stream_(FLAC__OggDemuxer *demuxer, unsigned i);
+static FLAC__StreamDecoderReadStatus read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+static FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
+static void metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
+static void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
+#endif
+
+/***********************************************************************
+ *
+ * Class constructor/destructor
+ *
+ ***********************************************************************/
+
+FLAC_API FLAC__OggDemuxer *FLAC__ogg_demuxer_new(void)
+{
+	FLAC__OggDemuxer *demuxer = calloc(1, sizeof(FLAC__OggDemuxer));
+
+	if(0 != demuxer)
+		demuxer->state = FLAC__OGG_DEMUXER_UNINITIALIZED;
+
+	return demuxer;
+}
+
+FLAC_API void FLAC__ogg_demuxer_delete(FLAC__OggDemuxer *demuxer)
+{
+	FLAC__ASSERT(0 != demuxer);
+
+	(void)FLAC__ogg_demuxer_finish(demuxer);
+#if FLAC__HAS_OGG
+	if(0 != demuxer->streams)
+		free(demuxer->streams);
+#endif
+	free(demuxer);
+}
+
+/***********************************************************************
+ *
+ * Public class methods
+ *
+ ***********************************************************************/
+
+FLAC_API FLAC__OggDemuxerState FLAC__ogg_demuxer_get_state(const FLAC__OggDemuxer *demuxer)
+{
+	FLAC__ASSERT(0 != demuxer);
+	return demuxer->state;
+}
+
+FLAC_API unsigned FLAC__ogg_demuxer_get_stream_count(const FLAC__OggDemuxer *demuxer)
+{
+	FLAC__ASSERT(0 != demuxer);
+#if FLAC__HAS_OGG
+	return demuxer->stream_count;
+#else
+	return 0;
+#endif
+}
+
+FLAC_API FLAC__bool FLAC__ogg_demuxer_init_stream(FLAC__OggDemuxer *demuxer, FLAC__OggDemuxerReadCallback read_callback, FLAC__OggDemuxerNewStreamCallback new_stream_callback, void *client_data)
+{
+	FLAC__ASSERT(0 != demuxer);
+
+	if(demuxer->state != FLAC__OGG_DEMUXER_UNINITIALIZED)
+		return false;
+
+#if FLAC__HAS_OGG
+	FLAC__ASSERT(0 != read_callback);
+	FLAC__ASSERT(0 != new_stream_callback);
+
+	if(ogg_sync_init(&demuxer->sync_state) != 0) {
+		demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+
+	demuxer->read_callback = read_callback;
+	demuxer->new_stream_callback = new_stream_callback;
+	demuxer->client_data = client_data;
+	demuxer->md5_failed = false;
+	demuxer->end_of_input = false;
+	demuxer->stream_count = 0;
+
+	demuxer->state = FLAC__OGG_DEMUXER_OK;
+	return true;
+#else
+	(void)read_callback;
+	(void)new_stream_callback;
+	(void)client_data;
+	/* stays uninitialized; the state only tells why */
+	demuxer->state = FLAC__OGG_DEMUXER_UNSUPPORTED_CONTAINER;
+	return false;
+#endif
+}
+
+FLAC_API FLAC__bool FLAC__ogg_demuxer_init_FILE(FLAC__OggDemuxer *demuxer, FILE *file, FLAC__OggDemuxerNewStreamCallback new_stream_callback, void *client_data)
+{
+	FLAC__ASSERT(0 != demuxer);
+	FLAC__ASSERT(0 != file);
+
+	if(!FLAC__ogg_demuxer_init_stream(demuxer, file_read_callback_, new_stream_callback, client_data))
+		return false;
+
+	demuxer->file = file;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__ogg_demuxer_finish(FLAC__OggDemuxer *demuxer)
+{
+	FLAC__bool md5_failed;
+
+	FLAC__ASSERT(0 != demuxer);
+
+	if(demuxer->state == FLAC__OGG_DEMUXER_UNINITIALIZED || demuxer->state == FLAC__OGG_DEMUXER_UNSUPPORTED_CONTAINER) {
+		demuxer->state = FLAC__OGG_DEMUXER_UNINITIALIZED;
+		return true;
+	}
+
+#if FLAC__HAS_OGG
+	while(demuxer->stream_count > 0)
+		delete_stream_(demuxer, demuxer->stream_count - 1);
+	(void)ogg_sync_clear(&demuxer->sync_state);
+#endif
+
+	if(0 != demuxer->file) {
+		if(demuxer->file != stdin)
+			fclose(demuxer->file);
+		demuxer->file = 0;
+	}
+
+	md5_failed = demuxer->md5_failed;
+	demuxer->state = FLAC__OGG_DEMUXER_UNINITIALIZED;
+	return !md5_failed;
+}
+
+FLAC_API FLAC__bool FLAC__ogg_demuxer_process_single(FLAC__OggDemuxer *demuxer)
+{
+#if FLAC__HAS_OGG
+	unsigned i;
+#endif
+
+	FLAC__ASSERT(0 != demuxer);
+
+	if(demuxer->state == FLAC__OGG_DEMUXER_END_OF_STREAM)
+		return true;
+	if(demuxer->state != FLAC__OGG_DEMUXER_OK)
+		return false;
+
+#if FLAC__HAS_OGG
+	if(demuxer->stream_count == 0) {
+		/* nothing to decode; read on to the start of the next stream, if there is one */
+		if(!read_page_(demuxer)) {
+			if(demuxer->state != FLAC__OGG_DEMUXER_OK)
+				return false;
+			demuxer->state = FLAC__OGG_DEMUXER_END_OF_STREAM;
+		}
+		return true;
+	}
+
+	/*
+	 * Streams may start while we go round, when a decoder reads the
+	 * first page of another stream; they get their first turn right
+	 * away.
+	 */
+	for(i = 0; i < demuxer->stream_count; ) {
+		FLAC__StreamDecoder *decoder = demuxer->streams[i]->decoder;
+		if(!FLAC__stream_decoder_process_single(decoder)) {
+			if(demuxer->state == FLAC__OGG_DEMUXER_OK)
+				demuxer->state = FLAC__OGG_DEMUXER_DECODER_ERROR;
+			return false;
+		}
+		if(FLAC__stream_decoder_get_state(decoder) == FLAC__STREAM_DECODER_END_OF_STREAM)
+			delete_stream_(demuxer, i);
+		else
+			i++;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+FLAC_API FLAC__bool FLAC__ogg_demuxer_process_until_end_of_stream(FLAC__OggDemuxer *demuxer)
+{
+	FLAC__ASSERT(0 != demuxer);
+
+	while(demuxer->state == FLAC__OGG_DEMUXER_OK) {
+		if(!FLAC__ogg_demuxer_process_single(demuxer))
+			return false;
+	}
+	return demuxer->state == FLAC__OGG_DEMUXER_END_OF_STREAM;
+}
+
+/***********************************************************************
+ *
+ * Private class methods
+ *
+ ***********************************************************************/
+
+FLAC__StreamDecoderReadStatus file_read_callback_(const FLAC__OggDemuxer *demuxer, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	(void)client_data;
+
+	if(*bytes > 0) {
+		*bytes = fread(buffer, sizeof(FLAC__byte), *bytes, demuxer->file);
+		if(ferror(demuxer->file))
+			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		else if(*bytes == 0)
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		else
+			return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+	else
+		return FLAC__STREAM_DECODER_READ_STATUS_ABORT; /* abort to avoid a deadlock */
+}
+
+#if FLAC__HAS_OGG
+/*
+ * Reads from the client until there is a whole page, and hands it to
+ * its stream.  Returns false at the end of the input, or on an error,
+ * in which case the state says so.
+ */
+FLAC__bool read_page_(FLAC__OggDemuxer *demuxer)
+{
+	ogg_page page;
+
+	for(;;) {
+		const int ret = ogg_sync_pageout(&demuxer->sync_state, &page);
+		if(ret > 0)
+			return route_page_(demuxer, &page);
+		else if(ret < 0)
+			continue; /* skipped some garbage; the decoder of a stream with a page missing will notice it */
+		else if(demuxer->end_of_input)
+			return false;
+		else {
+			char *oggbuf = ogg_sync_buffer(&demuxer->sync_state, OGG_BYTES_CHUNK);
+			size_t bytes = OGG_BYTES_CHUNK;
+
+			if(0 == oggbuf) {
+				demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+				return false;
+			}
+			switch(demuxer->read_callback(demuxer, (FLAC__byte*)oggbuf, &bytes, demuxer->client_data)) {
+				case FLAC__STREAM_DECODER_READ_STATUS_CONTINUE:
+					break;
+				case FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM:
+					demuxer->end_of_input = true;
+					break;
+				default:
+					demuxer->state = FLAC__OGG_DEMUXER_READ_ERROR;
+					return false;
+			}
+			if(ogg_sync_wrote(&demuxer->sync_state, bytes) < 0) {
+				/* the read callback returned more bytes than the max requested */
+				FLAC__ASSERT(0);
+				demuxer->state = FLAC__OGG_DEMUXER_READ_ERROR;
+				return false;
+			}
+		}
+	}
+}
+
+/*
+ * Gives 'page' to the stream it belongs to, starting a new stream if it
+ * is the first page of an Ogg FLAC stream.  Pages of streams we are not
+ * decoding are dropped.
+ */
+FLAC__bool route_page_(FLAC__OggDemuxer *demuxer, ogg_page *page)
+{
+	const long serial_number = ogg_page_serialno(page);
+	FLAC__OggDemuxerStream *stream = 0;
+	unsigned i;
+
+	for(i = 0; i < demuxer->stream_count; i++) {
+		if(demuxer->streams[i]->stream_state.serialno == serial_number) {
+			stream = demuxer->streams[i];
+			break;
+		}
+	}
+
+	if(0 == stream) {
+		/* the first packet of an Ogg FLAC stream is alone on its page and starts with the mapping header */
+		const unsigned header_length =
+			FLAC__OGG_MAPPING_PACKET_TYPE_LENGTH +
+			FLAC__OGG_MAPPING_MAGIC_LENGTH +
+			FLAC__OGG_MAPPING_VERSION_MAJOR_LENGTH +
+			FLAC__OGG_MAPPING_VERSION_MINOR_LENGTH +
+			FLAC__OGG_MAPPING_NUM_HEADERS_LENGTH;
+		const FLAC__byte *b = page->body;
+		if(
+			!ogg_page_bos(page) ||
+			page->body_len < (long)header_length ||
+			b[0] != FLAC__OGG_MAPPING_FIRST_HEADER_PACKET_TYPE ||
+			memcmp(b + FLAC__OGG_MAPPING_PACKET_TYPE_LENGTH, FLAC__OGG_MAPPING_MAGIC, FLAC__OGG_MAPPING_MAGIC_LENGTH) ||
+			b[FLAC__OGG_MAPPING_PACKET_TYPE_LENGTH + FLAC__OGG_MAPPING_MAGIC_LENGTH] != 1 /* the only major version we know */
+		)
+			return true;
+		if(!new_stream_(demuxer, serial_number, &stream))
+			return false;
+		if(0 == stream)
+			return true; /* the client skipped it */
+	}
+
+	/* this only fails for a page of another serial number or Ogg version, so there is nothing to do about it */
+	(void)ogg_stream_pagein(&stream->stream_state, page);
+	return true;
+}
+
+/*
+ * Asks the client about a new stream and starts decoding it.  '*stream'
+ * is set to NULL if the client skipped it.
+ */
+FLAC__bool new_stream_(FLAC__OggDemuxer *demuxer, long serial_number, FLAC__OggDemuxerStream **stream)
+{
+	FLAC__OggDemuxerStream *s;
+
+	*stream = 0;
+
+	if(demuxer->stream_count == demuxer->stream_capacity) {
+		const unsigned new_capacity = demuxer->stream_capacity == 0? 4 : demuxer->stream_capacity * 2;
+		FLAC__OggDemuxerStream **new_streams = safe_realloc_mul_2op_(demuxer->streams, new_capacity, sizeof(FLAC__OggDemuxerStream*));
+		if(0 == new_streams) {
+			demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		demuxer->streams = new_streams;
+		demuxer->stream_capacity = new_capacity;
+	}
+
+	if(0 == (s = calloc(1, sizeof(FLAC__OggDemuxerStream)))) {
+		demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	s->demuxer = demuxer;
+	if(0 == (s->decoder = FLAC__stream_decoder_new())) {
+		free(s);
+		demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	if(ogg_stream_init(&s->stream_state, (int)serial_number) != 0) {
+		FLAC__stream_decoder_delete(s->decoder);
+		free(s);
+		demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	/* so that delete_stream_() can clean up from here on */
+	demuxer->streams[demuxer->stream_count++] = s;
+
+	if(!demuxer->new_stream_callback(demuxer, serial_number, s->decoder, &s->callbacks, demuxer->client_data)) {
+		delete_stream_(demuxer, demuxer->stream_count - 1);
+		demuxer->state = FLAC__OGG_DEMUXER_DECODER_ERROR;
+		return false;
+	}
+	if(0 == s->callbacks.write_callback) {
+		delete_stream_(demuxer, demuxer->stream_count - 1);
+		return true;
+	}
+	if(
+		0 == s->callbacks.error_callback ||
+		FLAC__stream_decoder_init_stream(
+			s->decoder,
+			read_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*length_callback=*/0, /*eof_callback=*/0,
+			write_callback_, 0 != s->callbacks.metadata_callback? metadata_callback_ : 0, error_callback_,
+			s
+		) != FLAC__STREAM_DECODER_INIT_STATUS_OK
+	) {
+		delete_stream_(demuxer, demuxer->stream_count - 1);
+		demuxer->state = FLAC__OGG_DEMUXER_DECODER_ERROR;
+		return false;
+	}
+
+	*stream = s;
+	return true;
+}
+
+/*
+ * Finishes the decoder of stream 'i', noting an MD5 mismatch, and
+ * removes the stream
+ */
+void delete_stream_(FLAC__OggDemuxer *demuxer, unsigned i)
+{
+	FLAC__OggDemuxerStream *stream = demuxer->streams[i];
+
+	FLAC__ASSERT(i < demuxer->stream_count);
+
+	if(FLAC__stream_decoder_get_state(stream->decoder) != FLAC__STREAM_DECODER_UNINITIALIZED && !FLAC__stream_decoder_finish(stream->decoder))
+		demuxer->md5_failed = true;
+	FLAC__stream_decoder_delete(stream->decoder);
+	(void)ogg_stream_clear(&stream->stream_state);
+	if(0 != stream->leftover)
+		free(stream->leftover);
+	free(stream);
+
+	memmove(&demuxer->streams[i], &demuxer->streams[i + 1], (demuxer->stream_count - i - 1) * sizeof(FLAC__OggDemuxerStream*));
+	demuxer->stream_count--;
+}
+
+/*
+ * The read callback of the stream decoders: hands over the packets of
+ * the stream, reading pages from the client (and keeping those of other
+ * streams for them) when it has run out.  The packets make up a native
+ * FLAC stream once the mapping header is cut from the first one.
+ */
+FLAC__StreamDecoderReadStatus read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	FLAC__OggDemuxerStream *stream = (FLAC__OggDemuxerStream*)client_data;
+	const size_t bytes_requested = *bytes;
+
+	(void)decoder;
+
+	*bytes = 0;
+
+	if(stream->leftover_head < stream->leftover_tail) {
+		*bytes = flac_min(bytes_requested, stream->leftover_tail - stream->leftover_head);
+		memcpy(buffer, stream->leftover + stream->leftover_head, *bytes);
+		stream->leftover_head += *bytes;
+		return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+
+	for(;;) {
+		ogg_packet packet;
+		const int ret = ogg_stream_packetout(&stream->stream_state, &packet);
+		if(ret > 0) {
+			const FLAC__byte *data = packet.packet;
+			size_t n = (size_t)packet.bytes;
+
+			if(!stream->got_first_packet) {
+				const size_t header_length =
+					FLAC__OGG_MAPPING_PACKET_TYPE_LENGTH +
+					FLAC__OGG_MAPPING_MAGIC_LENGTH +
+					FLAC__OGG_MAPPING_VERSION_MAJOR_LENGTH +
+					FLAC__OGG_MAPPING_VERSION_MINOR_LENGTH +
+					FLAC__OGG_MAPPING_NUM_HEADERS_LENGTH;
+				/* we checked the header when the stream started, but only on the page */
+				const size_t skip = flac_min(n, header_length);
+				data += skip;
+				n -= skip;
+				stream->got_first_packet = true;
+			}
+
+			*bytes = flac_min(bytes_requested, n);
+			memcpy(buffer, data, *bytes);
+			data += *bytes;
+			n -= *bytes;
+			if(n > 0) {
+				if(n > stream->leftover_capacity) {
+					FLAC__byte *new_leftover = realloc(stream->leftover, n);
+					if(0 == new_leftover) {
+						stream->demuxer->state = FLAC__OGG_DEMUXER_MEMORY_ALLOCATION_ERROR;
+						return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+					}
+					stream->leftover = new_leftover;
+					stream->leftover_capacity = n;
+				}
+				memcpy(stream->leftover, data, n);
+				stream->leftover_head = 0;
+				stream->leftover_tail = n;
+			}
+			if(*bytes > 0)
+				return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+		}
+		else if(ret < 0) {
+			/* a page went missing; the decoder will lose sync and find it again */
+		}
+		else if(stream->stream_state.e_o_s) {
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		}
+		else if(!read_page_(stream->demuxer)) {
+			return stream->demuxer->state == FLAC__OGG_DEMUXER_OK? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		}
+	}
+}
+
+FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	FLAC__OggDemuxerStream *stream = (FLAC__OggDemuxerStream*)client_data;
+	return stream->callbacks.write_callback(decoder, frame, buffer, stream->callbacks.client_data);
+}
+
+void metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	FLAC__OggDemuxerStream *stream = (FLAC__OggDemuxerStream*)client_data;
+	stream->callbacks.metadata_callback(decoder, metadata, stream->callbacks.client_data);
+}
+
+void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	FLAC__OggDemuxerStream *stream = (FLAC__OggDemuxerStream*)client_data;
+	stream->callbacks.error_callback(decoder, status, stream->callbacks.client_data);
+}
+#endif
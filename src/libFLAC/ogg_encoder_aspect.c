@@ -34,22 +34,38 @@
 #  include <config.h>
 #endif
 
+#include <limits.h> /* for INT_MAX */
 #include <string.h> /* for memset() */
 #include "FLAC/assert.h"
 #include "private/ogg_encoder_aspect.h"
 #include "private/ogg_mapping.h"
+#include "private/macros.h"
+#include "private/memory.h"
 
 static const FLAC__byte FLAC__OGG_MAPPING_VERSION_MAJOR = 1;
 static const FLAC__byte FLAC__OGG_MAPPING_VERSION_MINOR = 0;
 
+/***********************************************************************
+ *
+ * Private class method prototypes
+ *
+ ***********************************************************************/
+
+static FLAC__bool queue_page_(FLAC__OggEncoderAspect *aspect);
+static FLAC__StreamEncoderWriteStatus write_pending_(FLAC__OggEncoderAspect *aspect, unsigned current_frame, FLAC__OggEncoderAspectWriteCallbackProxy write_callback, void *encoder, void *client_data);
+
 /***********************************************************************
  *
  * Public class methods
  *
  ***********************************************************************/
 
-FLAC__bool FLAC__ogg_encoder_aspect_init(FLAC__OggEncoderAspect *aspect)
+FLAC__bool FLAC__ogg_encoder_aspect_init(FLAC__OggEncoderAspect *aspect, const FLAC__MemoryCallbacks *mem)
 {
+	aspect->mem = mem;
+	aspect->pending = 0;
+	aspect->pending_bytes = aspect->pending_capacity = 0;
+
 	/* we will determine the serial number later if necessary */
 	if(ogg_stream_init(&aspect->stream_state, aspect->serial_number) != 0)
 		return false;
@@ -65,6 +81,18 @@ void FLAC__ogg_encoder_aspect_finish(FLAC__OggEncoderAspect *aspect)
 {
 	(void)ogg_stream_clear(&aspect->stream_state);
 	/*@@@ what about the page? */
+	if(0 != aspect->pending) {
+		FLAC__memory_free(aspect->mem, aspect->pending);
+		aspect->pending = 0;
+	}
+	aspect->pending_bytes = aspect->pending_capacity = 0;
+}
+
+size_t FLAC__ogg_encoder_aspect_get_memory_usage(const FLAC__OggEncoderAspect *aspect)
+{
+	if(0 == aspect->stream_state.body_data)
+		return 0;
+	return (size_t)aspect->stream_state.body_storage + (size_t)aspect->stream_state.lacing_storage * (sizeof(*aspect->stream_state.lacing_vals) + sizeof(*aspect->stream_state.granule_vals)) + aspect->pending_capacity;
 }
 
 void FLAC__ogg_encoder_aspect_set_serial_number(FLAC__OggEncoderAspect *aspect, long value)
@@ -82,10 +110,22 @@ FLAC__bool FLAC__ogg_encoder_aspect_set_num_metadata(FLAC__OggEncoderAspect *asp
 		return false;
 }
 
+void FLAC__ogg_encoder_aspect_set_page_size(FLAC__OggEncoderAspect *aspect, unsigned value)
+{
+	aspect->page_size = value;
+}
+
+void FLAC__ogg_encoder_aspect_set_write_size(FLAC__OggEncoderAspect *aspect, unsigned value)
+{
+	aspect->write_size = value;
+}
+
 void FLAC__ogg_encoder_aspect_set_defaults(FLAC__OggEncoderAspect *aspect)
 {
 	aspect->serial_number = 0;
 	aspect->num_metadata = 0;
+	aspect->page_size = 0;
+	aspect->write_size = 0;
 }
 
 /*
@@ -103,6 +143,11 @@ void FLAC__ogg_encoder_aspect_set_defaults(FLAC__OggEncoderAspect *aspect)
  *   the mapping only requires that a flush must occur after all
  *   metadata is written).
  * - Each subsequent FLAC audio frame goes into its own packet.
+ * - Pages are written whole, header and body in one write callback,
+ *   and audio pages may be collected for a while first (see
+ *   FLAC__stream_encoder_set_ogg_write_size()).  The metadata pages go
+ *   out at once, because the encoder takes the offsets of STREAMINFO
+ *   and SEEKTABLE from the tell callback as they are written.
  *
  * WATCHOUT:
  * This depends on the behavior of FLAC__StreamEncoder that we get a
@@ -195,17 +240,25 @@ FLAC__StreamEncoderWriteStatus FLAC__ogg_encoder_aspect_write_callback_wrapper(F
 		/*@@@ can't figure out a way to pass a useful number for 'samples' to the write_callback, so we'll just pass 0 */
 		if(is_metadata) {
 			while(ogg_stream_flush(&aspect->stream_state, &aspect->page) != 0) {
-				if(write_callback(encoder, aspect->page.header, aspect->page.header_len, 0, current_frame, client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
-					return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
-				if(write_callback(encoder, aspect->page.body, aspect->page.body_len, 0, current_frame, client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
+				if(!queue_page_(aspect))
 					return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
 			}
+			if(write_pending_(aspect, current_frame, write_callback, encoder, client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
+				return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
 		}
 		else {
-			while(ogg_stream_pageout(&aspect->stream_state, &aspect->page) != 0) {
-				if(write_callback(encoder, aspect->page.header, aspect->page.header_len, 0, current_frame, client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
+			/* with e_o_s set on the last packet, the pageout calls flush the rest */
+			while(
+				(aspect->page_size > 0?
+					ogg_stream_pageout_fill(&aspect->stream_state, &aspect->page, (int)flac_min(aspect->page_size, (unsigned)INT_MAX)) :
+					ogg_stream_pageout(&aspect->stream_state, &aspect->page)
+				) != 0
+			) {
+				if(!queue_page_(aspect))
 					return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
-				if(write_callback(encoder, aspect->page.body, aspect->page.body_len, 0, current_frame, client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
+			}
+			if(is_last_block || aspect->pending_bytes >= aspect->write_size) {
+				if(write_pending_(aspect, current_frame, write_callback, encoder, client_data) != FLAC__STREAM_ENCODER_WRITE_STATUS_OK)
 					return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
 			}
 		}
@@ -226,3 +279,44 @@ FLAC__StreamEncoderWriteStatus FLAC__ogg_encoder_aspect_write_callback_wrapper(F
 
 	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
 }
+
+
+/***********************************************************************
+ *
+ * Private class methods
+ *
+ ***********************************************************************/
+
+/*
+ * Appends the page just taken from the stream state, header and body,
+ * to the pages waiting to be written
+ */
+FLAC__bool queue_page_(FLAC__OggEncoderAspect *aspect)
+{
+	const size_t bytes = (size_t)aspect->page.header_len + (size_t)aspect->page.body_len;
+
+	if(aspect->pending_bytes + bytes > aspect->pending_capacity) {
+		const size_t new_capacity = flac_max(aspect->pending_bytes + bytes, (size_t)aspect->write_size + bytes);
+		FLAC__byte *new_pending = FLAC__memory_realloc(aspect->mem, aspect->pending, new_capacity);
+		if(0 == new_pending)
+			return false;
+		aspect->pending = new_pending;
+		aspect->pending_capacity = new_capacity;
+	}
+
+	memcpy(aspect->pending + aspect->pending_bytes, aspect->page.header, aspect->page.header_len);
+	aspect->pending_bytes += aspect->page.header_len;
+	memcpy(aspect->pending + aspect->pending_bytes, aspect->page.body, aspect->page.body_len);
+	aspect->pending_bytes += aspect->page.body_len;
+	return true;
+}
+
+FLAC__StreamEncoderWriteStatus write_pending_(FLAC__OggEncoderAspect *aspect, unsigned current_frame, FLAC__OggEncoderAspectWriteCallbackProxy write_callback, void *encoder, void *client_data)
+{
+	const size_t bytes = aspect->pending_bytes;
+
+	if(bytes == 0)
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	aspect->pending_bytes = 0;
+	return write_callback(encoder, aspect->pending, bytes, 0, current_frame, client_data);
+}
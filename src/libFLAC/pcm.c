@@ -0,0 +1,129 @@
+/* libFLAC - Free Lossless Audio Codec
+ * Copyright (C) 2002-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "FLAC/assert.h"
+#include "private/pcm.h"
+
+/* The vector kernels use intrinsics for the instruction set every target
+ * of this build is guaranteed to have (SSE2 on x86 and x64, NEON on ARM),
+ * so they are picked at compile time and need no CPU detection.  Mono and
+ * stereo get a vector loop; other channel counts use the scalar one. */
+#if defined _M_X64 || defined __x86_64__ || (defined _M_IX86_FP && _M_IX86_FP >= 2) || defined __SSE2__
+#  define FLAC__PCM_SSE2
+#  include <emmintrin.h>
+#elif defined _M_ARM || defined __ARM_NEON || defined __ARM_NEON__
+#  define FLAC__PCM_NEON
+#  include <arm_neon.h>
+#endif
+
+static void interleave_float_(const FLAC__int32 * const buffer[], unsigned channels, unsigned from, unsigned samples, float scale, float output[])
+{
+	unsigned i, channel;
+
+	output += (size_t)from * channels;
+	for(i = from; i < samples; i++)
+		for(channel = 0; channel < channels; channel++)
+			*output++ = (float)buffer[channel][i] * scale;
+}
+
+#if defined FLAC__PCM_SSE2
+
+static unsigned interleave_float_mono_(const FLAC__int32 *left, unsigned samples, float scale, float output[])
+{
+	const __m128 factor = _mm_set1_ps(scale);
+	unsigned i;
+
+	for(i = 0; i + 4 <= samples; i += 4)
+		_mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(left + i))), factor));
+	return i;
+}
+
+static unsigned interleave_float_stereo_(const FLAC__int32 *left, const FLAC__int32 *right, unsigned samples, float scale, float output[])
+{
+	const __m128 factor = _mm_set1_ps(scale);
+	unsigned i;
+
+	for(i = 0; i + 4 <= samples; i += 4) {
+		const __m128 l = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(left + i))), factor);
+		const __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(right + i))), factor);
+		_mm_storeu_ps(output + 2*i, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(output + 2*i + 4, _mm_unpackhi_ps(l, r));
+	}
+	return i;
+}
+
+#elif defined FLAC__PCM_NEON
+
+static unsigned interleave_float_mono_(const FLAC__int32 *left, unsigned samples, float scale, float output[])
+{
+	unsigned i;
+
+	for(i = 0; i + 4 <= samples; i += 4)
+		vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(left + i)), scale));
+	return i;
+}
+
+static unsigned interleave_float_stereo_(const FLAC__int32 *left, const FLAC__int32 *right, unsigned samples, float scale, float output[])
+{
+	float32x4x2_t lr;
+	unsigned i;
+
+	for(i = 0; i + 4 <= samples; i += 4) {
+		lr.val[0] = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(left + i)), scale);
+		lr.val[1] = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(right + i)), scale);
+		vst2q_f32(output + 2*i, lr);
+	}
+	return i;
+}
+
+#endif
+
+void FLAC__pcm_interleave_float(const FLAC__int32 * const buffer[], unsigned channels, unsigned samples, float scale, float output[])
+{
+	unsigned done = 0;
+
+	FLAC__ASSERT(0 != buffer);
+	FLAC__ASSERT(0 != output);
+
+#if defined FLAC__PCM_SSE2 || defined FLAC__PCM_NEON
+	if(channels == 1)
+		done = interleave_float_mono_(buffer[0], samples, scale, output);
+	else if(channels == 2)
+		done = interleave_float_stereo_(buffer[0], buffer[1], samples, scale, output);
+#endif
+
+	interleave_float_(buffer, channels, done, samples, scale, output);
+}
@@ -51,6 +51,7 @@
 #include "private/format.h"
 #include "private/lpc.h"
 #include "private/md5.h"
+#include "private/pcm.h"
 #include "private/memory.h"
 #include "private/macros.h"
 
@@ -82,6 +83,10 @@ static FLAC__byte ID3V2_TAG_[3] = { 'I', 'D', '3' };
 static void set_defaults_(FLAC__StreamDecoder *decoder);
 static FILE *get_binary_stdin_(void);
 static FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigned channels);
+static void free_buffers_(FLAC__StreamDecoder *decoder);
+static size_t output_bytes_(unsigned size);
+static void get_memory_usage_(const FLAC__StreamDecoder *decoder, FLAC__MemoryUsage *usage);
+static FLAC__bool check_memory_limit_(FLAC__StreamDecoder *decoder, size_t bytes_released, size_t bytes_needed);
 static FLAC__bool has_id_filtered_(FLAC__StreamDecoder *decoder, FLAC__byte *id);
 static FLAC__bool find_metadata_(FLAC__StreamDecoder *decoder);
 static FLAC__bool read_metadata_(FLAC__StreamDecoder *decoder);
@@ -90,6 +95,7 @@ static FLAC__bool read_metadata_seektable_(FLAC__StreamDecoder *decoder, FLAC__b
 static FLAC__bool read_metadata_vorbiscomment_(FLAC__StreamDecoder *decoder, FLAC__StreamMetadata_VorbisComment *obj);
 static FLAC__bool read_metadata_cuesheet_(FLAC__StreamDecoder *decoder, FLAC__StreamMetadata_CueSheet *obj);
 static FLAC__bool read_metadata_picture_(FLAC__StreamDecoder *decoder, FLAC__StreamMetadata_Picture *obj);
+static FLAC__bool skip_picture_data_(FLAC__StreamDecoder *decoder, FLAC__StreamMetadata_Picture *obj);
 static FLAC__bool skip_id3v2_tag_(FLAC__StreamDecoder *decoder);
 static FLAC__bool frame_sync_(FLAC__StreamDecoder *decoder);
 static FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FLAC__bool do_full_decode);
@@ -99,14 +105,20 @@ static FLAC__bool read_subframe_constant_(FLAC__StreamDecoder *decoder, unsigned
 static FLAC__bool read_subframe_fixed_(FLAC__StreamDecoder *decoder, unsigned channel, unsigned bps, const unsigned order, FLAC__bool do_full_decode);
 static FLAC__bool read_subframe_lpc_(FLAC__StreamDecoder *decoder, unsigned channel, unsigned bps, const unsigned order, FLAC__bool do_full_decode);
 static FLAC__bool read_subframe_verbatim_(FLAC__StreamDecoder *decoder, unsigned channel, unsigned bps, FLAC__bool do_full_decode);
-static FLAC__bool read_residual_partitioned_rice_(FLAC__StreamDecoder *decoder, unsigned predictor_order, unsigned partition_order, FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents, FLAC__int32 *residual, FLAC__bool is_extended);
+static FLAC__bool read_residual_partitioned_rice_(FLAC__StreamDecoder *decoder, unsigned predictor_order, unsigned partition_order, FLAC__EntropyCodingMethod_PartitionedRiceContents *partitioned_rice_contents, FLAC__int32 *residual, FLAC__bool is_extended); /* residual may be 0 to only parse it */
 static FLAC__bool read_zero_padding_(FLAC__StreamDecoder *decoder);
 static FLAC__bool read_callback_(FLAC__byte buffer[], size_t *bytes, void *client_data);
+static FLAC__StreamDecoderReadStatus client_read_(FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes);
+static FLAC__StreamDecoderSeekStatus client_seek_(FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset);
+static FLAC__StreamDecoderTellStatus client_tell_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset);
+static FLAC__bool client_eof_(FLAC__StreamDecoder *decoder);
 #if FLAC__HAS_OGG
 static FLAC__StreamDecoderReadStatus read_callback_ogg_aspect_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes);
 static FLAC__OggDecoderAspectReadStatus read_callback_proxy_(const void *void_decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+static FLAC__bool scan_read_(FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes);
 #endif
 static FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[]);
+static FLAC__bool copy_range_(FLAC__StreamDecoder *decoder, FLAC__uint64 first_sample, unsigned blocksize, unsigned channels, const FLAC__int32 * const buffer[]);
 static void send_error_to_client_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status);
 static FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 stream_length, FLAC__uint64 target_sample);
 #if FLAC__HAS_OGG
@@ -157,6 +169,13 @@ typedef struct FLAC__StreamDecoderPrivate {
 	FLAC__bool has_stream_info, has_seek_table;
 	FLAC__StreamMetadata stream_info;
 	FLAC__StreamMetadata seek_table;
+	unsigned seek_table_capacity; /* in points; the points array may be kept around longer than has_seek_table says */
+	FLAC__bool retain_buffers; /* if true, finish() keeps the buffers for the next init; NOT reset by set_defaults_() */
+	FLAC__MemoryCallbacks memory_callbacks; /* all zero means the C runtime heap; NOT reset by set_defaults_() */
+	size_t metadata_block_bytes; /* size of the metadata block being passed to the metadata callback, for FLAC__MemoryUsage */
+	FLAC__byte *read_buffer; /* chunks read from the client when protected_->read_buffer_size is set */
+	size_t read_buffer_capacity; /* in bytes; may be bigger than protected_->read_buffer_size when retain_buffers is set */
+	size_t read_buffer_head, read_buffer_tail; /* read_buffer[read_buffer_head..read_buffer_tail-1] is data not yet passed to the bitreader */
 	FLAC__bool metadata_filter[128]; /* MAGIC number 128 == total number of metadata block types == 1 << 7 */
 	FLAC__byte *metadata_filter_ids;
 	size_t metadata_filter_ids_count, metadata_filter_ids_capacity; /* units for both are IDs, not bytes */
@@ -177,6 +196,12 @@ typedef struct FLAC__StreamDecoderPrivate {
 	FLAC__uint64 first_frame_offset; /* hint to the seek routine of where in the stream the first audio frame starts */
 	FLAC__uint64 target_sample;
 	unsigned unparseable_frame_count; /* used to tell whether we're decoding a future version of FLAC or just got a bad sync */
+	/* (these are only used by FLAC__stream_decoder_decode_range()) */
+	FLAC__bool is_range_decoding;
+	FLAC__int32 *range_buffer[FLAC__MAX_CHANNELS]; /* where the next sample of each channel goes; advanced by range_stride per sample */
+	unsigned range_stride, range_channels;
+	FLAC__uint64 range_next_sample, range_end_sample; /* samples range_next_sample..range_end_sample-1 are still to be copied */
+	FLAC__bool has_last_output; /* true if output[] holds the whole frame in frame and the input is positioned right after it */
 #if FLAC__HAS_OGG
 	FLAC__bool got_a_frame; /* hack needed in Ogg FLAC seek routine to check when process_single() actually writes a frame */
 #endif
@@ -301,6 +326,12 @@ FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void)
 	decoder->private_->output_capacity = 0;
 	decoder->private_->output_channels = 0;
 	decoder->private_->has_seek_table = false;
+	decoder->private_->seek_table_capacity = 0;
+	decoder->private_->metadata_block_bytes = 0;
+	decoder->private_->read_buffer = 0;
+	decoder->private_->read_buffer_capacity = 0;
+	decoder->private_->read_buffer_head = decoder->private_->read_buffer_tail = 0;
+	decoder->private_->retain_buffers = false;
 
 	for(i = 0; i < FLAC__MAX_CHANNELS; i++)
 		FLAC__format_entropy_coding_method_partitioned_rice_contents_init(&decoder->private_->partitioned_rice_contents[i]);
@@ -316,8 +347,6 @@ FLAC_API FLAC__StreamDecoder *FLAC__stream_decoder_new(void)
 
 FLAC_API void FLAC__stream_decoder_delete(FLAC__StreamDecoder *decoder)
 {
-	unsigned i;
-
 	if (decoder == NULL)
 		return ;
 
@@ -326,15 +355,13 @@ FLAC_API void FLAC__stream_decoder_delete(FLAC__StreamDecoder *decoder)
 	FLAC__ASSERT(0 != decoder->private_->input);
 
 	(void)FLAC__stream_decoder_finish(decoder);
+	free_buffers_(decoder);
 
 	if(0 != decoder->private_->metadata_filter_ids)
 		free(decoder->private_->metadata_filter_ids);
 
 	FLAC__bitreader_delete(decoder->private_->input);
 
-	for(i = 0; i < FLAC__MAX_CHANNELS; i++)
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&decoder->private_->partitioned_rice_contents[i]);
-
 	free(decoder->private_);
 	free(decoder->protected_);
 	free(decoder);
@@ -380,7 +407,7 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 
 #if FLAC__HAS_OGG
 	decoder->private_->is_ogg = is_ogg;
-	if(is_ogg && !FLAC__ogg_decoder_aspect_init(&decoder->protected_->ogg_decoder_aspect))
+	if(is_ogg && !FLAC__ogg_decoder_aspect_init(&decoder->protected_->ogg_decoder_aspect, &decoder->private_->memory_callbacks))
 		return decoder->protected_->state = FLAC__STREAM_DECODER_OGG_ERROR;
 #endif
 
@@ -427,11 +454,27 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 
 	/* from here on, errors are fatal */
 
-	if(!FLAC__bitreader_init(decoder->private_->input, decoder->private_->cpuinfo, read_callback_, decoder)) {
+	if(!FLAC__bitreader_init(decoder->private_->input, &decoder->private_->memory_callbacks, decoder->private_->cpuinfo, read_callback_, decoder)) {
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
 	}
 
+	if(decoder->protected_->read_buffer_size > decoder->private_->read_buffer_capacity) {
+		if(!check_memory_limit_(decoder, decoder->private_->read_buffer_capacity, decoder->protected_->read_buffer_size))
+			return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
+		if(0 == (decoder->private_->read_buffer = FLAC__memory_realloc(&decoder->private_->memory_callbacks, decoder->private_->read_buffer, decoder->protected_->read_buffer_size))) {
+			decoder->private_->read_buffer_capacity = 0;
+			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+			return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
+		}
+		decoder->private_->read_buffer_capacity = decoder->protected_->read_buffer_size;
+	}
+	decoder->private_->read_buffer_head = decoder->private_->read_buffer_tail = 0;
+
+	/* the input buffer and the Ogg state are fixed size, so just check what we have so far */
+	if(!check_memory_limit_(decoder, 0, 0))
+		return FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR;
+
 	decoder->private_->read_callback = read_callback;
 	decoder->private_->seek_callback = seek_callback;
 	decoder->private_->tell_callback = tell_callback;
@@ -448,6 +491,7 @@ static FLAC__StreamDecoderInitStatus init_stream_internal_(
 
 	decoder->private_->do_md5_checking = decoder->protected_->md5_checking;
 	decoder->private_->is_seeking = false;
+	decoder->private_->is_range_decoding = false;
 
 	decoder->private_->internal_reset_hack = true; /* so the following reset does not try to rewind the input */
 	if(!FLAC__stream_decoder_reset(decoder)) {
@@ -642,7 +686,6 @@ FLAC_API FLAC__StreamDecoderInitStatus FLAC__stream_decoder_init_ogg_file(
 FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 {
 	FLAC__bool md5_failed = false;
-	unsigned i;
 
 	FLAC__ASSERT(0 != decoder);
 	FLAC__ASSERT(0 != decoder->private_);
@@ -656,35 +699,10 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 	 */
 	FLAC__MD5Final(decoder->private_->computed_md5sum, &decoder->private_->md5context);
 
-	if(decoder->private_->has_seek_table && 0 != decoder->private_->seek_table.data.seek_table.points) {
-		free(decoder->private_->seek_table.data.seek_table.points);
-		decoder->private_->seek_table.data.seek_table.points = 0;
-		decoder->private_->has_seek_table = false;
-	}
-	FLAC__bitreader_free(decoder->private_->input);
-	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
-		/* WATCHOUT:
-		 * FLAC__lpc_restore_signal_asm_ia32_mmx() requires that the
-		 * output arrays have a buffer of up to 3 zeroes in front
-		 * (at negative indices) for alignment purposes; we use 4
-		 * to keep the data well-aligned.
-		 */
-		if(0 != decoder->private_->output[i]) {
-			free(decoder->private_->output[i]-4);
-			decoder->private_->output[i] = 0;
-		}
-		if(0 != decoder->private_->residual_unaligned[i]) {
-			free(decoder->private_->residual_unaligned[i]);
-			decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
-		}
-	}
-	decoder->private_->output_capacity = 0;
-	decoder->private_->output_channels = 0;
-
-#if FLAC__HAS_OGG
-	if(decoder->private_->is_ogg)
-		FLAC__ogg_decoder_aspect_finish(&decoder->protected_->ogg_decoder_aspect);
-#endif
+	decoder->private_->has_seek_table = false;
+	decoder->private_->metadata_block_bytes = 0;
+	if(!decoder->private_->retain_buffers)
+		free_buffers_(decoder);
 
 	if(0 != decoder->private_->file) {
 		if(decoder->private_->file != stdin)
@@ -697,6 +715,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_finish(FLAC__StreamDecoder *decoder)
 			md5_failed = true;
 	}
 	decoder->private_->is_seeking = false;
+	decoder->private_->is_range_decoding = false;
 
 	set_defaults_(decoder);
 
@@ -722,6 +741,22 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_ogg_serial_number(FLAC__StreamDecod
 #endif
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_set_ogg_page_indexing(FLAC__StreamDecoder *decoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+#if FLAC__HAS_OGG
+	FLAC__ogg_decoder_aspect_set_page_indexing(&decoder->protected_->ogg_decoder_aspect, value);
+	return true;
+#else
+	(void)value;
+	return false;
+#endif
+}
+
 FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *decoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -732,6 +767,80 @@ FLAC_API FLAC__bool FLAC__stream_decoder_set_md5_checking(FLAC__StreamDecoder *d
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_set_retain_buffers(FLAC__StreamDecoder *decoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->private_->retain_buffers = value;
+	if(!value)
+		free_buffers_(decoder);
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_memory_callbacks(FLAC__StreamDecoder *decoder, const FLAC__MemoryCallbacks *callbacks)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	if(0 != callbacks && (0 == callbacks->malloc || 0 == callbacks->realloc || 0 == callbacks->free))
+		return false;
+	/* anything kept from a previous init came from the old allocator */
+	free_buffers_(decoder);
+	if(0 != callbacks)
+		decoder->private_->memory_callbacks = *callbacks;
+	else
+		memset(&decoder->private_->memory_callbacks, 0, sizeof(decoder->private_->memory_callbacks));
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_memory_limit(FLAC__StreamDecoder *decoder, size_t limit)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->memory_limit = limit;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_read_buffer_size(FLAC__StreamDecoder *decoder, unsigned bytes)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->read_buffer_size = bytes;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_lazy_pictures(FLAC__StreamDecoder *decoder, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->lazy_pictures = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_set_channel_mask(FLAC__StreamDecoder *decoder, FLAC__uint32 mask)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED)
+		return false;
+	decoder->protected_->channel_mask = mask & ((1u << FLAC__MAX_CHANNELS) - 1);
+	return true;
+}
+
 FLAC_API FLAC__bool FLAC__stream_decoder_set_metadata_respond(FLAC__StreamDecoder *decoder, FLAC__MetadataType type)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -867,6 +976,61 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_md5_checking(const FLAC__StreamDeco
 	return decoder->protected_->md5_checking;
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_get_retain_buffers(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	return decoder->private_->retain_buffers;
+}
+
+FLAC_API size_t FLAC__stream_decoder_get_memory_limit(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->memory_limit;
+}
+
+FLAC_API unsigned FLAC__stream_decoder_get_read_buffer_size(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->read_buffer_size;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_get_lazy_pictures(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->lazy_pictures;
+}
+
+FLAC_API void FLAC__stream_decoder_get_memory_usage(const FLAC__StreamDecoder *decoder, FLAC__MemoryUsage *usage)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	FLAC__ASSERT(0 != usage);
+	get_memory_usage_(decoder, usage);
+}
+
+FLAC_API FLAC__uint32 FLAC__stream_decoder_get_channel_mask(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+	return decoder->protected_->channel_mask;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_get_ogg_page_indexing(const FLAC__StreamDecoder *decoder)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->protected_);
+#if FLAC__HAS_OGG
+	return decoder->protected_->ogg_decoder_aspect.keep_index;
+#else
+	return false;
+#endif
+}
+
 FLAC_API FLAC__uint64 FLAC__stream_decoder_get_total_samples(const FLAC__StreamDecoder *decoder)
 {
 	FLAC__ASSERT(0 != decoder);
@@ -921,7 +1085,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_get_decode_position(const FLAC__StreamD
 #endif
 	if(0 == decoder->private_->tell_callback)
 		return false;
-	if(decoder->private_->tell_callback(decoder, position, decoder->private_->client_data) != FLAC__STREAM_DECODER_TELL_STATUS_OK)
+	if(client_tell_(decoder, position) != FLAC__STREAM_DECODER_TELL_STATUS_OK)
 		return false;
 	/* should never happen since all FLAC frames and metadata blocks are byte aligned, but check just in case */
 	if(!FLAC__bitreader_is_consumed_byte_aligned(decoder->private_->input))
@@ -939,6 +1103,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder)
 
 	decoder->private_->samples_decoded = 0;
 	decoder->private_->do_md5_checking = false;
+	decoder->private_->has_last_output = false;
 
 #if FLAC__HAS_OGG
 	if(decoder->private_->is_ogg)
@@ -949,6 +1114,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_flush(FLAC__StreamDecoder *decoder)
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return false;
 	}
+	decoder->private_->read_buffer_head = decoder->private_->read_buffer_tail = 0;
 	decoder->protected_->state = FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC;
 
 	return true;
@@ -979,7 +1145,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_reset(FLAC__StreamDecoder *decoder)
 	if(!decoder->private_->internal_reset_hack) {
 		if(decoder->private_->file == stdin)
 			return false; /* can't rewind stdin, reset fails */
-		if(decoder->private_->seek_callback && decoder->private_->seek_callback(decoder, 0, decoder->private_->client_data) == FLAC__STREAM_DECODER_SEEK_STATUS_ERROR)
+		if(decoder->private_->seek_callback && client_seek_(decoder, 0) == FLAC__STREAM_DECODER_SEEK_STATUS_ERROR)
 			return false; /* seekable and seek fails, reset fails */
 	}
 	else
@@ -988,10 +1154,11 @@ FLAC_API FLAC__bool FLAC__stream_decoder_reset(FLAC__StreamDecoder *decoder)
 	decoder->protected_->state = FLAC__STREAM_DECODER_SEARCH_FOR_METADATA;
 
 	decoder->private_->has_stream_info = false;
-	if(decoder->private_->has_seek_table && 0 != decoder->private_->seek_table.data.seek_table.points) {
-		free(decoder->private_->seek_table.data.seek_table.points);
+	decoder->private_->has_seek_table = false;
+	if(!decoder->private_->retain_buffers && 0 != decoder->private_->seek_table.data.seek_table.points) {
+		FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->seek_table.data.seek_table.points);
 		decoder->private_->seek_table.data.seek_table.points = 0;
-		decoder->private_->has_seek_table = false;
+		decoder->private_->seek_table_capacity = 0;
 	}
 	decoder->private_->do_md5_checking = decoder->protected_->md5_checking;
 	/*
@@ -1006,7 +1173,7 @@ FLAC_API FLAC__bool FLAC__stream_decoder_reset(FLAC__StreamDecoder *decoder)
 	 * FLAC__stream_decoder_finish() to make sure things are always cleaned up
 	 * properly.
 	 */
-	FLAC__MD5Init(&decoder->private_->md5context);
+	FLAC__MD5Init(&decoder->private_->md5context, &decoder->private_->memory_callbacks);
 
 	decoder->private_->first_frame_offset = 0;
 	decoder->private_->unparseable_frame_count = 0;
@@ -1210,6 +1377,219 @@ FLAC_API FLAC__bool FLAC__stream_decoder_seek_absolute(FLAC__StreamDecoder *deco
 	}
 }
 
+FLAC_API FLAC__bool FLAC__stream_decoder_decode_range(FLAC__StreamDecoder *decoder, FLAC__uint64 start, unsigned samples, FLAC__int32 * const buffer[], unsigned stride, unsigned *decoded)
+{
+	const FLAC__FrameHeader *last;
+	FLAC__uint64 total_samples;
+	FLAC__bool ok = true;
+	unsigned channel;
+
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	FLAC__ASSERT(0 != buffer || samples == 0);
+	FLAC__ASSERT(0 != decoded);
+
+	*decoded = 0;
+	last = &decoder->private_->frame.header;
+
+	if(
+		decoder->protected_->state != FLAC__STREAM_DECODER_SEARCH_FOR_METADATA &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_READ_METADATA &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_READ_FRAME &&
+		decoder->protected_->state != FLAC__STREAM_DECODER_END_OF_STREAM
+	)
+		return false;
+
+	/* we need the STREAMINFO for the channel count and the stream length */
+	if(
+		decoder->protected_->state == FLAC__STREAM_DECODER_SEARCH_FOR_METADATA ||
+		decoder->protected_->state == FLAC__STREAM_DECODER_READ_METADATA
+	) {
+		if(!FLAC__stream_decoder_process_until_end_of_metadata(decoder))
+			return false;
+	}
+	if(!decoder->private_->has_stream_info)
+		return false;
+
+	/* the sum can't match once part of the stream is skipped */
+	decoder->private_->do_md5_checking = false;
+
+	total_samples = FLAC__stream_decoder_get_total_samples(decoder);
+	if(total_samples > 0) {
+		if(start >= total_samples)
+			return true;
+		if((FLAC__uint64)samples > total_samples - start)
+			samples = (unsigned)(total_samples - start);
+	}
+	if(samples == 0)
+		return true;
+
+	decoder->private_->range_channels = decoder->private_->stream_info.data.stream_info.channels;
+	for(channel = 0; channel < decoder->private_->range_channels; channel++)
+		decoder->private_->range_buffer[channel] = buffer[channel];
+	decoder->private_->range_stride = stride;
+	decoder->private_->range_next_sample = start;
+	decoder->private_->range_end_sample = start + samples;
+	decoder->private_->is_range_decoding = true;
+
+	if(
+		decoder->private_->has_last_output &&
+		last->number.sample_number <= start &&
+		start < last->number.sample_number + last->blocksize
+	) {
+		/* the start is in the frame we just decoded, e.g. the previous range ended inside it */
+		ok = copy_range_(decoder, last->number.sample_number, last->blocksize, last->channels, (const FLAC__int32 * const *)decoder->private_->output);
+	}
+	else if(!(
+		decoder->private_->has_last_output &&
+		start == last->number.sample_number + last->blocksize
+	)) {
+		/* not contiguous with the input position; the frame the seek lands on is copied by write_audio_frame_to_client_() */
+		ok = FLAC__stream_decoder_seek_absolute(decoder, start);
+	}
+
+	while(ok && decoder->private_->range_next_sample < decoder->private_->range_end_sample) {
+		if(decoder->protected_->state == FLAC__STREAM_DECODER_END_OF_STREAM)
+			break;
+		ok = FLAC__stream_decoder_process_single(decoder);
+	}
+
+	decoder->private_->is_range_decoding = false;
+	*decoded = (unsigned)(decoder->private_->range_next_sample - start);
+	return ok;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_scan_ogg_page_index(FLAC__StreamDecoder *decoder)
+{
+#if FLAC__HAS_OGG
+	FLAC__uint64 saved_pos, length, pos;
+	FLAC__byte header[27 + 255];
+	FLAC__bool ok = true;
+
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+
+	if(decoder->protected_->state == FLAC__STREAM_DECODER_UNINITIALIZED || !decoder->private_->is_ogg || 0 == decoder->private_->seek_callback)
+		return false;
+
+	/*
+	 * We talk to the client directly, around the read buffer; it
+	 * stays valid as long as we put the client back where we found it.
+	 */
+	if(decoder->private_->tell_callback(decoder, &saved_pos, decoder->private_->client_data) != FLAC__STREAM_DECODER_TELL_STATUS_OK)
+		return false;
+	if(decoder->private_->length_callback(decoder, &length, decoder->private_->client_data) != FLAC__STREAM_DECODER_LENGTH_STATUS_OK)
+		return false;
+
+	for(pos = 0; ok && pos + 27 <= length; ) {
+		size_t bytes = 27;
+		if(decoder->private_->seek_callback(decoder, pos, decoder->private_->client_data) != FLAC__STREAM_DECODER_SEEK_STATUS_OK || !scan_read_(decoder, header, &bytes)) {
+			ok = false;
+			break;
+		}
+		if(bytes < 27)
+			break;
+		if(0 == memcmp(header, "OggS", 4) && header[4] == 0) {
+			const unsigned segments = header[26];
+			ogg_page page;
+			FLAC__OggPageIndexEntry entry;
+			unsigned i;
+
+			bytes = segments;
+			if(!scan_read_(decoder, header + 27, &bytes)) {
+				ok = false;
+				break;
+			}
+			if(bytes < segments)
+				break;
+			/* the libogg accessors only look at the header */
+			page.header = header;
+			page.header_len = 27 + segments;
+			page.body = 0;
+			page.body_len = 0;
+			entry.stream_offset = pos;
+			entry.granule_position = ogg_page_granulepos(&page);
+			entry.serial_number = ogg_page_serialno(&page);
+			ok = FLAC__ogg_decoder_aspect_add_index_entries(&decoder->protected_->ogg_decoder_aspect, &entry, 1);
+
+			pos += 27 + segments;
+			for(i = 0; i < segments; i++)
+				pos += header[27 + i];
+		}
+		else {
+			/* no page where we expected one; look for the next capture pattern */
+			size_t i;
+			bytes = sizeof(header) - 27;
+			if(!scan_read_(decoder, header + 27, &bytes)) {
+				ok = false;
+				break;
+			}
+			bytes += 27;
+			for(i = 1; i + 4 <= bytes; i++) {
+				if(0 == memcmp(header + i, "OggS", 4))
+					break;
+			}
+			pos += i;
+		}
+	}
+
+	if(decoder->private_->seek_callback(decoder, saved_pos, decoder->private_->client_data) != FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
+		decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
+		return false;
+	}
+	return ok;
+#else
+	(void)decoder;
+	return false;
+#endif
+}
+
+FLAC_API unsigned FLAC__stream_decoder_get_ogg_page_index(const FLAC__StreamDecoder *decoder, const FLAC__OggPageIndexEntry **entries)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	FLAC__ASSERT(0 != entries);
+
+	*entries = 0;
+#if FLAC__HAS_OGG
+	if(decoder->protected_->state != FLAC__STREAM_DECODER_UNINITIALIZED && decoder->private_->is_ogg)
+		return FLAC__ogg_decoder_aspect_get_index(&decoder->protected_->ogg_decoder_aspect, entries);
+#endif
+	return 0;
+}
+
+FLAC_API FLAC__bool FLAC__stream_decoder_add_ogg_page_index(FLAC__StreamDecoder *decoder, const FLAC__OggPageIndexEntry entries[], unsigned count)
+{
+	FLAC__ASSERT(0 != decoder);
+	FLAC__ASSERT(0 != decoder->private_);
+	FLAC__ASSERT(0 != decoder->protected_);
+	FLAC__ASSERT(0 != entries || count == 0);
+
+#if FLAC__HAS_OGG
+	if(decoder->protected_->state == FLAC__STREAM_DECODER_UNINITIALIZED || !decoder->private_->is_ogg)
+		return false;
+	return FLAC__ogg_decoder_aspect_add_index_entries(&decoder->protected_->ogg_decoder_aspect, entries, count);
+#else
+	(void)entries;
+	(void)count;
+	return false;
+#endif
+}
+
+FLAC_API void FLAC__stream_decoder_interleave_float(const FLAC__int32 * const buffer[], unsigned channels, unsigned samples, unsigned bits_per_sample, float gain, float output[])
+{
+	FLAC__ASSERT(0 != buffer);
+	FLAC__ASSERT(0 != output || samples == 0);
+	FLAC__ASSERT(bits_per_sample >= FLAC__MIN_BITS_PER_SAMPLE && bits_per_sample <= 32);
+
+	/* full scale is 2^(bps-1), folded into the gain so each sample takes one multiply */
+	FLAC__pcm_interleave_float(buffer, channels, samples, (float)(gain / (double)((FLAC__uint64)1 << (bits_per_sample - 1))), output);
+}
+
 /***********************************************************************
  *
  * Protected class methods
@@ -1250,6 +1630,10 @@ void set_defaults_(FLAC__StreamDecoder *decoder)
 	decoder->private_->metadata_filter_ids_count = 0;
 
 	decoder->protected_->md5_checking = false;
+	decoder->protected_->channel_mask = (1u << FLAC__MAX_CHANNELS) - 1;
+	decoder->protected_->memory_limit = 0;
+	decoder->protected_->read_buffer_size = 0;
+	decoder->protected_->lazy_pictures = false;
 
 #if FLAC__HAS_OGG
 	FLAC__ogg_decoder_aspect_set_defaults(&decoder->protected_->ogg_decoder_aspect);
@@ -1285,15 +1669,27 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigne
 	if(size <= decoder->private_->output_capacity && channels <= decoder->private_->output_channels)
 		return true;
 
+	if(decoder->protected_->memory_limit) {
+		size_t released = decoder->private_->output_channels * output_bytes_(decoder->private_->output_capacity);
+		size_t needed = channels * output_bytes_(size);
+		/* the MD5 buffer will follow the new size, at up to 4 bytes per sample */
+		if(decoder->private_->do_md5_checking && (size_t)channels * size * 4 > decoder->private_->md5context.capacity) {
+			released += decoder->private_->md5context.capacity;
+			needed += (size_t)channels * size * 4;
+		}
+		if(!check_memory_limit_(decoder, released, needed))
+			return false;
+	}
+
 	/* simply using realloc() is not practical because the number of channels may change mid-stream */
 
 	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
 		if(0 != decoder->private_->output[i]) {
-			free(decoder->private_->output[i]-4);
+			FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->output[i]-4);
 			decoder->private_->output[i] = 0;
 		}
 		if(0 != decoder->private_->residual_unaligned[i]) {
-			free(decoder->private_->residual_unaligned[i]);
+			FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->residual_unaligned[i]);
 			decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
 		}
 	}
@@ -1305,7 +1701,7 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigne
 		 * (at negative indices) for alignment purposes; we use 4
 		 * to keep the data well-aligned.
 		 */
-		tmp = safe_malloc_muladd2_(sizeof(FLAC__int32), /*times (*/size, /*+*/4/*)*/);
+		tmp = FLAC__memory_malloc_mul_2op(&decoder->private_->memory_callbacks, sizeof(FLAC__int32), /*times (*/(size_t)size + 4/*)*/);
 		if(tmp == 0) {
 			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 			return false;
@@ -1316,7 +1712,7 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigne
 		/* WATCHOUT:
 		 * minimum of quadword alignment for PPC vector optimizations is REQUIRED:
 		 */
-		if(!FLAC__memory_alloc_aligned_int32_array(size, &decoder->private_->residual_unaligned[i], &decoder->private_->residual[i])) {
+		if(!FLAC__memory_alloc_aligned_int32_array(&decoder->private_->memory_callbacks, size, &decoder->private_->residual_unaligned[i], &decoder->private_->residual[i])) {
 			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 			return false;
 		}
@@ -1328,6 +1724,105 @@ FLAC__bool allocate_output_(FLAC__StreamDecoder *decoder, unsigned size, unsigne
 	return true;
 }
 
+/*
+ * Bytes allocate_output_() allocates per channel for 'size' samples
+ */
+static size_t output_bytes_(unsigned size)
+{
+	/* output[] (with the 4 zeroes in front) plus residual[] */
+	return sizeof(FLAC__int32) * ((size_t)size + 4) + sizeof(FLAC__int32) * size;
+}
+
+void get_memory_usage_(const FLAC__StreamDecoder *decoder, FLAC__MemoryUsage *usage)
+{
+	unsigned i;
+
+	memset(usage, 0, sizeof(*usage));
+
+	usage->instance = sizeof(FLAC__StreamDecoder) + sizeof(FLAC__StreamDecoderProtected) + sizeof(FLAC__StreamDecoderPrivate) +
+		(FLAC__STREAM_METADATA_APPLICATION_ID_LEN/8) * decoder->private_->metadata_filter_ids_capacity;
+	usage->io = FLAC__bitreader_get_memory_usage(decoder->private_->input) + decoder->private_->read_buffer_capacity;
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		if(0 != decoder->private_->output[i])
+			usage->samples += output_bytes_(decoder->private_->output_capacity);
+		usage->entropy += FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(&decoder->private_->partitioned_rice_contents[i], 0);
+	}
+	usage->metadata = decoder->private_->seek_table_capacity * sizeof(FLAC__StreamMetadata_SeekPoint) + decoder->private_->metadata_block_bytes;
+	usage->md5 = decoder->private_->md5context.capacity;
+#if FLAC__HAS_OGG
+	usage->ogg = FLAC__ogg_decoder_aspect_get_memory_usage(&decoder->protected_->ogg_decoder_aspect);
+#endif
+
+	usage->total = usage->instance + usage->io + usage->samples + usage->entropy + usage->metadata + usage->md5 + usage->ogg + usage->verify;
+}
+
+/*
+ * Returns false and sets the state if trading 'bytes_released' for
+ * 'bytes_needed' would take the decoder over its memory limit
+ */
+FLAC__bool check_memory_limit_(FLAC__StreamDecoder *decoder, size_t bytes_released, size_t bytes_needed)
+{
+	FLAC__MemoryUsage usage;
+
+	if(0 == decoder->protected_->memory_limit)
+		return true;
+
+	get_memory_usage_(decoder, &usage);
+	FLAC__ASSERT(usage.total >= bytes_released);
+	if(usage.total - bytes_released + bytes_needed > decoder->protected_->memory_limit || bytes_needed > decoder->protected_->memory_limit) {
+		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Frees everything that FLAC__stream_decoder_finish() may have kept for
+ * the next init when retain_buffers is set
+ */
+void free_buffers_(FLAC__StreamDecoder *decoder)
+{
+	unsigned i;
+
+	if(0 != decoder->private_->seek_table.data.seek_table.points) {
+		FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->seek_table.data.seek_table.points);
+		decoder->private_->seek_table.data.seek_table.points = 0;
+	}
+	decoder->private_->seek_table_capacity = 0;
+	FLAC__bitreader_free(decoder->private_->input);
+	if(0 != decoder->private_->read_buffer) {
+		FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->read_buffer);
+		decoder->private_->read_buffer = 0;
+	}
+	decoder->private_->read_buffer_capacity = 0;
+	decoder->private_->read_buffer_head = decoder->private_->read_buffer_tail = 0;
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		/* WATCHOUT:
+		 * FLAC__lpc_restore_signal_asm_ia32_mmx() requires that the
+		 * output arrays have a buffer of up to 3 zeroes in front
+		 * (at negative indices) for alignment purposes; we use 4
+		 * to keep the data well-aligned.
+		 */
+		if(0 != decoder->private_->output[i]) {
+			FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->output[i]-4);
+			decoder->private_->output[i] = 0;
+		}
+		if(0 != decoder->private_->residual_unaligned[i]) {
+			FLAC__memory_free(&decoder->private_->memory_callbacks, decoder->private_->residual_unaligned[i]);
+			decoder->private_->residual_unaligned[i] = decoder->private_->residual[i] = 0;
+		}
+	}
+	decoder->private_->output_capacity = 0;
+	decoder->private_->output_channels = 0;
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++)
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&decoder->private_->memory_callbacks, &decoder->private_->partitioned_rice_contents[i]);
+
+#if FLAC__HAS_OGG
+	/* safe even if the aspect was never initialized */
+	FLAC__ogg_decoder_aspect_finish(&decoder->protected_->ogg_decoder_aspect);
+#endif
+}
+
 FLAC__bool has_id_filtered_(FLAC__StreamDecoder *decoder, FLAC__byte *id)
 {
 	size_t i;
@@ -1467,6 +1962,12 @@ FLAC__bool read_metadata_(FLAC__StreamDecoder *decoder)
 				return false; /* read_callback_ sets the state for us */
 		}
 		else {
+			/* with lazy pictures, the picture data may never be read, so read_metadata_picture_() checks for itself */
+			if(type != FLAC__METADATA_TYPE_PADDING && !(type == FLAC__METADATA_TYPE_PICTURE && decoder->protected_->lazy_pictures)) {
+				if(!check_memory_limit_(decoder, 0, real_length))
+					return false;
+				decoder->private_->metadata_block_bytes = real_length;
+			}
 			switch(type) {
 				case FLAC__METADATA_TYPE_PADDING:
 					/* skip the padding bytes */
@@ -1476,7 +1977,7 @@ FLAC__bool read_metadata_(FLAC__StreamDecoder *decoder)
 				case FLAC__METADATA_TYPE_APPLICATION:
 					/* remember, we read the ID already */
 					if(real_length > 0) {
-						if(0 == (block.data.application.data = malloc(real_length))) {
+						if(0 == (block.data.application.data = FLAC__memory_malloc(&decoder->private_->memory_callbacks, real_length))) {
 							decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 							return false;
 						}
@@ -1504,7 +2005,7 @@ FLAC__bool read_metadata_(FLAC__StreamDecoder *decoder)
 					break;
 				default:
 					if(real_length > 0) {
-						if(0 == (block.data.unknown.data = malloc(real_length))) {
+						if(0 == (block.data.unknown.data = FLAC__memory_malloc(&decoder->private_->memory_callbacks, real_length))) {
 							decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 							return false;
 						}
@@ -1524,42 +2025,43 @@ FLAC__bool read_metadata_(FLAC__StreamDecoder *decoder)
 					break;
 				case FLAC__METADATA_TYPE_APPLICATION:
 					if(0 != block.data.application.data)
-						free(block.data.application.data);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.application.data);
 					break;
 				case FLAC__METADATA_TYPE_VORBIS_COMMENT:
 					if(0 != block.data.vorbis_comment.vendor_string.entry)
-						free(block.data.vorbis_comment.vendor_string.entry);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.vorbis_comment.vendor_string.entry);
 					if(block.data.vorbis_comment.num_comments > 0)
 						for(i = 0; i < block.data.vorbis_comment.num_comments; i++)
 							if(0 != block.data.vorbis_comment.comments[i].entry)
-								free(block.data.vorbis_comment.comments[i].entry);
+								FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.vorbis_comment.comments[i].entry);
 					if(0 != block.data.vorbis_comment.comments)
-						free(block.data.vorbis_comment.comments);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.vorbis_comment.comments);
 					break;
 				case FLAC__METADATA_TYPE_CUESHEET:
 					if(block.data.cue_sheet.num_tracks > 0)
 						for(i = 0; i < block.data.cue_sheet.num_tracks; i++)
 							if(0 != block.data.cue_sheet.tracks[i].indices)
-								free(block.data.cue_sheet.tracks[i].indices);
+								FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.cue_sheet.tracks[i].indices);
 					if(0 != block.data.cue_sheet.tracks)
-						free(block.data.cue_sheet.tracks);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.cue_sheet.tracks);
 					break;
 				case FLAC__METADATA_TYPE_PICTURE:
 					if(0 != block.data.picture.mime_type)
-						free(block.data.picture.mime_type);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.picture.mime_type);
 					if(0 != block.data.picture.description)
-						free(block.data.picture.description);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.picture.description);
 					if(0 != block.data.picture.data)
-						free(block.data.picture.data);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.picture.data);
 					break;
 				case FLAC__METADATA_TYPE_STREAMINFO:
 				case FLAC__METADATA_TYPE_SEEKTABLE:
 					FLAC__ASSERT(0);
 				default:
 					if(0 != block.data.unknown.data)
-						free(block.data.unknown.data);
+						FLAC__memory_free(&decoder->private_->memory_callbacks, block.data.unknown.data);
 					break;
 			}
+			decoder->private_->metadata_block_bytes = 0;
 		}
 	}
 
@@ -1658,9 +2160,15 @@ FLAC__bool read_metadata_seektable_(FLAC__StreamDecoder *decoder, FLAC__bool is_
 	decoder->private_->seek_table.data.seek_table.num_points = length / FLAC__STREAM_METADATA_SEEKPOINT_LENGTH;
 
 	/* use realloc since we may pass through here several times (e.g. after seeking) */
-	if(0 == (decoder->private_->seek_table.data.seek_table.points = safe_realloc_mul_2op_(decoder->private_->seek_table.data.seek_table.points, decoder->private_->seek_table.data.seek_table.num_points, /*times*/sizeof(FLAC__StreamMetadata_SeekPoint)))) {
-		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
-		return false;
+	if(decoder->private_->seek_table.data.seek_table.num_points > decoder->private_->seek_table_capacity) {
+		if(!check_memory_limit_(decoder, decoder->private_->seek_table_capacity * sizeof(FLAC__StreamMetadata_SeekPoint), decoder->private_->seek_table.data.seek_table.num_points * sizeof(FLAC__StreamMetadata_SeekPoint)))
+			return false;
+		if(0 == (decoder->private_->seek_table.data.seek_table.points = FLAC__memory_realloc_mul_2op(&decoder->private_->memory_callbacks, decoder->private_->seek_table.data.seek_table.points, decoder->private_->seek_table.data.seek_table.num_points, /*times*/sizeof(FLAC__StreamMetadata_SeekPoint)))) {
+			decoder->private_->seek_table_capacity = 0;
+			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+			return false;
+		}
+		decoder->private_->seek_table_capacity = decoder->private_->seek_table.data.seek_table.num_points;
 	}
 	for(i = 0; i < decoder->private_->seek_table.data.seek_table.num_points; i++) {
 		if(!FLAC__bitreader_read_raw_uint64(decoder->private_->input, &xx, FLAC__STREAM_METADATA_SEEKPOINT_SAMPLE_NUMBER_LEN))
@@ -1697,7 +2205,7 @@ FLAC__bool read_metadata_vorbiscomment_(FLAC__StreamDecoder *decoder, FLAC__Stre
 	if(!FLAC__bitreader_read_uint32_little_endian(decoder->private_->input, &obj->vendor_string.length))
 		return false; /* read_callback_ sets the state for us */
 	if(obj->vendor_string.length > 0) {
-		if(0 == (obj->vendor_string.entry = safe_malloc_add_2op_(obj->vendor_string.length, /*+*/1))) {
+		if(0 == (obj->vendor_string.entry = FLAC__memory_malloc_add_2op(&decoder->private_->memory_callbacks, obj->vendor_string.length, /*+*/1))) {
 			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 			return false;
 		}
@@ -1715,7 +2223,7 @@ FLAC__bool read_metadata_vorbiscomment_(FLAC__StreamDecoder *decoder, FLAC__Stre
 
 	/* read comments */
 	if(obj->num_comments > 0) {
-		if(0 == (obj->comments = safe_malloc_mul_2op_p(obj->num_comments, /*times*/sizeof(FLAC__StreamMetadata_VorbisComment_Entry)))) {
+		if(0 == (obj->comments = FLAC__memory_malloc_mul_2op(&decoder->private_->memory_callbacks, obj->num_comments, /*times*/sizeof(FLAC__StreamMetadata_VorbisComment_Entry)))) {
 			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 			return false;
 		}
@@ -1724,7 +2232,7 @@ FLAC__bool read_metadata_vorbiscomment_(FLAC__StreamDecoder *decoder, FLAC__Stre
 			if(!FLAC__bitreader_read_uint32_little_endian(decoder->private_->input, &obj->comments[i].length))
 				return false; /* read_callback_ sets the state for us */
 			if(obj->comments[i].length > 0) {
-				if(0 == (obj->comments[i].entry = safe_malloc_add_2op_(obj->comments[i].length, /*+*/1))) {
+				if(0 == (obj->comments[i].entry = FLAC__memory_malloc_add_2op(&decoder->private_->memory_callbacks, obj->comments[i].length, /*+*/1))) {
 					decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 					return false;
 				}
@@ -1770,7 +2278,7 @@ FLAC__bool read_metadata_cuesheet_(FLAC__StreamDecoder *decoder, FLAC__StreamMet
 	obj->num_tracks = x;
 
 	if(obj->num_tracks > 0) {
-		if(0 == (obj->tracks = safe_calloc_(obj->num_tracks, sizeof(FLAC__StreamMetadata_CueSheet_Track)))) {
+		if(0 == (obj->tracks = FLAC__memory_calloc(&decoder->private_->memory_callbacks, obj->num_tracks, sizeof(FLAC__StreamMetadata_CueSheet_Track)))) {
 			decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 			return false;
 		}
@@ -1803,7 +2311,7 @@ FLAC__bool read_metadata_cuesheet_(FLAC__StreamDecoder *decoder, FLAC__StreamMet
 			track->num_indices = (FLAC__byte)x;
 
 			if(track->num_indices > 0) {
-				if(0 == (track->indices = safe_calloc_(track->num_indices, sizeof(FLAC__StreamMetadata_CueSheet_Index)))) {
+				if(0 == (track->indices = FLAC__memory_calloc(&decoder->private_->memory_callbacks, track->num_indices, sizeof(FLAC__StreamMetadata_CueSheet_Index)))) {
 					decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 					return false;
 				}
@@ -1840,7 +2348,7 @@ FLAC__bool read_metadata_picture_(FLAC__StreamDecoder *decoder, FLAC__StreamMeta
 	/* read MIME type */
 	if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, FLAC__STREAM_METADATA_PICTURE_MIME_TYPE_LENGTH_LEN))
 		return false; /* read_callback_ sets the state for us */
-	if(0 == (obj->mime_type = safe_malloc_add_2op_(x, /*+*/1))) {
+	if(0 == (obj->mime_type = FLAC__memory_malloc_add_2op(&decoder->private_->memory_callbacks, x, /*+*/1))) {
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return false;
 	}
@@ -1853,7 +2361,7 @@ FLAC__bool read_metadata_picture_(FLAC__StreamDecoder *decoder, FLAC__StreamMeta
 	/* read description */
 	if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &x, FLAC__STREAM_METADATA_PICTURE_DESCRIPTION_LENGTH_LEN))
 		return false; /* read_callback_ sets the state for us */
-	if(0 == (obj->description = safe_malloc_add_2op_(x, /*+*/1))) {
+	if(0 == (obj->description = FLAC__memory_malloc_add_2op(&decoder->private_->memory_callbacks, x, /*+*/1))) {
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return false;
 	}
@@ -1882,7 +2390,15 @@ FLAC__bool read_metadata_picture_(FLAC__StreamDecoder *decoder, FLAC__StreamMeta
 	/* read data */
 	if(!FLAC__bitreader_read_raw_uint32(decoder->private_->input, &(obj->data_length), FLAC__STREAM_METADATA_PICTURE_DATA_LENGTH_LEN))
 		return false; /* read_callback_ sets the state for us */
-	if(0 == (obj->data = safe_malloc_(obj->data_length))) {
+	obj->data_offset = 0;
+	if(decoder->protected_->lazy_pictures) {
+		if(obj->data_length > 0 && FLAC__stream_decoder_get_decode_position(decoder, &obj->data_offset))
+			return skip_picture_data_(decoder, obj);
+		if(!check_memory_limit_(decoder, 0, obj->data_length))
+			return false;
+		decoder->private_->metadata_block_bytes = obj->data_length;
+	}
+	if(0 == (obj->data = FLAC__memory_malloc(&decoder->private_->memory_callbacks, obj->data_length))) {
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return false;
 	}
@@ -1894,6 +2410,35 @@ FLAC__bool read_metadata_picture_(FLAC__StreamDecoder *decoder, FLAC__StreamMeta
 	return true;
 }
 
+/*
+ * Gets past the data of a lazy picture, seeking if what the bitreader
+ * already holds does not reach to the end of it
+ */
+FLAC__bool skip_picture_data_(FLAC__StreamDecoder *decoder, FLAC__StreamMetadata_Picture *obj)
+{
+	obj->data = 0;
+
+	if(0 != decoder->private_->seek_callback && obj->data_length > FLAC__bitreader_get_input_bits_unconsumed(decoder->private_->input) / 8) {
+		switch(client_seek_(decoder, obj->data_offset + obj->data_length)) {
+			case FLAC__STREAM_DECODER_SEEK_STATUS_OK:
+				if(!FLAC__bitreader_clear(decoder->private_->input)) {
+					decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
+					return false;
+				}
+				return true;
+			case FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED:
+				break;
+			default:
+				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
+				return false;
+		}
+	}
+
+	if(!FLAC__bitreader_skip_byte_block_aligned_no_crc(decoder->private_->input, obj->data_length))
+		return false; /* read_callback_ sets the state for us */
+	return true;
+}
+
 FLAC__bool skip_id3v2_tag_(FLAC__StreamDecoder *decoder)
 {
 	FLAC__uint32 x;
@@ -1978,8 +2523,11 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	FLAC__int32 mid, side;
 	unsigned frame_crc; /* the one we calculate from the input stream */
 	FLAC__uint32 x;
+	FLAC__uint32 decode_mask; /* the subframes we have to restore to produce the requested channels */
 
 	*got_a_frame = false;
+	/* output[] is about to be overwritten */
+	decoder->private_->has_last_output = false;
 
 	/* init the CRC */
 	frame_crc = 0;
@@ -1993,6 +2541,29 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 		return true;
 	if(!allocate_output_(decoder, decoder->private_->frame.header.blocksize, decoder->private_->frame.header.channels))
 		return false;
+	/*
+	 * figure out which subframes are needed for the requested channels;
+	 * a channel coded against the side channel needs both subframes
+	 */
+	decode_mask = do_full_decode? decoder->protected_->channel_mask : 0;
+	switch(decoder->private_->frame.header.channel_assignment) {
+		case FLAC__CHANNEL_ASSIGNMENT_INDEPENDENT:
+			break;
+		case FLAC__CHANNEL_ASSIGNMENT_LEFT_SIDE:
+			if(decode_mask & 2)
+				decode_mask |= 3;
+			break;
+		case FLAC__CHANNEL_ASSIGNMENT_RIGHT_SIDE:
+			if(decode_mask & 1)
+				decode_mask |= 3;
+			break;
+		case FLAC__CHANNEL_ASSIGNMENT_MID_SIDE:
+			if(decode_mask & 3)
+				decode_mask |= 3;
+			break;
+		default:
+			FLAC__ASSERT(0);
+	}
 	for(channel = 0; channel < decoder->private_->frame.header.channels; channel++) {
 		/*
 		 * first figure the correct bits-per-sample of the subframe
@@ -2023,7 +2594,7 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 		/*
 		 * now read it
 		 */
-		if(!read_subframe_(decoder, channel, bps, do_full_decode))
+		if(!read_subframe_(decoder, channel, bps, /*do_full_decode=*/(decode_mask >> channel) & 1))
 			return false;
 		if(decoder->protected_->state == FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC) /* means bad sync or got corruption */
 			return true;
@@ -2048,13 +2619,17 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 					break;
 				case FLAC__CHANNEL_ASSIGNMENT_LEFT_SIDE:
 					FLAC__ASSERT(decoder->private_->frame.header.channels == 2);
-					for(i = 0; i < decoder->private_->frame.header.blocksize; i++)
-						decoder->private_->output[1][i] = decoder->private_->output[0][i] - decoder->private_->output[1][i];
+					if(decoder->protected_->channel_mask & 2) {
+						for(i = 0; i < decoder->private_->frame.header.blocksize; i++)
+							decoder->private_->output[1][i] = decoder->private_->output[0][i] - decoder->private_->output[1][i];
+					}
 					break;
 				case FLAC__CHANNEL_ASSIGNMENT_RIGHT_SIDE:
 					FLAC__ASSERT(decoder->private_->frame.header.channels == 2);
-					for(i = 0; i < decoder->private_->frame.header.blocksize; i++)
-						decoder->private_->output[0][i] += decoder->private_->output[1][i];
+					if(decoder->protected_->channel_mask & 1) {
+						for(i = 0; i < decoder->private_->frame.header.blocksize; i++)
+							decoder->private_->output[0][i] += decoder->private_->output[1][i];
+					}
 					break;
 				case FLAC__CHANNEL_ASSIGNMENT_MID_SIDE:
 					FLAC__ASSERT(decoder->private_->frame.header.channels == 2);
@@ -2078,6 +2653,11 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 					FLAC__ASSERT(0);
 					break;
 			}
+			/* silence the channels that were not asked for, including any undecorrelation leftovers */
+			for(channel = 0; channel < decoder->private_->frame.header.channels; channel++) {
+				if(!(decoder->protected_->channel_mask & (1u << channel)))
+					memset(decoder->private_->output[channel], 0, sizeof(FLAC__int32) * decoder->private_->frame.header.blocksize);
+			}
 		}
 	}
 	else {
@@ -2110,6 +2690,7 @@ FLAC__bool read_frame_(FLAC__StreamDecoder *decoder, FLAC__bool *got_a_frame, FL
 	if(do_full_decode) {
 		if(write_audio_frame_to_client_(decoder, &decoder->private_->frame, (const FLAC__int32 * const *)decoder->private_->output) != FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE)
 			return false;
+		decoder->private_->has_last_output = true;
 	}
 
 	decoder->protected_->state = FLAC__STREAM_DECODER_SEARCH_FOR_FRAME_SYNC;
@@ -2559,7 +3140,7 @@ FLAC__bool read_subframe_fixed_(FLAC__StreamDecoder *decoder, unsigned channel,
 	switch(subframe->entropy_coding_method.type) {
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE:
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2:
-			if(!read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], decoder->private_->residual[channel], /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2))
+			if(!read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], do_full_decode? decoder->private_->residual[channel] : 0, /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2))
 				return false;
 			break;
 		default:
@@ -2638,7 +3219,7 @@ FLAC__bool read_subframe_lpc_(FLAC__StreamDecoder *decoder, unsigned channel, un
 	switch(subframe->entropy_coding_method.type) {
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE:
 		case FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2:
-			if(!read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], decoder->private_->residual[channel], /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2))
+			if(!read_residual_partitioned_rice_(decoder, order, subframe->entropy_coding_method.data.partitioned_rice.order, &decoder->private_->partitioned_rice_contents[channel], do_full_decode? decoder->private_->residual[channel] : 0, /*is_extended=*/subframe->entropy_coding_method.type == FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2))
 				return false;
 			break;
 		default:
@@ -2680,7 +3261,8 @@ FLAC__bool read_subframe_verbatim_(FLAC__StreamDecoder *decoder, unsigned channe
 	for(i = 0; i < decoder->private_->frame.header.blocksize; i++) {
 		if(!FLAC__bitreader_read_raw_int32(decoder->private_->input, &x, bps))
 			return false; /* read_callback_ sets the state for us */
-		residual[i] = x;
+		if(do_full_decode)
+			residual[i] = x;
 	}
 
 	/* decode the subframe */
@@ -2716,7 +3298,12 @@ FLAC__bool read_residual_partitioned_rice_(FLAC__StreamDecoder *decoder, unsigne
 		}
 	}
 
-	if(!FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(partitioned_rice_contents, flac_max(6u, partition_order))) {
+	if(
+		partitioned_rice_contents->capacity_by_order < flac_max(6u, partition_order) &&
+		!check_memory_limit_(decoder, FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(partitioned_rice_contents, 0), FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(partitioned_rice_contents, flac_max(6u, partition_order)))
+	)
+		return false;
+	if(!FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(&decoder->private_->memory_callbacks, partitioned_rice_contents, flac_max(6u, partition_order))) {
 		decoder->protected_->state = FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR;
 		return false;
 	}
@@ -2729,7 +3316,11 @@ FLAC__bool read_residual_partitioned_rice_(FLAC__StreamDecoder *decoder, unsigne
 		if(rice_parameter < pesc) {
 			partitioned_rice_contents->raw_bits[partition] = 0;
 			u = (partition_order == 0 || partition > 0)? partition_samples : partition_samples - predictor_order;
-			if(!decoder->private_->local_bitreader_read_rice_signed_block(decoder->private_->input, residual + sample, u, rice_parameter))
+			if(0 == residual) {
+				if(!FLAC__bitreader_skip_rice_signed_block(decoder->private_->input, u, rice_parameter))
+					return false; /* read_callback_ sets the state for us */
+			}
+			else if(!decoder->private_->local_bitreader_read_rice_signed_block(decoder->private_->input, residual + sample, u, rice_parameter))
 				return false; /* read_callback_ sets the state for us */
 			sample += u;
 		}
@@ -2740,7 +3331,8 @@ FLAC__bool read_residual_partitioned_rice_(FLAC__StreamDecoder *decoder, unsigne
 			for(u = (partition_order == 0 || partition > 0)? 0 : predictor_order; u < partition_samples; u++, sample++) {
 				if(!FLAC__bitreader_read_raw_int32(decoder->private_->input, &i, rice_parameter))
 					return false; /* read_callback_ sets the state for us */
-				residual[sample] = i;
+				if(0 != residual)
+					residual[sample] = i;
 			}
 		}
 	}
@@ -2771,7 +3363,7 @@ FLAC__bool read_callback_(FLAC__byte buffer[], size_t *bytes, void *client_data)
 		/* see [1] HACK NOTE below for why we don't call the eof_callback when decoding Ogg FLAC */
 		!decoder->private_->is_ogg &&
 #endif
-		decoder->private_->eof_callback && decoder->private_->eof_callback(decoder, decoder->private_->client_data)
+		client_eof_(decoder)
 	) {
 		*bytes = 0;
 		decoder->protected_->state = FLAC__STREAM_DECODER_END_OF_STREAM;
@@ -2798,7 +3390,7 @@ FLAC__bool read_callback_(FLAC__byte buffer[], size_t *bytes, void *client_data)
 				decoder->private_->is_ogg?
 				read_callback_ogg_aspect_(decoder, buffer, bytes) :
 #endif
-				decoder->private_->read_callback(decoder, buffer, bytes, decoder->private_->client_data)
+				client_read_(decoder, buffer, bytes)
 			;
 			if(status == FLAC__STREAM_DECODER_READ_STATUS_ABORT) {
 				decoder->protected_->state = FLAC__STREAM_DECODER_ABORTED;
@@ -2812,7 +3404,7 @@ FLAC__bool read_callback_(FLAC__byte buffer[], size_t *bytes, void *client_data)
 						/* see [1] HACK NOTE below for why we don't call the eof_callback when decoding Ogg FLAC */
 						!decoder->private_->is_ogg &&
 #endif
-						decoder->private_->eof_callback && decoder->private_->eof_callback(decoder, decoder->private_->client_data)
+						client_eof_(decoder)
 					)
 				) {
 					decoder->protected_->state = FLAC__STREAM_DECODER_END_OF_STREAM;
@@ -2842,9 +3434,78 @@ FLAC__bool read_callback_(FLAC__byte buffer[], size_t *bytes, void *client_data)
 	 */
 }
 
+/*
+ * The client_*_() functions are how the rest of the decoder talks to the
+ * client's I/O callbacks; they put the read buffer, if any, between
+ * the two
+ */
+FLAC__StreamDecoderReadStatus client_read_(FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes)
+{
+	size_t n;
+
+	if(decoder->private_->read_buffer_head == decoder->private_->read_buffer_tail) {
+		FLAC__StreamDecoderReadStatus status;
+
+		/* nothing buffered; big reads (and all reads when the read buffer is off) go straight through */
+		if(*bytes >= decoder->protected_->read_buffer_size)
+			return decoder->private_->read_callback(decoder, buffer, bytes, decoder->private_->client_data);
+
+		n = decoder->protected_->read_buffer_size;
+		FLAC__ASSERT(n <= decoder->private_->read_buffer_capacity);
+		status = decoder->private_->read_callback(decoder, decoder->private_->read_buffer, &n, decoder->private_->client_data);
+		if(status == FLAC__STREAM_DECODER_READ_STATUS_ABORT || n == 0) {
+			*bytes = 0;
+			return status;
+		}
+		/* if the client said END_OF_STREAM along with some data, the next refill will hear it again */
+		decoder->private_->read_buffer_head = 0;
+		decoder->private_->read_buffer_tail = n;
+	}
+
+	n = flac_min(*bytes, decoder->private_->read_buffer_tail - decoder->private_->read_buffer_head);
+	memcpy(buffer, decoder->private_->read_buffer + decoder->private_->read_buffer_head, n);
+	decoder->private_->read_buffer_head += n;
+	*bytes = n;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderSeekStatus client_seek_(FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset)
+{
+	const FLAC__StreamDecoderSeekStatus status = decoder->private_->seek_callback(decoder, absolute_byte_offset, decoder->private_->client_data);
+	/* an unsupported seek leaves the client where it was, so what is buffered still comes next */
+	if(status != FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED)
+		decoder->private_->read_buffer_head = decoder->private_->read_buffer_tail = 0;
+	return status;
+}
+
+FLAC__StreamDecoderTellStatus client_tell_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset)
+{
+	const FLAC__StreamDecoderTellStatus status = decoder->private_->tell_callback(decoder, absolute_byte_offset, decoder->private_->client_data);
+	if(status == FLAC__STREAM_DECODER_TELL_STATUS_OK) {
+		/* the client is ahead of us by whatever is still in the read buffer */
+		FLAC__ASSERT(*absolute_byte_offset >= decoder->private_->read_buffer_tail - decoder->private_->read_buffer_head);
+		*absolute_byte_offset -= decoder->private_->read_buffer_tail - decoder->private_->read_buffer_head;
+	}
+	return status;
+}
+
+FLAC__bool client_eof_(FLAC__StreamDecoder *decoder)
+{
+	if(decoder->private_->read_buffer_head < decoder->private_->read_buffer_tail)
+		return false;
+	return decoder->private_->eof_callback && decoder->private_->eof_callback(decoder, decoder->private_->client_data);
+}
+
 #if FLAC__HAS_OGG
 FLAC__StreamDecoderReadStatus read_callback_ogg_aspect_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes)
 {
+	/* for the page index, tell the aspect where its reading starts; it follows along from there until the next flush */
+	if(FLAC__ogg_decoder_aspect_need_stream_offset(&decoder->protected_->ogg_decoder_aspect) && 0 != decoder->private_->tell_callback) {
+		FLAC__uint64 offset;
+		if(client_tell_(decoder, &offset) == FLAC__STREAM_DECODER_TELL_STATUS_OK)
+			FLAC__ogg_decoder_aspect_set_stream_offset(&decoder->protected_->ogg_decoder_aspect, offset);
+	}
+
 	switch(FLAC__ogg_decoder_aspect_read_callback_wrapper(&decoder->protected_->ogg_decoder_aspect, buffer, bytes, read_callback_proxy_, decoder, decoder->private_->client_data)) {
 		case FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK:
 			return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
@@ -2873,7 +3534,8 @@ FLAC__OggDecoderAspectReadStatus read_callback_proxy_(const void *void_decoder,
 {
 	FLAC__StreamDecoder *decoder = (FLAC__StreamDecoder*)void_decoder;
 
-	switch(decoder->private_->read_callback(decoder, buffer, bytes, client_data)) {
+	(void)client_data;
+	switch(client_read_(decoder, buffer, bytes)) {
 		case FLAC__STREAM_DECODER_READ_STATUS_CONTINUE:
 			return FLAC__OGG_DECODER_ASPECT_READ_STATUS_OK;
 		case FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM:
@@ -2886,6 +3548,27 @@ FLAC__OggDecoderAspectReadStatus read_callback_proxy_(const void *void_decoder,
 			return FLAC__OGG_DECODER_ASPECT_READ_STATUS_ABORT;
 	}
 }
+
+/*
+ * Reads straight from the client until 'bytes' are read or the stream
+ * ends; '*bytes' is set to what was read.  Returns false on abort.
+ */
+FLAC__bool scan_read_(FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes)
+{
+	size_t got = 0;
+
+	while(got < *bytes) {
+		size_t n = *bytes - got;
+		const FLAC__StreamDecoderReadStatus status = decoder->private_->read_callback(decoder, buffer + got, &n, decoder->private_->client_data);
+		if(status == FLAC__STREAM_DECODER_READ_STATUS_ABORT)
+			return false;
+		got += n;
+		if(status == FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM || n == 0)
+			break;
+	}
+	*bytes = got;
+	return true;
+}
 #endif
 
 FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[])
@@ -2905,6 +3588,11 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 			unsigned delta = (unsigned)(target_sample - this_frame_sample);
 			/* kick out of seek mode */
 			decoder->private_->is_seeking = false;
+			if(decoder->private_->is_range_decoding) {
+				if(!copy_range_(decoder, this_frame_sample, frame->header.blocksize, frame->header.channels, buffer))
+					return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+				return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+			}
 			/* shift out the samples before target_sample */
 			if(delta > 0) {
 				unsigned channel;
@@ -2925,6 +3613,11 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 			return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 		}
 	}
+	else if(decoder->private_->is_range_decoding) {
+		if(!copy_range_(decoder, frame->header.number.sample_number, frame->header.blocksize, frame->header.channels, buffer))
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
 	else {
 		/*
 		 * If we never got STREAMINFO, turn off MD5 checking to save
@@ -2932,6 +3625,12 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 		 */
 		if(!decoder->private_->has_stream_info)
 			decoder->private_->do_md5_checking = false;
+		/*
+		 * Likewise if some channels are not being restored, the sum
+		 * can't match
+		 */
+		if((decoder->protected_->channel_mask & ((1u << frame->header.channels) - 1)) != ((1u << frame->header.channels) - 1))
+			decoder->private_->do_md5_checking = false;
 		if(decoder->private_->do_md5_checking) {
 			if(!FLAC__MD5Accumulate(&decoder->private_->md5context, buffer, frame->header.channels, frame->header.blocksize, (frame->header.bits_per_sample+7) / 8))
 				return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
@@ -2940,6 +3639,55 @@ FLAC__StreamDecoderWriteStatus write_audio_frame_to_client_(FLAC__StreamDecoder
 	}
 }
 
+FLAC__bool copy_range_(FLAC__StreamDecoder *decoder, FLAC__uint64 first_sample, unsigned blocksize, unsigned channels, const FLAC__int32 * const buffer[])
+{
+	const unsigned stride = decoder->private_->range_stride;
+	FLAC__uint64 next_sample = decoder->private_->range_next_sample;
+	unsigned channel, offset, samples, i;
+
+	if(channels != decoder->private_->range_channels)
+		return false;
+	if(first_sample + blocksize <= next_sample || next_sample >= decoder->private_->range_end_sample)
+		return true;
+
+	/* a frame was lost (e.g. the sync was lost over a damaged stretch); keep the output aligned with silence like for a bad CRC */
+	if(first_sample > next_sample) {
+		samples = (unsigned)((first_sample < decoder->private_->range_end_sample? first_sample : decoder->private_->range_end_sample) - next_sample);
+		for(channel = 0; channel < channels; channel++) {
+			FLAC__int32 *out = decoder->private_->range_buffer[channel];
+			for(i = 0; i < samples; i++, out += stride)
+				*out = 0;
+			decoder->private_->range_buffer[channel] = out;
+		}
+		next_sample += samples;
+		if(next_sample >= decoder->private_->range_end_sample) {
+			decoder->private_->range_next_sample = next_sample;
+			return true;
+		}
+	}
+
+	offset = (unsigned)(next_sample - first_sample);
+	samples = blocksize - offset;
+	if((FLAC__uint64)samples > decoder->private_->range_end_sample - next_sample)
+		samples = (unsigned)(decoder->private_->range_end_sample - next_sample);
+
+	for(channel = 0; channel < channels; channel++) {
+		const FLAC__int32 *in = buffer[channel] + offset;
+		FLAC__int32 *out = decoder->private_->range_buffer[channel];
+		if(stride == 1) {
+			memcpy(out, in, sizeof(FLAC__int32) * samples);
+			out += samples;
+		}
+		else {
+			for(i = 0; i < samples; i++, out += stride)
+				*out = in[i];
+		}
+		decoder->private_->range_buffer[channel] = out;
+	}
+	decoder->private_->range_next_sample = next_sample + samples;
+	return true;
+}
+
 void send_error_to_client_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status)
 {
 	if(!decoder->private_->is_seeking)
@@ -3088,7 +3836,7 @@ FLAC__bool seek_to_absolute_sample_(FLAC__StreamDecoder *decoder, FLAC__uint64 s
 			pos = (FLAC__int64)upper_bound - 1;
 		if(pos < (FLAC__int64)lower_bound)
 			pos = (FLAC__int64)lower_bound;
-		if(decoder->private_->seek_callback(decoder, (FLAC__uint64)pos, decoder->private_->client_data) != FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
+		if(client_seek_(decoder, (FLAC__uint64)pos) != FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
 			decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
 			return false;
 		}
@@ -3169,7 +3917,8 @@ FLAC__bool seek_to_absolute_sample_ogg_(FLAC__StreamDecoder *decoder, FLAC__uint
 	FLAC__uint64 left_sample = 0, right_sample = FLAC__stream_decoder_get_total_samples(decoder);
 	FLAC__uint64 this_frame_sample = (FLAC__uint64)0 - 1;
 	FLAC__uint64 pos = 0; /* only initialized to avoid compiler warning */
-	FLAC__bool did_a_seek;
+	FLAC__uint64 index_pos = 0;
+	FLAC__bool did_a_seek, use_index;
 	unsigned iteration = 0;
 
 	/* In the first iterations, we will calculate the target byte position
@@ -3192,10 +3941,18 @@ FLAC__bool seek_to_absolute_sample_ogg_(FLAC__StreamDecoder *decoder, FLAC__uint
 		BINARY_SEARCH_AFTER_ITERATION = 0;
 	}
 
+	/* If the page index knows the page to start at, we try it first; if
+	 * it turns out wrong, the search below carries on from there.
+	 */
+	use_index = FLAC__ogg_decoder_aspect_find_in_index(&decoder->protected_->ogg_decoder_aspect, target_sample, &index_pos, &right_pos, &right_sample) && index_pos > left_pos && index_pos < right_pos;
+
 	decoder->private_->target_sample = target_sample;
 	for( ; ; iteration++) {
 		if (iteration == 0 || this_frame_sample > target_sample || target_sample - this_frame_sample > LINEAR_SEARCH_WITHIN_SAMPLES) {
-			if (iteration >= BINARY_SEARCH_AFTER_ITERATION) {
+			if (iteration == 0 && use_index) {
+				pos = index_pos;
+			}
+			else if (iteration >= BINARY_SEARCH_AFTER_ITERATION) {
 				pos = (right_pos + left_pos) / 2;
 			}
 			else {
@@ -3221,7 +3978,7 @@ FLAC__bool seek_to_absolute_sample_ogg_(FLAC__StreamDecoder *decoder, FLAC__uint
 			}
 
 			/* physical seek */
-			if(decoder->private_->seek_callback((FLAC__StreamDecoder*)decoder, (FLAC__uint64)pos, decoder->private_->client_data) != FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
+			if(client_seek_(decoder, (FLAC__uint64)pos) != FLAC__STREAM_DECODER_SEEK_STATUS_OK) {
 				decoder->protected_->state = FLAC__STREAM_DECODER_SEEK_ERROR;
 				return false;
 			}
@@ -127,6 +127,8 @@ static struct CompressionLevels {
 static void set_defaults_(FLAC__StreamEncoder *encoder);
 static void free_(FLAC__StreamEncoder *encoder);
 static FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, unsigned new_blocksize);
+static size_t signal_bytes_(const FLAC__StreamEncoder *encoder, unsigned blocksize);
+static void get_memory_usage_(const FLAC__StreamEncoder *encoder, FLAC__MemoryUsage *usage);
 static FLAC__bool write_bitbuffer_(FLAC__StreamEncoder *encoder, unsigned samples, FLAC__bool is_last_block);
 static FLAC__StreamEncoderWriteStatus write_frame_(FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, FLAC__bool is_last_block);
 static void update_metadata_(const FLAC__StreamEncoder *encoder);
@@ -253,6 +255,7 @@ static void precompute_partition_info_escapes_(
 );
 
 static FLAC__bool set_partitioned_rice_(
+	const FLAC__MemoryCallbacks *mem,
 #ifdef EXACT_RICE_BITS_CALCULATION
 	const FLAC__int32 residual[],
 #endif
@@ -417,6 +420,7 @@ typedef struct FLAC__StreamEncoderPrivate {
 		} error_stats;
 	} verify;
 	FLAC__bool is_being_deleted; /* if true, call to ..._finish() from ..._delete() will not call the callbacks */
+	FLAC__MemoryCallbacks memory_callbacks; /* all zero means the C runtime heap; NOT reset by set_defaults_() */
 } FLAC__StreamEncoderPrivate;
 
 /***********************************************************************
@@ -570,8 +574,6 @@ FLAC_API FLAC__StreamEncoder *FLAC__stream_encoder_new(void)
 
 FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder)
 {
-	unsigned i;
-
 	if (encoder == NULL)
 		return ;
 
@@ -586,17 +588,6 @@ FLAC_API void FLAC__stream_encoder_delete(FLAC__StreamEncoder *encoder)
 	if(0 != encoder->private_->verify.decoder)
 		FLAC__stream_decoder_delete(encoder->private_->verify.decoder);
 
-	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_workspace[i][0]);
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_workspace[i][1]);
-	}
-	for(i = 0; i < 2; i++) {
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][0]);
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][1]);
-	}
-	for(i = 0; i < 2; i++)
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->partitioned_rice_contents_extra[i]);
-
 	FLAC__bitwriter_delete(encoder->private_->frame);
 	free(encoder->private_);
 	free(encoder->protected_);
@@ -793,6 +784,8 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 		else if(m->type == FLAC__METADATA_TYPE_PICTURE) {
 			if(!FLAC__format_picture_is_legal(&m->data.picture, /*violation=*/0))
 				return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_METADATA;
+			if(0 == m->data.picture.data && m->data.picture.data_length > 0) /* a lazy picture whose data was never loaded */
+				return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_METADATA;
 			if(m->data.picture.type == FLAC__STREAM_METADATA_PICTURE_TYPE_FILE_ICON_STANDARD) {
 				if(metadata_picture_has_type1) /* there should only be 1 per stream */
 					return FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_METADATA;
@@ -927,7 +920,7 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 
 #if FLAC__HAS_OGG
 	encoder->private_->is_ogg = is_ogg;
-	if(is_ogg && !FLAC__ogg_encoder_aspect_init(&encoder->protected_->ogg_encoder_aspect)) {
+	if(is_ogg && !FLAC__ogg_encoder_aspect_init(&encoder->protected_->ogg_encoder_aspect, &encoder->private_->memory_callbacks)) {
 		encoder->protected_->state = FLAC__STREAM_ENCODER_OGG_ERROR;
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 	}
@@ -940,12 +933,33 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->metadata_callback = metadata_callback;
 	encoder->private_->client_data = client_data;
 
+	/*
+	 * Check the memory limit up front against what the buffers below will
+	 * need, so we fail before allocating anything big
+	 */
+	if(encoder->protected_->memory_limit) {
+		FLAC__MemoryUsage usage;
+		size_t needed = signal_bytes_(encoder, encoder->protected_->blocksize);
+		get_memory_usage_(encoder, &usage);
+		if(encoder->protected_->do_md5)
+			needed += (size_t)encoder->protected_->channels * encoder->protected_->blocksize * sizeof(FLAC__int32);
+		if(encoder->protected_->verify) {
+			/* the verify FIFO, plus the output and residual buffers of the verify decoder */
+			needed += (size_t)encoder->protected_->channels * (encoder->protected_->blocksize+OVERREAD_) * sizeof(FLAC__int32);
+			needed += (size_t)encoder->protected_->channels * (2 * encoder->protected_->blocksize + 4) * sizeof(FLAC__int32);
+		}
+		if(usage.total + needed > encoder->protected_->memory_limit) {
+			encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+		}
+	}
+
 	if(!resize_buffers_(encoder, encoder->protected_->blocksize)) {
 		/* the above function sets the state for us in case of an error */
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 	}
 
-	if(!FLAC__bitwriter_init(encoder->private_->frame)) {
+	if(!FLAC__bitwriter_init(encoder->private_->frame, &encoder->private_->memory_callbacks)) {
 		encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 	}
@@ -960,7 +974,7 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 		 */
 		encoder->private_->verify.input_fifo.size = encoder->protected_->blocksize+OVERREAD_;
 		for(i = 0; i < encoder->protected_->channels; i++) {
-			if(0 == (encoder->private_->verify.input_fifo.data[i] = safe_malloc_mul_2op_p(sizeof(FLAC__int32), /*times*/encoder->private_->verify.input_fifo.size))) {
+			if(0 == (encoder->private_->verify.input_fifo.data[i] = FLAC__memory_malloc_mul_2op(&encoder->private_->memory_callbacks, sizeof(FLAC__int32), /*times*/encoder->private_->verify.input_fifo.size))) {
 				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
 				return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 			}
@@ -978,8 +992,20 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 			}
 		}
 
+		(void)FLAC__stream_decoder_set_memory_callbacks(encoder->private_->verify.decoder, 0 != encoder->private_->memory_callbacks.malloc? &encoder->private_->memory_callbacks : 0);
+		if(encoder->protected_->memory_limit) {
+			/* the verify decoder gets whatever is left of the budget */
+			FLAC__MemoryUsage usage;
+			get_memory_usage_(encoder, &usage);
+			(void)FLAC__stream_decoder_set_memory_limit(encoder->private_->verify.decoder, usage.total < encoder->protected_->memory_limit? encoder->protected_->memory_limit - usage.total : 1);
+		}
+		else
+			(void)FLAC__stream_decoder_set_memory_limit(encoder->private_->verify.decoder, 0);
 		if(FLAC__stream_decoder_init_stream(encoder->private_->verify.decoder, verify_read_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*length_callback=*/0, /*eof_callback=*/0, verify_write_callback_, verify_metadata_callback_, verify_error_callback_, /*client_data=*/encoder) != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
-			encoder->protected_->state = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR;
+			if(FLAC__stream_decoder_get_state(encoder->private_->verify.decoder) == FLAC__STREAM_DECODER_MEMORY_ALLOCATION_ERROR)
+				encoder->protected_->state = FLAC__STREAM_ENCODER_MEMORY_ALLOCATION_ERROR;
+			else
+				encoder->protected_->state = FLAC__STREAM_ENCODER_VERIFY_DECODER_ERROR;
 			return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
 		}
 	}
@@ -1032,7 +1058,7 @@ static FLAC__StreamEncoderInitStatus init_stream_internal_(
 	encoder->private_->streaminfo.data.stream_info.total_samples = encoder->protected_->total_samples_estimate; /* we will replace this later with the real total */
 	memset(encoder->private_->streaminfo.data.stream_info.md5sum, 0, 16); /* we don't know this yet; have to fill it in later */
 	if(encoder->protected_->do_md5)
-		FLAC__MD5Init(&encoder->private_->md5context);
+		FLAC__MD5Init(&encoder->private_->md5context, &encoder->private_->memory_callbacks);
 	if(!FLAC__add_metadata_block(&encoder->private_->streaminfo, encoder->private_->frame)) {
 		encoder->protected_->state = FLAC__STREAM_ENCODER_FRAMING_ERROR;
 		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
@@ -1366,6 +1392,38 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_serial_number(FLAC__StreamEncod
 #endif
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_page_size(FLAC__StreamEncoder *encoder, unsigned value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+#if FLAC__HAS_OGG
+	FLAC__ogg_encoder_aspect_set_page_size(&encoder->protected_->ogg_encoder_aspect, value);
+	return true;
+#else
+	(void)value;
+	return false;
+#endif
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_set_ogg_write_size(FLAC__StreamEncoder *encoder, unsigned value)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+#if FLAC__HAS_OGG
+	FLAC__ogg_encoder_aspect_set_write_size(&encoder->protected_->ogg_encoder_aspect, value);
+	return true;
+#else
+	(void)value;
+	return false;
+#endif
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_set_verify(FLAC__StreamEncoder *encoder, FLAC__bool value)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1714,6 +1772,33 @@ FLAC_API FLAC__bool FLAC__stream_encoder_set_metadata(FLAC__StreamEncoder *encod
 	return true;
 }
 
+FLAC_API FLAC__bool FLAC__stream_encoder_set_memory_callbacks(FLAC__StreamEncoder *encoder, const FLAC__MemoryCallbacks *callbacks)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	if(0 != callbacks && (0 == callbacks->malloc || 0 == callbacks->realloc || 0 == callbacks->free))
+		return false;
+	if(0 != callbacks)
+		encoder->private_->memory_callbacks = *callbacks;
+	else
+		memset(&encoder->private_->memory_callbacks, 0, sizeof(encoder->private_->memory_callbacks));
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_encoder_set_memory_limit(FLAC__StreamEncoder *encoder, size_t limit)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	if(encoder->protected_->state != FLAC__STREAM_ENCODER_UNINITIALIZED)
+		return false;
+	encoder->protected_->memory_limit = limit;
+	return true;
+}
+
 /*
  * These three functions are not static, but not publically exposed in
  * include/FLAC/ either.  They are used by the test suite.
@@ -1808,6 +1893,28 @@ FLAC_API FLAC__bool FLAC__stream_encoder_get_verify(const FLAC__StreamEncoder *e
 	return encoder->protected_->verify;
 }
 
+FLAC_API unsigned FLAC__stream_encoder_get_ogg_page_size(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->protected_);
+#if FLAC__HAS_OGG
+	return encoder->protected_->ogg_encoder_aspect.page_size;
+#else
+	return 0;
+#endif
+}
+
+FLAC_API unsigned FLAC__stream_encoder_get_ogg_write_size(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->protected_);
+#if FLAC__HAS_OGG
+	return encoder->protected_->ogg_encoder_aspect.write_size;
+#else
+	return 0;
+#endif
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_get_streamable_subset(const FLAC__StreamEncoder *encoder)
 {
 	FLAC__ASSERT(0 != encoder);
@@ -1944,6 +2051,23 @@ FLAC_API FLAC__uint64 FLAC__stream_encoder_get_total_samples_estimate(const FLAC
 	return encoder->protected_->total_samples_estimate;
 }
 
+FLAC_API size_t FLAC__stream_encoder_get_memory_limit(const FLAC__StreamEncoder *encoder)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	return encoder->protected_->memory_limit;
+}
+
+FLAC_API void FLAC__stream_encoder_get_memory_usage(const FLAC__StreamEncoder *encoder, FLAC__MemoryUsage *usage)
+{
+	FLAC__ASSERT(0 != encoder);
+	FLAC__ASSERT(0 != encoder->private_);
+	FLAC__ASSERT(0 != encoder->protected_);
+	FLAC__ASSERT(0 != usage);
+	get_memory_usage_(encoder, usage);
+}
+
 FLAC_API FLAC__bool FLAC__stream_encoder_process(FLAC__StreamEncoder *encoder, const FLAC__int32 * const buffer[], unsigned samples)
 {
 	unsigned i, j = 0, channel;
@@ -2117,6 +2241,7 @@ void set_defaults_(FLAC__StreamEncoder *encoder)
 	encoder->protected_->total_samples_estimate = 0;
 	encoder->protected_->metadata = 0;
 	encoder->protected_->num_metadata_blocks = 0;
+	encoder->protected_->memory_limit = 0;
 
 	encoder->private_->seek_table = 0;
 	encoder->private_->disable_constant_subframes = false;
@@ -2152,24 +2277,24 @@ void free_(FLAC__StreamEncoder *encoder)
 	}
 	for(i = 0; i < encoder->protected_->channels; i++) {
 		if(0 != encoder->private_->integer_signal_unaligned[i]) {
-			free(encoder->private_->integer_signal_unaligned[i]);
+			FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->integer_signal_unaligned[i]);
 			encoder->private_->integer_signal_unaligned[i] = 0;
 		}
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 		if(0 != encoder->private_->real_signal_unaligned[i]) {
-			free(encoder->private_->real_signal_unaligned[i]);
+			FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->real_signal_unaligned[i]);
 			encoder->private_->real_signal_unaligned[i] = 0;
 		}
 #endif
 	}
 	for(i = 0; i < 2; i++) {
 		if(0 != encoder->private_->integer_signal_mid_side_unaligned[i]) {
-			free(encoder->private_->integer_signal_mid_side_unaligned[i]);
+			FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->integer_signal_mid_side_unaligned[i]);
 			encoder->private_->integer_signal_mid_side_unaligned[i] = 0;
 		}
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 		if(0 != encoder->private_->real_signal_mid_side_unaligned[i]) {
-			free(encoder->private_->real_signal_mid_side_unaligned[i]);
+			FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->real_signal_mid_side_unaligned[i]);
 			encoder->private_->real_signal_mid_side_unaligned[i] = 0;
 		}
 #endif
@@ -2177,19 +2302,19 @@ void free_(FLAC__StreamEncoder *encoder)
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	for(i = 0; i < encoder->protected_->num_apodizations; i++) {
 		if(0 != encoder->private_->window_unaligned[i]) {
-			free(encoder->private_->window_unaligned[i]);
+			FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->window_unaligned[i]);
 			encoder->private_->window_unaligned[i] = 0;
 		}
 	}
 	if(0 != encoder->private_->windowed_signal_unaligned) {
-		free(encoder->private_->windowed_signal_unaligned);
+		FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->windowed_signal_unaligned);
 		encoder->private_->windowed_signal_unaligned = 0;
 	}
 #endif
 	for(channel = 0; channel < encoder->protected_->channels; channel++) {
 		for(i = 0; i < 2; i++) {
 			if(0 != encoder->private_->residual_workspace_unaligned[channel][i]) {
-				free(encoder->private_->residual_workspace_unaligned[channel][i]);
+				FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->residual_workspace_unaligned[channel][i]);
 				encoder->private_->residual_workspace_unaligned[channel][i] = 0;
 			}
 		}
@@ -2197,30 +2322,100 @@ void free_(FLAC__StreamEncoder *encoder)
 	for(channel = 0; channel < 2; channel++) {
 		for(i = 0; i < 2; i++) {
 			if(0 != encoder->private_->residual_workspace_mid_side_unaligned[channel][i]) {
-				free(encoder->private_->residual_workspace_mid_side_unaligned[channel][i]);
+				FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->residual_workspace_mid_side_unaligned[channel][i]);
 				encoder->private_->residual_workspace_mid_side_unaligned[channel][i] = 0;
 			}
 		}
 	}
 	if(0 != encoder->private_->abs_residual_partition_sums_unaligned) {
-		free(encoder->private_->abs_residual_partition_sums_unaligned);
+		FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->abs_residual_partition_sums_unaligned);
 		encoder->private_->abs_residual_partition_sums_unaligned = 0;
 	}
 	if(0 != encoder->private_->raw_bits_per_partition_unaligned) {
-		free(encoder->private_->raw_bits_per_partition_unaligned);
+		FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->raw_bits_per_partition_unaligned);
 		encoder->private_->raw_bits_per_partition_unaligned = 0;
 	}
 	if(encoder->protected_->verify) {
 		for(i = 0; i < encoder->protected_->channels; i++) {
 			if(0 != encoder->private_->verify.input_fifo.data[i]) {
-				free(encoder->private_->verify.input_fifo.data[i]);
+				FLAC__memory_free(&encoder->private_->memory_callbacks, encoder->private_->verify.input_fifo.data[i]);
 				encoder->private_->verify.input_fifo.data[i] = 0;
 			}
 		}
 	}
+	/* these are kept across frames but not across streams */
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->memory_callbacks, &encoder->private_->partitioned_rice_contents_workspace[i][0]);
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->memory_callbacks, &encoder->private_->partitioned_rice_contents_workspace[i][1]);
+	}
+	for(i = 0; i < 2; i++) {
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->memory_callbacks, &encoder->private_->partitioned_rice_contents_workspace_mid_side[i][0]);
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->memory_callbacks, &encoder->private_->partitioned_rice_contents_workspace_mid_side[i][1]);
+	}
+	for(i = 0; i < 2; i++)
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_clear(&encoder->private_->memory_callbacks, &encoder->private_->partitioned_rice_contents_extra[i]);
 	FLAC__bitwriter_free(encoder->private_->frame);
 }
 
+/*
+ * Bytes resize_buffers_() allocates for a given blocksize, not counting
+ * the alignment slack
+ */
+size_t signal_bytes_(const FLAC__StreamEncoder *encoder, unsigned blocksize)
+{
+	const size_t signal = sizeof(FLAC__int32) * ((size_t)blocksize + 4 + OVERREAD_);
+	const size_t residual = sizeof(FLAC__int32) * 2 * (size_t)blocksize;
+	size_t bytes;
+
+	bytes = (encoder->protected_->channels + 2) * (signal + residual);
+#ifndef FLAC__INTEGER_ONLY_LIBRARY
+	if(encoder->protected_->max_lpc_order > 0)
+		bytes += (encoder->protected_->num_apodizations + 1) * sizeof(FLAC__real) * (size_t)blocksize;
+#endif
+	bytes += sizeof(FLAC__uint64) * 2 * (size_t)blocksize;
+	if(encoder->protected_->do_escape_coding)
+		bytes += sizeof(unsigned) * 2 * (size_t)blocksize;
+	return bytes;
+}
+
+void get_memory_usage_(const FLAC__StreamEncoder *encoder, FLAC__MemoryUsage *usage)
+{
+	unsigned i;
+
+	memset(usage, 0, sizeof(*usage));
+
+	usage->instance = sizeof(FLAC__StreamEncoder) + sizeof(FLAC__StreamEncoderProtected) + sizeof(FLAC__StreamEncoderPrivate);
+	usage->io = FLAC__bitwriter_get_memory_usage(encoder->private_->frame);
+	if(0 != encoder->private_->integer_signal_unaligned[0])
+		usage->samples = signal_bytes_(encoder, encoder->private_->input_capacity);
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		usage->entropy += FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(&encoder->private_->partitioned_rice_contents_workspace[i][0], 0);
+		usage->entropy += FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(&encoder->private_->partitioned_rice_contents_workspace[i][1], 0);
+	}
+	for(i = 0; i < 2; i++) {
+		usage->entropy += FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][0], 0);
+		usage->entropy += FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(&encoder->private_->partitioned_rice_contents_workspace_mid_side[i][1], 0);
+		usage->entropy += FLAC__format_entropy_coding_method_partitioned_rice_contents_get_memory_usage(&encoder->private_->partitioned_rice_contents_extra[i], 0);
+	}
+	if(0 != encoder->protected_->metadata)
+		usage->metadata = encoder->protected_->num_metadata_blocks * sizeof(FLAC__StreamMetadata*);
+	usage->md5 = encoder->private_->md5context.capacity;
+#if FLAC__HAS_OGG
+	usage->ogg = FLAC__ogg_encoder_aspect_get_memory_usage(&encoder->protected_->ogg_encoder_aspect);
+#endif
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		if(0 != encoder->private_->verify.input_fifo.data[i])
+			usage->verify += sizeof(FLAC__int32) * encoder->private_->verify.input_fifo.size;
+	}
+	if(0 != encoder->private_->verify.decoder) {
+		FLAC__MemoryUsage decoder_usage;
+		FLAC__stream_decoder_get_memory_usage(encoder->private_->verify.decoder, &decoder_usage);
+		usage->verify += decoder_usage.total;
+	}
+
+	usage->total = usage->instance + usage->io + usage->samples + usage->entropy + usage->metadata + usage->md5 + usage->ogg + usage->verify;
+}
+
 FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, unsigned new_blocksize)
 {
 	FLAC__bool ok;
@@ -2243,49 +2438,49 @@ FLAC__bool resize_buffers_(FLAC__StreamEncoder *encoder, unsigned new_blocksize)
 	 */
 
 	for(i = 0; ok && i < encoder->protected_->channels; i++) {
-		ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize+4+OVERREAD_, &encoder->private_->integer_signal_unaligned[i], &encoder->private_->integer_signal[i]);
+		ok = ok && FLAC__memory_alloc_aligned_int32_array(&encoder->private_->memory_callbacks, new_blocksize+4+OVERREAD_, &encoder->private_->integer_signal_unaligned[i], &encoder->private_->integer_signal[i]);
 		memset(encoder->private_->integer_signal[i], 0, sizeof(FLAC__int32)*4);
 		encoder->private_->integer_signal[i] += 4;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 #if 0 /* @@@ currently unused */
 		if(encoder->protected_->max_lpc_order > 0)
-			ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize+OVERREAD_, &encoder->private_->real_signal_unaligned[i], &encoder->private_->real_signal[i]);
+			ok = ok && FLAC__memory_alloc_aligned_real_array(&encoder->private_->memory_callbacks, new_blocksize+OVERREAD_, &encoder->private_->real_signal_unaligned[i], &encoder->private_->real_signal[i]);
 #endif
 #endif
 	}
 	for(i = 0; ok && i < 2; i++) {
-		ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize+4+OVERREAD_, &encoder->private_->integer_signal_mid_side_unaligned[i], &encoder->private_->integer_signal_mid_side[i]);
+		ok = ok && FLAC__memory_alloc_aligned_int32_array(&encoder->private_->memory_callbacks, new_blocksize+4+OVERREAD_, &encoder->private_->integer_signal_mid_side_unaligned[i], &encoder->private_->integer_signal_mid_side[i]);
 		memset(encoder->private_->integer_signal_mid_side[i], 0, sizeof(FLAC__int32)*4);
 		encoder->private_->integer_signal_mid_side[i] += 4;
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 #if 0 /* @@@ currently unused */
 		if(encoder->protected_->max_lpc_order > 0)
-			ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize+OVERREAD_, &encoder->private_->real_signal_mid_side_unaligned[i], &encoder->private_->real_signal_mid_side[i]);
+			ok = ok && FLAC__memory_alloc_aligned_real_array(&encoder->private_->memory_callbacks, new_blocksize+OVERREAD_, &encoder->private_->real_signal_mid_side_unaligned[i], &encoder->private_->real_signal_mid_side[i]);
 #endif
 #endif
 	}
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
 	if(ok && encoder->protected_->max_lpc_order > 0) {
 		for(i = 0; ok && i < encoder->protected_->num_apodizations; i++)
-			ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize, &encoder->private_->window_unaligned[i], &encoder->private_->window[i]);
-		ok = ok && FLAC__memory_alloc_aligned_real_array(new_blocksize, &encoder->private_->windowed_signal_unaligned, &encoder->private_->windowed_signal);
+			ok = ok && FLAC__memory_alloc_aligned_real_array(&encoder->private_->memory_callbacks, new_blocksize, &encoder->private_->window_unaligned[i], &encoder->private_->window[i]);
+		ok = ok && FLAC__memory_alloc_aligned_real_array(&encoder->private_->memory_callbacks, new_blocksize, &encoder->private_->windowed_signal_unaligned, &encoder->private_->windowed_signal);
 	}
 #endif
 	for(channel = 0; ok && channel < encoder->protected_->channels; channel++) {
 		for(i = 0; ok && i < 2; i++) {
-			ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize, &encoder->private_->residual_workspace_unaligned[channel][i], &encoder->private_->residual_workspace[channel][i]);
+			ok = ok && FLAC__memory_alloc_aligned_int32_array(&encoder->private_->memory_callbacks, new_blocksize, &encoder->private_->residual_workspace_unaligned[channel][i], &encoder->private_->residual_workspace[channel][i]);
 		}
 	}
 	for(channel = 0; ok && channel < 2; channel++) {
 		for(i = 0; ok && i < 2; i++) {
-			ok = ok && FLAC__memory_alloc_aligned_int32_array(new_blocksize, &encoder->private_->residual_workspace_mid_side_unaligned[channel][i], &encoder->private_->residual_workspace_mid_side[channel][i]);
+			ok = ok && FLAC__memory_alloc_aligned_int32_array(&encoder->private_->memory_callbacks, new_blocksize, &encoder->private_->residual_workspace_mid_side_unaligned[channel][i], &encoder->private_->residual_workspace_mid_side[channel][i]);
 		}
 	}
 	/* the *2 is an approximation to the series 1 + 1/2 + 1/4 + ... that sums tree occupies in a flat array */
 	/*@@@ new_blocksize*2 is too pessimistic, but to fix, we need smarter logic because a smaller new_blocksize can actually increase the # of partitions; would require moving this out into a separate function, then checking its capacity against the need of the current blocksize&min/max_partition_order (and maybe predictor order) */
-	ok = ok && FLAC__memory_alloc_aligned_uint64_array(new_blocksize * 2, &encoder->private_->abs_residual_partition_sums_unaligned, &encoder->private_->abs_residual_partition_sums);
+	ok = ok && FLAC__memory_alloc_aligned_uint64_array(&encoder->private_->memory_callbacks, new_blocksize * 2, &encoder->private_->abs_residual_partition_sums_unaligned, &encoder->private_->abs_residual_partition_sums);
 	if(encoder->protected_->do_escape_coding)
-		ok = ok && FLAC__memory_alloc_aligned_unsigned_array(new_blocksize * 2, &encoder->private_->raw_bits_per_partition_unaligned, &encoder->private_->raw_bits_per_partition);
+		ok = ok && FLAC__memory_alloc_aligned_unsigned_array(&encoder->private_->memory_callbacks, new_blocksize * 2, &encoder->private_->raw_bits_per_partition_unaligned, &encoder->private_->raw_bits_per_partition);
 
 	/* now adjust the windows if the blocksize has changed */
 #ifndef FLAC__INTEGER_ONLY_LIBRARY
@@ -3683,6 +3878,7 @@ unsigned find_best_partition_order_(
 		for(partition_order = (int)max_partition_order, sum = 0; partition_order >= (int)min_partition_order; partition_order--) {
 			if(!
 				set_partitioned_rice_(
+					&private_->memory_callbacks,
 #ifdef EXACT_RICE_BITS_CALCULATION
 					residual,
 #endif
@@ -3723,7 +3919,7 @@ unsigned find_best_partition_order_(
 		unsigned partition;
 
 		/* save best parameters and raw_bits */
-		FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(prc, flac_max(6u, best_partition_order));
+		FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(&private_->memory_callbacks, prc, flac_max(6u, best_partition_order));
 		memcpy(prc->parameters, private_->partitioned_rice_contents_extra[best_parameters_index].parameters, sizeof(unsigned)*(1<<(best_partition_order)));
 		if(do_escape_coding)
 			memcpy(prc->raw_bits, private_->partitioned_rice_contents_extra[best_parameters_index].raw_bits, sizeof(unsigned)*(1<<(best_partition_order)));
@@ -3924,6 +4120,7 @@ static inline unsigned count_rice_bits_in_partition_(
 #endif
 
 FLAC__bool set_partitioned_rice_(
+	const FLAC__MemoryCallbacks *mem,
 #ifdef EXACT_RICE_BITS_CALCULATION
 	const FLAC__int32 residual[],
 #endif
@@ -3953,7 +4150,7 @@ FLAC__bool set_partitioned_rice_(
 	FLAC__ASSERT(suggested_rice_parameter < FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2_ESCAPE_PARAMETER);
 	FLAC__ASSERT(rice_parameter_limit <= FLAC__ENTROPY_CODING_METHOD_PARTITIONED_RICE2_ESCAPE_PARAMETER);
 
-	FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(partitioned_rice_contents, flac_max(6u, partition_order));
+	FLAC__format_entropy_coding_method_partitioned_rice_contents_ensure_size(mem, partitioned_rice_contents, flac_max(6u, partition_order));
 	parameters = partitioned_rice_contents->parameters;
 	raw_bits = partitioned_rice_contents->raw_bits;
 
@@ -0,0 +1,1123 @@
+/* libFLAC - Free Lossless Audio Codec
+ * Copyright (C) 2002-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h> /* for SEEK_SET, SEEK_CUR, SEEK_END */
+#include <stdlib.h> /* for calloc() */
+#include <string.h> /* for memcpy(), memmove() */
+#include "FLAC/assert.h"
+#include "FLAC/metadata.h"
+#include "FLAC/stream_decoder.h"
+#include "FLAC/stream_encoder.h"
+#include "FLAC/stream_splicer.h"
+#include "share/alloc.h"
+#include "private/bitwriter.h"
+#include "private/crc.h"
+#include "private/md5.h"
+#include "private/stream_encoder_framing.h"
+
+
+/***********************************************************************
+ *
+ * Private class data
+ *
+ ***********************************************************************/
+
+/* how much to read from a source at a time when looking for frames */
+static const size_t WINDOW_CHUNK = 65536;
+
+/* the longest a frame header can be, with the 7 byte sample number and
+ * 16-bit blocksize and sample rate */
+#define MAX_FRAME_HEADER_LENGTH 16
+
+typedef struct {
+	FLAC__bool variable;
+	FLAC__uint64 number;
+	unsigned blocksize;
+	unsigned number_end; /* offset of the first byte after the coded frame/sample number */
+	unsigned length; /* including the CRC-8 */
+} FLAC__StreamSplicerFrameHeader;
+
+typedef struct {
+	FLAC__IOHandle handle;
+	FLAC__IOCallbacks callbacks;
+	FLAC__uint64 start_sample;
+	FLAC__uint64 samples;
+} FLAC__StreamSplicerSegment;
+
+typedef struct {
+	FLAC__StreamSplicer *splicer;
+	const FLAC__StreamSplicerSegment *segment;
+	FLAC__StreamDecoder *decoder;
+	FLAC__uint64 position; /* where the decoder reads next */
+	FLAC__uint64 length;
+	FLAC__bool length_known;
+	FLAC__StreamMetadata_StreamInfo stream_info;
+	FLAC__bool got_stream_info;
+	FLAC__uint64 end_sample; /* the range is start_sample to end_sample */
+} FLAC__StreamSplicerSource;
+
+struct FLAC__StreamSplicer {
+	FLAC__StreamSplicerStatus status;
+	FLAC__bool do_md5;
+	unsigned compression_level;
+	FLAC__StreamSplicerSegment *segments;
+	unsigned segment_count, segment_capacity;
+
+	/* everything below only lives during FLAC__stream_splicer_splice() */
+	FLAC__StreamSplicerSource *sources;
+	FLAC__StreamMetadata **metadata; /* the blocks kept from the first source */
+	unsigned metadata_count, metadata_capacity;
+	FLAC__StreamMetadata *seek_table;
+	unsigned first_seekpoint_to_check;
+	FLAC__StreamMetadata_StreamInfo stream_info; /* of the new stream */
+	FLAC__bool variable_blocksize;
+	unsigned blocksize; /* for the boundary frames */
+	unsigned last_blocksize;
+	FLAC__uint64 frame_count;
+
+	/* the bytes of a source being looked through for frames */
+	const FLAC__StreamSplicerSource *window_source;
+	FLAC__byte *window;
+	FLAC__uint64 window_offset;
+	size_t window_length, window_capacity;
+
+	/* a frame with its header rewritten */
+	FLAC__byte *frame;
+	size_t frame_capacity;
+
+	/* decoded samples waiting to be encoded */
+	FLAC__int32 *pending[FLAC__MAX_CHANNELS];
+	unsigned pending_samples, pending_capacity;
+	FLAC__bool capture;
+	FLAC__uint64 capture_end;
+	FLAC__uint64 decoded_first, decoded_next; /* the samples of the last frame decoded */
+
+	FLAC__StreamEncoder *encoder;
+	FLAC__BitWriter *bw;
+	FLAC__MD5Context md5context;
+	FLAC__bool md5_open;
+
+	FLAC__IOHandle out;
+	FLAC__IOCallbacks out_callbacks;
+	FLAC__uint64 out_position; /* relative to where the output started */
+	FLAC__uint64 audio_offset;
+	FLAC__uint64 seek_table_offset;
+	FLAC__uint64 out_samples;
+};
+
+FLAC_API const char * const FLAC__StreamSplicerStatusString[] = {
+	"FLAC__STREAM_SPLICER_OK",
+	"FLAC__STREAM_SPLICER_INVALID_SEGMENT",
+	"FLAC__STREAM_SPLICER_FORMAT_MISMATCH",
+	"FLAC__STREAM_SPLICER_READ_ERROR",
+	"FLAC__STREAM_SPLICER_BAD_FRAME",
+	"FLAC__STREAM_SPLICER_DECODER_ERROR",
+	"FLAC__STREAM_SPLICER_ENCODER_ERROR",
+	"FLAC__STREAM_SPLICER_WRITE_ERROR",
+	"FLAC__STREAM_SPLICER_SEEK_ERROR",
+	"FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR"
+};
+
+/***********************************************************************
+ *
+ * Private class method prototypes
+ *
+ ***********************************************************************/
+
+static FLAC__bool fail_(FLAC__StreamSplicer *splicer, FLAC__StreamSplicerStatus status);
+static FLAC__bool open_sources_(FLAC__StreamSplicer *splicer);
+static void close_sources_(FLAC__StreamSplicer *splicer);
+static FLAC__bool write_header_(FLAC__StreamSplicer *splicer);
+static FLAC__bool write_metadata_block_(FLAC__StreamSplicer *splicer, const FLAC__StreamMetadata *block);
+static FLAC__bool rewrite_header_(FLAC__StreamSplicer *splicer);
+static FLAC__bool splice_segment_(FLAC__StreamSplicer *splicer, FLAC__StreamSplicerSource *source);
+static FLAC__bool decode_frame_at_(FLAC__StreamSplicer *splicer, FLAC__StreamSplicerSource *source, FLAC__uint64 offset, FLAC__uint64 sample, FLAC__bool capture);
+static FLAC__bool read_frame_header_(FLAC__StreamSplicer *splicer, const FLAC__StreamSplicerSource *source, FLAC__uint64 offset, FLAC__uint64 sample, FLAC__StreamSplicerFrameHeader *header);
+static FLAC__bool find_frame_end_(FLAC__StreamSplicer *splicer, const FLAC__StreamSplicerSource *source, FLAC__uint64 offset, FLAC__uint64 sample, const FLAC__StreamSplicerFrameHeader *header, size_t *bytes);
+static FLAC__bool fill_window_(FLAC__StreamSplicer *splicer, const FLAC__StreamSplicerSource *source, FLAC__uint64 offset, size_t bytes, size_t *available);
+static FLAC__bool parse_frame_header_(const FLAC__byte *b, size_t bytes, FLAC__StreamSplicerFrameHeader *header);
+static FLAC__uint64 frame_header_sample_(const FLAC__StreamSplicerFrameHeader *header, const FLAC__StreamMetadata_StreamInfo *stream_info);
+static unsigned put_utf8_(FLAC__byte *b, FLAC__uint64 value);
+static FLAC__bool write_frame_(FLAC__StreamSplicer *splicer, const FLAC__byte *buffer, size_t bytes);
+static FLAC__bool write_out_(FLAC__StreamSplicer *splicer, const FLAC__byte *buffer, size_t bytes);
+static FLAC__bool seek_out_(FLAC__StreamSplicer *splicer, FLAC__uint64 position);
+static FLAC__bool append_pending_(FLAC__StreamSplicer *splicer, const FLAC__int32 * const buffer[], unsigned channels, unsigned samples);
+static FLAC__bool flush_pending_(FLAC__StreamSplicer *splicer);
+static FLAC__StreamDecoderReadStatus read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data);
+static FLAC__StreamDecoderSeekStatus seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data);
+static FLAC__StreamDecoderTellStatus tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data);
+static FLAC__StreamDecoderLengthStatus length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data);
+static FLAC__bool eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data);
+static FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data);
+static void metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data);
+static void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data);
+static FLAC__StreamEncoderWriteStatus encoder_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data);
+
+/***********************************************************************
+ *
+ * Class constructor/destructor
+ *
+ ***********************************************************************/
+
+FLAC_API FLAC__StreamSplicer *FLAC__stream_splicer_new(void)
+{
+	FLAC__StreamSplicer *splicer = calloc(1, sizeof(FLAC__StreamSplicer));
+
+	if(0 != splicer) {
+		splicer->status = FLAC__STREAM_SPLICER_OK;
+		splicer->do_md5 = true;
+		splicer->compression_level = 5;
+	}
+
+	return splicer;
+}
+
+FLAC_API void FLAC__stream_splicer_delete(FLAC__StreamSplicer *splicer)
+{
+	FLAC__ASSERT(0 != splicer);
+
+	if(0 != splicer->segments)
+		free(splicer->segments);
+	free(splicer);
+}
+
+/***********************************************************************
+ *
+ * Public class methods
+ *
+ ***********************************************************************/
+
+FLAC_API FLAC__bool FLAC__stream_splicer_set_md5(FLAC__StreamSplicer *splicer, FLAC__bool value)
+{
+	FLAC__ASSERT(0 != splicer);
+	splicer->do_md5 = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_splicer_set_compression_level(FLAC__StreamSplicer *splicer, unsigned value)
+{
+	FLAC__ASSERT(0 != splicer);
+	splicer->compression_level = value;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_splicer_add_segment(FLAC__StreamSplicer *splicer, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks, FLAC__uint64 start_sample, FLAC__uint64 samples)
+{
+	FLAC__StreamSplicerSegment *segment;
+
+	FLAC__ASSERT(0 != splicer);
+
+	if(0 == callbacks.read || 0 == callbacks.seek || 0 == callbacks.tell)
+		return false;
+
+	if(splicer->segment_count == splicer->segment_capacity) {
+		unsigned capacity = splicer->segment_capacity? splicer->segment_capacity * 2 : 8;
+		FLAC__StreamSplicerSegment *segments = safe_realloc_mul_2op_(splicer->segments, capacity, sizeof(FLAC__StreamSplicerSegment));
+		if(0 == segments)
+			return false;
+		splicer->segments = segments;
+		splicer->segment_capacity = capacity;
+	}
+
+	segment = &splicer->segments[splicer->segment_count++];
+	segment->handle = handle;
+	segment->callbacks = callbacks;
+	segment->start_sample = start_sample;
+	segment->samples = samples;
+	return true;
+}
+
+FLAC_API FLAC__bool FLAC__stream_splicer_splice(FLAC__StreamSplicer *splicer, FLAC__IOHandle handle, FLAC__IOCallbacks callbacks)
+{
+	FLAC__bool ok;
+	unsigned i;
+
+	FLAC__ASSERT(0 != splicer);
+
+	splicer->status = FLAC__STREAM_SPLICER_OK;
+	if(0 == callbacks.write)
+		return fail_(splicer, FLAC__STREAM_SPLICER_WRITE_ERROR);
+	if(0 == callbacks.seek)
+		return fail_(splicer, FLAC__STREAM_SPLICER_SEEK_ERROR);
+	if(0 == splicer->segment_count)
+		return fail_(splicer, FLAC__STREAM_SPLICER_INVALID_SEGMENT);
+
+	splicer->out = handle;
+	splicer->out_callbacks = callbacks;
+	splicer->out_position = 0;
+	splicer->out_samples = 0;
+	splicer->frame_count = 0;
+	splicer->first_seekpoint_to_check = 0;
+	splicer->pending_samples = 0;
+	splicer->window_source = 0;
+
+	ok = open_sources_(splicer) && write_header_(splicer);
+	for(i = 0; ok && i < splicer->segment_count; i++)
+		ok = splice_segment_(splicer, &splicer->sources[i]);
+	ok = ok && flush_pending_(splicer) && rewrite_header_(splicer);
+
+	close_sources_(splicer);
+	return ok;
+}
+
+FLAC_API FLAC__StreamSplicerStatus FLAC__stream_splicer_get_status(const FLAC__StreamSplicer *splicer)
+{
+	FLAC__ASSERT(0 != splicer);
+	return splicer->status;
+}
+
+/***********************************************************************
+ *
+ * Private class methods
+ *
+ ***********************************************************************/
+
+/* keeps the first error, since a failing callback makes the libFLAC
+ * call around it fail too */
+FLAC__bool fail_(FLAC__StreamSplicer *splicer, FLAC__StreamSplicerStatus status)
+{
+	if(splicer->status == FLAC__STREAM_SPLICER_OK)
+		splicer->status = status;
+	return false;
+}
+
+FLAC__bool open_sources_(FLAC__StreamSplicer *splicer)
+{
+	const FLAC__StreamMetadata_StreamInfo *first;
+	FLAC__StreamDecoderInitStatus init_status;
+	FLAC__bool fixed;
+	unsigned i;
+
+	if(0 == (splicer->sources = safe_calloc_(splicer->segment_count, sizeof(FLAC__StreamSplicerSource))) ||
+	   0 == (splicer->encoder = FLAC__stream_encoder_new()) ||
+	   0 == (splicer->bw = FLAC__bitwriter_new()) ||
+	   !FLAC__bitwriter_init(splicer->bw, 0))
+		return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+	if(splicer->do_md5) {
+		FLAC__MD5Init(&splicer->md5context, 0);
+		splicer->md5_open = true;
+	}
+
+	for(i = 0; i < splicer->segment_count; i++) {
+		FLAC__StreamSplicerSource *source = &splicer->sources[i];
+		const FLAC__StreamSplicerSegment *segment = &splicer->segments[i];
+
+		source->splicer = splicer;
+		source->segment = segment;
+		if(0 == (source->decoder = FLAC__stream_decoder_new()))
+			return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+		(void)FLAC__stream_decoder_set_md5_checking(source->decoder, false);
+		/* only the first source's metadata goes into the new stream */
+		if(i == 0)
+			(void)FLAC__stream_decoder_set_metadata_respond_all(source->decoder);
+		init_status = FLAC__stream_decoder_init_stream(source->decoder, read_callback_, seek_callback_, tell_callback_, length_callback_, eof_callback_, write_callback_, metadata_callback_, error_callback_, source);
+		if(init_status == FLAC__STREAM_DECODER_INIT_STATUS_MEMORY_ALLOCATION_ERROR)
+			return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+		if(init_status != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+			return fail_(splicer, FLAC__STREAM_SPLICER_DECODER_ERROR);
+		if(!FLAC__stream_decoder_process_until_end_of_metadata(source->decoder) || !source->got_stream_info)
+			return fail_(splicer, FLAC__STREAM_SPLICER_DECODER_ERROR);
+
+		if(source->stream_info.total_samples == 0 || segment->start_sample >= source->stream_info.total_samples)
+			return fail_(splicer, FLAC__STREAM_SPLICER_INVALID_SEGMENT);
+		if(segment->samples == 0 || segment->samples > source->stream_info.total_samples - segment->start_sample)
+			source->end_sample = source->stream_info.total_samples;
+		else
+			source->end_sample = segment->start_sample + segment->samples;
+
+		if(source->stream_info.sample_rate != splicer->sources[0].stream_info.sample_rate ||
+		   source->stream_info.channels != splicer->sources[0].stream_info.channels ||
+		   source->stream_info.bits_per_sample != splicer->sources[0].stream_info.bits_per_sample)
+			return fail_(splicer, FLAC__STREAM_SPLICER_FORMAT_MISMATCH);
+	}
+
+	/* The new stream keeps a fixed blocksize only if every range can be
+	 * copied as whole frames of it; otherwise the frames at the joins
+	 * are shorter and the frame headers need sample numbers.
+	 */
+	first = &splicer->sources[0].stream_info;
+	fixed = first->min_blocksize == first->max_blocksize && first->min_blocksize >= FLAC__MIN_BLOCK_SIZE;
+	splicer->blocksize = FLAC__MIN_BLOCK_SIZE;
+	for(i = 0; i < splicer->segment_count; i++) {
+		const FLAC__StreamSplicerSource *source = &splicer->sources[i];
+		if(source->stream_info.min_blocksize != first->min_blocksize || source->stream_info.max_blocksize != first->min_blocksize)
+			fixed = false;
+		else if(source->segment->start_sample % first->min_blocksize != 0)
+			fixed = false;
+		else if(i + 1 < splicer->segment_count && (source->end_sample - source->segment->start_sample) % first->min_blocksize != 0)
+			fixed = false;
+		if(source->stream_info.max_blocksize > splicer->blocksize)
+			splicer->blocksize = source->stream_info.max_blocksize;
+	}
+	if(splicer->blocksize > FLAC__MAX_BLOCK_SIZE)
+		splicer->blocksize = FLAC__MAX_BLOCK_SIZE;
+	if(fixed)
+		splicer->blocksize = first->min_blocksize;
+	splicer->variable_blocksize = !fixed;
+
+	memset(&splicer->stream_info, 0, sizeof(splicer->stream_info));
+	splicer->stream_info.sample_rate = first->sample_rate;
+	splicer->stream_info.channels = first->channels;
+	splicer->stream_info.bits_per_sample = first->bits_per_sample;
+	for(i = 0; i < splicer->segment_count; i++)
+		splicer->stream_info.total_samples += splicer->sources[i].end_sample - splicer->sources[i].segment->start_sample;
+	return true;
+}
+
+void close_sources_(FLAC__StreamSplicer *splicer)
+{
+	unsigned i;
+
+	if(0 != splicer->sources) {
+		for(i = 0; i < splicer->segment_count; i++) {
+			if(0 != splicer->sources[i].decoder)
+				FLAC__stream_decoder_delete(splicer->sources[i].decoder);
+		}
+		free(splicer->sources);
+		splicer->sources = 0;
+	}
+	if(0 != splicer->metadata) {
+		for(i = 0; i < splicer->metadata_count; i++)
+			FLAC__metadata_object_delete(splicer->metadata[i]);
+		free(splicer->metadata);
+		splicer->metadata = 0;
+	}
+	splicer->metadata_count = splicer->metadata_capacity = 0;
+	if(0 != splicer->seek_table) {
+		FLAC__metadata_object_delete(splicer->seek_table);
+		splicer->seek_table = 0;
+	}
+	if(0 != splicer->encoder) {
+		FLAC__stream_encoder_delete(splicer->encoder);
+		splicer->encoder = 0;
+	}
+	if(0 != splicer->bw) {
+		FLAC__bitwriter_delete(splicer->bw);
+		splicer->bw = 0;
+	}
+	if(splicer->md5_open) {
+		FLAC__byte digest[16];
+		FLAC__MD5Final(digest, &splicer->md5context);
+		splicer->md5_open = false;
+	}
+	for(i = 0; i < FLAC__MAX_CHANNELS; i++) {
+		if(0 != splicer->pending[i]) {
+			free(splicer->pending[i]);
+			splicer->pending[i] = 0;
+		}
+	}
+	splicer->pending_samples = splicer->pending_capacity = 0;
+	if(0 != splicer->window) {
+		free(splicer->window);
+		splicer->window = 0;
+	}
+	splicer->window_length = splicer->window_capacity = 0;
+	splicer->window_source = 0;
+	if(0 != splicer->frame) {
+		free(splicer->frame);
+		splicer->frame = 0;
+	}
+	splicer->frame_capacity = 0;
+}
+
+/* Writes the stream marker, a STREAMINFO and SEEKTABLE to be filled in
+ * by rewrite_header_(), and the kept metadata.
+ */
+FLAC__bool write_header_(FLAC__StreamSplicer *splicer)
+{
+	FLAC__StreamMetadata streaminfo;
+	const unsigned seek_samples = 10 * splicer->stream_info.sample_rate;
+	unsigned i;
+
+	if(!(
+		0 != (splicer->seek_table = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE)) &&
+		FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(splicer->seek_table, seek_samples, splicer->stream_info.total_samples) &&
+		FLAC__metadata_object_seektable_template_sort(splicer->seek_table, /*compact=*/true)
+	))
+		return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+	if(splicer->seek_table->data.seek_table.num_points == 0) {
+		FLAC__metadata_object_delete(splicer->seek_table);
+		splicer->seek_table = 0;
+	}
+
+	if(!write_out_(splicer, FLAC__STREAM_SYNC_STRING, sizeof(FLAC__STREAM_SYNC_STRING)))
+		return false;
+
+	memset(&streaminfo, 0, sizeof(streaminfo));
+	streaminfo.type = FLAC__METADATA_TYPE_STREAMINFO;
+	streaminfo.is_last = 0 == splicer->seek_table && 0 == splicer->metadata_count;
+	streaminfo.length = FLAC__STREAM_METADATA_STREAMINFO_LENGTH;
+	streaminfo.data.stream_info = splicer->stream_info;
+	if(!write_metadata_block_(splicer, &streaminfo))
+		return false;
+
+	if(0 != splicer->seek_table) {
+		splicer->seek_table->is_last = 0 == splicer->metadata_count;
+		splicer->seek_table_offset = splicer->out_position;
+		if(!write_metadata_block_(splicer, splicer->seek_table))
+			return false;
+	}
+
+	for(i = 0; i < splicer->metadata_count; i++) {
+		splicer->metadata[i]->is_last = i + 1 == splicer->metadata_count;
+		if(!write_metadata_block_(splicer, splicer->metadata[i]))
+			return false;
+	}
+
+	splicer->audio_offset = splicer->out_position;
+	return true;
+}
+
+FLAC__bool write_metadata_block_(FLAC__StreamSplicer *splicer, const FLAC__StreamMetadata *block)
+{
+	const FLAC__byte *buffer;
+	size_t bytes;
+	FLAC__bool ok;
+
+	FLAC__bitwriter_clear(splicer->bw);
+	if(!FLAC__add_metadata_block(block, splicer->bw) || !FLAC__bitwriter_get_buffer(splicer->bw, &buffer, &bytes))
+		return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+	ok = write_out_(splicer, buffer, bytes);
+	FLAC__bitwriter_release_buffer(splicer->bw);
+	return ok;
+}
+
+/* Goes back and writes the final STREAMINFO and SEEKTABLE over the
+ * ones written by write_header_(); both keep their length.
+ */
+FLAC__bool rewrite_header_(FLAC__StreamSplicer *splicer)
+{
+	FLAC__StreamMetadata streaminfo;
+	const FLAC__uint64 end = splicer->out_position;
+
+	if(splicer->out_samples != splicer->stream_info.total_samples)
+		return fail_(splicer, FLAC__STREAM_SPLICER_BAD_FRAME);
+
+	/* the last frame may be short, so it only counts for the largest blocksize */
+	if(splicer->frame_count == 1)
+		splicer->stream_info.min_blocksize = splicer->last_blocksize;
+	if(splicer->last_blocksize > splicer->stream_info.max_blocksize)
+		splicer->stream_info.max_blocksize = splicer->last_blocksize;
+	if(splicer->md5_open) {
+		FLAC__MD5Final(splicer->stream_info.md5sum, &splicer->md5context);
+		splicer->md5_open = false;
+	}
+
+	memset(&streaminfo, 0, sizeof(streaminfo));
+	streaminfo.type = FLAC__METADATA_TYPE_STREAMINFO;
+	streaminfo.is_last = 0 == splicer->seek_table && 0 == splicer->metadata_count;
+	streaminfo.length = FLAC__STREAM_METADATA_STREAMINFO_LENGTH;
+	streaminfo.data.stream_info = splicer->stream_info;
+	if(!seek_out_(splicer, sizeof(FLAC__STREAM_SYNC_STRING)) || !write_metadata_block_(splicer, &streaminfo))
+		return false;
+
+	if(0 != splicer->seek_table) {
+		(void)FLAC__format_seektable_sort(&splicer->seek_table->data.seek_table);
+		if(!seek_out_(splicer, splicer->seek_table_offset) || !write_metadata_block_(splicer, splicer->seek_table))
+			return false;
+	}
+
+	return seek_out_(splicer, end);
+}
+
+FLAC__bool splice_segment_(FLAC__StreamSplicer *splicer, FLAC__StreamSplicerSource *source)
+{
+	const FLAC__uint64 end = source->end_sample;
+	FLAC__StreamSplicerFrameHeader header;
+	FLAC__uint64 offset, sample;
+	size_t bytes;
+
+	/* the frame holding the first sample is decoded and trimmed, since
+	 * a range rarely starts on a frame boundary */
+	splicer->capture = true;
+	splicer->capture_end = end;
+	splicer->decoded_next = 0;
+	if(!FLAC__stream_decoder_seek_absolute(source->decoder, source->segment->start_sample))
+		return fail_(splicer, FLAC__STREAM_SPLICER_SEEK_ERROR);
+	if(!FLAC__stream_decoder_get_decode_position(source->decoder, &offset))
+		return fail_(splicer, FLAC__STREAM_SPLICER_DECODER_ERROR);
+	sample = splicer->decoded_next;
+
+	while(sample < end) {
+		if(!read_frame_header_(splicer, source, offset, sample, &header))
+			return false;
+		/* A frame cut by the end of the range is decoded and trimmed
+		 * too, and so is the last frame of the source, as there is no
+		 * frame header after it to find its end by.
+		 */
+		if(sample + header.blocksize > end || sample + header.blocksize >= source->stream_info.total_samples)
+			return decode_frame_at_(splicer, source, offset, sample, /*capture=*/true);
+
+		if(!find_frame_end_(splicer, source, offset, sample, &header, &bytes))
+			return false;
+		if(!flush_pending_(splicer))
+			return false;
+		if(splicer->do_md5 && !decode_frame_at_(splicer, source, offset, sample, /*capture=*/false))
+			return false;
+		/* the decoder reads through its own callbacks, so the frame is
+		 * still in the window */
+		FLAC__ASSERT(splicer->window_offset <= offset && offset + bytes <= splicer->window_offset + splicer->window_length);
+		if(!write_frame_(splicer, splicer->window + (size_t)(offset - splicer->window_offset), bytes))
+			return false;
+		offset += bytes;
+		sample += header.blocksize;
+	}
+
+	return true;
+}
+
+/* Decodes the frame at \a offset of the source, capturing its samples
+ * up to the end of the range or only feeding them to the MD5 sum.  The
+ * decoder is moved there first unless it already is, which it is when
+ * decoding along with the frames being copied.
+ */
+FLAC__bool decode_frame_at_(FLAC__StreamSplicer *splicer, FLAC__StreamSplicerSource *source, FLAC__uint64 offset, FLAC__uint64 sample, FLAC__bool capture)
+{
+	FLAC__uint64 position;
+
+	if(!FLAC__stream_decoder_get_decode_position(source->decoder, &position) || position != offset) {
+		if(!FLAC__stream_decoder_flush(source->decoder))
+			return fail_(splicer, FLAC__STREAM_SPLICER_DECODER_ERROR);
+		source->position = offset;
+	}
+
+	splicer->capture = capture;
+	splicer->decoded_first = (FLAC__uint64)(-1);
+	if(!FLAC__stream_decoder_process_single(source->decoder))
+		return fail_(splicer, FLAC__STREAM_SPLICER_DECODER_ERROR);
+	if(splicer->decoded_first != sample)
+		return fail_(splicer, FLAC__STREAM_SPLICER_BAD_FRAME);
+	return true;
+}
+
+FLAC__bool read_frame_header_(FLAC__StreamSplicer *splicer, const FLAC__StreamSplicerSource *source, FLAC__uint64 offset, FLAC__uint64 sample, FLAC__StreamSplicerFrameHeader *header)
+{
+	size_t available;
+
+	if(!fill_window_(splicer, source, offset, MAX_FRAME_HEADER_LENGTH, &available))
+		return false;
+	if(!parse_frame_header_(splicer->window + (size_t)(offset - splicer->window_offset), available, header) ||
+	   frame_header_sample_(header, &source->stream_info) != sample)
+		return fail_(splicer, FLAC__STREAM_SPLICER_BAD_FRAME);
+	return true;
+}
+
+/* Finds the length of the frame at \a offset, whose header has been
+ * read: the CRC-16 of a whole frame, footer included, comes out zero,
+ * and a false match is ruled out by checking that the header of the
+ * next frame follows.  The frame is left in the window.
+ */
+FLAC__bool find_frame_end_(FLAC__StreamSplicer *splicer, const FLAC__StreamSplicerSource *source, FLAC__uint64 offset, FLAC__uint64 sample, const FLAC__StreamSplicerFrameHeader *header, size_t *bytes)
+{
+	const FLAC__StreamMetadata_StreamInfo *stream_info = &source->stream_info;
+	/* a frame is never much bigger than its samples stored verbatim */
+	const size_t limit = MAX_FRAME_HEADER_LENGTH + 2 + stream_info->channels * (2 + ((size_t)header->blocksize * (stream_info->bits_per_sample + 1) + 7) / 8);
+	const FLAC__byte *b = 0;
+	size_t available = 0, i;
+	unsigned crc = 0;
+
+	for(i = 0; i < limit; ) {
+		if(i + 1 + MAX_FRAME_HEADER_LENGTH > available) {
+			size_t want = i + 1 + MAX_FRAME_HEADER_LENGTH + WINDOW_CHUNK;
+			if(!fill_window_(splicer, source, offset, want < limit + MAX_FRAME_HEADER_LENGTH? want : limit + MAX_FRAME_HEADER_LENGTH, &available))
+				return false;
+			if(i >= available)
+				break;
+			b = splicer->window + (size_t)(offset - splicer->window_offset);
+		}
+		crc = FLAC__CRC16_UPDATE(b[i], crc);
+		i++;
+		if(crc == 0 && i >= header->length + 2) {
+			FLAC__StreamSplicerFrameHeader next;
+			if(parse_frame_header_(b + i, available - i, &next) && frame_header_sample_(&next, stream_info) == sample + header->blocksize) {
+				*bytes = i;
+				return true;
+			}
+		}
+	}
+
+	return fail_(splicer, FLAC__STREAM_SPLICER_BAD_FRAME);
+}
+
+/* Makes the window hold \a bytes bytes of the source from \a offset,
+ * or as many as there are; \a available gets how many it holds.
+ */
+FLAC__bool fill_window_(FLAC__StreamSplicer *splicer, const FLAC__StreamSplicerSource *source, FLAC__uint64 offset, size_t bytes, size_t *available)
+{
+	const FLAC__IOCallbacks *callbacks = &source->segment->callbacks;
+	size_t head;
+
+	if(splicer->window_source != source || offset < splicer->window_offset || offset > splicer->window_offset + splicer->window_length) {
+		splicer->window_source = source;
+		splicer->window_offset = offset;
+		splicer->window_length = 0;
+	}
+	head = (size_t)(offset - splicer->window_offset);
+
+	if(head + bytes > splicer->window_length) {
+		/* drop what is before offset, and grow to fit */
+		if(head > 0) {
+			memmove(splicer->window, splicer->window + head, splicer->window_length - head);
+			splicer->window_length -= head;
+			splicer->window_offset = offset;
+			head = 0;
+		}
+		if(bytes > splicer->window_capacity) {
+			size_t capacity = bytes < WINDOW_CHUNK? WINDOW_CHUNK : bytes;
+			FLAC__byte *window = realloc(splicer->window, capacity);
+			if(0 == window)
+				return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+			splicer->window = window;
+			splicer->window_capacity = capacity;
+		}
+		if(callbacks->seek(source->segment->handle, (FLAC__int64)(splicer->window_offset + splicer->window_length), SEEK_SET) < 0)
+			return fail_(splicer, FLAC__STREAM_SPLICER_SEEK_ERROR);
+		while(splicer->window_length < bytes) {
+			size_t n = callbacks->read(splicer->window + splicer->window_length, 1, splicer->window_capacity - splicer->window_length, source->segment->handle);
+			if(n == 0) {
+				if(0 != callbacks->eof && !callbacks->eof(source->segment->handle))
+					return fail_(splicer, FLAC__STREAM_SPLICER_READ_ERROR);
+				break;
+			}
+			splicer->window_length += n;
+		}
+	}
+
+	*available = splicer->window_length - head < bytes? splicer->window_length - head : bytes;
+	return true;
+}
+
+/* Parses a frame header as far as splicing needs and checks its CRC-8;
+ * returns false if \a b does not hold a valid one.
+ */
+FLAC__bool parse_frame_header_(const FLAC__byte *b, size_t bytes, FLAC__StreamSplicerFrameHeader *header)
+{
+	unsigned i, n, ones, blocksize_code, rate_code;
+	FLAC__uint64 number;
+
+	if(bytes < 6 || b[0] != 0xff || (b[1] & 0xfe) != 0xf8)
+		return false;
+	header->variable = b[1] & 1;
+
+	blocksize_code = b[2] >> 4;
+	rate_code = b[2] & 0x0f;
+	if(blocksize_code == 0 || rate_code == 15)
+		return false;
+	/* reserved channel assignments and sample sizes */
+	if((b[3] >> 4) > 10 || ((b[3] >> 1) & 7) == 3 || ((b[3] >> 1) & 7) == 7 || (b[3] & 1))
+		return false;
+
+	/* the frame or sample number, coded like UTF-8 */
+	for(ones = 0; ones < 8 && (b[4] & (0x80 >> ones)); ones++)
+		;
+	if(ones == 1 || ones == 8 || (ones == 7 && !header->variable))
+		return false;
+	n = ones? ones - 1 : 0; /* continuation bytes */
+	number = b[4] & (0x7f >> ones);
+	if(bytes < 5 + n)
+		return false;
+	for(i = 0; i < n; i++) {
+		if((b[5 + i] & 0xc0) != 0x80)
+			return false;
+		number = (number << 6) | (b[5 + i] & 0x3f);
+	}
+	header->number = number;
+	header->number_end = i = 5 + n;
+
+	if(blocksize_code == 1)
+		header->blocksize = 192;
+	else if(blocksize_code <= 5)
+		header->blocksize = 576 << (blocksize_code - 2);
+	else if(blocksize_code >= 8)
+		header->blocksize = 256 << (blocksize_code - 8);
+	else if(blocksize_code == 6) {
+		if(bytes < i + 1)
+			return false;
+		header->blocksize = b[i] + 1;
+		i += 1;
+	}
+	else {
+		if(bytes < i + 2)
+			return false;
+		header->blocksize = ((unsigned)b[i] << 8 | b[i + 1]) + 1;
+		i += 2;
+	}
+	if(rate_code >= 12)
+		i += rate_code == 12? 1 : 2;
+
+	if(bytes < i + 1 || FLAC__crc8(b, i) != b[i])
+		return false;
+	header->length = i + 1;
+	return true;
+}
+
+FLAC__uint64 frame_header_sample_(const FLAC__StreamSplicerFrameHeader *header, const FLAC__StreamMetadata_StreamInfo *stream_info)
+{
+	if(header->variable)
+		return header->number;
+	/* like the decoder, trust STREAMINFO's blocksize over the frame's,
+	 * which is shorter for the last frame */
+	if(stream_info->min_blocksize == stream_info->max_blocksize)
+		return header->number * stream_info->min_blocksize;
+	return header->number * header->blocksize;
+}
+
+unsigned put_utf8_(FLAC__byte *b, FLAC__uint64 value)
+{
+	static const FLAC__uint64 limit[6] = { 0x80, 0x800, 0x10000, 0x200000, 0x4000000, 0x80000000 };
+	unsigned i, n;
+
+	for(n = 0; n < 6 && value >= limit[n]; n++)
+		;
+	if(n == 0) {
+		b[0] = (FLAC__byte)value;
+		return 1;
+	}
+	b[0] = (FLAC__byte)((0xff << (7 - n)) | (value >> (6 * n)));
+	for(i = 1; i <= n; i++)
+		b[i] = (FLAC__byte)(0x80 | ((value >> (6 * (n - i))) & 0x3f));
+	return n + 1;
+}
+
+/* Writes a frame, copied or from the encoder, with the frame or sample
+ * number for its place in the new stream and new CRCs, and keeps track
+ * of the STREAMINFO values and seek points.
+ */
+FLAC__bool write_frame_(FLAC__StreamSplicer *splicer, const FLAC__byte *buffer, size_t bytes)
+{
+	FLAC__StreamSplicerFrameHeader header;
+	FLAC__StreamMetadata_StreamInfo *stream_info = &splicer->stream_info;
+	const FLAC__uint64 sample = splicer->out_samples;
+	size_t n, body;
+	unsigned crc, i;
+
+	if(!parse_frame_header_(buffer, bytes, &header) || bytes < header.length + 2)
+		return fail_(splicer, FLAC__STREAM_SPLICER_BAD_FRAME);
+	body = bytes - header.length - 2;
+
+	if(splicer->frame_capacity < body + MAX_FRAME_HEADER_LENGTH + 2) {
+		FLAC__byte *frame = realloc(splicer->frame, body + MAX_FRAME_HEADER_LENGTH + 2);
+		if(0 == frame)
+			return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+		splicer->frame = frame;
+		splicer->frame_capacity = body + MAX_FRAME_HEADER_LENGTH + 2;
+	}
+
+	/* the blocksize, sample rate, channel and sample size codes stay,
+	 * only the number and the blocking strategy bit change */
+	splicer->frame[0] = 0xff;
+	splicer->frame[1] = (FLAC__byte)(0xf8 | (splicer->variable_blocksize? 1 : 0));
+	splicer->frame[2] = buffer[2];
+	splicer->frame[3] = buffer[3];
+	FLAC__ASSERT(splicer->variable_blocksize || sample % splicer->blocksize == 0);
+	n = 4 + put_utf8_(splicer->frame + 4, splicer->variable_blocksize? sample : sample / splicer->blocksize);
+	memcpy(splicer->frame + n, buffer + header.number_end, header.length - 1 - header.number_end);
+	n += header.length - 1 - header.number_end;
+	splicer->frame[n] = FLAC__crc8(splicer->frame, (unsigned)n);
+	n++;
+	memcpy(splicer->frame + n, buffer + header.length, body);
+	n += body;
+	crc = FLAC__crc16(splicer->frame, (unsigned)n);
+	splicer->frame[n++] = (FLAC__byte)(crc >> 8);
+	splicer->frame[n++] = (FLAC__byte)crc;
+
+	if(0 != splicer->seek_table) {
+		FLAC__StreamMetadata_SeekTable *seek_table = &splicer->seek_table->data.seek_table;
+		const FLAC__uint64 last_sample = sample + header.blocksize - 1;
+		for(i = splicer->first_seekpoint_to_check; i < seek_table->num_points; i++) {
+			const FLAC__uint64 test_sample = seek_table->points[i].sample_number;
+			if(test_sample > last_sample)
+				break;
+			if(test_sample >= sample) {
+				seek_table->points[i].sample_number = sample;
+				seek_table->points[i].stream_offset = splicer->out_position - splicer->audio_offset;
+				seek_table->points[i].frame_samples = header.blocksize;
+			}
+			splicer->first_seekpoint_to_check++;
+		}
+	}
+
+	if(splicer->frame_count > 0 && (stream_info->min_blocksize == 0 || splicer->last_blocksize < stream_info->min_blocksize))
+		stream_info->min_blocksize = splicer->last_blocksize;
+	if(splicer->frame_count > 0 && splicer->last_blocksize > stream_info->max_blocksize)
+		stream_info->max_blocksize = splicer->last_blocksize;
+	if(stream_info->min_framesize == 0 || n < stream_info->min_framesize)
+		stream_info->min_framesize = (unsigned)n;
+	if(n > stream_info->max_framesize)
+		stream_info->max_framesize = (unsigned)n;
+	splicer->last_blocksize = header.blocksize;
+	splicer->frame_count++;
+	splicer->out_samples += header.blocksize;
+
+	return write_out_(splicer, splicer->frame, n);
+}
+
+FLAC__bool write_out_(FLAC__StreamSplicer *splicer, const FLAC__byte *buffer, size_t bytes)
+{
+	if(splicer->out_callbacks.write(buffer, 1, bytes, splicer->out) != bytes)
+		return fail_(splicer, FLAC__STREAM_SPLICER_WRITE_ERROR);
+	splicer->out_position += bytes;
+	return true;
+}
+
+FLAC__bool seek_out_(FLAC__StreamSplicer *splicer, FLAC__uint64 position)
+{
+	/* relative, as the output need not start at offset 0 */
+	if(splicer->out_callbacks.seek(splicer->out, (FLAC__int64)position - (FLAC__int64)splicer->out_position, SEEK_CUR) < 0)
+		return fail_(splicer, FLAC__STREAM_SPLICER_SEEK_ERROR);
+	splicer->out_position = position;
+	return true;
+}
+
+FLAC__bool append_pending_(FLAC__StreamSplicer *splicer, const FLAC__int32 * const buffer[], unsigned channels, unsigned samples)
+{
+	unsigned channel;
+
+	if(splicer->pending_samples + samples > splicer->pending_capacity) {
+		unsigned capacity = splicer->pending_capacity? splicer->pending_capacity : 4096;
+		while(capacity < splicer->pending_samples + samples)
+			capacity *= 2;
+		for(channel = 0; channel < channels; channel++) {
+			FLAC__int32 *pending = safe_realloc_mul_2op_(splicer->pending[channel], capacity, sizeof(FLAC__int32));
+			if(0 == pending)
+				return fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+			splicer->pending[channel] = pending;
+		}
+		splicer->pending_capacity = capacity;
+	}
+
+	for(channel = 0; channel < channels; channel++)
+		memcpy(splicer->pending[channel] + splicer->pending_samples, buffer[channel], samples * sizeof(FLAC__int32));
+	splicer->pending_samples += samples;
+	return true;
+}
+
+/* Encodes the decoded samples waiting at a boundary; the encoder's
+ * frames go through write_frame_() like the copied ones.
+ */
+FLAC__bool flush_pending_(FLAC__StreamSplicer *splicer)
+{
+	FLAC__StreamEncoder *encoder = splicer->encoder;
+	const FLAC__StreamMetadata_StreamInfo *stream_info = &splicer->stream_info;
+	FLAC__bool ok;
+
+	if(splicer->pending_samples == 0)
+		return true;
+
+	if(!(
+		FLAC__stream_encoder_set_channels(encoder, stream_info->channels) &&
+		FLAC__stream_encoder_set_bits_per_sample(encoder, stream_info->bits_per_sample) &&
+		FLAC__stream_encoder_set_sample_rate(encoder, stream_info->sample_rate) &&
+		FLAC__stream_encoder_set_compression_level(encoder, splicer->compression_level) &&
+		FLAC__stream_encoder_set_blocksize(encoder, splicer->blocksize) &&
+		FLAC__stream_encoder_set_streamable_subset(encoder, false) &&
+		FLAC__stream_encoder_set_total_samples_estimate(encoder, splicer->pending_samples)
+	))
+		return fail_(splicer, FLAC__STREAM_SPLICER_ENCODER_ERROR);
+	if(FLAC__stream_encoder_init_stream(encoder, encoder_write_callback_, 0, 0, 0, splicer) != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+		return fail_(splicer, FLAC__STREAM_SPLICER_ENCODER_ERROR);
+
+	ok = FLAC__stream_encoder_process(encoder, (const FLAC__int32 * const *)splicer->pending, splicer->pending_samples);
+	ok = FLAC__stream_encoder_finish(encoder) && ok;
+	splicer->pending_samples = 0;
+	if(!ok)
+		return fail_(splicer, FLAC__STREAM_SPLICER_ENCODER_ERROR);
+	return true;
+}
+
+FLAC__StreamDecoderReadStatus read_callback_(const FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+	const FLAC__StreamSplicerSegment *segment = source->segment;
+	size_t n;
+
+	(void)decoder;
+	if(*bytes == 0)
+		return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+	/* the window reads from the same handle, so always seek first */
+	if(segment->callbacks.seek(segment->handle, (FLAC__int64)source->position, SEEK_SET) < 0) {
+		(void)fail_(source->splicer, FLAC__STREAM_SPLICER_SEEK_ERROR);
+		return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+	}
+	n = segment->callbacks.read(buffer, 1, *bytes, segment->handle);
+	*bytes = n;
+	if(n == 0) {
+		if(0 != segment->callbacks.eof && !segment->callbacks.eof(segment->handle)) {
+			(void)fail_(source->splicer, FLAC__STREAM_SPLICER_READ_ERROR);
+			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		}
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	source->position += n;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderSeekStatus seek_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+
+	(void)decoder;
+	source->position = absolute_byte_offset;
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+FLAC__StreamDecoderTellStatus tell_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+
+	(void)decoder;
+	*absolute_byte_offset = source->position;
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+FLAC__StreamDecoderLengthStatus length_callback_(const FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+	const FLAC__StreamSplicerSegment *segment = source->segment;
+
+	(void)decoder;
+	if(!source->length_known) {
+		FLAC__int64 length;
+		if(segment->callbacks.seek(segment->handle, 0, SEEK_END) < 0 || (length = segment->callbacks.tell(segment->handle)) < 0)
+			return FLAC__STREAM_DECODER_LENGTH_STATUS_ERROR;
+		source->length = (FLAC__uint64)length;
+		source->length_known = true;
+	}
+	*stream_length = source->length;
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+FLAC__bool eof_callback_(const FLAC__StreamDecoder *decoder, void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+	FLAC__uint64 length;
+
+	if(length_callback_(decoder, &length, client_data) != FLAC__STREAM_DECODER_LENGTH_STATUS_OK)
+		return false;
+	return source->position >= length;
+}
+
+FLAC__StreamDecoderWriteStatus write_callback_(const FLAC__StreamDecoder *decoder, const FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+	FLAC__StreamSplicer *splicer = source->splicer;
+	const FLAC__uint64 first = frame->header.number.sample_number;
+	unsigned samples = frame->header.blocksize;
+
+	(void)decoder;
+	FLAC__ASSERT(frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER);
+
+	splicer->decoded_first = first;
+	splicer->decoded_next = first + samples;
+	if(!splicer->capture) {
+		if(splicer->md5_open && !FLAC__MD5Accumulate(&splicer->md5context, buffer, frame->header.channels, samples, (frame->header.bits_per_sample + 7) / 8)) {
+			(void)fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		}
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+
+	/* a seek hands over the frame already trimmed to the start */
+	if(first >= splicer->capture_end)
+		samples = 0;
+	else if(first + samples > splicer->capture_end)
+		samples = (unsigned)(splicer->capture_end - first);
+	if(frame->header.channels != splicer->stream_info.channels) {
+		(void)fail_(splicer, FLAC__STREAM_SPLICER_FORMAT_MISMATCH);
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	if(!append_pending_(splicer, buffer, frame->header.channels, samples))
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	if(splicer->md5_open && !FLAC__MD5Accumulate(&splicer->md5context, buffer, frame->header.channels, samples, (frame->header.bits_per_sample + 7) / 8)) {
+		(void)fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void metadata_callback_(const FLAC__StreamDecoder *decoder, const FLAC__StreamMetadata *metadata, void *client_data)
+{
+	FLAC__StreamSplicerSource *source = (FLAC__StreamSplicerSource *)client_data;
+	FLAC__StreamSplicer *splicer = source->splicer;
+	FLAC__StreamMetadata *block;
+
+	(void)decoder;
+	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+		source->stream_info = metadata->data.stream_info;
+		source->got_stream_info = true;
+		return;
+	}
+	/* the seek table and cue sheet would not match the new stream */
+	if(metadata->type == FLAC__METADATA_TYPE_SEEKTABLE || metadata->type == FLAC__METADATA_TYPE_CUESHEET)
+		return;
+
+	if(splicer->metadata_count == splicer->metadata_capacity) {
+		unsigned capacity = splicer->metadata_capacity? splicer->metadata_capacity * 2 : 8;
+		FLAC__StreamMetadata **blocks = safe_realloc_mul_2op_(splicer->metadata, capacity, sizeof(FLAC__StreamMetadata *));
+		if(0 == blocks) {
+			(void)fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+			return;
+		}
+		splicer->metadata = blocks;
+		splicer->metadata_capacity = capacity;
+	}
+	if(0 == (block = FLAC__metadata_object_clone(metadata))) {
+		(void)fail_(splicer, FLAC__STREAM_SPLICER_MEMORY_ALLOCATION_ERROR);
+		return;
+	}
+	splicer->metadata[splicer->metadata_count++] = block;
+}
+
+void error_callback_(const FLAC__StreamDecoder *decoder, FLAC__StreamDecoderErrorStatus status, void *client_data)
+{
+	/* lost sync while seeking is expected; a bad frame shows up as the
+	 * wrong sample number in write_callback_() */
+	(void)decoder;
+	(void)status;
+	(void)client_data;
+}
+
+FLAC__StreamEncoderWriteStatus encoder_write_callback_(const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
+{
+	FLAC__StreamSplicer *splicer = (FLAC__StreamSplicer *)client_data;
+
+	(void)encoder;
+	(void)current_frame;
+	/* the encoder's own stream marker and metadata are dropped */
+	if(samples == 0)
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	return write_frame_(splicer, buffer, bytes)? FLAC__STREAM_ENCODER_WRITE_STATUS_OK : FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+}
@@ -0,0 +1,75 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FLAC_winrt/deferral.h"
+#include "private/completion_latch.h"
+
+
+namespace FLAC {
+
+	namespace WindowsRuntime {
+
+		namespace Decoder {
+
+			namespace Callbacks {
+
+				void Deferral::Complete()
+				{
+					::CompletionLatch *latch = latch_.exchange(nullptr);
+					if (nullptr != latch && !latch->Signal(token_)) {
+						throw ref new Platform::COMException(E_NOT_VALID_STATE);
+					}
+				}
+
+				DeferralManager::DeferralManager(::CompletionLatch *latch) :
+					latch_(latch),
+					token_(latch->Begin())
+				{
+				}
+
+				IDeferral^ DeferralManager::GetDeferral()
+				{
+					/* refused once the callback has returned */
+					if (!latch_->AddCount(token_)) {
+						throw ref new Platform::COMException(E_NOT_VALID_STATE);
+					}
+					return ref new Deferral(latch_, token_);
+				}
+
+				void DeferralManager::SignalAndWait()
+				{
+					latch_->SignalAndWait(token_);
+				}
+
+			}
+		}
+	}
+}
@@ -0,0 +1,416 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__PRIVATE__BATCH_DECODER_H
+#define FLACRT__PRIVATE__BATCH_DECODER_H
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FLAC/stream_decoder.h"
+
+
+enum class BatchStatus {
+	Ok,
+	EndOfStream,
+	Error,
+	Cancelled
+};
+
+
+/** Interleaved PCM waiting to be handed out in batches.
+ *
+ *  Frames are packed on arrival in the same layout as
+ *  Helper::pack_sample() (unsigned 8 bit, signed little-endian 16/24/32
+ *  bit), or as 32-bit float with SetFloat(), so a batch can straddle
+ *  frame boundaries and whatever is left of the last frame carries over
+ *  into the next batch.
+ */
+class PcmFifo
+{
+public:
+	PcmFifo() : read_(0), frame_bytes_(0), channels_(0), bits_per_sample_(0), float_(false), gain_(1.0f) { }
+
+	/** Switches between packed and float samples, or changes the gain of
+	 *  float samples.  The samples already waiting are converted, so
+	 *  batches never mix the two and a switch loses nothing.
+	 */
+	void SetFloat(bool value, float gain)
+	{
+		if (GetSamples() > 0) {
+			if (value != float_) {
+				Convert(value, gain);
+			}
+			else if (float_ && gain != gain_) {
+				Rescale(gain);
+			}
+		}
+		float_ = value;
+		gain_ = gain;
+	}
+
+	/** Packs one decoded frame.  Returns false for a sample size that has
+	 *  no packed layout.
+	 */
+	bool Append(const FLAC__int32 *const data[], unsigned blocksize, unsigned channels, unsigned bits_per_sample)
+	{
+		channels_ = channels;
+		bits_per_sample_ = bits_per_sample;
+
+		if (float_) {
+			const size_t offset = data_.size();
+			frame_bytes_ = channels * (unsigned)sizeof(float);
+			data_.resize(offset + (size_t)blocksize * frame_bytes_);
+			/* offsets stay multiples of frame_bytes_, so this is aligned */
+			::FLAC__stream_decoder_interleave_float(data, channels, blocksize, bits_per_sample, gain_, reinterpret_cast<float *>(data_.data() + offset));
+			return true;
+		}
+
+		if (8 != bits_per_sample && 16 != bits_per_sample && 24 != bits_per_sample && 32 != bits_per_sample) {
+			return false;
+		}
+
+		const unsigned sample_bytes = bits_per_sample / 8;
+		const size_t offset = data_.size();
+		frame_bytes_ = channels * sample_bytes;
+		data_.resize(offset + (size_t)blocksize * frame_bytes_);
+
+		FLAC__byte *out = &data_[offset];
+		for (unsigned i = 0; i < blocksize; i++) {
+			for (unsigned j = 0; j < channels; j++) {
+				FLAC__int32 sample = data[j][i];
+				if (8 == bits_per_sample) {
+					*out++ = (FLAC__byte)(sample + 0x80);
+					continue;
+				}
+				for (unsigned k = 0; k < sample_bytes; k++) {
+					*out++ = (FLAC__byte)((sample >> (8 * k)) & 0xFF);
+				}
+			}
+		}
+		return true;
+	}
+
+	/** Number of whole inter-channel samples waiting. */
+	size_t GetSamples() const
+	{
+		return 0 == frame_bytes_ ? 0 : (data_.size() - read_) / frame_bytes_;
+	}
+
+	/** Moves up to \a samples inter-channel samples into \a out,
+	 *  replacing its contents.
+	 */
+	void Take(size_t samples, std::vector<FLAC__byte> &out)
+	{
+		size_t available = GetSamples();
+		size_t bytes = (samples < available ? samples : available) * frame_bytes_;
+
+		out.assign(data_.begin() + read_, data_.begin() + read_ + bytes);
+		read_ += bytes;
+
+		if (read_ == data_.size()) {
+			data_.clear();
+			read_ = 0;
+		}
+		else if (read_ > data_.size() / 2) {
+			data_.erase(data_.begin(), data_.begin() + read_);
+			read_ = 0;
+		}
+	}
+
+	/** Drops everything; call when the decoder's position jumps. */
+	void Clear()
+	{
+		data_.clear();
+		read_ = 0;
+	}
+
+private:
+	/* full scale is 2^(bps-1), as in FLAC__stream_decoder_interleave_float() */
+	double FullScale() const
+	{
+		return (double)((FLAC__uint64)1 << (bits_per_sample_ - 1));
+	}
+
+	/** Rewrites the waiting samples in the other format.  Float samples
+	 *  go back to packed ones by undoing the gain, which is exact up to
+	 *  24 bits; after a gain of 0 they stay silent.
+	 */
+	void Convert(bool to_float, float gain)
+	{
+		const size_t samples = GetSamples() * channels_;
+		const FLAC__byte *in = &data_[read_];
+		std::vector<FLAC__byte> converted;
+
+		if (to_float) {
+			const unsigned sample_bytes = bits_per_sample_ / 8;
+			const unsigned shift = 32 - 8 * sample_bytes;
+			const float scale = (float)(gain / FullScale());
+
+			converted.resize(samples * sizeof(float));
+			float *out = reinterpret_cast<float *>(converted.data());
+			for (size_t i = 0; i < samples; i++, in += sample_bytes) {
+				FLAC__int32 sample;
+				if (1 == sample_bytes) {
+					sample = (FLAC__int32)in[0] - 0x80;
+				}
+				else {
+					FLAC__uint32 bits = 0;
+					for (unsigned k = 0; k < sample_bytes; k++) {
+						bits |= (FLAC__uint32)in[k] << (8 * k);
+					}
+					sample = (FLAC__int32)(bits << shift) >> shift;
+				}
+				out[i] = (float)sample * scale;
+			}
+			frame_bytes_ = channels_ * (unsigned)sizeof(float);
+		}
+		else {
+			if (8 != bits_per_sample_ && 16 != bits_per_sample_ && 24 != bits_per_sample_ && 32 != bits_per_sample_) {
+				/* Append() refuses these too */
+				Clear();
+				return;
+			}
+
+			const unsigned sample_bytes = bits_per_sample_ / 8;
+			const double scale = 0.0f == gain_ ? 0.0 : FullScale() / gain_;
+			const double high = FullScale() - 1.0, low = -FullScale();
+
+			converted.resize(samples * sample_bytes);
+			const float *floats = reinterpret_cast<const float *>(in);
+			FLAC__byte *out = converted.data();
+			for (size_t i = 0; i < samples; i++) {
+				double value = std::floor(floats[i] * scale + 0.5);
+				const FLAC__int32 sample = (FLAC__int32)(value > high ? high : value < low ? low : value);
+				if (1 == sample_bytes) {
+					*out++ = (FLAC__byte)(sample + 0x80);
+					continue;
+				}
+				for (unsigned k = 0; k < sample_bytes; k++) {
+					*out++ = (FLAC__byte)((sample >> (8 * k)) & 0xFF);
+				}
+			}
+			frame_bytes_ = channels_ * sample_bytes;
+		}
+
+		data_.swap(converted);
+		read_ = 0;
+	}
+
+	void Rescale(float gain)
+	{
+		/* silence stays silence */
+		if (0.0f == gain_) {
+			return;
+		}
+
+		const float factor = gain / gain_;
+		float *samples = reinterpret_cast<float *>(&data_[read_]);
+		for (size_t i = 0, n = GetSamples() * channels_; i < n; i++) {
+			samples[i] *= factor;
+		}
+	}
+
+	std::vector<FLAC__byte> data_;
+	size_t read_;
+	unsigned frame_bytes_;
+	unsigned channels_;
+	unsigned bits_per_sample_;
+	bool float_;
+	float gain_;
+};
+
+
+/** Runs \a decoder until \a fifo holds \a samples inter-channel samples or
+ *  the stream ends, then moves them into \a out.  The decoder's write
+ *  callback is expected to feed \a fifo.  \a cancelled is polled between
+ *  frames.
+ */
+inline BatchStatus decode_batch(::FLAC__StreamDecoder *decoder, PcmFifo &fifo, size_t samples, std::vector<FLAC__byte> &out, const std::atomic<bool> &cancelled)
+{
+	while (fifo.GetSamples() < samples) {
+		if (cancelled) {
+			return BatchStatus::Cancelled;
+		}
+		if (FLAC__STREAM_DECODER_END_OF_STREAM == ::FLAC__stream_decoder_get_state(decoder)) {
+			break;
+		}
+		if (!::FLAC__stream_decoder_process_single(decoder)) {
+			return BatchStatus::Error;
+		}
+	}
+
+	fifo.Take(samples, out);
+	return out.empty() ? BatchStatus::EndOfStream : BatchStatus::Ok;
+}
+
+
+/** Bounded queue of decoded batches filled by one worker thread.
+ *
+ *  The worker calls the producer whenever fewer than \a depth batches are
+ *  waiting, so a depth of 2 gives double buffering: one batch is played
+ *  while the next one is decoded.  The producer owns the decoder for as
+ *  long as the queue runs.  The worker stops after the producer reports
+ *  anything other than BatchStatus::Ok, or when the queue is stopped.
+ */
+class DecodeQueue
+{
+public:
+	typedef std::function<BatchStatus(std::vector<FLAC__byte> &buffer, const std::atomic<bool> &cancelled)> Producer;
+
+	DecodeQueue(const Producer &producer, size_t depth) :
+		producer_(producer),
+		depth_(0 == depth ? 1 : depth),
+		cancelled_(false),
+		finished_(false),
+		status_(BatchStatus::Ok)
+	{
+	}
+
+	~DecodeQueue()
+	{
+		Stop();
+	}
+
+	void Start()
+	{
+		worker_ = std::thread(&DecodeQueue::Run, this);
+	}
+
+	/** Waits for the next batch.  Returns BatchStatus::Ok with the batch in
+	 *  \a buffer, or, once every batch has been handed out, the status the
+	 *  worker stopped with.  Returns BatchStatus::Cancelled after Stop(),
+	 *  or once \a abandoned is set and Wake() called; that gives up this
+	 *  wait alone, and leaves the queue running and the next batch for the
+	 *  next Pop().
+	 */
+	BatchStatus Pop(std::vector<FLAC__byte> &buffer, const std::atomic<bool> &abandoned)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		ready_.wait(lock, [this, &abandoned] { return !batches_.empty() || finished_ || cancelled_ || abandoned; });
+
+		if (cancelled_ || abandoned) {
+			return BatchStatus::Cancelled;
+		}
+		if (batches_.empty()) {
+			return status_;
+		}
+
+		buffer.swap(batches_.front());
+		batches_.pop_front();
+		space_.notify_one();
+		return BatchStatus::Ok;
+	}
+
+	BatchStatus Pop(std::vector<FLAC__byte> &buffer)
+	{
+		const std::atomic<bool> never(false);
+		return Pop(buffer, never);
+	}
+
+	/** Makes every waiting Pop() look at its \a abandoned flag again. */
+	void Wake()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		ready_.notify_all();
+	}
+
+	/** Stops the worker after the frame it is decoding, fails every
+	 *  waiting and later Pop() with BatchStatus::Cancelled, and waits for
+	 *  the worker, after which the producer is no longer running.
+	 */
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			cancelled_ = true;
+			ready_.notify_all();
+			space_.notify_all();
+		}
+		if (worker_.joinable()) {
+			worker_.join();
+		}
+	}
+
+private:
+	DecodeQueue(const DecodeQueue &);
+	DecodeQueue &operator=(const DecodeQueue &);
+
+	void Run()
+	{
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				space_.wait(lock, [this] { return batches_.size() < depth_ || cancelled_; });
+				if (cancelled_) {
+					break;
+				}
+			}
+
+			std::vector<FLAC__byte> buffer;
+			BatchStatus status = producer_(buffer, cancelled_);
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (BatchStatus::Ok != status) {
+				status_ = status;
+				finished_ = true;
+				ready_.notify_all();
+				break;
+			}
+			batches_.push_back(std::vector<FLAC__byte>());
+			batches_.back().swap(buffer);
+			ready_.notify_one();
+		}
+	}
+
+	Producer producer_;
+	size_t depth_;
+
+	std::mutex mutex_;
+	std::condition_variable ready_;
+	std::condition_variable space_;
+	std::deque<std::vector<FLAC__byte> > batches_;
+
+	std::atomic<bool> cancelled_;
+	bool finished_;
+	BatchStatus status_;
+
+	std::thread worker_;
+};
+
+#endif
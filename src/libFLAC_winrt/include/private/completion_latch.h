@@ -0,0 +1,232 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__PRIVATE__COMPLETION_LATCH_H
+#define FLACRT__PRIVATE__COMPLETION_LATCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined _WIN32
+#include <windows.h>
+#if _WIN32_WINNT >= 0x0602 /* _WIN32_WINNT_WIN8 */
+#define FLACRT__LATCH_WAIT_ON_ADDRESS
+#pragma comment(lib, "Synchronization.lib")
+#endif
+#elif defined __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define FLACRT__LATCH_FUTEX
+#endif
+
+#if !defined FLACRT__LATCH_WAIT_ON_ADDRESS && !defined FLACRT__LATCH_FUTEX
+#include <condition_variable>
+#include <mutex>
+#endif
+
+
+/** Counts outstanding deferrals of one callback at a time and lets the
+ *  decoder thread wait for them.
+ *
+ *  The whole state is one 32-bit word: the outstanding count in the low
+ *  15 bits, a "someone is asleep" bit, and a 16-bit generation that
+ *  Begin() advances for every callback.  Counting is a compare-and-swap
+ *  on that word, so a callback whose handlers take no deferral costs two
+ *  atomic operations and no allocation.  Wait() spins briefly and then
+ *  sleeps on the word itself (futex on Linux, WaitOnAddress on Windows 8
+ *  and later); Signal() only wakes anyone when the sleeping bit is set.
+ *
+ *  The token returned by Begin() ties a deferral to its callback, so a
+ *  deferral taken from the event arguments of an earlier callback is
+ *  refused rather than holding up the current one.
+ */
+class CompletionLatch
+{
+public:
+	CompletionLatch() : state_(0) { }
+
+	/** Starts the next round, held once by the caller.  The previous round
+	 *  must have been waited for.
+	 */
+	unsigned Begin()
+	{
+		const std::uint32_t generation = ((state_.load(std::memory_order_relaxed) >> GenerationShift) + 1) & GenerationMask;
+		state_.store(generation << GenerationShift | 1, std::memory_order_release);
+		return generation;
+	}
+
+	/** Adds a hold to round \a token; false if that round has completed. */
+	bool AddCount(unsigned token)
+	{
+		std::uint32_t state = state_.load(std::memory_order_relaxed);
+		for (;;) {
+			const std::uint32_t count = state & CountMask;
+			if (!IsCurrent(state, token) || 0 == count || CountMask == count) {
+				return false;
+			}
+			if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+	}
+
+	/** Releases a hold on round \a token; false if it had none left. */
+	bool Signal(unsigned token)
+	{
+		std::uint32_t state = state_.load(std::memory_order_relaxed);
+		for (;;) {
+			const std::uint32_t count = state & CountMask;
+			if (!IsCurrent(state, token) || 0 == count) {
+				return false;
+			}
+
+			/* the last release clears the sleeping bit and wakes the sleeper */
+			const std::uint32_t next = 1 == count ? state & ~(CountMask | SleepingBit) : state - 1;
+			if (state_.compare_exchange_weak(state, next, std::memory_order_release, std::memory_order_relaxed)) {
+				if (1 == count && 0 != (state & SleepingBit)) {
+					WakeAll();
+				}
+				return true;
+			}
+		}
+	}
+
+	/** Blocks until every hold on round \a token has been released. */
+	void Wait(unsigned token)
+	{
+		/* on a single processor the completing thread cannot run while
+		 * this one spins */
+		static const unsigned spin_count = std::thread::hardware_concurrency() > 1 ? SpinCount : 0;
+		for (unsigned spin = 0; spin < spin_count; spin++) {
+			if (IsDone(state_.load(std::memory_order_acquire), token)) {
+				return;
+			}
+			Relax();
+		}
+
+		std::uint32_t state = state_.load(std::memory_order_acquire);
+		while (!IsDone(state, token)) {
+			if (0 == (state & SleepingBit) &&
+				!state_.compare_exchange_weak(state, state | SleepingBit, std::memory_order_acquire, std::memory_order_acquire)) {
+				continue;
+			}
+			WaitForChange(state | SleepingBit);
+			state = state_.load(std::memory_order_acquire);
+		}
+	}
+
+	void SignalAndWait(unsigned token)
+	{
+		(void)Signal(token);
+		Wait(token);
+	}
+
+private:
+	CompletionLatch(const CompletionLatch &);
+	CompletionLatch &operator=(const CompletionLatch &);
+
+	static const std::uint32_t CountMask = 0x7FFF;
+	static const std::uint32_t SleepingBit = 0x8000;
+	static const unsigned GenerationShift = 16;
+	static const std::uint32_t GenerationMask = 0xFFFF;
+
+	/* a deferral completed by a continuation on another core usually lands
+	 * within a few microseconds, which is cheaper to spin through than to
+	 * sleep and be woken */
+	static const unsigned SpinCount = 4000;
+
+	static bool IsCurrent(std::uint32_t state, unsigned token)
+	{
+		return (state >> GenerationShift) == token;
+	}
+
+	static bool IsDone(std::uint32_t state, unsigned token)
+	{
+		return !IsCurrent(state, token) || 0 == (state & CountMask);
+	}
+
+	static void Relax()
+	{
+#if defined _WIN32
+		YieldProcessor();
+#elif defined __i386__ || defined __x86_64__
+		__builtin_ia32_pause();
+#elif defined __arm__ || defined __aarch64__
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+#if defined FLACRT__LATCH_WAIT_ON_ADDRESS
+	void WaitForChange(std::uint32_t expected)
+	{
+		(void)::WaitOnAddress(&state_, &expected, sizeof(expected), INFINITE);
+	}
+
+	void WakeAll()
+	{
+		::WakeByAddressAll(&state_);
+	}
+#elif defined FLACRT__LATCH_FUTEX
+	void WaitForChange(std::uint32_t expected)
+	{
+		(void)syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&state_), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+	}
+
+	void WakeAll()
+	{
+		(void)syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&state_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+#else
+	/* without a wait-on-address primitive the word is re-checked under a
+	 * lock, which only the sleeping path ever takes */
+	void WaitForChange(std::uint32_t expected)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		condition_.wait(lock, [this, expected]() { return state_.load(std::memory_order_acquire) != expected; });
+	}
+
+	void WakeAll()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		condition_.notify_all();
+	}
+
+	std::mutex mutex_;
+	std::condition_variable condition_;
+#endif
+
+	std::atomic<std::uint32_t> state_;
+};
+
+#endif
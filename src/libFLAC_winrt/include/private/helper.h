@@ -32,6 +32,13 @@
 #ifndef FLACRT__PRIVATE__HELPER_H
 #define FLACRT__PRIVATE__HELPER_H
 
+#include <ppltasks.h>
+#include <robuffer.h>
+#include <vector>
+#include <wrl/client.h>
+
+#include "FLAC/stream_decoder.h"
+#include "private/batch_decoder.h"
 
 struct Helper
 {
@@ -102,6 +109,42 @@ public:
 			throw ref new Platform::InvalidArgumentException("Invalid bits per sample count.");
 		}
 	}
+
+	/* converts straight into the IBuffer's memory, so the samples are touched once */
+	static inline Windows::Storage::Streams::IBuffer^ pack_float(const int* const data[], unsigned blocksize, unsigned channels, unsigned bits_per_sample, float gain)
+	{
+		const unsigned int length = blocksize * channels * sizeof(float);
+		Windows::Storage::Streams::Buffer^ buffer = ref new Windows::Storage::Streams::Buffer(length);
+		Microsoft::WRL::ComPtr<Windows::Storage::Streams::IBufferByteAccess> byteAccess;
+		byte *bytes = nullptr;
+
+		if (FAILED(reinterpret_cast<IInspectable *>(buffer)->QueryInterface(IID_PPV_ARGS(&byteAccess))) || FAILED(byteAccess->Buffer(&bytes))) {
+			throw ref new Platform::COMException(E_NOINTERFACE);
+		}
+		::FLAC__stream_decoder_interleave_float(data, channels, blocksize, bits_per_sample, gain, reinterpret_cast<float *>(bytes));
+		buffer->Length = length;
+		return buffer;
+	}
+
+	/* turns the outcome of a decode_batch() or DecodeQueue::Pop() into the
+	 * result of an IAsyncOperation body */
+	static inline Windows::Storage::Streams::IBuffer^ complete_batch(BatchStatus status, std::vector<FLAC__byte> &pcm)
+	{
+		switch (status) {
+		case BatchStatus::Cancelled:
+			concurrency::cancel_current_task();
+		case BatchStatus::Error:
+			throw ref new Platform::COMException(E_FAIL);
+		default:
+			break;
+		}
+
+		Windows::Storage::Streams::DataWriter^ dataWriter = ref new Windows::Storage::Streams::DataWriter();
+		if (!pcm.empty()) {
+			dataWriter->WriteBytes(Platform::ArrayReference<FLAC__byte>(pcm.data(), (unsigned int)pcm.size()));
+		}
+		return dataWriter->DetachBuffer();
+	}
 };
 
 
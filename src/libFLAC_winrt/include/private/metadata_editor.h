@@ -0,0 +1,567 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__PRIVATE__METADATA_EDITOR_H
+#define FLACRT__PRIVATE__METADATA_EDITOR_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FLAC/metadata.h"
+#include "FLAC/stream_splicer.h"
+
+
+/** Seekable byte stream behind a MetadataEditor, driven through
+ *  FLAC__IOCallbacks.  The methods follow the stdio semantics the
+ *  callbacks expect: Seek() takes SEEK_SET, SEEK_CUR or SEEK_END, and
+ *  Read() returns 0 at the end of the stream.  SetLength() is used after a
+ *  rewrite that made the stream shorter, and Flush() once a write is done.
+ */
+class MetadataStream
+{
+public:
+	virtual ~MetadataStream() { }
+
+	virtual size_t Read(void *buffer, size_t bytes) = 0;
+	virtual size_t Write(const void *buffer, size_t bytes) = 0;
+	virtual bool Seek(FLAC__int64 offset, int whence) = 0;
+	virtual FLAC__int64 Tell() = 0;
+	virtual bool Eof() = 0;
+	virtual bool SetLength(FLAC__uint64 length) = 0;
+	virtual bool Flush() = 0;
+
+	static FLAC__IOCallbacks GetCallbacks()
+	{
+		FLAC__IOCallbacks callbacks = { read_, write_, seek_, tell_, eof_, /*close=*/0 };
+		return callbacks;
+	}
+
+private:
+	static size_t read_(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+	{
+		return 0 == size ? 0 : static_cast<MetadataStream *>(handle)->Read(ptr, size * nmemb) / size;
+	}
+
+	static size_t write_(const void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+	{
+		return 0 == size ? 0 : static_cast<MetadataStream *>(handle)->Write(ptr, size * nmemb) / size;
+	}
+
+	static int seek_(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+	{
+		return static_cast<MetadataStream *>(handle)->Seek(offset, whence) ? 0 : -1;
+	}
+
+	static FLAC__int64 tell_(FLAC__IOHandle handle)
+	{
+		return static_cast<MetadataStream *>(handle)->Tell();
+	}
+
+	static int eof_(FLAC__IOHandle handle)
+	{
+		return static_cast<MetadataStream *>(handle)->Eof() ? 1 : 0;
+	}
+};
+
+
+/** Reads and edits the metadata of one FLAC stream through a
+ *  FLAC__Metadata_Chain, without decoding any audio.
+ *
+ *  PICTURE data is left in the stream when reading and loaded only by
+ *  GetPicture(), so reading tags costs one pass over the block headers.
+ *  Write() updates the stream in place whenever the edited blocks fit in
+ *  the existing metadata plus padding; otherwise it needs a scratch
+ *  stream to build the new file in, which is then copied back.  Ogg FLAC
+ *  can be read but not written.
+ *
+ *  Block pointers handed out stay valid until the next edit or Read().
+ */
+class MetadataEditor
+{
+public:
+	MetadataEditor() :
+		chain_(::FLAC__metadata_chain_new()),
+		iterator_(::FLAC__metadata_iterator_new()),
+		stream_(nullptr)
+	{
+		if (nullptr != chain_) {
+			::FLAC__metadata_chain_set_lazy_pictures(chain_, true);
+			/* CanWriteInPlace() is asked before Write() sorts the padding to the end */
+			::FLAC__metadata_chain_set_any_padding(chain_, true);
+		}
+	}
+
+	~MetadataEditor()
+	{
+		if (nullptr != iterator_) {
+			::FLAC__metadata_iterator_delete(iterator_);
+		}
+		if (nullptr != chain_) {
+			::FLAC__metadata_chain_delete(chain_);
+		}
+	}
+
+	bool IsValid() const
+	{
+		return nullptr != chain_ && nullptr != iterator_;
+	}
+
+	/** Reads the metadata of \a stream, which must stay open for
+	 *  GetPicture() and Write().
+	 */
+	bool Read(MetadataStream *stream, bool ogg)
+	{
+		stream_ = stream;
+		return ogg ?
+			!!::FLAC__metadata_chain_read_ogg_with_callbacks(chain_, stream, MetadataStream::GetCallbacks()) :
+			!!::FLAC__metadata_chain_read_with_callbacks(chain_, stream, MetadataStream::GetCallbacks());
+	}
+
+	::FLAC__Metadata_ChainStatus GetStatus()
+	{
+		return ::FLAC__metadata_chain_status(chain_);
+	}
+
+	const ::FLAC__StreamMetadata *GetStreamInfo()
+	{
+		return FindBlock(FLAC__METADATA_TYPE_STREAMINFO, 0);
+	}
+
+	unsigned GetBlockCount()
+	{
+		unsigned count = 0;
+		::FLAC__metadata_iterator_init(iterator_, chain_);
+		do {
+			count++;
+		} while (::FLAC__metadata_iterator_next(iterator_));
+		return count;
+	}
+
+	const ::FLAC__StreamMetadata *GetBlock(unsigned index)
+	{
+		::FLAC__metadata_iterator_init(iterator_, chain_);
+		while (index-- > 0) {
+			if (!::FLAC__metadata_iterator_next(iterator_)) {
+				return nullptr;
+			}
+		}
+		return ::FLAC__metadata_iterator_get_block(iterator_);
+	}
+
+	/** Appends the values of every \a name tag to \a values. */
+	void GetTag(const char *name, std::vector<std::string> &values)
+	{
+		const ::FLAC__StreamMetadata *tags = FindBlock(FLAC__METADATA_TYPE_VORBIS_COMMENT, 0);
+		if (nullptr == tags) {
+			return;
+		}
+
+		const size_t name_length = strlen(name);
+		for (FLAC__uint32 i = 0; i < tags->data.vorbis_comment.num_comments; i++) {
+			const ::FLAC__StreamMetadata_VorbisComment_Entry &entry = tags->data.vorbis_comment.comments[i];
+			if (::FLAC__metadata_object_vorbiscomment_entry_matches(entry, name, (unsigned)name_length)) {
+				const char *value = reinterpret_cast<const char *>(entry.entry) + name_length + 1;
+				values.push_back(std::string(value, entry.length - name_length - 1));
+			}
+		}
+	}
+
+	/** Replaces every \a name tag with one holding \a value. */
+	bool SetTag(const char *name, const char *value)
+	{
+		::FLAC__StreamMetadata *tags = GetOrAddTags();
+		::FLAC__StreamMetadata_VorbisComment_Entry entry;
+		if (nullptr == tags || !::FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(&entry, name, value)) {
+			return false;
+		}
+		if (!::FLAC__metadata_object_vorbiscomment_replace_comment(tags, entry, /*all=*/true, /*copy=*/false)) {
+			free(entry.entry);
+			return false;
+		}
+		return true;
+	}
+
+	bool AddTag(const char *name, const char *value)
+	{
+		::FLAC__StreamMetadata *tags = GetOrAddTags();
+		::FLAC__StreamMetadata_VorbisComment_Entry entry;
+		if (nullptr == tags || !::FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(&entry, name, value)) {
+			return false;
+		}
+		if (!::FLAC__metadata_object_vorbiscomment_append_comment(tags, entry, /*copy=*/false)) {
+			free(entry.entry);
+			return false;
+		}
+		return true;
+	}
+
+	/** Returns the number of tags removed, or -1 on error. */
+	int RemoveTag(const char *name)
+	{
+		::FLAC__StreamMetadata *tags = FindBlock(FLAC__METADATA_TYPE_VORBIS_COMMENT, 0);
+		return nullptr == tags ? 0 : ::FLAC__metadata_object_vorbiscomment_remove_entries_matching(tags, name);
+	}
+
+	unsigned GetPictureCount()
+	{
+		unsigned count = 0;
+		::FLAC__metadata_iterator_init(iterator_, chain_);
+		do {
+			if (FLAC__METADATA_TYPE_PICTURE == ::FLAC__metadata_iterator_get_block_type(iterator_)) {
+				count++;
+			}
+		} while (::FLAC__metadata_iterator_next(iterator_));
+		return count;
+	}
+
+	/** Returns the \a index th PICTURE block, reading its data from the
+	 *  stream first if \a load_data is set.
+	 */
+	const ::FLAC__StreamMetadata *GetPicture(unsigned index, bool load_data)
+	{
+		::FLAC__StreamMetadata *picture = FindBlock(FLAC__METADATA_TYPE_PICTURE, index);
+		if (nullptr != picture && load_data && nullptr != stream_ &&
+			!::FLAC__metadata_object_picture_load_data(picture, stream_, MetadataStream::GetCallbacks())) {
+			return nullptr;
+		}
+		return picture;
+	}
+
+	/** Adds \a picture after the last non-padding block and takes
+	 *  ownership of it.
+	 */
+	bool AddPicture(::FLAC__StreamMetadata *picture)
+	{
+		::FLAC__metadata_iterator_init(iterator_, chain_);
+		while (::FLAC__metadata_iterator_next(iterator_)) {
+		}
+		while (FLAC__METADATA_TYPE_PADDING == ::FLAC__metadata_iterator_get_block_type(iterator_) && ::FLAC__metadata_iterator_prev(iterator_)) {
+		}
+		return !!::FLAC__metadata_iterator_insert_block_after(iterator_, picture);
+	}
+
+	/** Removes the \a index th PICTURE block, leaving padding in its
+	 *  place so the stream can be updated in place.
+	 */
+	bool RemovePicture(unsigned index)
+	{
+		if (nullptr == FindBlock(FLAC__METADATA_TYPE_PICTURE, index)) {
+			return false;
+		}
+		return !!::FLAC__metadata_iterator_delete_block(iterator_, /*replace_with_padding=*/true);
+	}
+
+	/** True if Write() can update the stream without a scratch stream. */
+	bool CanWriteInPlace()
+	{
+		return !::FLAC__metadata_chain_check_if_tempfile_needed(chain_, /*use_padding=*/true);
+	}
+
+	/** Writes the edited metadata back to the stream given to Read(),
+	 *  using padding to avoid moving the audio.  If the metadata grew
+	 *  beyond what padding covers, the whole stream is rebuilt in
+	 *  \a scratch and copied back; without a scratch stream that case
+	 *  fails with FLAC__METADATA_CHAIN_STATUS_WRONG_WRITE_CALL.
+	 */
+	bool Write(MetadataStream *scratch)
+	{
+		if (nullptr == stream_) {
+			return false;
+		}
+
+		/* an Ogg chain or a missing scratch stream fail here with the
+		 * matching chain status */
+		::FLAC__metadata_chain_sort_padding(chain_);
+		if (nullptr == scratch || CanWriteInPlace()) {
+			return ::FLAC__metadata_chain_write_with_callbacks(chain_, /*use_padding=*/true, stream_, MetadataStream::GetCallbacks()) && stream_->Flush();
+		}
+
+		/* the chain reads the audio from the original and writes the whole
+		 * stream to the scratch one, which then replaces the original */
+		if (!::FLAC__metadata_chain_write_with_callbacks_and_tempfile(chain_, /*use_padding=*/true, stream_, MetadataStream::GetCallbacks(), scratch, MetadataStream::GetCallbacks())) {
+			return false;
+		}
+		return CopyBack(scratch);
+	}
+
+private:
+	MetadataEditor(const MetadataEditor &);
+	MetadataEditor &operator=(const MetadataEditor &);
+
+	::FLAC__StreamMetadata *FindBlock(::FLAC__MetadataType type, unsigned index)
+	{
+		::FLAC__metadata_iterator_init(iterator_, chain_);
+		do {
+			if (type == ::FLAC__metadata_iterator_get_block_type(iterator_) && 0 == index--) {
+				return ::FLAC__metadata_iterator_get_block(iterator_);
+			}
+		} while (::FLAC__metadata_iterator_next(iterator_));
+		return nullptr;
+	}
+
+	::FLAC__StreamMetadata *GetOrAddTags()
+	{
+		::FLAC__StreamMetadata *tags = FindBlock(FLAC__METADATA_TYPE_VORBIS_COMMENT, 0);
+		if (nullptr != tags) {
+			return tags;
+		}
+
+		/* right after STREAMINFO, where readers look first */
+		if (nullptr == (tags = ::FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT))) {
+			return nullptr;
+		}
+		::FLAC__metadata_iterator_init(iterator_, chain_);
+		if (!::FLAC__metadata_iterator_insert_block_after(iterator_, tags)) {
+			::FLAC__metadata_object_delete(tags);
+			return nullptr;
+		}
+		return tags;
+	}
+
+	bool CopyBack(MetadataStream *scratch)
+	{
+		FLAC__byte buffer[64 * 1024];
+		FLAC__uint64 length = 0;
+		size_t n;
+
+		if (!scratch->Seek(0, SEEK_SET) || !stream_->Seek(0, SEEK_SET)) {
+			return false;
+		}
+		while (0 < (n = scratch->Read(buffer, sizeof(buffer)))) {
+			if (stream_->Write(buffer, n) != n) {
+				return false;
+			}
+			length += n;
+		}
+		return stream_->SetLength(length) && stream_->Flush();
+	}
+
+	::FLAC__Metadata_Chain *chain_;
+	::FLAC__Metadata_Iterator *iterator_;
+	MetadataStream *stream_;
+};
+
+
+/** Cuts and joins ranges of FLAC streams through a FLAC__StreamSplicer.
+ *
+ *  Owns the MetadataStream of every added range.  The output goes
+ *  through a buffer, so the frame-sized writes of the splicer reach the
+ *  stream in large blocks.
+ */
+class StreamSplicer
+{
+public:
+	static const size_t OutputBufferSize = 256 * 1024;
+
+	StreamSplicer() :
+		splicer_(::FLAC__stream_splicer_new()),
+		output_(nullptr)
+	{
+	}
+
+	~StreamSplicer()
+	{
+		if (nullptr != splicer_) {
+			::FLAC__stream_splicer_delete(splicer_);
+		}
+		for (size_t i = 0; i < sources_.size(); i++) {
+			delete sources_[i];
+		}
+	}
+
+	bool IsValid() const
+	{
+		return nullptr != splicer_;
+	}
+
+	bool SetMd5(bool value)
+	{
+		return !!::FLAC__stream_splicer_set_md5(splicer_, value);
+	}
+
+	bool SetCompressionLevel(unsigned value)
+	{
+		return !!::FLAC__stream_splicer_set_compression_level(splicer_, value);
+	}
+
+	/** Adds a range of \a source and takes ownership of it. */
+	bool AddSegment(MetadataStream *source, FLAC__uint64 start_sample, FLAC__uint64 samples)
+	{
+		sources_.push_back(source);
+		return !!::FLAC__stream_splicer_add_segment(splicer_, source, MetadataStream::GetCallbacks(), start_sample, samples);
+	}
+
+	/** Writes the new stream to \a output from its start and cuts off
+	 *  whatever \a output held beyond it.
+	 */
+	bool Splice(MetadataStream *output)
+	{
+		FLAC__IOCallbacks callbacks = { /*read=*/0, write_, seek_, /*tell=*/0, /*eof=*/0, /*close=*/0 };
+
+		output_ = output;
+		buffer_.clear();
+		bool ok = !!::FLAC__stream_splicer_splice(splicer_, this, callbacks) && Drain();
+		output_ = nullptr;
+		return ok && output->SetLength((FLAC__uint64)output->Tell()) && output->Flush();
+	}
+
+	::FLAC__StreamSplicerStatus GetStatus()
+	{
+		return ::FLAC__stream_splicer_get_status(splicer_);
+	}
+
+private:
+	StreamSplicer(const StreamSplicer &);
+	StreamSplicer &operator=(const StreamSplicer &);
+
+	bool Drain()
+	{
+		if (buffer_.empty()) {
+			return true;
+		}
+		bool ok = output_->Write(&buffer_[0], buffer_.size()) == buffer_.size();
+		buffer_.clear();
+		return ok;
+	}
+
+	static size_t write_(const void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+	{
+		StreamSplicer *splicer = static_cast<StreamSplicer *>(handle);
+		const FLAC__byte *bytes = static_cast<const FLAC__byte *>(ptr);
+
+		splicer->buffer_.insert(splicer->buffer_.end(), bytes, bytes + size * nmemb);
+		if (splicer->buffer_.size() >= OutputBufferSize && !splicer->Drain()) {
+			return 0;
+		}
+		return nmemb;
+	}
+
+	/* the splicer only seeks back to fill in STREAMINFO and SEEKTABLE */
+	static int seek_(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+	{
+		StreamSplicer *splicer = static_cast<StreamSplicer *>(handle);
+		return splicer->Drain() && splicer->output_->Seek(offset, whence) ? 0 : -1;
+	}
+
+	::FLAC__StreamSplicer *splicer_;
+	std::vector<MetadataStream *> sources_;
+	MetadataStream *output_;
+	std::vector<FLAC__byte> buffer_;
+};
+
+/** Reads the metadata of many streams through a FLAC__MetadataIndexer.
+ *
+ *  libFLAC cannot start threads of its own in a Store app, so
+ *  FLAC__metadata_indexer_run() would read the streams one by one;
+ *  instead each call to Work() is one worker, and the caller runs as
+ *  many of them at once as it wants, e.g. as thread pool work items.
+ *  The streams stay open until the indexer is deleted.
+ */
+class MetadataIndexer
+{
+public:
+	MetadataIndexer() :
+		indexer_(::FLAC__metadata_indexer_new())
+	{
+	}
+
+	~MetadataIndexer()
+	{
+		if (nullptr != indexer_) {
+			::FLAC__metadata_indexer_delete(indexer_);
+		}
+		for (size_t i = 0; i < sources_.size(); i++) {
+			delete sources_[i];
+		}
+	}
+
+	bool IsValid() const
+	{
+		return nullptr != indexer_;
+	}
+
+	bool SetTypes(unsigned types)
+	{
+		return !!::FLAC__metadata_indexer_set_types(indexer_, types);
+	}
+
+	bool SetTagNames(const char * const names[])
+	{
+		return !!::FLAC__metadata_indexer_set_tag_names(indexer_, names);
+	}
+
+	/** Queues \a source and takes ownership of it. */
+	bool AddStream(MetadataStream *source)
+	{
+		sources_.push_back(source);
+		return !!::FLAC__metadata_indexer_add_stream(indexer_, source, MetadataStream::GetCallbacks());
+	}
+
+	unsigned GetCount() const
+	{
+		return ::FLAC__metadata_indexer_get_count(indexer_);
+	}
+
+	/** Reads queued streams until no other worker has one left to take. */
+	void Work()
+	{
+		::FLAC__metadata_indexer_work(indexer_);
+	}
+
+	/** Whether every entry was read, as FLAC__metadata_indexer_run() returns. */
+	bool AllRead() const
+	{
+		const unsigned count = GetCount();
+		for (unsigned i = 0; i < count; i++) {
+			if (FLAC__METADATA_INDEX_STATUS_OK != GetEntry(i)->status) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const ::FLAC__MetadataIndexEntry *GetEntry(unsigned index) const
+	{
+		return ::FLAC__metadata_indexer_get_entry(indexer_, index);
+	}
+
+private:
+	MetadataIndexer(const MetadataIndexer &);
+	MetadataIndexer &operator=(const MetadataIndexer &);
+
+	::FLAC__MetadataIndexer *indexer_;
+	std::vector<MetadataStream *> sources_;
+};
+
+#endif
@@ -0,0 +1,510 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__PRIVATE__PCM_ENCODER_H
+#define FLACRT__PRIVATE__PCM_ENCODER_H
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FLAC/metadata.h"
+#include "FLAC/stream_encoder.h"
+
+
+/** Byte sink behind an EncoderWriteCache.
+ *
+ *  Write() stores \a bytes bytes at \a offset.  Read() is only needed by
+ *  the Ogg encoder, which reads back the first page when it rewrites
+ *  STREAMINFO; it stores the number of bytes read in \a bytes_read.
+ *  All methods return false on an I/O error.
+ */
+class EncoderSink
+{
+public:
+	virtual ~EncoderSink() { }
+
+	virtual bool Write(FLAC__uint64 offset, const FLAC__byte *buffer, size_t bytes) = 0;
+	virtual bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read) = 0;
+};
+
+
+/** Coalesces the encoder's small per-frame writes into large block
+ *  writes.
+ *
+ *  Writes that continue the pending block are appended to it; the block
+ *  goes to the sink when it is full, when the position jumps, or on
+ *  Flush().  Writes at least as large as the block go straight through.
+ *
+ *  The cache takes ownership of \a sink.
+ */
+class EncoderWriteCache
+{
+public:
+	static const size_t DefaultCapacity = 256 * 1024;
+
+	explicit EncoderWriteCache(EncoderSink *sink, size_t capacity = DefaultCapacity) :
+		sink_(sink),
+		buffer_(new FLAC__byte[capacity]),
+		capacity_(capacity),
+		pending_offset_(0),
+		pending_length_(0),
+		position_(0)
+	{
+	}
+
+	~EncoderWriteCache()
+	{
+		delete[] buffer_;
+		delete sink_;
+	}
+
+	bool Write(const FLAC__byte *buffer, size_t bytes)
+	{
+		if (position_ != pending_offset_ + pending_length_ && !Flush()) {
+			return false;
+		}
+		if (0 == pending_length_) {
+			pending_offset_ = position_;
+		}
+
+		if (pending_length_ + bytes > capacity_) {
+			if (!Flush()) {
+				return false;
+			}
+			pending_offset_ = position_;
+			if (bytes >= capacity_) {
+				if (!sink_->Write(position_, buffer, bytes)) {
+					return false;
+				}
+				position_ += bytes;
+				return true;
+			}
+		}
+
+		memcpy(buffer_ + pending_length_, buffer, bytes);
+		pending_length_ += bytes;
+		position_ += bytes;
+		return true;
+	}
+
+	bool Read(FLAC__byte *buffer, size_t *bytes)
+	{
+		size_t read = 0;
+		if (!Flush() || !sink_->Read(position_, buffer, *bytes, &read)) {
+			return false;
+		}
+		position_ += read;
+		*bytes = read;
+		return true;
+	}
+
+	bool Seek(FLAC__uint64 offset)
+	{
+		position_ = offset;
+		return true;
+	}
+
+	FLAC__uint64 Tell() const
+	{
+		return position_;
+	}
+
+	bool Flush()
+	{
+		if (0 == pending_length_) {
+			return true;
+		}
+		bool ok = sink_->Write(pending_offset_, buffer_, pending_length_);
+		pending_length_ = 0;
+		return ok;
+	}
+
+private:
+	EncoderWriteCache(const EncoderWriteCache &);
+	EncoderWriteCache &operator=(const EncoderWriteCache &);
+
+	EncoderSink *sink_;
+	FLAC__byte *buffer_;
+	size_t capacity_;
+
+	FLAC__uint64 pending_offset_;
+	size_t pending_length_;
+	FLAC__uint64 position_;
+};
+
+
+/** Feeds interleaved little-endian PCM bytes to a ::FLAC__StreamEncoder.
+ *
+ *  8 bit samples are unsigned, 16 and 24 bit samples signed, matching
+ *  Helper::pack_sample().  The bytes are unpacked through a fixed scratch
+ *  block, so encoding allocates nothing per call, and a trailing partial
+ *  sample is kept for the next call.  Channels and sample size are taken
+ *  from the encoder, which must be initialized.
+ */
+class PcmEncoder
+{
+public:
+	static const unsigned ScratchSamples = 4096;
+
+	explicit PcmEncoder(::FLAC__StreamEncoder *encoder) :
+		encoder_(encoder),
+		scratch_(ScratchSamples * FLAC__MAX_CHANNELS),
+		carry_length_(0)
+	{
+	}
+
+	bool Process(const FLAC__byte *data, size_t bytes)
+	{
+		const unsigned channels = ::FLAC__stream_encoder_get_channels(encoder_);
+		const unsigned sample_bytes = (::FLAC__stream_encoder_get_bits_per_sample(encoder_) + 7) / 8;
+		const size_t frame_bytes = channels * sample_bytes;
+
+		if (sample_bytes < 1 || sample_bytes > 3) {
+			return false;
+		}
+
+		if (carry_length_ > 0) {
+			size_t n = frame_bytes - carry_length_;
+			if (n > bytes) {
+				n = bytes;
+			}
+			memcpy(carry_ + carry_length_, data, n);
+			carry_length_ += n;
+			data += n;
+			bytes -= n;
+			if (carry_length_ < frame_bytes) {
+				return true;
+			}
+			carry_length_ = 0;
+			if (!Encode(carry_, 1, channels, sample_bytes)) {
+				return false;
+			}
+		}
+
+		size_t samples = bytes / frame_bytes;
+		while (samples > 0) {
+			unsigned n = samples < ScratchSamples ? (unsigned)samples : ScratchSamples;
+			if (!Encode(data, n, channels, sample_bytes)) {
+				return false;
+			}
+			data += n * frame_bytes;
+			bytes -= n * frame_bytes;
+			samples -= n;
+		}
+
+		memcpy(carry_, data, bytes);
+		carry_length_ = bytes;
+		return true;
+	}
+
+	/** Drops a pending partial sample; call before a new stream. */
+	void Reset()
+	{
+		carry_length_ = 0;
+	}
+
+private:
+	bool Encode(const FLAC__byte *data, unsigned samples, unsigned channels, unsigned sample_bytes)
+	{
+		FLAC__int32 *out = &scratch_[0];
+		const size_t count = (size_t)samples * channels;
+
+		switch (sample_bytes) {
+		case 1:
+			for (size_t i = 0; i < count; i++) {
+				out[i] = (FLAC__int32)data[i] - 0x80;
+			}
+			break;
+		case 2:
+			for (size_t i = 0; i < count; i++, data += 2) {
+				out[i] = (FLAC__int32)(FLAC__int16)(data[0] | (data[1] << 8));
+			}
+			break;
+		default:
+			for (size_t i = 0; i < count; i++, data += 3) {
+				FLAC__int32 sample = data[0] | (data[1] << 8) | (data[2] << 16);
+				out[i] = (sample ^ 0x800000) - 0x800000;
+			}
+			break;
+		}
+
+		return !!::FLAC__stream_encoder_process_interleaved(encoder_, out, samples);
+	}
+
+	::FLAC__StreamEncoder *encoder_;
+	std::vector<FLAC__int32> scratch_;
+	FLAC__byte carry_[FLAC__MAX_CHANNELS * 4];
+	size_t carry_length_;
+};
+
+
+/** Runs a PcmEncoder on a worker thread.
+ *
+ *  Submit() copies the caller's bytes into a recycled buffer and returns
+ *  as soon as the buffer is queued, so converting, encoding and writing
+ *  overlap with whatever the caller does to produce the next buffer.  At
+ *  most \a depth buffers wait at a time; Submit() blocks while the queue
+ *  is full.  Once the encoder fails, Submit() and Drain() return false.
+ *
+ *  The encoder's callbacks run on the worker thread.  An exception thrown
+ *  from them counts as a failure; nothing on that thread could catch it.
+ */
+class EncodeQueue
+{
+public:
+	EncodeQueue(PcmEncoder *encoder, size_t depth) :
+		encoder_(encoder),
+		depth_(0 == depth ? 1 : depth),
+		busy_(false),
+		stopping_(false),
+		failed_(false)
+	{
+		worker_ = std::thread(&EncodeQueue::Run, this);
+	}
+
+	~EncodeQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+			changed_.notify_all();
+		}
+		worker_.join();
+	}
+
+	bool Submit(const FLAC__byte *data, size_t bytes)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		changed_.wait(lock, [this] { return queue_.size() < depth_ || failed_; });
+		if (failed_) {
+			return false;
+		}
+
+		std::vector<FLAC__byte> buffer;
+		if (!spare_.empty()) {
+			buffer.swap(spare_.back());
+			spare_.pop_back();
+		}
+		buffer.assign(data, data + bytes);
+
+		queue_.push_back(std::vector<FLAC__byte>());
+		queue_.back().swap(buffer);
+		changed_.notify_all();
+		return true;
+	}
+
+	/** Waits until every submitted buffer has been encoded. */
+	bool Drain()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		changed_.wait(lock, [this] { return (queue_.empty() && !busy_) || failed_; });
+		return !failed_;
+	}
+
+private:
+	EncodeQueue(const EncodeQueue &);
+	EncodeQueue &operator=(const EncodeQueue &);
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;) {
+			changed_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+			if (queue_.empty()) {
+				break;
+			}
+
+			std::vector<FLAC__byte> buffer;
+			buffer.swap(queue_.front());
+			queue_.pop_front();
+			busy_ = true;
+
+			lock.unlock();
+			bool ok;
+			try {
+				ok = encoder_->Process(buffer.empty() ? 0 : &buffer[0], buffer.size());
+			}
+			catch (...) {
+				ok = false;
+			}
+			lock.lock();
+
+			busy_ = false;
+			if (!ok) {
+				failed_ = true;
+				queue_.clear();
+			}
+			spare_.push_back(std::vector<FLAC__byte>());
+			spare_.back().swap(buffer);
+			changed_.notify_all();
+		}
+	}
+
+	PcmEncoder *encoder_;
+	size_t depth_;
+
+	std::mutex mutex_;
+	std::condition_variable changed_;
+	std::deque<std::vector<FLAC__byte> > queue_;
+	std::vector<std::vector<FLAC__byte> > spare_;
+	bool busy_;
+	bool stopping_;
+	bool failed_;
+
+	std::thread worker_;
+};
+
+
+/** Metadata blocks handed to FLAC__stream_encoder_set_metadata().
+ *
+ *  Owns the blocks it builds.  Comments are UTF-8 NAME=value pairs;
+ *  a seek table is built only when the total sample count is known.
+ */
+class EncoderMetadata
+{
+public:
+	EncoderMetadata() :
+		comments_(nullptr),
+		padding_(nullptr),
+		seek_table_(nullptr),
+		padding_length_(0),
+		seek_point_spacing_(0)
+	{
+	}
+
+	~EncoderMetadata()
+	{
+		Clear();
+	}
+
+	bool AddComment(const char *name, const char *value)
+	{
+		::FLAC__StreamMetadata_VorbisComment_Entry entry;
+		if (nullptr == comments_ && nullptr == (comments_ = ::FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT))) {
+			return false;
+		}
+		if (!::FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(&entry, name, value)) {
+			return false;
+		}
+		if (!::FLAC__metadata_object_vorbiscomment_append_comment(comments_, entry, /*copy=*/false)) {
+			free(entry.entry);
+			return false;
+		}
+		return true;
+	}
+
+	void SetPadding(unsigned length)
+	{
+		padding_length_ = length;
+	}
+
+	void SetSeekPointSpacing(unsigned samples)
+	{
+		seek_point_spacing_ = samples;
+	}
+
+	/** Builds the block list and passes it to \a encoder, which must not
+	 *  be initialized yet.  The blocks stay owned by this object and must
+	 *  outlive the encoding.
+	 */
+	bool Apply(::FLAC__StreamEncoder *encoder)
+	{
+		blocks_.clear();
+		if (nullptr != padding_) {
+			::FLAC__metadata_object_delete(padding_);
+			padding_ = nullptr;
+		}
+		if (nullptr != seek_table_) {
+			::FLAC__metadata_object_delete(seek_table_);
+			seek_table_ = nullptr;
+		}
+
+		if (nullptr != comments_) {
+			blocks_.push_back(comments_);
+		}
+
+		FLAC__uint64 total_samples = ::FLAC__stream_encoder_get_total_samples_estimate(encoder);
+		if (seek_point_spacing_ > 0 && total_samples > 0) {
+			if (nullptr == (seek_table_ = ::FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE)) ||
+				!::FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(seek_table_, seek_point_spacing_, total_samples) ||
+				!::FLAC__metadata_object_seektable_template_sort(seek_table_, /*compact=*/true)) {
+				return false;
+			}
+			blocks_.push_back(seek_table_);
+		}
+
+		if (padding_length_ > 0) {
+			if (nullptr == (padding_ = ::FLAC__metadata_object_new(FLAC__METADATA_TYPE_PADDING))) {
+				return false;
+			}
+			padding_->length = padding_length_;
+			blocks_.push_back(padding_);
+		}
+
+		return !!::FLAC__stream_encoder_set_metadata(encoder, blocks_.empty() ? nullptr : &blocks_[0], (unsigned)blocks_.size());
+	}
+
+	void Clear()
+	{
+		blocks_.clear();
+		if (nullptr != comments_) {
+			::FLAC__metadata_object_delete(comments_);
+			comments_ = nullptr;
+		}
+		if (nullptr != padding_) {
+			::FLAC__metadata_object_delete(padding_);
+			padding_ = nullptr;
+		}
+		if (nullptr != seek_table_) {
+			::FLAC__metadata_object_delete(seek_table_);
+			seek_table_ = nullptr;
+		}
+	}
+
+private:
+	EncoderMetadata(const EncoderMetadata &);
+	EncoderMetadata &operator=(const EncoderMetadata &);
+
+	::FLAC__StreamMetadata *comments_;
+	::FLAC__StreamMetadata *padding_;
+	::FLAC__StreamMetadata *seek_table_;
+	std::vector< ::FLAC__StreamMetadata *> blocks_;
+
+	unsigned padding_length_;
+	unsigned seek_point_spacing_;
+};
+
+#endif
@@ -0,0 +1,516 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef FLACRT__PRIVATE__PLAYLIST_DECODER_H
+#define FLACRT__PRIVATE__PLAYLIST_DECODER_H
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FLAC/stream_decoder.h"
+#include "private/batch_decoder.h"
+#include "private/stream_cache.h"
+
+
+/** Sample format of a playlist track, from its STREAMINFO. */
+struct TrackFormat
+{
+	unsigned sample_rate;
+	unsigned channels;
+	unsigned bits_per_sample;
+	FLAC__uint64 total_samples;
+};
+
+
+/** One stream of a playlist: its own decoder reading through a
+ *  StreamCache and writing straight into a PcmFifo.
+ *
+ *  Open() does everything that stands between a new stream and its first
+ *  sample (init, metadata, the first frames), so it can run on another
+ *  thread while the previous track plays.  After that the track belongs
+ *  to whoever calls Decode().
+ */
+class PlaylistTrack
+{
+public:
+	/** Takes ownership of \a source. */
+	PlaylistTrack(StreamCacheSource *source, bool ogg, unsigned index) :
+		decoder_(::FLAC__stream_decoder_new()),
+		cache_(source),
+		ogg_(ogg),
+		index_(index),
+		float_(false),
+		has_format_(false),
+		abandoned_(false)
+	{
+		memset(&format_, 0, sizeof(format_));
+	}
+
+	~PlaylistTrack()
+	{
+		if (nullptr != decoder_) {
+			(void)::FLAC__stream_decoder_finish(decoder_);
+			::FLAC__stream_decoder_delete(decoder_);
+		}
+	}
+
+	/** Reads the metadata and decodes until \a preroll samples (at least
+	 *  one frame) are waiting.  Returns false if the stream cannot be
+	 *  decoded or has no STREAMINFO.
+	 */
+	bool Open(bool float_output, float gain, size_t preroll)
+	{
+		if (nullptr == decoder_) {
+			return false;
+		}
+
+		float_ = float_output;
+		fifo_.SetFloat(float_output, gain);
+
+		::FLAC__StreamDecoderInitStatus status = ogg_ ?
+			::FLAC__stream_decoder_init_ogg_stream(decoder_, read_callback_, seek_callback_, tell_callback_, length_callback_, eof_callback_, write_callback_, metadata_callback_, error_callback_, this) :
+			::FLAC__stream_decoder_init_stream(decoder_, read_callback_, seek_callback_, tell_callback_, length_callback_, eof_callback_, write_callback_, metadata_callback_, error_callback_, this);
+		if (FLAC__STREAM_DECODER_INIT_STATUS_OK != status) {
+			return false;
+		}
+		if (!::FLAC__stream_decoder_process_until_end_of_metadata(decoder_) || !has_format_) {
+			return false;
+		}
+
+		if (0 == preroll) {
+			preroll = 1;
+		}
+		while (fifo_.GetSamples() < preroll) {
+			if (FLAC__STREAM_DECODER_END_OF_STREAM == ::FLAC__stream_decoder_get_state(decoder_)) {
+				break;
+			}
+			if (!::FLAC__stream_decoder_process_single(decoder_)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Makes a pending or running Open() give up at its next read. */
+	void Abandon()
+	{
+		abandoned_ = true;
+	}
+
+	BatchStatus Decode(size_t samples, std::vector<FLAC__byte> &out, const std::atomic<bool> &cancelled)
+	{
+		return decode_batch(decoder_, fifo_, samples, out, cancelled);
+	}
+
+	/** Converts what is waiting too; see PcmFifo::SetFloat(). */
+	void SetFloat(bool value, float gain)
+	{
+		float_ = value;
+		fifo_.SetFloat(value, gain);
+	}
+
+	const TrackFormat &GetFormat() const
+	{
+		return format_;
+	}
+
+	unsigned GetIndex() const
+	{
+		return index_;
+	}
+
+	/** Bytes per inter-channel sample in the output. */
+	size_t GetFrameBytes() const
+	{
+		return format_.channels * (float_ ? sizeof(float) : format_.bits_per_sample / 8);
+	}
+
+	/** True if PCM from \a other can follow ours in the same buffer. */
+	bool HasSameLayout(const PlaylistTrack &other) const
+	{
+		return format_.sample_rate == other.format_.sample_rate &&
+			format_.channels == other.format_.channels &&
+			(float_ || format_.bits_per_sample == other.format_.bits_per_sample) &&
+			float_ == other.float_;
+	}
+
+private:
+	PlaylistTrack(const PlaylistTrack &);
+	PlaylistTrack &operator=(const PlaylistTrack &);
+
+	static ::FLAC__StreamDecoderReadStatus read_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+	{
+		(void)decoder;
+		PlaylistTrack *track = static_cast<PlaylistTrack *>(client_data);
+		if (track->abandoned_ || !track->cache_.Read(buffer, bytes)) {
+			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		}
+		return 0 == *bytes ? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+
+	static ::FLAC__StreamDecoderSeekStatus seek_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+	{
+		(void)decoder;
+		PlaylistTrack *track = static_cast<PlaylistTrack *>(client_data);
+		return track->cache_.Seek(absolute_byte_offset) ? FLAC__STREAM_DECODER_SEEK_STATUS_OK : FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+	}
+
+	static ::FLAC__StreamDecoderTellStatus tell_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+	{
+		(void)decoder;
+		*absolute_byte_offset = static_cast<PlaylistTrack *>(client_data)->cache_.Tell();
+		return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+	}
+
+	static ::FLAC__StreamDecoderLengthStatus length_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__uint64 *stream_length, void *client_data)
+	{
+		(void)decoder;
+		PlaylistTrack *track = static_cast<PlaylistTrack *>(client_data);
+		return track->cache_.Length(stream_length) ? FLAC__STREAM_DECODER_LENGTH_STATUS_OK : FLAC__STREAM_DECODER_LENGTH_STATUS_ERROR;
+	}
+
+	static FLAC__bool eof_callback_(const ::FLAC__StreamDecoder *decoder, void *client_data)
+	{
+		(void)decoder;
+		return static_cast<PlaylistTrack *>(client_data)->cache_.Eof();
+	}
+
+	static ::FLAC__StreamDecoderWriteStatus write_callback_(const ::FLAC__StreamDecoder *decoder, const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[], void *client_data)
+	{
+		(void)decoder;
+		PlaylistTrack *track = static_cast<PlaylistTrack *>(client_data);
+		return track->fifo_.Append(buffer, frame->header.blocksize, frame->header.channels, frame->header.bits_per_sample) ?
+			FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE : FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+
+	static void metadata_callback_(const ::FLAC__StreamDecoder *decoder, const ::FLAC__StreamMetadata *metadata, void *client_data)
+	{
+		(void)decoder;
+		PlaylistTrack *track = static_cast<PlaylistTrack *>(client_data);
+		if (FLAC__METADATA_TYPE_STREAMINFO == metadata->type) {
+			track->format_.sample_rate = metadata->data.stream_info.sample_rate;
+			track->format_.channels = metadata->data.stream_info.channels;
+			track->format_.bits_per_sample = metadata->data.stream_info.bits_per_sample;
+			track->format_.total_samples = metadata->data.stream_info.total_samples;
+			track->has_format_ = true;
+		}
+	}
+
+	static void error_callback_(const ::FLAC__StreamDecoder *decoder, ::FLAC__StreamDecoderErrorStatus status, void *client_data)
+	{
+		/* libFLAC resyncs by itself; a playlist has nobody to tell */
+		(void)decoder;
+		(void)status;
+		(void)client_data;
+	}
+
+	::FLAC__StreamDecoder *decoder_;
+	StreamCache cache_;
+	PcmFifo fifo_;
+	bool ogg_;
+	unsigned index_;
+	bool float_;
+
+	TrackFormat format_;
+	bool has_format_;
+	std::atomic<bool> abandoned_;
+};
+
+
+/** Decodes a queue of streams as one continuous stream of PCM.
+ *
+ *  While a track plays, the next one is opened on a worker thread
+ *  (PlaylistTrack::Open()), so at the boundary its first samples are
+ *  already waiting and Read() carries straight on.  A batch only spans
+ *  two tracks when they have the same layout (rate, channels and, for
+ *  packed output, sample size); otherwise it ends at the boundary and the
+ *  next batch starts the new track, so a batch never mixes formats.
+ *  GetNextFormat() reports the next track's format as soon as it is
+ *  known, ahead of the boundary.  A track that cannot be opened is
+ *  skipped.
+ *
+ *  Enqueue() and the getters may be called from any thread.  Read(),
+ *  SetFloat() and Clear() may be too, but they take turns: each waits
+ *  for the one running to return, so Clear() or SetFloat() during a
+ *  Read() takes effect after that batch.
+ */
+class PlaylistDecoder
+{
+public:
+	PlaylistDecoder() :
+		next_ok_(false),
+		next_ready_(false),
+		enqueued_(0),
+		float_(false),
+		gain_(1.0f),
+		preroll_(0),
+		current_index_(0),
+		has_current_format_(false)
+	{
+		memset(&current_format_, 0, sizeof(current_format_));
+	}
+
+	~PlaylistDecoder()
+	{
+		AbandonNext();
+	}
+
+	/** Appends a track; takes ownership of \a source.  Returns the
+	 *  track's index, counting from 0 over every track ever enqueued.
+	 */
+	unsigned Enqueue(StreamCacheSource *source, bool ogg)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_.push_back(std::unique_ptr<PlaylistTrack>(new PlaylistTrack(source, ogg, enqueued_)));
+		return enqueued_++;
+	}
+
+	/** Drops every track, including the one playing. */
+	void Clear()
+	{
+		std::lock_guard<std::mutex> turn(turn_mutex_);
+		AbandonNext();
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending_.clear();
+		current_.reset();
+		has_current_format_ = false;
+	}
+
+	/** Takes effect at the next batch.  PCM already decoded, including
+	 *  the next track's pre-roll, is converted rather than dropped (see
+	 *  PcmFifo::SetFloat()), so no samples are lost at the switch.
+	 */
+	void SetFloat(bool value, float gain)
+	{
+		std::lock_guard<std::mutex> turn(turn_mutex_);
+		/* the worker reads float_ and gain_ when it opens the next track */
+		if (preparer_.joinable()) {
+			preparer_.join();
+		}
+		float_ = value;
+		gain_ = gain;
+		if (current_) {
+			current_->SetFloat(value, gain);
+		}
+		if (next_) {
+			next_->SetFloat(value, gain);
+		}
+	}
+
+	/** Moves up to \a samples inter-channel samples into \a out,
+	 *  replacing its contents; the batch is shorter only at the end of
+	 *  the queue or before a track with a different layout.  Returns
+	 *  BatchStatus::EndOfStream with \a out empty once every track has
+	 *  played; enqueueing more tracks resumes playback.  After
+	 *  BatchStatus::Error the broken track is dropped and the next Read()
+	 *  continues with the one after it.
+	 */
+	BatchStatus Read(size_t samples, std::vector<FLAC__byte> &out, const std::atomic<bool> &cancelled)
+	{
+		std::lock_guard<std::mutex> turn(turn_mutex_);
+		std::vector<FLAC__byte> chunk;
+		size_t taken = 0;
+
+		out.clear();
+		preroll_ = samples;
+
+		if (!current_ && !Advance(0)) {
+			return BatchStatus::EndOfStream;
+		}
+		StartNext();
+
+		while (taken < samples) {
+			BatchStatus status = current_->Decode(samples - taken, chunk, cancelled);
+
+			if (BatchStatus::Ok == status) {
+				out.insert(out.end(), chunk.begin(), chunk.end());
+				taken += chunk.size() / current_->GetFrameBytes();
+				continue;
+			}
+			if (BatchStatus::EndOfStream != status) {
+				if (BatchStatus::Error == status) {
+					std::lock_guard<std::mutex> lock(mutex_);
+					current_.reset();
+					has_current_format_ = false;
+				}
+				return status;
+			}
+
+			/* this track is done; a batch that has samples already only
+			 * carries on into a track of the same layout */
+			if (!Advance(0 == taken ? nullptr : current_.get())) {
+				break;
+			}
+		}
+
+		return out.empty() ? BatchStatus::EndOfStream : BatchStatus::Ok;
+	}
+
+	/** Format and index of the track the last batch ended in. */
+	bool GetCurrentFormat(TrackFormat *format, unsigned *index)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!has_current_format_) {
+			return false;
+		}
+		*format = current_format_;
+		*index = current_index_;
+		return true;
+	}
+
+	/** Format and index of the track that follows, once it is open. */
+	bool GetNextFormat(TrackFormat *format, unsigned *index)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!next_ready_ || !next_ok_) {
+			return false;
+		}
+		*format = next_->GetFormat();
+		*index = next_->GetIndex();
+		return true;
+	}
+
+private:
+	PlaylistDecoder(const PlaylistDecoder &);
+	PlaylistDecoder &operator=(const PlaylistDecoder &);
+
+	/** Starts opening the first pending track unless one is already
+	 *  open or opening.
+	 */
+	void StartNext()
+	{
+		if (preparer_.joinable()) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (next_ || pending_.empty()) {
+			return;
+		}
+		next_ = std::move(pending_.front());
+		pending_.pop_front();
+		next_ok_ = false;
+		next_ready_ = false;
+
+		PlaylistTrack *track = next_.get();
+		const bool float_output = float_;
+		const float gain = gain_;
+		const size_t preroll = preroll_;
+		preparer_ = std::thread([this, track, float_output, gain, preroll]()
+		{
+			bool ok = track->Open(float_output, gain, preroll);
+			std::lock_guard<std::mutex> lock(mutex_);
+			next_ok_ = ok;
+			next_ready_ = true;
+		});
+	}
+
+	/** Makes the next track that opens current, skipping broken ones.
+	 *  With \a previous set, only does so if the next track has the same
+	 *  layout as \a previous.  Returns false if there is nothing (yet) to
+	 *  switch to.
+	 */
+	bool Advance(const PlaylistTrack *previous)
+	{
+		for (;;) {
+			StartNext();
+			if (preparer_.joinable()) {
+				preparer_.join();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!next_) {
+				return false;
+			}
+			if (!next_ok_) {
+				next_.reset();
+				next_ready_ = false;
+				continue;
+			}
+			if (nullptr != previous && !previous->HasSameLayout(*next_)) {
+				return false;
+			}
+			current_ = std::move(next_);
+			next_ready_ = false;
+			current_format_ = current_->GetFormat();
+			current_index_ = current_->GetIndex();
+			has_current_format_ = true;
+			break;
+		}
+
+		StartNext();
+		return true;
+	}
+
+	void AbandonNext()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (next_) {
+				next_->Abandon();
+			}
+		}
+		if (preparer_.joinable()) {
+			preparer_.join();
+		}
+		std::lock_guard<std::mutex> lock(mutex_);
+		next_.reset();
+		next_ready_ = false;
+	}
+
+	/* held for the whole of Read(), SetFloat() and Clear() */
+	std::mutex turn_mutex_;
+
+	std::mutex mutex_;
+	std::deque<std::unique_ptr<PlaylistTrack> > pending_;
+	std::unique_ptr<PlaylistTrack> current_;
+	std::unique_ptr<PlaylistTrack> next_;
+	std::thread preparer_;
+	bool next_ok_;
+	bool next_ready_;
+	unsigned enqueued_;
+
+	bool float_;
+	float gain_;
+	size_t preroll_;
+
+	TrackFormat current_format_;
+	unsigned current_index_;
+	bool has_current_format_;
+};
+
+#endif
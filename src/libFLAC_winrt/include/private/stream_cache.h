@@ -0,0 +1,252 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__PRIVATE__STREAM_CACHE_H
+#define FLACRT__PRIVATE__STREAM_CACHE_H
+
+#include <cstring>
+
+#include "FLAC/ordinals.h"
+
+
+/** Random access byte source behind a StreamCache.
+ *
+ *  Read() must fill \a buffer with up to \a bytes bytes starting at
+ *  \a offset and store the number of bytes actually read in
+ *  \a bytes_read, 0 meaning the end of the source.  Both methods return
+ *  false on an I/O error.  Implementations may block; the cache only
+ *  calls Read() when a request falls outside its window.
+ *
+ *  After a read that carries on where the previous one ended the cache
+ *  calls Prefetch() with where the next one will most likely be, so a
+ *  source with asynchronous I/O can start it and let it run while the
+ *  caller works through the window.  CancelPrefetch() is called before
+ *  the stream is touched behind the cache's back; it must not return
+ *  while a prefetch is still using the stream.
+ */
+class StreamCacheSource
+{
+public:
+	virtual ~StreamCacheSource() { }
+
+	virtual bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read) = 0;
+	virtual bool Length(FLAC__uint64 *length) = 0;
+
+	virtual void Prefetch(FLAC__uint64 offset, size_t bytes) { (void)offset; (void)bytes; }
+	virtual void CancelPrefetch() { }
+};
+
+
+/** Read cache keyed by stream position.
+ *
+ *  Keeps one window of \a capacity bytes of the source in memory and
+ *  serves read/seek/tell/length/eof requests from it, going back to the
+ *  source only when a read falls outside the window.  Seeking never
+ *  touches the source, so the decoder's short backward seeks during
+ *  sync and seek-table lookups are free.  Reads at least as large as the
+ *  window bypass it and go straight into the caller's buffer.  Reading
+ *  on from where the last source read ended asks the source to
+ *  prefetch the next stretch.
+ *
+ *  The cache takes ownership of \a source.
+ */
+class StreamCache
+{
+public:
+	static const size_t DefaultCapacity = 256 * 1024;
+
+	explicit StreamCache(StreamCacheSource *source, size_t capacity = DefaultCapacity) :
+		source_(source),
+		buffer_(new FLAC__byte[capacity]),
+		capacity_(capacity),
+		window_offset_(0),
+		window_length_(0),
+		position_(0),
+		source_end_(0),
+		length_(0),
+		length_known_(false)
+	{
+	}
+
+	~StreamCache()
+	{
+		delete[] buffer_;
+		delete source_;
+	}
+
+	/** Copies up to \a *bytes bytes at the current position into
+	 *  \a buffer and advances the position.  On return \a *bytes holds
+	 *  the number of bytes copied, 0 meaning the end of the stream.
+	 *  Returns false on a source error.
+	 */
+	bool Read(FLAC__byte *buffer, size_t *bytes)
+	{
+		const size_t wanted = *bytes;
+		size_t copied = 0;
+
+		while (copied < wanted) {
+			if (position_ < window_offset_ || position_ >= window_offset_ + window_length_) {
+				if (wanted - copied >= capacity_) {
+					size_t direct = 0;
+					if (!SourceRead(buffer + copied, wanted - copied, &direct)) {
+						*bytes = copied;
+						return false;
+					}
+					if (0 == direct) {
+						break;
+					}
+					position_ += direct;
+					copied += direct;
+					continue;
+				}
+				if (!Refill()) {
+					*bytes = copied;
+					return false;
+				}
+				if (0 == window_length_) {
+					break;
+				}
+			}
+
+			size_t available = (size_t)(window_offset_ + window_length_ - position_);
+			size_t n = wanted - copied < available ? wanted - copied : available;
+			memcpy(buffer + copied, buffer_ + (size_t)(position_ - window_offset_), n);
+			position_ += n;
+			copied += n;
+		}
+
+		*bytes = copied;
+		return true;
+	}
+
+	/** Moves the read position; fails if \a offset is past the end of
+	 *  the stream.  The window is kept, so seeking back into it costs
+	 *  nothing.
+	 */
+	bool Seek(FLAC__uint64 offset)
+	{
+		FLAC__uint64 length;
+		if (!Length(&length) || offset > length) {
+			return false;
+		}
+		position_ = offset;
+		return true;
+	}
+
+	FLAC__uint64 Tell() const
+	{
+		return position_;
+	}
+
+	bool Length(FLAC__uint64 *length)
+	{
+		if (!length_known_) {
+			if (!source_->Length(&length_)) {
+				return false;
+			}
+			length_known_ = true;
+		}
+		*length = length_;
+		return true;
+	}
+
+	bool Eof()
+	{
+		FLAC__uint64 length;
+		if (!Length(&length)) {
+			return true;
+		}
+		return position_ >= length;
+	}
+
+	/** Drops the window, any prefetch and the cached length; call before
+	 *  the source is written to behind the cache's back.
+	 */
+	void Invalidate()
+	{
+		source_->CancelPrefetch();
+		source_end_ = NoOffset;
+		window_offset_ = 0;
+		window_length_ = 0;
+		length_known_ = false;
+	}
+
+private:
+	StreamCache(const StreamCache &);
+	StreamCache &operator=(const StreamCache &);
+
+	bool Refill()
+	{
+		size_t filled = 0;
+		window_offset_ = position_;
+		window_length_ = 0;
+		if (!SourceRead(buffer_, capacity_, &filled)) {
+			return false;
+		}
+		window_length_ = filled;
+		/* the source is touched anyway, so pick up a file that grew
+		 * or shrank since the length was last asked for */
+		length_known_ = false;
+		return true;
+	}
+
+	/* a full read that starts where the last one ended is taken as
+	 * sequential, and the source is told the next one is coming */
+	bool SourceRead(FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+	{
+		const bool sequential = position_ == source_end_;
+		if (!source_->Read(position_, buffer, bytes, bytes_read)) {
+			source_end_ = NoOffset;
+			return false;
+		}
+		source_end_ = position_ + *bytes_read;
+		if (sequential && *bytes_read == bytes) {
+			source_->Prefetch(source_end_, bytes);
+		}
+		return true;
+	}
+
+	static const FLAC__uint64 NoOffset = ~(FLAC__uint64)0;
+
+	StreamCacheSource *source_;
+	FLAC__byte *buffer_;
+	size_t capacity_;
+
+	FLAC__uint64 window_offset_;
+	size_t window_length_;
+	FLAC__uint64 position_;
+	FLAC__uint64 source_end_;
+
+	FLAC__uint64 length_;
+	bool length_known_;
+};
+
+#endif
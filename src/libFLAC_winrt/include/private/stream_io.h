@@ -0,0 +1,215 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FLACRT__PRIVATE__STREAM_IO_H
+#define FLACRT__PRIVATE__STREAM_IO_H
+
+#include <ppltasks.h>
+
+#include "private/stream_cache.h"
+
+
+/** Blocks until an asynchronous load or store completes and stores its
+ *  result.  The libFLAC callbacks are synchronous, so the stream adapters
+ *  below wait here, once per cache window or write-behind block.  The
+ *  continuation runs on an arbitrary thread, so this is safe to call from
+ *  any thread that may block.
+ */
+template <typename Operation, typename T>
+inline bool wait_for(Operation operation, T *result)
+{
+	Concurrency::event completed;
+	bool failed = false;
+
+	concurrency::create_task(operation).then([&completed, &failed, result](concurrency::task<T> operationTask)
+	{
+		try {
+			*result = operationTask.get();
+		}
+		catch (Platform::Exception^) {
+			failed = true;
+		}
+		completed.set();
+	}, concurrency::task_continuation_context::use_arbitrary());
+	completed.wait();
+
+	return !failed;
+}
+
+/** Blocks until an asynchronous action completes; see above. */
+inline bool wait_for(Windows::Foundation::IAsyncAction^ action)
+{
+	Concurrency::event completed;
+	bool failed = false;
+
+	concurrency::create_task(action).then([&completed, &failed](concurrency::task<void> actionTask)
+	{
+		try {
+			actionTask.get();
+		}
+		catch (Platform::Exception^) {
+			failed = true;
+		}
+		completed.set();
+	}, concurrency::task_continuation_context::use_arbitrary());
+	completed.wait();
+
+	return !failed;
+}
+
+
+/** Feeds a StreamCache from an IRandomAccessStream through one
+ *  DataReader that lives as long as the source.
+ *
+ *  Prefetch() starts the next LoadAsync() without waiting for it, so the
+ *  stream loads the next window while the decoder works through the
+ *  current one, and Read() only waits for what is still outstanding.
+ *  Whatever the reader holds is served before the stream is touched
+ *  again, and dropped when a read goes elsewhere.
+ */
+class RandomAccessStreamSource : public StreamCacheSource
+{
+public:
+	RandomAccessStreamSource(Windows::Storage::Streams::IRandomAccessStream^ file_stream) :
+		file_stream_(file_stream),
+		data_reader_(ref new Windows::Storage::Streams::DataReader(file_stream)),
+		prefetch_(nullptr),
+		buffered_offset_(0)
+	{
+	}
+
+	virtual ~RandomAccessStreamSource()
+	{
+		FinishPrefetch();
+		(void)data_reader_->DetachStream();
+	}
+
+	virtual bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+	{
+		unsigned int count = 0;
+
+		*bytes_read = 0;
+		FinishPrefetch();
+		if (data_reader_->UnconsumedBufferLength > 0) {
+			if (buffered_offset_ == offset) {
+				ReadBuffered(buffer, bytes, bytes_read);
+				return true;
+			}
+			DropBuffered();
+		}
+
+		if (offset >= file_stream_->Size) {
+			return true;
+		}
+		if (file_stream_->Position != offset) {
+			file_stream_->Seek(offset);
+		}
+		if (bytes > 0xFFFFFFFFu) {
+			bytes = 0xFFFFFFFFu;
+		}
+
+		if (!wait_for(data_reader_->LoadAsync((unsigned int)bytes), &count)) {
+			return false;
+		}
+		buffered_offset_ = offset;
+		ReadBuffered(buffer, bytes, bytes_read);
+		return true;
+	}
+
+	virtual bool Length(FLAC__uint64 *length)
+	{
+		*length = file_stream_->Size;
+		return true;
+	}
+
+	virtual void Prefetch(FLAC__uint64 offset, size_t bytes)
+	{
+		if (nullptr != prefetch_ || data_reader_->UnconsumedBufferLength > 0 || offset >= file_stream_->Size) {
+			return;
+		}
+		if (file_stream_->Position != offset) {
+			file_stream_->Seek(offset);
+		}
+		if (bytes > 0xFFFFFFFFu) {
+			bytes = 0xFFFFFFFFu;
+		}
+		prefetch_ = data_reader_->LoadAsync((unsigned int)bytes);
+		buffered_offset_ = offset;
+	}
+
+	/* a load cannot be abandoned halfway without losing the reader, so
+	 * this waits for it and throws away what it brought in */
+	virtual void CancelPrefetch()
+	{
+		FinishPrefetch();
+		DropBuffered();
+	}
+
+private:
+	/* a failed prefetch leaves nothing buffered, so the next Read()
+	 * simply loads again and reports the error if it persists */
+	void FinishPrefetch()
+	{
+		unsigned int count = 0;
+		if (nullptr != prefetch_) {
+			(void)wait_for(prefetch_, &count);
+			prefetch_ = nullptr;
+		}
+	}
+
+	void ReadBuffered(FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+	{
+		unsigned int count = data_reader_->UnconsumedBufferLength;
+		if (count > bytes) {
+			count = (unsigned int)bytes;
+		}
+		if (count > 0) {
+			data_reader_->ReadBytes(Platform::ArrayReference<FLAC__byte>(buffer, count));
+		}
+		buffered_offset_ += count;
+		*bytes_read = count;
+	}
+
+	void DropBuffered()
+	{
+		const unsigned int count = data_reader_->UnconsumedBufferLength;
+		if (count > 0) {
+			(void)data_reader_->ReadBuffer(count);
+		}
+	}
+
+	Windows::Storage::Streams::IRandomAccessStream^ file_stream_;
+	Windows::Storage::Streams::DataReader^ data_reader_;
+	Windows::Storage::Streams::DataReaderLoadOperation^ prefetch_;
+	FLAC__uint64 buffered_offset_;  // stream offset of the reader's first unconsumed byte
+};
+
+#endif
@@ -0,0 +1,461 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <codecvt>
+#include <locale>
+#include <string>
+#include <vector>
+
+#include "FLAC_winrt/metadata.h"
+#include "FLAC/assert.h"
+#include "private/metadata_editor.h"
+#include "private/stream_io.h"
+
+
+namespace FLAC {
+
+	namespace WindowsRuntime {
+
+		namespace Editor {
+
+			namespace {
+
+				/* Reads go through a StreamCache, so the block-by-block reads of
+				 * the chain cost one load per window; writes go straight to the
+				 * stream and drop the window. */
+				class RandomAccessMetadataStream : public MetadataStream
+				{
+				public:
+					RandomAccessMetadataStream(Windows::Storage::Streams::IRandomAccessStream^ file_stream) :
+						file_stream_(file_stream),
+						cache_(new RandomAccessStreamSource(file_stream)),
+						data_writer_(ref new Windows::Storage::Streams::DataWriter(file_stream))
+					{
+					}
+
+					virtual ~RandomAccessMetadataStream()
+					{
+						(void)data_writer_->DetachStream();
+					}
+
+					virtual size_t Read(void *buffer, size_t bytes)
+					{
+						return cache_.Read(static_cast<FLAC__byte *>(buffer), &bytes) ? bytes : 0;
+					}
+
+					virtual size_t Write(const void *buffer, size_t bytes)
+					{
+						const FLAC__uint64 position = cache_.Tell();
+						unsigned int stored = 0;
+
+						cache_.Invalidate();
+						if (file_stream_->Position != position) {
+							file_stream_->Seek(position);
+						}
+						data_writer_->WriteBytes(Platform::ArrayReference<FLAC__byte>(static_cast<FLAC__byte *>(const_cast<void *>(buffer)), (unsigned int)bytes));
+						if (!wait_for(data_writer_->StoreAsync(), &stored)) {
+							return 0;
+						}
+						(void)cache_.Seek(position + stored);
+						return stored;
+					}
+
+					virtual bool Seek(FLAC__int64 offset, int whence)
+					{
+						FLAC__uint64 length;
+
+						switch (whence) {
+						case SEEK_SET:
+							break;
+						case SEEK_CUR:
+							offset += (FLAC__int64)cache_.Tell();
+							break;
+						case SEEK_END:
+							if (!cache_.Length(&length)) {
+								return false;
+							}
+							offset += (FLAC__int64)length;
+							break;
+						default:
+							return false;
+						}
+						return offset >= 0 && cache_.Seek((FLAC__uint64)offset);
+					}
+
+					virtual FLAC__int64 Tell()
+					{
+						return (FLAC__int64)cache_.Tell();
+					}
+
+					virtual bool Eof()
+					{
+						return cache_.Eof();
+					}
+
+					virtual bool SetLength(FLAC__uint64 length)
+					{
+						cache_.Invalidate();
+						file_stream_->Size = length;
+						return true;
+					}
+
+					virtual bool Flush()
+					{
+						bool flushed = false;
+						return wait_for(file_stream_->FlushAsync(), &flushed) && flushed;
+					}
+
+				private:
+					Windows::Storage::Streams::IRandomAccessStream^ file_stream_;
+					StreamCache cache_;
+					Windows::Storage::Streams::DataWriter^ data_writer_;
+				};
+
+				std::string utf8_from_string(Platform::String^ str)
+				{
+					std::wstring_convert<std::codecvt_utf8_utf16<wchar_t> > utf8;
+					return utf8.to_bytes(str->Data());
+				}
+
+			}
+
+			MetadataEditor::MetadataEditor() :
+				stream_(nullptr)
+			{
+				editor_ = new ::MetadataEditor();
+			}
+
+			MetadataEditor::~MetadataEditor()
+			{
+				delete editor_;
+				editor_ = nullptr;
+				delete stream_;
+				stream_ = nullptr;
+			}
+
+			bool MetadataEditor::IsValid::get()
+			{
+				return nullptr != editor_ && editor_->IsValid();
+			}
+
+			bool MetadataEditor::Read(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				delete stream_;
+				stream_ = new RandomAccessMetadataStream(fileStream);
+				return editor_->Read(stream_, /*ogg=*/false);
+			}
+
+			bool MetadataEditor::ReadOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				delete stream_;
+				stream_ = new RandomAccessMetadataStream(fileStream);
+				return editor_->Read(stream_, /*ogg=*/true);
+			}
+
+			bool MetadataEditor::Write()
+			{
+				FLAC__ASSERT(IsValid);
+				if (editor_->CanWriteInPlace()) {
+					return editor_->Write(nullptr);
+				}
+
+				/* the whole stream is rebuilt in a temporary file, so its size
+				 * is bounded by the disk rather than by memory */
+				Windows::Storage::StorageFile^ file = nullptr;
+				Windows::Storage::Streams::IRandomAccessStream^ file_stream = nullptr;
+				if (!wait_for(Windows::Storage::ApplicationData::Current->TemporaryFolder->CreateFileAsync(L"metadata.tmp", Windows::Storage::CreationCollisionOption::GenerateUniqueName), &file)) {
+					return false;
+				}
+
+				bool ok = wait_for(file->OpenAsync(Windows::Storage::FileAccessMode::ReadWrite), &file_stream);
+				if (ok) {
+					{
+						RandomAccessMetadataStream scratch(file_stream);
+						ok = editor_->Write(&scratch);
+					}
+					delete file_stream;
+				}
+				(void)wait_for(file->DeleteAsync(Windows::Storage::StorageDeleteOption::PermanentDelete));
+				return ok;
+			}
+
+			bool MetadataEditor::CanWriteInPlace()
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->CanWriteInPlace();
+			}
+
+			MetadataEditorStatus MetadataEditor::GetStatus()
+			{
+				FLAC__ASSERT(IsValid);
+				return (MetadataEditorStatus)(int)editor_->GetStatus();
+			}
+
+			Format::StreamMetadata^ MetadataEditor::GetStreamInfo()
+			{
+				FLAC__ASSERT(IsValid);
+				const ::FLAC__StreamMetadata *block = editor_->GetStreamInfo();
+				return nullptr != block ? ref new Format::StreamMetadata(block) : nullptr;
+			}
+
+			unsigned MetadataEditor::GetBlockCount()
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->GetBlockCount();
+			}
+
+			Format::StreamMetadata^ MetadataEditor::GetBlock(unsigned index)
+			{
+				FLAC__ASSERT(IsValid);
+				const ::FLAC__StreamMetadata *block = editor_->GetBlock(index);
+				return nullptr != block ? ref new Format::StreamMetadata(block) : nullptr;
+			}
+
+			Platform::Array<Platform::String^>^ MetadataEditor::GetTag(Platform::String^ name)
+			{
+				FLAC__ASSERT(IsValid);
+				std::vector<std::string> values;
+				editor_->GetTag(utf8_from_string(name).c_str(), values);
+
+				Platform::Array<Platform::String^>^ arr = ref new Platform::Array<Platform::String^>((unsigned int)values.size());
+				for (unsigned int i = 0; i < arr->Length; i++) {
+					arr[i] = string_from_utf8(values[i].c_str());
+				}
+				return arr;
+			}
+
+			bool MetadataEditor::SetTag(Platform::String^ name, Platform::String^ value)
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->SetTag(utf8_from_string(name).c_str(), utf8_from_string(value).c_str());
+			}
+
+			bool MetadataEditor::AddTag(Platform::String^ name, Platform::String^ value)
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->AddTag(utf8_from_string(name).c_str(), utf8_from_string(value).c_str());
+			}
+
+			int MetadataEditor::RemoveTag(Platform::String^ name)
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->RemoveTag(utf8_from_string(name).c_str());
+			}
+
+			unsigned MetadataEditor::GetPictureCount()
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->GetPictureCount();
+			}
+
+			Format::StreamMetadata^ MetadataEditor::GetPicture(unsigned index)
+			{
+				FLAC__ASSERT(IsValid);
+				const ::FLAC__StreamMetadata *block = editor_->GetPicture(index, /*load_data=*/true);
+				return nullptr != block ? ref new Format::StreamMetadata(block) : nullptr;
+			}
+
+			bool MetadataEditor::AddPicture(Format::Metadata::PictureType type, Platform::String^ mimeType, Platform::String^ description,
+				FLAC__uint32 width, FLAC__uint32 height, FLAC__uint32 depth, FLAC__uint32 colors, const Platform::Array<FLAC__byte>^ data)
+			{
+				FLAC__ASSERT(IsValid);
+				::FLAC__StreamMetadata *picture = ::FLAC__metadata_object_new(FLAC__METADATA_TYPE_PICTURE);
+				if (nullptr == picture) {
+					return false;
+				}
+
+				std::string utf8_mime_type = utf8_from_string(mimeType);
+				std::string utf8_description = utf8_from_string(description);
+				picture->data.picture.type = (::FLAC__StreamMetadata_Picture_Type)(int)type;
+				picture->data.picture.width = width;
+				picture->data.picture.height = height;
+				picture->data.picture.depth = depth;
+				picture->data.picture.colors = colors;
+				if (!::FLAC__metadata_object_picture_set_mime_type(picture, const_cast<char *>(utf8_mime_type.c_str()), /*copy=*/true) ||
+					!::FLAC__metadata_object_picture_set_description(picture, reinterpret_cast<FLAC__byte *>(const_cast<char *>(utf8_description.c_str())), /*copy=*/true) ||
+					!::FLAC__metadata_object_picture_set_data(picture, data->Data, data->Length, /*copy=*/true) ||
+					!::FLAC__metadata_object_picture_is_legal(picture, nullptr) ||
+					!editor_->AddPicture(picture)) {
+					::FLAC__metadata_object_delete(picture);
+					return false;
+				}
+				return true;
+			}
+
+			bool MetadataEditor::RemovePicture(unsigned index)
+			{
+				FLAC__ASSERT(IsValid);
+				return editor_->RemovePicture(index);
+			}
+
+			StreamSplicer::StreamSplicer()
+			{
+				splicer_ = new ::StreamSplicer();
+			}
+
+			StreamSplicer::~StreamSplicer()
+			{
+				delete splicer_;
+				splicer_ = nullptr;
+			}
+
+			bool StreamSplicer::IsValid::get()
+			{
+				return nullptr != splicer_ && splicer_->IsValid();
+			}
+
+			bool StreamSplicer::SetMd5(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				return splicer_->SetMd5(value);
+			}
+
+			bool StreamSplicer::SetCompressionLevel(unsigned value)
+			{
+				FLAC__ASSERT(IsValid);
+				return splicer_->SetCompressionLevel(value);
+			}
+
+			bool StreamSplicer::AddSegment(Windows::Storage::Streams::IRandomAccessStream^ fileStream, FLAC__uint64 startSample, FLAC__uint64 samples)
+			{
+				FLAC__ASSERT(IsValid);
+				return splicer_->AddSegment(new RandomAccessMetadataStream(fileStream), startSample, samples);
+			}
+
+			bool StreamSplicer::Splice(Windows::Storage::Streams::IRandomAccessStream^ outputStream)
+			{
+				FLAC__ASSERT(IsValid);
+				RandomAccessMetadataStream output(outputStream);
+				return splicer_->Splice(&output);
+			}
+
+			StreamSplicerStatus StreamSplicer::GetStatus()
+			{
+				FLAC__ASSERT(IsValid);
+				return (StreamSplicerStatus)(int)splicer_->GetStatus();
+			}
+
+			MetadataIndexer::MetadataIndexer()
+			{
+				indexer_ = new ::MetadataIndexer();
+			}
+
+			MetadataIndexer::~MetadataIndexer()
+			{
+				delete indexer_;
+				indexer_ = nullptr;
+			}
+
+			bool MetadataIndexer::IsValid::get()
+			{
+				return nullptr != indexer_ && indexer_->IsValid();
+			}
+
+			bool MetadataIndexer::SetTypes(const Platform::Array<Format::MetadataType>^ types)
+			{
+				FLAC__ASSERT(IsValid);
+				unsigned mask = 0;
+				for (unsigned int i = 0; i < types->Length; i++) {
+					if ((unsigned)types[i] < FLAC__METADATA_TYPE_UNDEFINED) {
+						mask |= FLAC__METADATA_PROBE_TYPE((unsigned)types[i]);
+					}
+				}
+				return indexer_->SetTypes(mask);
+			}
+
+			bool MetadataIndexer::SetTagNames(const Platform::Array<Platform::String^>^ names)
+			{
+				FLAC__ASSERT(IsValid);
+				if (nullptr == names) {
+					return indexer_->SetTagNames(nullptr);
+				}
+
+				std::vector<std::string> utf8_names;
+				std::vector<const char *> pointers;
+				for (unsigned int i = 0; i < names->Length; i++) {
+					utf8_names.push_back(utf8_from_string(names[i]));
+				}
+				for (size_t i = 0; i < utf8_names.size(); i++) {
+					pointers.push_back(utf8_names[i].c_str());
+				}
+				pointers.push_back(nullptr);
+				return indexer_->SetTagNames(&pointers[0]);
+			}
+
+			bool MetadataIndexer::AddStream(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				return indexer_->AddStream(new RandomAccessMetadataStream(fileStream));
+			}
+
+			unsigned MetadataIndexer::GetCount()
+			{
+				FLAC__ASSERT(IsValid);
+				return indexer_->GetCount();
+			}
+
+			Windows::Foundation::IAsyncOperation<bool>^ MetadataIndexer::RunAsync(unsigned maxInFlight)
+			{
+				FLAC__ASSERT(IsValid);
+				unsigned workers = maxInFlight > 0 ? maxInFlight : 1;
+				if (workers > indexer_->GetCount()) {
+					workers = indexer_->GetCount();
+				}
+
+				MetadataIndexer^ self = this;
+				return concurrency::create_async([self, workers]() -> concurrency::task<bool>
+				{
+					std::vector<concurrency::task<void> > work;
+					for (unsigned i = 0; i < workers; i++) {
+						work.push_back(concurrency::create_task(Windows::System::Threading::ThreadPool::RunAsync(
+							ref new Windows::System::Threading::WorkItemHandler([self](Windows::Foundation::IAsyncAction^)
+						{
+							self->indexer_->Work();
+						}))));
+					}
+					return concurrency::when_all(work.begin(), work.end()).then([self]()
+					{
+						return self->indexer_->AllRead();
+					});
+				});
+			}
+
+			MetadataIndexEntry^ MetadataIndexer::GetEntry(unsigned index)
+			{
+				FLAC__ASSERT(IsValid);
+				return index < indexer_->GetCount() ? ref new MetadataIndexEntry(indexer_->GetEntry(index)) : nullptr;
+			}
+
+		}
+	}
+}
@@ -0,0 +1,172 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <atomic>
+#include <vector>
+
+#include "FLAC_winrt/decoder.h"
+#include "FLAC/assert.h"
+#include "private/helper.h"
+#include "private/playlist_decoder.h"
+#include "private/stream_io.h"
+
+
+namespace FLAC {
+
+	namespace WindowsRuntime {
+
+		namespace Decoder {
+
+			namespace {
+
+				PlaylistTrackFormat make_track_format(const ::TrackFormat &format, unsigned index)
+				{
+					PlaylistTrackFormat result;
+					result.Index = index;
+					result.SampleRate = format.sample_rate;
+					result.Channels = format.channels;
+					result.BitsPerSample = format.bits_per_sample;
+					result.TotalSamples = format.total_samples;
+					return result;
+				}
+
+			}
+
+			PlaylistDecoder::PlaylistDecoder() :
+				float_output_(false),
+				output_gain_(1.0f)
+			{
+				playlist_ = new ::PlaylistDecoder();
+			}
+
+			PlaylistDecoder::~PlaylistDecoder()
+			{
+				delete playlist_;
+				playlist_ = nullptr;
+			}
+
+			bool PlaylistDecoder::IsValid::get()
+			{
+				return (nullptr != playlist_);
+			}
+
+			unsigned PlaylistDecoder::Enqueue(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				return playlist_->Enqueue(new RandomAccessStreamSource(fileStream), /*ogg=*/false);
+			}
+
+			unsigned PlaylistDecoder::EnqueueOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				return playlist_->Enqueue(new RandomAccessStreamSource(fileStream), /*ogg=*/true);
+			}
+
+			void PlaylistDecoder::Clear()
+			{
+				FLAC__ASSERT(IsValid);
+				playlist_->Clear();
+			}
+
+			bool PlaylistDecoder::SetFloatOutput(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				float_output_ = value;
+				playlist_->SetFloat(float_output_, output_gain_);
+				return true;
+			}
+
+			bool PlaylistDecoder::SetOutputGain(float gain)
+			{
+				FLAC__ASSERT(IsValid);
+				output_gain_ = gain;
+				playlist_->SetFloat(float_output_, output_gain_);
+				return true;
+			}
+
+			bool PlaylistDecoder::GetFloatOutput()
+			{
+				FLAC__ASSERT(IsValid);
+				return float_output_;
+			}
+
+			float PlaylistDecoder::GetOutputGain()
+			{
+				FLAC__ASSERT(IsValid);
+				return output_gain_;
+			}
+
+			bool PlaylistDecoder::GetCurrentFormat(PlaylistTrackFormat *format)
+			{
+				FLAC__ASSERT(IsValid);
+				::TrackFormat track_format;
+				unsigned index;
+				if (!playlist_->GetCurrentFormat(&track_format, &index)) {
+					return false;
+				}
+				*format = make_track_format(track_format, index);
+				return true;
+			}
+
+			bool PlaylistDecoder::GetNextFormat(PlaylistTrackFormat *format)
+			{
+				FLAC__ASSERT(IsValid);
+				::TrackFormat track_format;
+				unsigned index;
+				if (!playlist_->GetNextFormat(&track_format, &index)) {
+					return false;
+				}
+				*format = make_track_format(track_format, index);
+				return true;
+			}
+
+			Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ PlaylistDecoder::DecodeAsync(unsigned samples)
+			{
+				FLAC__ASSERT(IsValid);
+
+				PlaylistDecoder^ self = this;
+				return concurrency::create_async([self, samples](concurrency::cancellation_token token) -> Windows::Storage::Streams::IBuffer^
+				{
+					std::atomic<bool> cancelled(false);
+					concurrency::cancellation_token_registration registration = token.register_callback([&cancelled]() { cancelled = true; });
+
+					std::vector<FLAC__byte> pcm;
+					BatchStatus status = self->playlist_->Read(samples, pcm, cancelled);
+					token.deregister_callback(registration);
+
+					return Helper::complete_batch(status, pcm);
+				});
+			}
+
+		}
+	}
+}
@@ -34,6 +34,9 @@
 #include "FLAC_winrt/decoder.h"
 #include "FLAC/assert.h"
 #include "private/helper.h"
+#include "private/stream_io.h"
+#include "private/batch_decoder.h"
+#include "private/completion_latch.h"
 
 
 namespace FLAC {
@@ -42,21 +45,75 @@ namespace FLAC {
 
 		namespace Decoder {
 
+			namespace {
+
+				/* hands the decoder back when a DecodeAsync() batch ends, however
+				 * it ends */
+				class BatchingScope
+				{
+				public:
+					explicit BatchingScope(std::atomic<bool> &batching) : batching_(batching) { }
+					~BatchingScope() { batching_ = false; }
+
+				private:
+					BatchingScope(const BatchingScope &);
+					BatchingScope &operator=(const BatchingScope &);
+
+					std::atomic<bool> &batching_;
+				};
+
+				/* decodes the first sample on its own so that the channel count and
+				 * resolution are known before the output is laid out; the rest of the
+				 * range then carries on from the frame just decoded, without a second seek */
+				bool probe_range(::FLAC__StreamDecoder *decoder, FLAC__uint64 start, unsigned *channels, unsigned *bits_per_sample)
+				{
+					FLAC__int32 first[FLAC__MAX_CHANNELS];
+					FLAC__int32 *planes[FLAC__MAX_CHANNELS];
+					unsigned decoded = 0;
+
+					for (unsigned i = 0; i < FLAC__MAX_CHANNELS; i++) {
+						planes[i] = first + i;
+					}
+					if (!::FLAC__stream_decoder_decode_range(decoder, start, 1, planes, 1, &decoded)) {
+						return false;
+					}
+					*channels = (0 != decoded) ? ::FLAC__stream_decoder_get_channels(decoder) : 0;
+					*bits_per_sample = ::FLAC__stream_decoder_get_bits_per_sample(decoder);
+					return true;
+				}
+
+			}
+
 			StreamDecoder::StreamDecoder() :
-				file_stream_(nullptr)
+				file_stream_(nullptr),
+				pcm_fifo_(nullptr),
+				batching_(false),
+				float_output_(false),
+				output_gain_(1.0f)
 			{
 				decoder_ = ::FLAC__stream_decoder_new();
+				deferral_latch_ = new CompletionLatch();
 			}
 
 			StreamDecoder::~StreamDecoder()
 			{
+				if (decode_queue_) {
+					decode_queue_->Stop();
+					decode_queue_.reset();
+				}
+
 				if (nullptr != decoder_) {
 					(void)::FLAC__stream_decoder_finish(decoder_);
 					::FLAC__stream_decoder_delete(decoder_);
 				}
 
 				decoder_ = nullptr;
+				delete file_stream_;
 				file_stream_ = nullptr;
+				delete pcm_fifo_;
+				pcm_fifo_ = nullptr;
+				delete deferral_latch_;
+				deferral_latch_ = nullptr;
 			}
 
 			bool StreamDecoder::IsValid::get()
@@ -70,12 +127,51 @@ namespace FLAC {
 				return !!(::FLAC__stream_decoder_set_ogg_serial_number(decoder_, value));
 			}
 
+			bool StreamDecoder::SetOggPageIndexing(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_set_ogg_page_indexing(decoder_, value));
+			}
+
 			bool StreamDecoder::SetMd5Checking(bool value)
 			{
 				FLAC__ASSERT(IsValid);
 				return !!(::FLAC__stream_decoder_set_md5_checking(decoder_, value));
 			}
 
+			bool StreamDecoder::SetChannelMask(unsigned mask)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_set_channel_mask(decoder_, mask));
+			}
+
+			bool StreamDecoder::SetRetainBuffers(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_set_retain_buffers(decoder_, value));
+			}
+
+			bool StreamDecoder::SetMemoryLimit(FLAC__uint64 limit)
+			{
+				FLAC__ASSERT(IsValid);
+				if (limit > (FLAC__uint64)SIZE_MAX) {
+					limit = SIZE_MAX;
+				}
+				return !!(::FLAC__stream_decoder_set_memory_limit(decoder_, (size_t)limit));
+			}
+
+			bool StreamDecoder::SetReadBufferSize(unsigned bytes)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_set_read_buffer_size(decoder_, bytes));
+			}
+
+			bool StreamDecoder::SetLazyPictures(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_set_lazy_pictures(decoder_, value));
+			}
+
 			bool StreamDecoder::SetMetadataRespond(Format::MetadataType type)
 			{
 				FLAC__ASSERT(IsValid);
@@ -112,6 +208,33 @@ namespace FLAC {
 				return !!(::FLAC__stream_decoder_set_metadata_ignore_all(decoder_));
 			}
 
+			bool StreamDecoder::SetFloatOutput(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				/* the batch worker owns the fifo */
+				if (batching_) {
+					return false;
+				}
+				float_output_ = value;
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->SetFloat(float_output_, output_gain_);
+				}
+				return true;
+			}
+
+			bool StreamDecoder::SetOutputGain(float gain)
+			{
+				FLAC__ASSERT(IsValid);
+				if (batching_) {
+					return false;
+				}
+				output_gain_ = gain;
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->SetFloat(float_output_, output_gain_);
+				}
+				return true;
+			}
+
 			StreamDecoderState StreamDecoder::GetState()
 			{
 				FLAC__ASSERT(IsValid);
@@ -124,6 +247,62 @@ namespace FLAC {
 				return !!(::FLAC__stream_decoder_get_md5_checking(decoder_));
 			}
 
+			unsigned StreamDecoder::GetChannelMask()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_decoder_get_channel_mask(decoder_);
+			}
+
+			bool StreamDecoder::GetOggPageIndexing()
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_get_ogg_page_indexing(decoder_));
+			}
+
+			bool StreamDecoder::GetRetainBuffers()
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_get_retain_buffers(decoder_));
+			}
+
+			FLAC__uint64 StreamDecoder::GetMemoryLimit()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_decoder_get_memory_limit(decoder_);
+			}
+
+			FLAC__uint64 StreamDecoder::GetMemoryUsage()
+			{
+				::FLAC__MemoryUsage usage;
+				FLAC__ASSERT(IsValid);
+				::FLAC__stream_decoder_get_memory_usage(decoder_, &usage);
+				return usage.total;
+			}
+
+			unsigned StreamDecoder::GetReadBufferSize()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_decoder_get_read_buffer_size(decoder_);
+			}
+
+			bool StreamDecoder::GetLazyPictures()
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_decoder_get_lazy_pictures(decoder_));
+			}
+
+			bool StreamDecoder::GetFloatOutput()
+			{
+				FLAC__ASSERT(IsValid);
+				return float_output_;
+			}
+
+			float StreamDecoder::GetOutputGain()
+			{
+				FLAC__ASSERT(IsValid);
+				return output_gain_;
+			}
+
 			FLAC__uint64 StreamDecoder::GetTotalSamples()
 			{
 				FLAC__ASSERT(IsValid);
@@ -175,8 +354,9 @@ namespace FLAC {
 			StreamDecoderInitStatus StreamDecoder::Init(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
 			{
 				FLAC__ASSERT(IsValid);
-				file_stream_ = fileStream;
-				file_stream_->Seek(0);
+				CheckNotBatching();
+				delete file_stream_;
+				file_stream_ = new StreamCache(new RandomAccessStreamSource(fileStream));
 				return (StreamDecoderInitStatus)(int)::FLAC__stream_decoder_init_stream(decoder_, read_callback_, seek_callback_, tell_callback_, length_callback_, eof_callback_, write_callback_, metadata_callback_, error_callback_, /*client_data=*/(void*)this);
 			}
 
@@ -189,60 +369,249 @@ namespace FLAC {
 			StreamDecoderInitStatus StreamDecoder::InitOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
 			{
 				FLAC__ASSERT(IsValid);
-				file_stream_ = fileStream;
-				file_stream_->Seek(0);
+				CheckNotBatching();
+				delete file_stream_;
+				file_stream_ = new StreamCache(new RandomAccessStreamSource(fileStream));
 				return (StreamDecoderInitStatus)(int)::FLAC__stream_decoder_init_ogg_stream(decoder_, read_callback_, seek_callback_, tell_callback_, length_callback_, eof_callback_, write_callback_, metadata_callback_, error_callback_, /*client_data=*/(void*)this);
 			}
 
 			bool StreamDecoder::Finish()
 			{
 				FLAC__ASSERT(IsValid);
+				StopDecodeQueue();
+				/* a pending DecodeAsync() is still using the decoder and the fifo */
+				CheckNotBatching();
+				delete file_stream_;
 				file_stream_ = nullptr;
-				return !!(::FLAC__stream_decoder_finish(decoder_));
+				bool ok = !!(::FLAC__stream_decoder_finish(decoder_));
+				delete pcm_fifo_;
+				pcm_fifo_ = nullptr;
+				return ok;
 			}
 
 			bool StreamDecoder::Flush()
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->Clear();
+				}
 				return !!(::FLAC__stream_decoder_flush(decoder_));
 			}
 
 			bool StreamDecoder::Reset()
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->Clear();
+				}
 				return !!(::FLAC__stream_decoder_reset(decoder_));
 			}
 
 			bool StreamDecoder::ProcessSingle()
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
 				return !!(::FLAC__stream_decoder_process_single(decoder_));
 			}
 
 			bool StreamDecoder::ProcessUntilEndOfMetadata()
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
 				return !!(::FLAC__stream_decoder_process_until_end_of_metadata(decoder_));
 			}
 
 			bool StreamDecoder::ProcessUntilEndOfStream()
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
 				return !!(::FLAC__stream_decoder_process_until_end_of_stream(decoder_));
 			}
 
 			bool StreamDecoder::SkipSingleFrame()
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
 				return !!(::FLAC__stream_decoder_skip_single_frame(decoder_));
 			}
 
 			bool StreamDecoder::SeekAbsolute(FLAC__uint64 sample)
 			{
 				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->Clear();
+				}
 				return !!(::FLAC__stream_decoder_seek_absolute(decoder_, sample));
 			}
 
+			bool StreamDecoder::DecodeRange(FLAC__uint64 start, Platform::WriteOnlyArray<int>^ buffer, bool planar, unsigned *decoded)
+			{
+				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->Clear();
+				}
+
+				unsigned channels, bits_per_sample;
+				*decoded = 0;
+				if (!probe_range(decoder_, start, &channels, &bits_per_sample)) {
+					return false;
+				}
+				if (0 == channels || buffer->Length < channels) {
+					return true;
+				}
+
+				const unsigned samples = buffer->Length / channels;
+				FLAC__int32 *planes[FLAC__MAX_CHANNELS];
+				for (unsigned i = 0; i < channels; i++) {
+					planes[i] = planar ? buffer->Data + i * samples : buffer->Data + i;
+				}
+				return !!(::FLAC__stream_decoder_decode_range(decoder_, start, samples, planes, planar ? 1 : channels, decoded));
+			}
+
+			Windows::Storage::Streams::IBuffer^ StreamDecoder::DecodeRange(FLAC__uint64 start, unsigned samples)
+			{
+				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				if (nullptr != pcm_fifo_) {
+					pcm_fifo_->Clear();
+				}
+
+				unsigned channels = 0, bits_per_sample = 0, decoded = 0;
+				if (!probe_range(decoder_, start, &channels, &bits_per_sample)) {
+					throw ref new Platform::COMException(E_FAIL);
+				}
+				if (0 == channels || 0 == samples) {
+					return ref new Windows::Storage::Streams::Buffer(0);
+				}
+
+				/* planar, which is what the packers take */
+				std::vector<FLAC__int32> pcm((size_t)samples * channels);
+				FLAC__int32 *planes[FLAC__MAX_CHANNELS];
+				for (unsigned i = 0; i < channels; i++) {
+					planes[i] = pcm.data() + (size_t)i * samples;
+				}
+				if (!::FLAC__stream_decoder_decode_range(decoder_, start, samples, planes, 1, &decoded)) {
+					throw ref new Platform::COMException(E_FAIL);
+				}
+
+				const int *data[FLAC__MAX_CHANNELS];
+				for (unsigned i = 0; i < channels; i++) {
+					data[i] = planes[i];
+				}
+				return float_output_ ?
+					Helper::pack_float(data, decoded, channels, bits_per_sample, output_gain_) :
+					Helper::pack_sample(data, decoded, channels, bits_per_sample);
+			}
+
+			bool StreamDecoder::ScanOggPageIndex()
+			{
+				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				return !!(::FLAC__stream_decoder_scan_ogg_page_index(decoder_));
+			}
+
+			Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ StreamDecoder::DecodeAsync(unsigned samples)
+			{
+				FLAC__ASSERT(IsValid);
+				bool idle = false;
+				if (!batching_.compare_exchange_strong(idle, true)) {
+					throw ref new Platform::COMException(E_ILLEGAL_METHOD_CALL);
+				}
+				if (nullptr == pcm_fifo_) {
+					pcm_fifo_ = new PcmFifo();
+					pcm_fifo_->SetFloat(float_output_, output_gain_);
+				}
+
+				StreamDecoder^ self = this;
+				return concurrency::create_async([self, samples](concurrency::cancellation_token token)
+				{
+					/* the task does not take the token, so it runs even when the
+					 * operation is cancelled before it starts, and always hands
+					 * the decoder back */
+					return concurrency::create_task([self, samples, token]() -> Windows::Storage::Streams::IBuffer^
+					{
+						BatchingScope scope(self->batching_);
+						std::atomic<bool> cancelled(false);
+						concurrency::cancellation_token_registration registration = token.register_callback([&cancelled]() { cancelled = true; });
+
+						std::vector<FLAC__byte> pcm;
+						BatchStatus status = decode_batch(self->decoder_, *self->pcm_fifo_, samples, pcm, cancelled);
+						token.deregister_callback(registration);
+
+						return Helper::complete_batch(status, pcm);
+					});
+				});
+			}
+
+			void StreamDecoder::StartDecodeQueue(unsigned samples, unsigned depth)
+			{
+				FLAC__ASSERT(IsValid);
+				CheckNotBatching();
+				if (nullptr == pcm_fifo_) {
+					pcm_fifo_ = new PcmFifo();
+					pcm_fifo_->SetFloat(float_output_, output_gain_);
+				}
+
+				/* raw pointers, so the worker does not keep the decoder alive */
+				::FLAC__StreamDecoder *decoder = decoder_;
+				::PcmFifo *fifo = pcm_fifo_;
+				batching_ = true;
+				decode_queue_ = std::make_shared<DecodeQueue>([decoder, fifo, samples](std::vector<FLAC__byte> &buffer, const std::atomic<bool> &cancelled)
+				{
+					return decode_batch(decoder, *fifo, samples, buffer, cancelled);
+				}, depth);
+				decode_queue_->Start();
+			}
+
+			Windows::Foundation::IAsyncOperation<Windows::Storage::Streams::IBuffer^>^ StreamDecoder::DequeueAsync()
+			{
+				FLAC__ASSERT(IsValid);
+				if (!decode_queue_) {
+					throw ref new Platform::COMException(E_ILLEGAL_METHOD_CALL);
+				}
+
+				std::shared_ptr<DecodeQueue> queue = decode_queue_;
+				return concurrency::create_async([queue](concurrency::cancellation_token token) -> Windows::Storage::Streams::IBuffer^
+				{
+					/* cancelling gives up this wait only; the queue keeps running */
+					std::atomic<bool> abandoned(false);
+					concurrency::cancellation_token_registration registration = token.register_callback([queue, &abandoned]()
+					{
+						abandoned = true;
+						queue->Wake();
+					});
+
+					std::vector<FLAC__byte> pcm;
+					BatchStatus status = queue->Pop(pcm, abandoned);
+					token.deregister_callback(registration);
+
+					return Helper::complete_batch(status, pcm);
+				});
+			}
+
+			void StreamDecoder::StopDecodeQueue()
+			{
+				FLAC__ASSERT(IsValid);
+				if (decode_queue_) {
+					/* a pending DequeueAsync() may still hold the queue, so stop
+					 * the worker here rather than in the queue's destructor */
+					decode_queue_->Stop();
+					decode_queue_.reset();
+					batching_ = false;
+				}
+			}
+
+			void StreamDecoder::CheckNotBatching()
+			{
+				if (batching_) {
+					throw ref new Platform::COMException(E_ILLEGAL_METHOD_CALL);
+				}
+			}
+
 
 			::FLAC__StreamDecoderReadStatus StreamDecoder::read_callback_(const ::FLAC__StreamDecoder *decoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
 			{
@@ -251,7 +620,7 @@ namespace FLAC {
 				StreamDecoder^ instance = reinterpret_cast<StreamDecoder^>(client_data);
 				FLAC__ASSERT(nullptr != instance && instance->IsValid);
 
-				Callbacks::StreamDecoderReadEventArgs^ args = ref new Callbacks::StreamDecoderReadEventArgs(buffer, bytes);
+				Callbacks::StreamDecoderReadEventArgs^ args = ref new Callbacks::StreamDecoderReadEventArgs(buffer, bytes, instance->deferral_latch_);
 				if (instance->file_stream_) {
 					StreamDecoder::file_stream_read_(instance->file_stream_, args);
 				}
@@ -270,7 +639,7 @@ namespace FLAC {
 				StreamDecoder^ instance = reinterpret_cast<StreamDecoder^>(client_data);
 				FLAC__ASSERT(nullptr != instance && instance->IsValid);
 
-				Callbacks::StreamDecoderSeekEventArgs^ args = ref new Callbacks::StreamDecoderSeekEventArgs(absolute_byte_offset);
+				Callbacks::StreamDecoderSeekEventArgs^ args = ref new Callbacks::StreamDecoderSeekEventArgs(absolute_byte_offset, instance->deferral_latch_);
 				if (instance->file_stream_) {
 					StreamDecoder::file_stream_seek_(instance->file_stream_, args);
 				}
@@ -289,7 +658,7 @@ namespace FLAC {
 				StreamDecoder^ instance = reinterpret_cast<StreamDecoder^>(client_data);
 				FLAC__ASSERT(nullptr != instance && instance->IsValid);
 
-				Callbacks::StreamDecoderTellEventArgs^ args = ref new Callbacks::StreamDecoderTellEventArgs(absolute_byte_offset);
+				Callbacks::StreamDecoderTellEventArgs^ args = ref new Callbacks::StreamDecoderTellEventArgs(absolute_byte_offset, instance->deferral_latch_);
 				if (instance->file_stream_) {
 					StreamDecoder::file_stream_tell_(instance->file_stream_, args);
 				}
@@ -308,7 +677,7 @@ namespace FLAC {
 				StreamDecoder^ instance = reinterpret_cast<StreamDecoder^>(client_data);
 				FLAC__ASSERT(nullptr != instance && instance->IsValid);
 
-				Callbacks::StreamDecoderLengthEventArgs^ args = ref new Callbacks::StreamDecoderLengthEventArgs(stream_length);
+				Callbacks::StreamDecoderLengthEventArgs^ args = ref new Callbacks::StreamDecoderLengthEventArgs(stream_length, instance->deferral_latch_);
 				if (instance->file_stream_) {
 					StreamDecoder::file_stream_length_(instance->file_stream_, args);
 				}
@@ -327,7 +696,7 @@ namespace FLAC {
 				StreamDecoder^ instance = reinterpret_cast<StreamDecoder^>(client_data);
 				FLAC__ASSERT(nullptr != instance && instance->IsValid);
 
-				Callbacks::StreamDecoderEofEventArgs^ args = ref new Callbacks::StreamDecoderEofEventArgs();
+				Callbacks::StreamDecoderEofEventArgs^ args = ref new Callbacks::StreamDecoderEofEventArgs(instance->deferral_latch_);
 				if (instance->file_stream_) {
 					StreamDecoder::file_stream_eof_(instance->file_stream_, args);
 				}
@@ -346,7 +715,12 @@ namespace FLAC {
 				StreamDecoder^ instance = reinterpret_cast<StreamDecoder^>(client_data);
 				FLAC__ASSERT(nullptr != instance && instance->IsValid);
 
-				Callbacks::StreamDecoderWriteEventArgs^ args = ref new Callbacks::StreamDecoderWriteEventArgs(buffer, frame);
+				if (instance->batching_) {
+					return instance->pcm_fifo_->Append(buffer, frame->header.blocksize, frame->header.channels, frame->header.bits_per_sample) ?
+						FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE : FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+				}
+
+				Callbacks::StreamDecoderWriteEventArgs^ args = ref new Callbacks::StreamDecoderWriteEventArgs(buffer, frame, instance->deferral_latch_);
 				instance->WriteCallback(instance, args);
 				args->WaitForDeferrals();
 
@@ -372,80 +746,80 @@ namespace FLAC {
 			}
 
 
-			void StreamDecoder::file_stream_read_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderReadEventArgs^ e)
+			void StreamDecoder::file_stream_read_(::StreamCache *file_stream, Callbacks::StreamDecoderReadEventArgs^ e)
 			{
 				if (e->BufferSize > 0) {
-					Callbacks::IDeferral^ deferral = e->GetDeferral();
-					Windows::Storage::Streams::IDataReader^ dataReader = ref new Windows::Storage::Streams::DataReader(file_stream);
-
-					Windows::Storage::Streams::DataReaderLoadOperation^ loadOperation = dataReader->LoadAsync(e->BufferSize);
-					concurrency::create_task(loadOperation).then([e, dataReader, deferral](uint32 count)
-					{
-						e->BufferSize = count;
-
-						if (0 == e->BufferSize) {
-							e->SetResult(Callbacks::StreamDecoderReadStatus::EndOfStream);
-						}
-						else {
-							dataReader->ReadBytes(e->GetArrayReference());
-							e->SetResult(Callbacks::StreamDecoderReadStatus::Continue);
-						}
-
-						(void)dataReader->DetachStream();
-						deferral->Complete();
-					});
+					size_t bytes = e->BufferSize;
+					Platform::Array<FLAC__byte>^ buffer = e->GetArrayReference();
+					if (!file_stream->Read(buffer->Data, &bytes)) {
+						e->SetResult(Callbacks::StreamDecoderReadStatus::Abort);
+					}
+					else {
+						e->BufferSize = bytes;
+						e->SetResult(0 == bytes ? Callbacks::StreamDecoderReadStatus::EndOfStream : Callbacks::StreamDecoderReadStatus::Continue);
+					}
 				}
 				else {
 					e->SetResult(Callbacks::StreamDecoderReadStatus::Abort);
 				}
 			}
 
-			void StreamDecoder::file_stream_seek_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderSeekEventArgs^ e)
+			void StreamDecoder::file_stream_seek_(::StreamCache *file_stream, Callbacks::StreamDecoderSeekEventArgs^ e)
 			{
-				if (e->AbsoluteByteOffset > file_stream->Size) {
+				if (!file_stream->Seek(e->AbsoluteByteOffset)) {
 					e->SetResult(Callbacks::StreamDecoderSeekStatus::Error);
 				}
 				else {
-					file_stream->Seek(e->AbsoluteByteOffset);
 					e->SetResult(Callbacks::StreamDecoderSeekStatus::OK);
 				}
 			}
 
-			void StreamDecoder::file_stream_tell_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderTellEventArgs^ e)
+			void StreamDecoder::file_stream_tell_(::StreamCache *file_stream, Callbacks::StreamDecoderTellEventArgs^ e)
 			{
-				e->SetAbsoluteByteOffset(file_stream->Position);
+				e->SetAbsoluteByteOffset(file_stream->Tell());
 				e->SetResult(Callbacks::StreamDecoderTellStatus::OK);
 			}
 
-			void StreamDecoder::file_stream_length_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderLengthEventArgs^ e)
+			void StreamDecoder::file_stream_length_(::StreamCache *file_stream, Callbacks::StreamDecoderLengthEventArgs^ e)
 			{
-				e->SetStreamLength(file_stream->Size);
-				e->SetResult(Callbacks::StreamDecoderLengthStatus::OK);
+				FLAC__uint64 length;
+				if (!file_stream->Length(&length)) {
+					e->SetResult(Callbacks::StreamDecoderLengthStatus::Error);
+				}
+				else {
+					e->SetStreamLength(length);
+					e->SetResult(Callbacks::StreamDecoderLengthStatus::OK);
+				}
 			}
 
-			void StreamDecoder::file_stream_eof_(Windows::Storage::Streams::IRandomAccessStream^ file_stream, Callbacks::StreamDecoderEofEventArgs^ e)
+			void StreamDecoder::file_stream_eof_(::StreamCache *file_stream, Callbacks::StreamDecoderEofEventArgs^ e)
 			{
-				e->SetResult(file_stream->Position >= file_stream->Size);
+				e->SetResult(file_stream->Eof());
 			}
 
 
 			Windows::Storage::Streams::IBuffer^ Callbacks::StreamDecoderWriteEventArgs::GetBuffer()
 			{
 				if (!buffer_) {
-					buffer_ = Helper::pack_sample(data_, frame_->Header->Blocksize, frame_->Header->Channels, frame_->Header->BitsPerSample);
+					buffer_ = Helper::pack_sample(data_, native_frame_->header.blocksize, native_frame_->header.channels, native_frame_->header.bits_per_sample);
 				}
 				return buffer_;
 			}
 
+			Windows::Storage::Streams::IBuffer^ Callbacks::StreamDecoderWriteEventArgs::GetFloatBuffer(float gain)
+			{
+				return Helper::pack_float(data_, native_frame_->header.blocksize, native_frame_->header.channels, native_frame_->header.bits_per_sample, gain);
+			}
+
 			Platform::Array<FLAC__int32>^ Callbacks::StreamDecoderWriteEventArgs::GetData(unsigned index)
 			{
-				if (index > frame_->Header->Channels)
+				if (index >= native_frame_->header.channels)
 					throw ref new Platform::OutOfBoundsException();
 
 				if (!data_array_) {
-					data_array_ = ref new Platform::Array<Platform::Object^>(frame_->Header->Channels);
-					for (unsigned i = 0; i < frame_->Header->Channels; i++) {
-						data_array_[i] = ref new Platform::Array<FLAC__int32>(const_cast<FLAC__int32 *>(data_[i]), frame_->Header->Blocksize);
+					data_array_ = ref new Platform::Array<Platform::Object^>(native_frame_->header.channels);
+					for (unsigned i = 0; i < native_frame_->header.channels; i++) {
+						data_array_[i] = ref new Platform::Array<FLAC__int32>(const_cast<FLAC__int32 *>(data_[i]), native_frame_->header.blocksize);
 					}
 				}
 
@@ -0,0 +1,503 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <codecvt>
+#include <locale>
+#include <string>
+
+#include "FLAC_winrt/encoder.h"
+#include "FLAC/assert.h"
+#include "private/pcm_encoder.h"
+#include "private/stream_io.h"
+
+
+namespace FLAC {
+
+	namespace WindowsRuntime {
+
+		namespace Encoder {
+
+			namespace {
+
+				class OutputStreamSink : public EncoderSink
+				{
+				public:
+					OutputStreamSink(Windows::Storage::Streams::IOutputStream^ output_stream) :
+						data_writer_(ref new Windows::Storage::Streams::DataWriter(output_stream)),
+						written_(0)
+					{
+					}
+
+					virtual ~OutputStreamSink()
+					{
+						(void)data_writer_->DetachStream();
+					}
+
+					virtual bool Write(FLAC__uint64 offset, const FLAC__byte *buffer, size_t bytes)
+					{
+						/* nothing can be rewritten on a sequential stream */
+						if (offset != written_) {
+							return false;
+						}
+						if (!Store(buffer, bytes)) {
+							return false;
+						}
+						written_ += bytes;
+						return true;
+					}
+
+					virtual bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+					{
+						(void)offset, (void)buffer, (void)bytes;
+						*bytes_read = 0;
+						return false;
+					}
+
+				protected:
+					bool Store(const FLAC__byte *buffer, size_t bytes)
+					{
+						unsigned int stored = 0;
+						data_writer_->WriteBytes(Platform::ArrayReference<FLAC__byte>(const_cast<FLAC__byte *>(buffer), (unsigned int)bytes));
+						return wait_for(data_writer_->StoreAsync(), &stored) && stored == bytes;
+					}
+
+				private:
+					Windows::Storage::Streams::DataWriter^ data_writer_;
+					FLAC__uint64 written_;
+				};
+
+				/* Truncates the stream at the first write, so an Init() that is
+				 * refused leaves the caller's file alone.  Nothing is written
+				 * before the encoder has initialized. */
+				class RandomAccessStreamSink : public OutputStreamSink
+				{
+				public:
+					RandomAccessStreamSink(Windows::Storage::Streams::IRandomAccessStream^ file_stream) :
+						OutputStreamSink(file_stream),
+						file_stream_(file_stream),
+						truncated_(false)
+					{
+					}
+
+					virtual bool Write(FLAC__uint64 offset, const FLAC__byte *buffer, size_t bytes)
+					{
+						try {
+							if (!truncated_) {
+								file_stream_->Size = 0;
+								truncated_ = true;
+							}
+							if (file_stream_->Position != offset) {
+								file_stream_->Seek(offset);
+							}
+						}
+						catch (Platform::Exception^) {
+							return false;
+						}
+						return Store(buffer, bytes);
+					}
+
+					virtual bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+					{
+						*bytes_read = 0;
+						if (offset >= file_stream_->Size) {
+							return true;
+						}
+
+						Windows::Storage::Streams::DataReader^ dataReader = ref new Windows::Storage::Streams::DataReader(file_stream_->GetInputStreamAt(offset));
+						unsigned int count = 0;
+						if (!wait_for(dataReader->LoadAsync((unsigned int)bytes), &count)) {
+							return false;
+						}
+						if (count > 0) {
+							dataReader->ReadBytes(Platform::ArrayReference<FLAC__byte>(buffer, count));
+						}
+						*bytes_read = count;
+						return true;
+					}
+
+				private:
+					Windows::Storage::Streams::IRandomAccessStream^ file_stream_;
+					bool truncated_;
+				};
+
+			}
+
+			StreamEncoder::StreamEncoder() :
+				file_stream_(nullptr),
+				encode_queue_(nullptr),
+				encode_queue_depth_(0)
+			{
+				encoder_ = ::FLAC__stream_encoder_new();
+				pcm_encoder_ = new PcmEncoder(encoder_);
+				metadata_ = new EncoderMetadata();
+				write_args_ = ref new Callbacks::StreamEncoderWriteEventArgs();
+				tell_args_ = ref new Callbacks::StreamEncoderTellEventArgs();
+			}
+
+			StreamEncoder::~StreamEncoder()
+			{
+				delete encode_queue_;
+				encode_queue_ = nullptr;
+
+				if (nullptr != encoder_) {
+					(void)::FLAC__stream_encoder_finish(encoder_);
+					::FLAC__stream_encoder_delete(encoder_);
+				}
+
+				encoder_ = nullptr;
+				delete file_stream_;
+				file_stream_ = nullptr;
+				delete pcm_encoder_;
+				pcm_encoder_ = nullptr;
+				delete metadata_;
+				metadata_ = nullptr;
+			}
+
+			bool StreamEncoder::IsValid::get()
+			{
+				return (nullptr != encoder_);
+			}
+
+			bool StreamEncoder::SetOggSerialNumber(int value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_ogg_serial_number(encoder_, value));
+			}
+
+			bool StreamEncoder::SetVerify(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_verify(encoder_, value));
+			}
+
+			bool StreamEncoder::SetStreamableSubset(bool value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_streamable_subset(encoder_, value));
+			}
+
+			bool StreamEncoder::SetChannels(unsigned value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_channels(encoder_, value));
+			}
+
+			bool StreamEncoder::SetBitsPerSample(unsigned value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_bits_per_sample(encoder_, value));
+			}
+
+			bool StreamEncoder::SetSampleRate(unsigned value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_sample_rate(encoder_, value));
+			}
+
+			bool StreamEncoder::SetCompressionLevel(unsigned value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_compression_level(encoder_, value));
+			}
+
+			bool StreamEncoder::SetBlocksize(unsigned value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_blocksize(encoder_, value));
+			}
+
+			bool StreamEncoder::SetTotalSamplesEstimate(FLAC__uint64 value)
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_set_total_samples_estimate(encoder_, value));
+			}
+
+			bool StreamEncoder::AddMetadataComment(Platform::String^ name, Platform::String^ value)
+			{
+				FLAC__ASSERT(IsValid);
+				if (FLAC__STREAM_ENCODER_UNINITIALIZED != ::FLAC__stream_encoder_get_state(encoder_)) {
+					return false;
+				}
+
+				std::wstring_convert<std::codecvt_utf8_utf16<wchar_t> > utf8;
+				std::string utf8_name = utf8.to_bytes(name->Data());
+				std::string utf8_value = utf8.to_bytes(value->Data());
+				return metadata_->AddComment(utf8_name.c_str(), utf8_value.c_str());
+			}
+
+			bool StreamEncoder::SetMetadataPadding(unsigned length)
+			{
+				FLAC__ASSERT(IsValid);
+				if (FLAC__STREAM_ENCODER_UNINITIALIZED != ::FLAC__stream_encoder_get_state(encoder_)) {
+					return false;
+				}
+				metadata_->SetPadding(length);
+				return true;
+			}
+
+			bool StreamEncoder::SetMetadataSeekPointSpacing(unsigned samples)
+			{
+				FLAC__ASSERT(IsValid);
+				if (FLAC__STREAM_ENCODER_UNINITIALIZED != ::FLAC__stream_encoder_get_state(encoder_)) {
+					return false;
+				}
+				metadata_->SetSeekPointSpacing(samples);
+				return true;
+			}
+
+			bool StreamEncoder::SetEncodeQueueDepth(unsigned depth)
+			{
+				FLAC__ASSERT(IsValid);
+				if (FLAC__STREAM_ENCODER_UNINITIALIZED != ::FLAC__stream_encoder_get_state(encoder_)) {
+					return false;
+				}
+				encode_queue_depth_ = depth;
+				return true;
+			}
+
+			StreamEncoderState StreamEncoder::GetState()
+			{
+				FLAC__ASSERT(IsValid);
+				return (StreamEncoderState)(int)::FLAC__stream_encoder_get_state(encoder_);
+			}
+
+			bool StreamEncoder::GetVerify()
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_get_verify(encoder_));
+			}
+
+			bool StreamEncoder::GetStreamableSubset()
+			{
+				FLAC__ASSERT(IsValid);
+				return !!(::FLAC__stream_encoder_get_streamable_subset(encoder_));
+			}
+
+			unsigned StreamEncoder::GetChannels()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_encoder_get_channels(encoder_);
+			}
+
+			unsigned StreamEncoder::GetBitsPerSample()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_encoder_get_bits_per_sample(encoder_);
+			}
+
+			unsigned StreamEncoder::GetSampleRate()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_encoder_get_sample_rate(encoder_);
+			}
+
+			unsigned StreamEncoder::GetBlocksize()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_encoder_get_blocksize(encoder_);
+			}
+
+			FLAC__uint64 StreamEncoder::GetTotalSamplesEstimate()
+			{
+				FLAC__ASSERT(IsValid);
+				return ::FLAC__stream_encoder_get_total_samples_estimate(encoder_);
+			}
+
+			unsigned StreamEncoder::GetEncodeQueueDepth()
+			{
+				FLAC__ASSERT(IsValid);
+				return encode_queue_depth_;
+			}
+
+			StreamEncoderInitStatus StreamEncoder::Init()
+			{
+				return init_file_stream_(nullptr, /*seekable=*/true, /*ogg=*/false);
+			}
+
+			StreamEncoderInitStatus StreamEncoder::Init(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				return init_file_stream_(new EncoderWriteCache(new RandomAccessStreamSink(fileStream)), /*seekable=*/true, /*ogg=*/false);
+			}
+
+			StreamEncoderInitStatus StreamEncoder::InitOutputStream(Windows::Storage::Streams::IOutputStream^ outputStream)
+			{
+				FLAC__ASSERT(IsValid);
+				return init_file_stream_(new EncoderWriteCache(new OutputStreamSink(outputStream)), /*seekable=*/false, /*ogg=*/false);
+			}
+
+			StreamEncoderInitStatus StreamEncoder::InitOgg(Windows::Storage::Streams::IRandomAccessStream^ fileStream)
+			{
+				FLAC__ASSERT(IsValid);
+				return init_file_stream_(new EncoderWriteCache(new RandomAccessStreamSink(fileStream)), /*seekable=*/true, /*ogg=*/true);
+			}
+
+			StreamEncoderInitStatus StreamEncoder::init_file_stream_(::EncoderWriteCache *file_stream, bool seekable, bool ogg)
+			{
+				FLAC__ASSERT(IsValid);
+				::FLAC__StreamEncoderInitStatus status;
+
+				if (FLAC__STREAM_ENCODER_UNINITIALIZED != ::FLAC__stream_encoder_get_state(encoder_)) {
+					delete file_stream;
+					return StreamEncoderInitStatus::AlreadyInitialized;
+				}
+
+				delete file_stream_;
+				file_stream_ = file_stream;
+
+				if (!metadata_->Apply(encoder_)) {
+					status = FLAC__STREAM_ENCODER_INIT_STATUS_INVALID_METADATA;
+				}
+				else if (ogg) {
+					status = ::FLAC__stream_encoder_init_ogg_stream(encoder_, read_callback_, write_callback_, seek_callback_, tell_callback_, /*metadata_callback=*/0, /*client_data=*/(void*)this);
+				}
+				else if (seekable) {
+					status = ::FLAC__stream_encoder_init_stream(encoder_, write_callback_, seek_callback_, tell_callback_, /*metadata_callback=*/0, /*client_data=*/(void*)this);
+				}
+				else {
+					status = ::FLAC__stream_encoder_init_stream(encoder_, write_callback_, /*seek_callback=*/0, /*tell_callback=*/0, /*metadata_callback=*/0, /*client_data=*/(void*)this);
+				}
+
+				if (FLAC__STREAM_ENCODER_INIT_STATUS_OK != status) {
+					delete file_stream_;
+					file_stream_ = nullptr;
+					return (StreamEncoderInitStatus)(int)status;
+				}
+
+				pcm_encoder_->Reset();
+				if (encode_queue_depth_ > 0) {
+					encode_queue_ = new EncodeQueue(pcm_encoder_, encode_queue_depth_);
+				}
+
+				return StreamEncoderInitStatus::OK;
+			}
+
+			bool StreamEncoder::Finish()
+			{
+				FLAC__ASSERT(IsValid);
+				bool ok = true;
+
+				if (nullptr != encode_queue_) {
+					ok = encode_queue_->Drain();
+					delete encode_queue_;
+					encode_queue_ = nullptr;
+				}
+
+				ok = !!(::FLAC__stream_encoder_finish(encoder_)) && ok;
+
+				if (nullptr != file_stream_) {
+					ok = file_stream_->Flush() && ok;
+					delete file_stream_;
+					file_stream_ = nullptr;
+				}
+
+				return ok;
+			}
+
+			bool StreamEncoder::ProcessInterleaved(const Platform::Array<FLAC__byte>^ data)
+			{
+				FLAC__ASSERT(IsValid);
+				if (nullptr != encode_queue_) {
+					return encode_queue_->Submit(data->Data, data->Length);
+				}
+				return pcm_encoder_->Process(data->Data, data->Length);
+			}
+
+			::FLAC__StreamEncoderReadStatus StreamEncoder::read_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__byte buffer[], size_t *bytes, void *client_data)
+			{
+				(void)encoder;
+				FLAC__ASSERT(0 != client_data);
+				StreamEncoder^ instance = reinterpret_cast<StreamEncoder^>(client_data);
+				FLAC__ASSERT(nullptr != instance && instance->IsValid);
+
+				/* only the Ogg encoder reads, and only from a file stream */
+				if (nullptr == instance->file_stream_) {
+					return FLAC__STREAM_ENCODER_READ_STATUS_UNSUPPORTED;
+				}
+				if (!instance->file_stream_->Read(buffer, bytes)) {
+					return FLAC__STREAM_ENCODER_READ_STATUS_ABORT;
+				}
+				return 0 == *bytes ? FLAC__STREAM_ENCODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_ENCODER_READ_STATUS_CONTINUE;
+			}
+
+			::FLAC__StreamEncoderWriteStatus StreamEncoder::write_callback_(const ::FLAC__StreamEncoder *encoder, const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame, void *client_data)
+			{
+				(void)encoder;
+				FLAC__ASSERT(0 != client_data);
+				StreamEncoder^ instance = reinterpret_cast<StreamEncoder^>(client_data);
+				FLAC__ASSERT(nullptr != instance && instance->IsValid);
+
+				if (nullptr != instance->file_stream_) {
+					return instance->file_stream_->Write(buffer, bytes) ? FLAC__STREAM_ENCODER_WRITE_STATUS_OK : FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+				}
+
+				instance->write_args_->Reset(buffer, bytes, samples, current_frame);
+				instance->WriteCallback(instance, instance->write_args_);
+				return instance->write_args_->Result;
+			}
+
+			::FLAC__StreamEncoderSeekStatus StreamEncoder::seek_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__uint64 absolute_byte_offset, void *client_data)
+			{
+				(void)encoder;
+				FLAC__ASSERT(0 != client_data);
+				StreamEncoder^ instance = reinterpret_cast<StreamEncoder^>(client_data);
+				FLAC__ASSERT(nullptr != instance && instance->IsValid);
+
+				if (nullptr != instance->file_stream_) {
+					return instance->file_stream_->Seek(absolute_byte_offset) ? FLAC__STREAM_ENCODER_SEEK_STATUS_OK : FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+				}
+
+				Callbacks::StreamEncoderSeekEventArgs^ args = ref new Callbacks::StreamEncoderSeekEventArgs(absolute_byte_offset);
+				instance->SeekCallback(instance, args);
+				return args->Result;
+			}
+
+			::FLAC__StreamEncoderTellStatus StreamEncoder::tell_callback_(const ::FLAC__StreamEncoder *encoder, FLAC__uint64 *absolute_byte_offset, void *client_data)
+			{
+				(void)encoder;
+				FLAC__ASSERT(0 != client_data);
+				StreamEncoder^ instance = reinterpret_cast<StreamEncoder^>(client_data);
+				FLAC__ASSERT(nullptr != instance && instance->IsValid);
+
+				if (nullptr != instance->file_stream_) {
+					*absolute_byte_offset = instance->file_stream_->Tell();
+					return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+				}
+
+				instance->tell_args_->Reset();
+				instance->TellCallback(instance, instance->tell_args_);
+				*absolute_byte_offset = instance->tell_args_->AbsoluteByteOffset;
+				return instance->tell_args_->Result;
+			}
+
+		}
+	}
+}
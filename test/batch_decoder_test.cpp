@@ -0,0 +1,454 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * PcmFifo and DecodeQueue: batches straddling frames, back-pressure at
+ * the queue depth, Stop() and abandoned waits while Pop() waits, and
+ * the producer's error or end of stream reaching every later Pop().
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FLAC/stream_encoder.h"
+#include "check.h"
+#include "private/batch_decoder.h"
+
+
+namespace {
+
+	FLAC__int32 sample_at(unsigned i, unsigned channel, unsigned bits_per_sample)
+	{
+		const FLAC__uint32 hash = i * 2654435761u + channel * 40503u;
+		return (FLAC__int32)(hash << (32 - bits_per_sample)) >> (32 - bits_per_sample);
+	}
+
+	/* a frame of planar samples, numbered from \a first */
+	struct Frame {
+		Frame(unsigned first, unsigned blocksize, unsigned channels, unsigned bits_per_sample) :
+			planes(channels, std::vector<FLAC__int32>(blocksize))
+		{
+			for (unsigned c = 0; c < channels; c++) {
+				for (unsigned i = 0; i < blocksize; i++) {
+					planes[c][i] = sample_at(first + i, c, bits_per_sample);
+				}
+				pointers.push_back(&planes[c][0]);
+			}
+		}
+
+		std::vector<std::vector<FLAC__int32> > planes;
+		std::vector<const FLAC__int32 *> pointers;
+	};
+
+	std::vector<FLAC__byte> packed(unsigned samples, unsigned channels, unsigned bits_per_sample)
+	{
+		std::vector<FLAC__byte> out;
+		for (unsigned i = 0; i < samples; i++) {
+			for (unsigned c = 0; c < channels; c++) {
+				const FLAC__int32 sample = sample_at(i, c, bits_per_sample);
+				if (8 == bits_per_sample) {
+					out.push_back((FLAC__byte)(sample + 0x80));
+					continue;
+				}
+				for (unsigned k = 0; k < bits_per_sample / 8; k++) {
+					out.push_back((FLAC__byte)((sample >> (8 * k)) & 0xFF));
+				}
+			}
+		}
+		return out;
+	}
+
+	void test_fifo_straddling(unsigned bits_per_sample)
+	{
+		const unsigned blocksizes[] = { 100, 37, 250, 1, 612 };
+		const unsigned channels = 2, total = 1000;
+		PcmFifo fifo;
+		std::vector<FLAC__byte> all, batch;
+		unsigned first = 0;
+
+		for (unsigned b = 0; b < sizeof(blocksizes) / sizeof(blocksizes[0]); b++) {
+			Frame frame(first, blocksizes[b], channels, bits_per_sample);
+			CHECK(fifo.Append(&frame.pointers[0], blocksizes[b], channels, bits_per_sample));
+			first += blocksizes[b];
+			CHECK(fifo.GetSamples() == first - all.size() / (channels * bits_per_sample / 8));
+
+			/* batches of 64 leave part of a frame behind for the next one */
+			while (fifo.GetSamples() >= 64) {
+				fifo.Take(64, batch);
+				CHECK(batch.size() == 64 * channels * bits_per_sample / 8);
+				all.insert(all.end(), batch.begin(), batch.end());
+			}
+		}
+		fifo.Take(1000000, batch);
+		all.insert(all.end(), batch.begin(), batch.end());
+		CHECK(0 == fifo.GetSamples());
+		CHECK(first == total);
+		CHECK(all == packed(total, channels, bits_per_sample));
+
+		fifo.Take(64, batch);
+		CHECK(batch.empty());
+	}
+
+	std::vector<float> to_floats(const std::vector<FLAC__byte> &bytes)
+	{
+		std::vector<float> floats(bytes.size() / sizeof(float));
+		if (!floats.empty()) {
+			memcpy(&floats[0], &bytes[0], floats.size() * sizeof(float));
+		}
+		return floats;
+	}
+
+	void test_fifo_formats(unsigned bits_per_sample)
+	{
+		const unsigned channels = 2, blocksize = 100;
+		Frame frame(0, blocksize, channels, bits_per_sample);
+		std::vector<FLAC__byte> out;
+
+		/* what float output gives for the same frame */
+		PcmFifo reference;
+		reference.SetFloat(true, 0.5f);
+		CHECK(reference.Append(&frame.pointers[0], blocksize, channels, bits_per_sample));
+		std::vector<FLAC__byte> expected;
+		reference.Take(blocksize, expected);
+
+		/* switching converts what is waiting, as a playlist's pre-roll is */
+		PcmFifo fifo;
+		CHECK(fifo.Append(&frame.pointers[0], blocksize, channels, bits_per_sample));
+		fifo.Take(30, out);
+		fifo.SetFloat(true, 0.5f);
+		CHECK(blocksize - 30 == fifo.GetSamples());
+		fifo.Take(blocksize, out);
+		const std::vector<float> floats = to_floats(expected);
+		CHECK(std::vector<float>(floats.begin() + 30 * channels, floats.end()) == to_floats(out));
+
+		/* and back again, exactly */
+		CHECK(fifo.Append(&frame.pointers[0], blocksize, channels, bits_per_sample));
+		fifo.SetFloat(true, 0.7f);
+		fifo.SetFloat(false, 1.0f);
+		CHECK(blocksize == fifo.GetSamples());
+		fifo.Take(blocksize, out);
+		CHECK(out == packed(blocksize, channels, bits_per_sample));
+	}
+
+	void test_fifo_gain()
+	{
+		Frame frame(0, 10, 1, 16);
+		PcmFifo fifo;
+		std::vector<FLAC__byte> out;
+
+		/* a new gain applies to the samples waiting too */
+		fifo.SetFloat(true, 1.0f);
+		CHECK(fifo.Append(&frame.pointers[0], 10, 1, 16));
+		fifo.SetFloat(true, 0.25f);
+		CHECK(10 == fifo.GetSamples());
+		fifo.Take(10, out);
+		const std::vector<float> floats = to_floats(out);
+		CHECK(10 == floats.size());
+		for (unsigned i = 0; i < floats.size(); i++) {
+			CHECK(std::fabs(floats[i] - 0.25f * (float)sample_at(i, 0, 16) / 32768.0f) < 1e-6f);
+		}
+
+		/* no packed layout for 12 bits, so those float samples are dropped */
+		Frame odd(0, 10, 1, 12);
+		fifo.SetFloat(true, 1.0f);
+		CHECK(fifo.Append(&odd.pointers[0], 10, 1, 12));
+		fifo.SetFloat(false, 1.0f);
+		CHECK(0 == fifo.GetSamples());
+		CHECK(!fifo.Append(&odd.pointers[0], 10, 1, 12));
+	}
+
+	/* a real stream, so that decode_batch() straddles real frames */
+	struct MemoryStream {
+		std::vector<FLAC__byte> data;
+		size_t position;
+		PcmFifo fifo;
+	};
+
+	FLAC__StreamEncoderWriteStatus encoder_write(const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes, unsigned, unsigned, void *client_data)
+	{
+		MemoryStream *stream = static_cast<MemoryStream *>(client_data);
+		stream->data.insert(stream->data.end(), buffer, buffer + bytes);
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	}
+
+	FLAC__StreamDecoderReadStatus decoder_read(const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *client_data)
+	{
+		MemoryStream *stream = static_cast<MemoryStream *>(client_data);
+		const size_t left = stream->data.size() - stream->position;
+		if (0 == left) {
+			*bytes = 0;
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		}
+		if (*bytes > left) {
+			*bytes = left;
+		}
+		memcpy(buffer, &stream->data[stream->position], *bytes);
+		stream->position += *bytes;
+		return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+
+	FLAC__StreamDecoderWriteStatus decoder_write(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+	{
+		MemoryStream *stream = static_cast<MemoryStream *>(client_data);
+		return stream->fifo.Append(buffer, frame->header.blocksize, frame->header.channels, frame->header.bits_per_sample)
+			? FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE : FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+
+	void decoder_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *)
+	{
+	}
+
+	void test_decode_batch()
+	{
+		const unsigned channels = 2, bits_per_sample = 16, total = 10000;
+		MemoryStream stream;
+		stream.position = 0;
+
+		FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+		FLAC__stream_encoder_set_channels(encoder, channels);
+		FLAC__stream_encoder_set_bits_per_sample(encoder, bits_per_sample);
+		FLAC__stream_encoder_set_blocksize(encoder, 1152);
+		CHECK(FLAC__STREAM_ENCODER_INIT_STATUS_OK == FLAC__stream_encoder_init_stream(encoder, encoder_write, 0, 0, 0, &stream));
+		std::vector<FLAC__int32> interleaved;
+		for (unsigned i = 0; i < total; i++) {
+			for (unsigned c = 0; c < channels; c++) {
+				interleaved.push_back(sample_at(i, c, bits_per_sample));
+			}
+		}
+		CHECK(FLAC__stream_encoder_process_interleaved(encoder, &interleaved[0], total));
+		CHECK(FLAC__stream_encoder_finish(encoder));
+		FLAC__stream_encoder_delete(encoder);
+
+		FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+		CHECK(FLAC__STREAM_DECODER_INIT_STATUS_OK == FLAC__stream_decoder_init_stream(decoder, decoder_read, 0, 0, 0, 0, decoder_write, 0, decoder_error, &stream));
+
+		/* 1000 is no multiple of 1152, so most batches straddle two frames */
+		std::atomic<bool> cancelled(false);
+		std::vector<FLAC__byte> batch, all;
+		BatchStatus status;
+		unsigned batches = 0;
+		while (BatchStatus::Ok == (status = decode_batch(decoder, stream.fifo, 1000, batch, cancelled))) {
+			CHECK(batch.size() == 1000 * channels * 2);
+			all.insert(all.end(), batch.begin(), batch.end());
+			batches++;
+		}
+		CHECK(BatchStatus::EndOfStream == status);
+		CHECK(10 == batches);
+		CHECK(all == packed(total, channels, bits_per_sample));
+
+		/* a cancelled batch stops before decoding anything */
+		CHECK(FLAC__stream_decoder_reset(decoder));
+		stream.position = 0;
+		stream.fifo.Clear();
+		cancelled = true;
+		CHECK(BatchStatus::Cancelled == decode_batch(decoder, stream.fifo, 1000, batch, cancelled));
+
+		FLAC__stream_decoder_delete(decoder);
+	}
+
+	/* a producer that numbers its batches and can be held back or made to fail */
+	struct Producer {
+		Producer() : produced(0), fail_after(-1), failure(BatchStatus::Error), held(false) { }
+
+		BatchStatus operator()(std::vector<FLAC__byte> &buffer, const std::atomic<bool> &cancelled)
+		{
+			/* polls \a cancelled the way decode_batch() does between frames */
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				while (held && !cancelled) {
+					released.wait_for(lock, std::chrono::milliseconds(1));
+				}
+			}
+			if (cancelled) {
+				return BatchStatus::Cancelled;
+			}
+			if (produced == fail_after) {
+				return failure;
+			}
+			buffer.assign(1, (FLAC__byte)produced);
+			produced++;
+			return BatchStatus::Ok;
+		}
+
+		void Hold(bool value)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			held = value;
+			released.notify_all();
+		}
+
+		std::atomic<int> produced;
+		int fail_after;
+		BatchStatus failure;
+
+		std::mutex mutex;
+		std::condition_variable released;
+		bool held;
+	};
+
+	DecodeQueue::Producer wrap(Producer &producer)
+	{
+		return [&producer](std::vector<FLAC__byte> &buffer, const std::atomic<bool> &cancelled) { return producer(buffer, cancelled); };
+	}
+
+	void settle()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+
+	void test_queue_back_pressure()
+	{
+		Producer producer;
+		DecodeQueue queue(wrap(producer), 3);
+		std::vector<FLAC__byte> batch;
+
+		queue.Start();
+		settle();
+		CHECK(3 == producer.produced);
+
+		/* each batch taken makes room for one more */
+		CHECK(BatchStatus::Ok == queue.Pop(batch));
+		CHECK(1 == batch.size() && 0 == batch[0]);
+		settle();
+		CHECK(4 == producer.produced);
+
+		for (int i = 1; i < 10; i++) {
+			CHECK(BatchStatus::Ok == queue.Pop(batch));
+			CHECK(1 == batch.size() && i == batch[0]);
+		}
+		settle();
+		CHECK(13 == producer.produced);
+		queue.Stop();
+	}
+
+	void test_queue_status(BatchStatus failure)
+	{
+		Producer producer;
+		producer.fail_after = 5;
+		producer.failure = failure;
+		DecodeQueue queue(wrap(producer), 2);
+		std::vector<FLAC__byte> batch;
+
+		queue.Start();
+		/* the batches before the failure are all handed out first */
+		for (int i = 0; i < 5; i++) {
+			CHECK(BatchStatus::Ok == queue.Pop(batch));
+			CHECK(1 == batch.size() && i == batch[0]);
+		}
+		CHECK(failure == queue.Pop(batch));
+		CHECK(failure == queue.Pop(batch));
+		queue.Stop();
+		CHECK(5 == producer.produced);
+	}
+
+	void test_queue_stop_while_popping()
+	{
+		Producer producer;
+		producer.Hold(true);
+		DecodeQueue queue(wrap(producer), 2);
+		std::atomic<bool> popped(false);
+		BatchStatus status = BatchStatus::Ok;
+
+		queue.Start();
+		std::thread waiter([&] {
+			std::vector<FLAC__byte> batch;
+			status = queue.Pop(batch);
+			popped = true;
+		});
+		settle();
+		CHECK(!popped);
+
+		/* Stop() wakes the waiter and cancels the held producer */
+		queue.Stop();
+		waiter.join();
+		CHECK(BatchStatus::Cancelled == status);
+		CHECK(0 == producer.produced);
+
+		std::vector<FLAC__byte> batch;
+		CHECK(BatchStatus::Cancelled == queue.Pop(batch));
+	}
+
+	void test_queue_abandoned_pop()
+	{
+		Producer producer;
+		producer.Hold(true);
+		DecodeQueue queue(wrap(producer), 2);
+		std::atomic<bool> abandoned(false);
+		BatchStatus status = BatchStatus::Ok;
+
+		queue.Start();
+		std::thread waiter([&] {
+			std::vector<FLAC__byte> batch;
+			status = queue.Pop(batch, abandoned);
+		});
+		settle();
+		abandoned = true;
+		queue.Wake();
+		waiter.join();
+		CHECK(BatchStatus::Cancelled == status);
+
+		/* the queue runs on, and no batch went to the abandoned wait */
+		producer.Hold(false);
+		std::vector<FLAC__byte> batch;
+		CHECK(BatchStatus::Ok == queue.Pop(batch));
+		CHECK(1 == batch.size() && 0 == batch[0]);
+		queue.Stop();
+	}
+
+}
+
+int main()
+{
+	test_fifo_straddling(8);
+	test_fifo_straddling(16);
+	test_fifo_straddling(24);
+	test_fifo_straddling(32);
+	test_fifo_formats(8);
+	test_fifo_formats(16);
+	test_fifo_formats(24);
+	test_fifo_gain();
+	test_decode_batch();
+	test_queue_back_pressure();
+	test_queue_status(BatchStatus::Error);
+	test_queue_status(BatchStatus::EndOfStream);
+	test_queue_stop_while_popping();
+	test_queue_abandoned_pop();
+
+	return check_summary();
+}
@@ -0,0 +1,330 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * CompletionLatch: a stress run of rounds whose deferrals complete on
+ * other threads, then the latency of a round with no deferral, with one
+ * completed at once by another thread, and with one completed after a
+ * sleep, next to a mutex and condition variable latch like the
+ * per-callback event it replaced.  With --check only the stress run is
+ * done, which is what ctest does.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "private/completion_latch.h"
+
+
+namespace {
+
+	/* completes deferrals on other threads, the way continuations do */
+	class Pool
+	{
+	public:
+		explicit Pool(unsigned threads) : stopping_(false)
+		{
+			for (unsigned i = 0; i < threads; i++) {
+				threads_.push_back(std::thread(&Pool::Run, this));
+			}
+		}
+
+		~Pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+				changed_.notify_all();
+			}
+			for (size_t i = 0; i < threads_.size(); i++) {
+				threads_[i].join();
+			}
+		}
+
+		void Post(const std::function<void()> &work)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.push_back(work);
+			changed_.notify_one();
+		}
+
+	private:
+		void Run()
+		{
+			for (;;) {
+				std::function<void()> work;
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					changed_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+					if (queue_.empty()) {
+						return;
+					}
+					work = queue_.front();
+					queue_.pop_front();
+				}
+				work();
+			}
+		}
+
+		std::mutex mutex_;
+		std::condition_variable changed_;
+		std::deque<std::function<void()> > queue_;
+		std::vector<std::thread> threads_;
+		bool stopping_;
+	};
+
+	/* more rounds than the 16-bit generation has values, so it wraps */
+	void stress(unsigned rounds)
+	{
+		CompletionLatch latch;
+		Pool pool(4);
+		std::atomic<unsigned> completed(0);
+		unsigned previous = 0;
+
+		for (unsigned round = 0; round < rounds; round++) {
+			const unsigned token = latch.Begin();
+			const unsigned deferrals = round % 5;
+			completed = 0;
+
+			for (unsigned i = 0; i < deferrals; i++) {
+				CHECK(latch.AddCount(token));
+				const unsigned delay = (round * 7 + i * 13) % 200;
+				pool.Post([&latch, &completed, token, delay] {
+					for (volatile unsigned k = 0; k < delay; k++) { }
+					if (0 == delay % 50) {
+						std::this_thread::sleep_for(std::chrono::microseconds(20));
+					}
+					completed.fetch_add(1, std::memory_order_relaxed);
+					CHECK(latch.Signal(token));
+				});
+			}
+
+			/* a deferral taken in the previous round is refused */
+			if (round > 0) {
+				CHECK(!latch.AddCount(previous));
+				CHECK(!latch.Signal(previous));
+			}
+
+			latch.SignalAndWait(token);
+			CHECK(completed.load() == deferrals);
+			CHECK(!latch.AddCount(token));
+			CHECK(!latch.Signal(token));
+			previous = token;
+
+			if (0 != failures) {
+				printf("round %u failed\n", round);
+				return;
+			}
+		}
+	}
+
+	void saturation()
+	{
+		CompletionLatch latch;
+		const unsigned token = latch.Begin();
+		unsigned added = 0;
+
+		while (latch.AddCount(token)) {
+			added++;
+		}
+		/* the caller's hold plus the rest of the 15-bit count */
+		CHECK(0x7FFE == added);
+		for (unsigned i = 0; i < added; i++) {
+			CHECK(latch.Signal(token));
+		}
+		latch.SignalAndWait(token);
+		CHECK(!latch.Signal(token));
+	}
+
+	/* the event the latch replaced, allocated per callback */
+	struct EventLatch {
+		EventLatch() : count(1), set(false) { }
+
+		void Signal()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (0 == --count) {
+				set = true;
+				changed.notify_all();
+			}
+		}
+
+		void SignalAndWait()
+		{
+			Signal();
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return set; });
+		}
+
+		unsigned count;
+		bool set;
+		std::mutex mutex;
+		std::condition_variable changed;
+	};
+
+	double nanoseconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void print_percentiles(const char *name, std::vector<double> &latencies)
+	{
+		std::sort(latencies.begin(), latencies.end());
+		printf("%-34s p50 %9.0f ns  p99 %9.0f ns  max %9.0f ns\n", name,
+			latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], latencies.back());
+	}
+
+	void benchmark()
+	{
+		const unsigned callbacks = 10000000, handoffs = 20000, sleeps = 200;
+		CompletionLatch latch;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < callbacks; i++) {
+			latch.SignalAndWait(latch.Begin());
+		}
+		printf("%-34s %.1f ns per callback\n", "no deferral, latch:", nanoseconds_since(start) / callbacks);
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < callbacks / 10; i++) {
+			EventLatch *event = new EventLatch();
+			event->SignalAndWait();
+			delete event;
+		}
+		printf("%-34s %.1f ns per callback\n", "no deferral, event:", nanoseconds_since(start) / (callbacks / 10));
+
+		/* another thread completes each deferral as soon as it sees it */
+		{
+			std::atomic<unsigned> mailbox(0);
+			std::atomic<bool> quit(false);
+			std::thread other([&] {
+				for (;;) {
+					unsigned token;
+					while (0 == (token = mailbox.exchange(0))) {
+						if (quit) {
+							return;
+						}
+					}
+					(void)latch.Signal(token - 1);
+				}
+			});
+			std::vector<double> latencies;
+			for (unsigned i = 0; i < handoffs; i++) {
+				start = std::chrono::steady_clock::now();
+				const unsigned token = latch.Begin();
+				(void)latch.AddCount(token);
+				mailbox = token + 1;
+				latch.SignalAndWait(token);
+				latencies.push_back(nanoseconds_since(start));
+			}
+			quit = true;
+			other.join();
+			print_percentiles("cross-thread deferral, latch:", latencies);
+		}
+		{
+			std::atomic<EventLatch *> mailbox(nullptr);
+			std::atomic<bool> quit(false);
+			std::thread other([&] {
+				for (;;) {
+					EventLatch *event;
+					while (nullptr == (event = mailbox.exchange(nullptr))) {
+						if (quit) {
+							return;
+						}
+					}
+					event->Signal();
+				}
+			});
+			std::vector<double> latencies;
+			for (unsigned i = 0; i < handoffs; i++) {
+				start = std::chrono::steady_clock::now();
+				EventLatch *event = new EventLatch();
+				event->count++;
+				mailbox = event;
+				event->SignalAndWait();
+				latencies.push_back(nanoseconds_since(start));
+				/* Signal() may still hold the mutex after the wait returns */
+				{
+					std::lock_guard<std::mutex> lock(event->mutex);
+				}
+				delete event;
+			}
+			quit = true;
+			other.join();
+			print_percentiles("cross-thread deferral, event:", latencies);
+		}
+
+		/* a deferral that outlasts the spin has to sleep and be woken */
+		{
+			std::vector<double> latencies;
+			for (unsigned i = 0; i < sleeps; i++) {
+				const unsigned token = latch.Begin();
+				(void)latch.AddCount(token);
+				std::thread other([&latch, token] {
+					std::this_thread::sleep_for(std::chrono::milliseconds(2));
+					(void)latch.Signal(token);
+				});
+				start = std::chrono::steady_clock::now();
+				latch.SignalAndWait(token);
+				latencies.push_back(nanoseconds_since(start));
+				other.join();
+			}
+			print_percentiles("2 ms deferral, latch:", latencies);
+		}
+	}
+
+}
+
+int main(int argc, char *argv[])
+{
+	saturation();
+	stress(100000);
+	if (0 != check_summary()) {
+		return 1;
+	}
+	if (argc > 1 && 0 == strcmp(argv[1], "--check")) {
+		return 0;
+	}
+
+	benchmark();
+	return 0;
+}
@@ -0,0 +1,130 @@
+/* libFLAC - Free Lossless Audio Codec
+ * Copyright (C) 2002-2009  Josh Coalson
+ * Copyright (C) 2011-2013  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput of ogg_page_checksum_set() over page bodies from 256 bytes
+ * to 64 KiB, after checking it against a bit-at-a-time CRC.  With
+ * --check only the check is run, which is what ctest does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ogg/ogg.h>
+
+#define MAX_BODY 65536
+#define BYTES_PER_SIZE (256L << 20) /* checksummed per page size when timing */
+
+static ogg_uint32_t reference_crc_(ogg_uint32_t crc, const unsigned char *buffer, long size)
+{
+	int i;
+	while(size--) {
+		crc ^= (ogg_uint32_t)*buffer++ << 24;
+		for(i = 0; i < 8; i++)
+			crc = (crc & 0x80000000u)? (crc << 1) ^ 0x04c11db7u : crc << 1;
+	}
+	return crc;
+}
+
+static ogg_uint32_t page_crc_(const ogg_page *og)
+{
+	return
+		(ogg_uint32_t)og->header[22] |
+		((ogg_uint32_t)og->header[23] << 8) |
+		((ogg_uint32_t)og->header[24] << 16) |
+		((ogg_uint32_t)og->header[25] << 24);
+}
+
+static int check_(unsigned char *header, unsigned char *body)
+{
+	long size;
+	for(size = 0; size <= MAX_BODY; size = size? size * 2 : 1) {
+		/* odd sizes and offsets too, so the 8-byte loop and its tail both get used */
+		long offset, body_len = size > 3? size - 3 : size;
+		for(offset = 0; offset < 4; offset++) {
+			ogg_page og;
+			ogg_uint32_t expect;
+			og.header = header;
+			og.header_len = 27;
+			og.body = body + offset;
+			og.body_len = body_len > MAX_BODY - offset? MAX_BODY - offset : body_len;
+			memset(header + 22, 0, 4);
+			expect = reference_crc_(reference_crc_(0, og.header, og.header_len), og.body, og.body_len);
+			ogg_page_checksum_set(&og);
+			if(page_crc_(&og) != expect) {
+				printf("FAILED: body of %ld bytes at offset %ld: crc %08x, expected %08x\n", og.body_len, offset, (unsigned)page_crc_(&og), (unsigned)expect);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	static unsigned char header[27], body[MAX_BODY];
+	long size, i;
+
+	srand(1);
+	for(i = 0; i < (long)sizeof(header); i++)
+		header[i] = (unsigned char)rand();
+	for(i = 0; i < MAX_BODY; i++)
+		body[i] = (unsigned char)rand();
+
+	if(!check_(header, body))
+		return 1;
+	printf("checksums match the reference\n");
+	if(argc > 1 && 0 == strcmp(argv[1], "--check"))
+		return 0;
+
+	for(size = 256; size <= MAX_BODY; size *= 2) {
+		ogg_page og;
+		const long iterations = BYTES_PER_SIZE / size;
+		unsigned sink = 0;
+		clock_t start;
+		double seconds;
+
+		og.header = header;
+		og.header_len = 27;
+		og.body = body;
+		og.body_len = size;
+		start = clock();
+		for(i = 0; i < iterations; i++) {
+			ogg_page_checksum_set(&og);
+			sink += header[22];
+		}
+		seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+		printf("%6ld byte pages: %8.1f MB/s (%u)\n", size, (double)BYTES_PER_SIZE / (1 << 20) / (seconds > 0? seconds : 1e-9), sink);
+	}
+	return 0;
+}
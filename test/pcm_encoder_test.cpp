@@ -0,0 +1,300 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * PcmEncoder round trip: PCM bytes fed in odd-sized pieces, directly and
+ * through an EncodeQueue, native and Ogg, go through an EncoderWriteCache
+ * and decode back to the same bytes with a matching STREAMINFO MD5.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "FLAC/stream_decoder.h"
+#include "check.h"
+#include "private/batch_decoder.h"
+#include "private/pcm_encoder.h"
+
+
+namespace {
+
+	/* the cache owns its sink, so the bytes live outside it */
+	class MemorySink : public EncoderSink
+	{
+	public:
+		explicit MemorySink(std::vector<FLAC__byte> *data) : data_(data) { }
+
+		bool Write(FLAC__uint64 offset, const FLAC__byte *buffer, size_t bytes)
+		{
+			if (data_->size() < offset + bytes) {
+				data_->resize((size_t)offset + bytes);
+			}
+			memcpy(&(*data_)[(size_t)offset], buffer, bytes);
+			return true;
+		}
+
+		bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+		{
+			*bytes_read = offset < data_->size() ? (size_t)(data_->size() - offset) : 0;
+			if (*bytes_read > bytes) {
+				*bytes_read = bytes;
+			}
+			if (*bytes_read > 0) {
+				memcpy(buffer, &(*data_)[(size_t)offset], *bytes_read);
+			}
+			return true;
+		}
+
+	private:
+		std::vector<FLAC__byte> *data_;
+	};
+
+	FLAC__StreamEncoderReadStatus encoder_read(const FLAC__StreamEncoder *, FLAC__byte buffer[], size_t *bytes, void *client_data)
+	{
+		if (!static_cast<EncoderWriteCache *>(client_data)->Read(buffer, bytes)) {
+			return FLAC__STREAM_ENCODER_READ_STATUS_ABORT;
+		}
+		return 0 == *bytes ? FLAC__STREAM_ENCODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_ENCODER_READ_STATUS_CONTINUE;
+	}
+
+	FLAC__StreamEncoderWriteStatus encoder_write(const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes, unsigned, unsigned, void *client_data)
+	{
+		return static_cast<EncoderWriteCache *>(client_data)->Write(buffer, bytes)
+			? FLAC__STREAM_ENCODER_WRITE_STATUS_OK : FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+
+	FLAC__StreamEncoderSeekStatus encoder_seek(const FLAC__StreamEncoder *, FLAC__uint64 offset, void *client_data)
+	{
+		return static_cast<EncoderWriteCache *>(client_data)->Seek(offset)
+			? FLAC__STREAM_ENCODER_SEEK_STATUS_OK : FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	}
+
+	FLAC__StreamEncoderTellStatus encoder_tell(const FLAC__StreamEncoder *, FLAC__uint64 *offset, void *client_data)
+	{
+		*offset = static_cast<EncoderWriteCache *>(client_data)->Tell();
+		return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+	}
+
+	struct Decoded {
+		Decoded(const std::vector<FLAC__byte> &data) : data(data), position(0), has_md5(false) { }
+
+		const std::vector<FLAC__byte> &data;
+		size_t position;
+		PcmFifo fifo;
+		bool has_md5;
+	};
+
+	FLAC__StreamDecoderReadStatus decoder_read(const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *client_data)
+	{
+		Decoded *decoded = static_cast<Decoded *>(client_data);
+		const size_t left = decoded->data.size() - decoded->position;
+		if (*bytes > left) {
+			*bytes = left;
+		}
+		if (0 == *bytes) {
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		}
+		memcpy(buffer, &decoded->data[decoded->position], *bytes);
+		decoded->position += *bytes;
+		return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+
+	FLAC__StreamDecoderWriteStatus decoder_write(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+	{
+		return static_cast<Decoded *>(client_data)->fifo.Append(buffer, frame->header.blocksize, frame->header.channels, frame->header.bits_per_sample)
+			? FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE : FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+
+	void decoder_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data)
+	{
+		static const FLAC__byte zero[16] = { 0 };
+		if (FLAC__METADATA_TYPE_STREAMINFO == metadata->type) {
+			static_cast<Decoded *>(client_data)->has_md5 = 0 != memcmp(metadata->data.stream_info.md5sum, zero, sizeof(zero));
+		}
+	}
+
+	void decoder_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *)
+	{
+	}
+
+	std::vector<FLAC__byte> make_pcm(unsigned samples, unsigned channels, unsigned bits_per_sample)
+	{
+		const unsigned sample_bytes = bits_per_sample / 8;
+		std::vector<FLAC__byte> pcm;
+		FLAC__uint32 noise = 1;
+		for (unsigned i = 0; i < samples; i++) {
+			for (unsigned c = 0; c < channels; c++) {
+				/* a ramp plus a little noise, so the predictor has work to do */
+				noise = noise * 1664525u + 1013904223u;
+				const FLAC__int32 sample = (FLAC__int32)(((i * (c + 1) * 37u) + (noise >> 26)) << (32 - bits_per_sample)) >> (32 - bits_per_sample);
+				if (1 == sample_bytes) {
+					pcm.push_back((FLAC__byte)(sample + 0x80));
+					continue;
+				}
+				for (unsigned k = 0; k < sample_bytes; k++) {
+					pcm.push_back((FLAC__byte)((sample >> (8 * k)) & 0xFF));
+				}
+			}
+		}
+		return pcm;
+	}
+
+	void test_round_trip(unsigned channels, unsigned bits_per_sample, bool ogg, bool queued)
+	{
+		const unsigned samples = 30000;
+		const std::vector<FLAC__byte> pcm = make_pcm(samples, channels, bits_per_sample);
+		std::vector<FLAC__byte> encoded;
+
+		{
+			/* a small block, so the cache flushes and seeks back for STREAMINFO */
+			EncoderWriteCache cache(new MemorySink(&encoded), 4096);
+			FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+			FLAC__stream_encoder_set_channels(encoder, channels);
+			FLAC__stream_encoder_set_bits_per_sample(encoder, bits_per_sample);
+			FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+			FLAC__stream_encoder_set_total_samples_estimate(encoder, samples);
+
+			EncoderMetadata metadata;
+			CHECK(metadata.AddComment("TITLE", "round trip"));
+			metadata.SetPadding(512);
+			metadata.SetSeekPointSpacing(4096);
+			CHECK(metadata.Apply(encoder));
+
+			const FLAC__StreamEncoderInitStatus status = ogg
+				? FLAC__stream_encoder_init_ogg_stream(encoder, encoder_read, encoder_write, encoder_seek, encoder_tell, 0, &cache)
+				: FLAC__stream_encoder_init_stream(encoder, encoder_write, encoder_seek, encoder_tell, 0, &cache);
+			CHECK(FLAC__STREAM_ENCODER_INIT_STATUS_OK == status);
+
+			PcmEncoder pcm_encoder(encoder);
+			EncodeQueue *queue = queued ? new EncodeQueue(&pcm_encoder, 2) : nullptr;
+
+			/* pieces that split samples and channels at odd places */
+			size_t offset = 0, piece = 1;
+			while (offset < pcm.size()) {
+				const size_t bytes = piece < pcm.size() - offset ? piece : pcm.size() - offset;
+				CHECK(queue ? queue->Submit(&pcm[offset], bytes) : pcm_encoder.Process(&pcm[offset], bytes));
+				offset += bytes;
+				piece = piece > 20000 ? 5 : piece * 3 + 7;
+			}
+			if (queue) {
+				CHECK(queue->Drain());
+				delete queue;
+			}
+
+			CHECK(FLAC__stream_encoder_finish(encoder));
+			CHECK(cache.Flush());
+			FLAC__stream_encoder_delete(encoder);
+		}
+
+		Decoded decoded(encoded);
+		FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+		FLAC__stream_decoder_set_md5_checking(decoder, true);
+		const FLAC__StreamDecoderInitStatus status = ogg
+			? FLAC__stream_decoder_init_ogg_stream(decoder, decoder_read, 0, 0, 0, 0, decoder_write, decoder_metadata, decoder_error, &decoded)
+			: FLAC__stream_decoder_init_stream(decoder, decoder_read, 0, 0, 0, 0, decoder_write, decoder_metadata, decoder_error, &decoded);
+		CHECK(FLAC__STREAM_DECODER_INIT_STATUS_OK == status);
+		CHECK(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+		/* finish() fails when the decoded audio does not match the MD5 */
+		CHECK(FLAC__stream_decoder_finish(decoder));
+		FLAC__stream_decoder_delete(decoder);
+
+		std::vector<FLAC__byte> back;
+		decoded.fifo.Take(samples, back);
+		CHECK(decoded.has_md5);
+		CHECK(back == pcm);
+	}
+
+	/* a write handler that throws once the stream header is out, as an
+	 * event handler that leaves its result unset does */
+	FLAC__StreamEncoderWriteStatus throwing_write(const FLAC__StreamEncoder *, const FLAC__byte[], size_t, unsigned, unsigned samples, void *client_data)
+	{
+		bool *thrown = static_cast<bool *>(client_data);
+		if (0 != samples && !*thrown) {
+			*thrown = true;
+			throw std::runtime_error("write failed");
+		}
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	}
+
+	void test_queue_exception()
+	{
+		const std::vector<FLAC__byte> pcm = make_pcm(20000, 2, 16);
+		bool thrown = false;
+		FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+		FLAC__stream_encoder_set_channels(encoder, 2);
+		FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+		CHECK(FLAC__STREAM_ENCODER_INIT_STATUS_OK == FLAC__stream_encoder_init_stream(encoder, throwing_write, 0, 0, 0, &thrown));
+
+		PcmEncoder pcm_encoder(encoder);
+		{
+			/* the worker reports the exception as a failure instead of terminating */
+			EncodeQueue queue(&pcm_encoder, 2);
+			for (size_t offset = 0; offset < pcm.size(); offset += 4000) {
+				(void)queue.Submit(&pcm[offset], 4000 < pcm.size() - offset ? 4000 : pcm.size() - offset);
+			}
+			CHECK(!queue.Drain());
+			CHECK(!queue.Submit(&pcm[0], 4));
+		}
+		CHECK(thrown);
+		FLAC__stream_encoder_delete(encoder);
+	}
+
+	void test_bad_sample_size()
+	{
+		FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+		FLAC__stream_encoder_set_bits_per_sample(encoder, 32);
+		PcmEncoder pcm_encoder(encoder);
+		const FLAC__byte data[8] = { 0 };
+		CHECK(!pcm_encoder.Process(data, sizeof(data)));
+		FLAC__stream_encoder_delete(encoder);
+	}
+
+}
+
+int main()
+{
+	const unsigned sizes[] = { 8, 16, 24 };
+	for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (unsigned channels = 1; channels <= 3; channels++) {
+			for (int ogg = 0; ogg < 2; ogg++) {
+				test_round_trip(channels, sizes[s], !!ogg, false);
+				test_round_trip(channels, sizes[s], !!ogg, true);
+			}
+		}
+	}
+	test_queue_exception();
+	test_bad_sample_size();
+
+	return check_summary();
+}
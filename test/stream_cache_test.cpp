@@ -0,0 +1,317 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * StreamCache against a file-backed source that counts its reads:
+ * window hits, backward seeks, reads at and past the end, reads larger
+ * than the window, and the prefetch hints sequential reads give.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "check.h"
+#include "private/stream_cache.h"
+
+
+namespace {
+
+	const size_t FileSize = 10000;
+	const size_t Window = 1024;
+
+	FLAC__byte pattern(FLAC__uint64 offset)
+	{
+		return (FLAC__byte)((offset * 7 + offset / 251) & 0xFF);
+	}
+
+	/* stands in for RandomAccessStreamSource; the stream is a temporary file */
+	class FileSource : public StreamCacheSource
+	{
+	public:
+		explicit FileSource(FILE *file) : file_(file), reads(0), cancels(0) { }
+
+		virtual ~FileSource()
+		{
+			fclose(file_);
+		}
+
+		virtual bool Read(FLAC__uint64 offset, FLAC__byte *buffer, size_t bytes, size_t *bytes_read)
+		{
+			reads++;
+			if (0 != fseek(file_, (long)offset, SEEK_SET)) {
+				return false;
+			}
+			*bytes_read = fread(buffer, 1, bytes, file_);
+			return !ferror(file_);
+		}
+
+		virtual bool Length(FLAC__uint64 *length)
+		{
+			if (0 != fseek(file_, 0, SEEK_END)) {
+				return false;
+			}
+			*length = (FLAC__uint64)ftell(file_);
+			return true;
+		}
+
+		virtual void Prefetch(FLAC__uint64 offset, size_t bytes)
+		{
+			prefetches.push_back(std::make_pair(offset, bytes));
+		}
+
+		virtual void CancelPrefetch()
+		{
+			cancels++;
+		}
+
+		FILE *file_;
+		int reads;
+		std::vector<std::pair<FLAC__uint64, size_t> > prefetches;
+		int cancels;
+	};
+
+	FileSource *make_source()
+	{
+		FILE *file = tmpfile();
+		if (nullptr == file) {
+			perror("tmpfile");
+			exit(1);
+		}
+		for (size_t i = 0; i < FileSize; i++) {
+			fputc(pattern(i), file);
+		}
+		fflush(file);
+		return new FileSource(file);
+	}
+
+	/* reads \a bytes at the cache's position and checks them against the file */
+	size_t read_and_check(StreamCache &cache, size_t bytes)
+	{
+		std::vector<FLAC__byte> buffer(bytes + 1);
+		const FLAC__uint64 offset = cache.Tell();
+		size_t got = bytes;
+
+		CHECK(cache.Read(&buffer[0], &got));
+		CHECK(got <= bytes);
+		for (size_t i = 0; i < got; i++) {
+			if (buffer[i] != pattern(offset + i)) {
+				printf("FAILED: byte %u of a read at %u\n", (unsigned)i, (unsigned)offset);
+				failures++;
+				break;
+			}
+		}
+		CHECK(cache.Tell() == offset + got);
+		return got;
+	}
+
+	void test_window_hits()
+	{
+		FileSource *source = make_source();
+		StreamCache cache(source, Window);
+
+		/* small sequential reads are served from one window */
+		for (int i = 0; i < 16; i++) {
+			CHECK(read_and_check(cache, 64) == 64);
+		}
+		CHECK(source->reads == 1);
+
+		/* the next one straddles the end of the window */
+		CHECK(cache.Seek(Window - 10));
+		CHECK(read_and_check(cache, 20) == 20);
+		CHECK(source->reads == 2);
+	}
+
+	void test_backward_seeks()
+	{
+		FileSource *source = make_source();
+		StreamCache cache(source, Window);
+
+		CHECK(cache.Seek(4000));
+		CHECK(read_and_check(cache, 100) == 100);
+		CHECK(source->reads == 1);
+
+		/* back into the window: free */
+		CHECK(cache.Seek(4000));
+		CHECK(read_and_check(cache, 500) == 500);
+		CHECK(cache.Seek(4050));
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(source->reads == 1);
+
+		/* back before the window: one refill, which then serves forward reads */
+		CHECK(cache.Seek(3990));
+		CHECK(read_and_check(cache, 20) == 20);
+		CHECK(source->reads == 2);
+		CHECK(read_and_check(cache, 500) == 500);
+		CHECK(source->reads == 2);
+	}
+
+	void test_end_of_stream()
+	{
+		FileSource *source = make_source();
+		StreamCache cache(source, Window);
+		FLAC__uint64 length = 0;
+		FLAC__byte byte;
+		size_t got;
+
+		CHECK(cache.Length(&length) && FileSize == length);
+
+		/* a read across the end is cut short */
+		CHECK(cache.Seek(FileSize - 100));
+		CHECK(!cache.Eof());
+		CHECK(read_and_check(cache, 300) == 100);
+		CHECK(cache.Eof());
+
+		/* at the end a read gets nothing, and is not an error */
+		got = 1;
+		CHECK(cache.Read(&byte, &got));
+		CHECK(0 == got);
+		CHECK(cache.Tell() == FileSize);
+
+		/* seeking to the end is allowed, past it is not */
+		CHECK(cache.Seek(FileSize));
+		CHECK(!cache.Seek(FileSize + 1));
+		CHECK(cache.Tell() == FileSize);
+
+		/* a read larger than the window at the end gets nothing too */
+		{
+			std::vector<FLAC__byte> buffer(4 * Window);
+			got = buffer.size();
+			CHECK(cache.Read(&buffer[0], &got));
+			CHECK(0 == got);
+		}
+	}
+
+	void test_large_reads()
+	{
+		FileSource *source = make_source();
+		StreamCache cache(source, Window);
+
+		/* at least a window's worth goes straight to the source */
+		CHECK(read_and_check(cache, 3 * Window) == 3 * Window);
+		CHECK(source->reads == 1);
+		/* and leaves no window behind, so a small read refills */
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(source->reads == 2);
+
+		/* a large read from inside the window uses what it has, then reads the rest directly */
+		CHECK(read_and_check(cache, 2 * Window) == 2 * Window);
+		CHECK(source->reads == 3);
+
+		/* a large read across the end is cut short */
+		CHECK(cache.Seek(FileSize - Window));
+		CHECK(read_and_check(cache, 5 * Window) == Window);
+	}
+
+	void test_invalidate()
+	{
+		FileSource *source = make_source();
+		StreamCache cache(source, Window);
+		FLAC__uint64 length = 0;
+
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(cache.Length(&length) && FileSize == length);
+
+		/* the file grows behind the cache's back */
+		fseek(source->file_, 0, SEEK_END);
+		for (size_t i = FileSize; i < FileSize + 500; i++) {
+			fputc(pattern(i), source->file_);
+		}
+		fflush(source->file_);
+
+		cache.Invalidate();
+		CHECK(cache.Length(&length) && FileSize + 500 == length);
+		CHECK(cache.Seek(FileSize + 400));
+		CHECK(read_and_check(cache, 200) == 100);
+	}
+
+	bool prefetched(const FileSource *source, size_t index, FLAC__uint64 offset, size_t bytes)
+	{
+		return index < source->prefetches.size() &&
+			source->prefetches[index].first == offset && source->prefetches[index].second == bytes;
+	}
+
+	void test_prefetch()
+	{
+		FileSource *source = make_source();
+		StreamCache cache(source, Window);
+
+		/* reading on from the start asks for the window after each one */
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(prefetched(source, 0, Window, Window));
+		CHECK(cache.Seek(Window - 5));
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(source->reads == 2);
+		CHECK(prefetched(source, 1, 2 * Window, Window));
+
+		/* a refill anywhere else is not sequential, and hints nothing */
+		CHECK(cache.Seek(4000));
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(source->prefetches.size() == 2);
+		/* but reading on from there is */
+		CHECK(cache.Seek(4000 + Window));
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(prefetched(source, 2, 4000 + 2 * Window, Window));
+
+		/* direct reads hint the same size again */
+		CHECK(cache.Seek(4000 + 2 * Window));
+		CHECK(read_and_check(cache, 2 * Window) == 2 * Window);
+		CHECK(prefetched(source, 3, 4000 + 4 * Window, 2 * Window));
+
+		/* a read cut short by the end of the file hints nothing */
+		CHECK(read_and_check(cache, 2 * Window) == FileSize - (4000 + 4 * Window));
+		CHECK(source->prefetches.size() == 4);
+
+		/* invalidating cancels the prefetch, and the next read is not sequential */
+		CHECK(0 == source->cancels);
+		cache.Invalidate();
+		CHECK(1 == source->cancels);
+		CHECK(cache.Seek(0));
+		CHECK(read_and_check(cache, 10) == 10);
+		CHECK(source->prefetches.size() == 4);
+	}
+
+}
+
+int main()
+{
+	test_window_hits();
+	test_backward_seeks();
+	test_end_of_stream();
+	test_large_reads();
+	test_invalidate();
+	test_prefetch();
+
+	return check_summary();
+}
@@ -0,0 +1,367 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Stream decoder paths that a plain decode does not reach: lazy pictures
+ * with a read buffer, whether the client can seek past the picture or
+ * not, the Ogg page index when the tell callback fails, and
+ * FLAC__stream_decoder_decode_range() carrying on from one range to the
+ * next, trimming frames and stopping at the end of the stream.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "FLAC/metadata.h"
+#include "FLAC/stream_decoder.h"
+#include "FLAC/stream_encoder.h"
+#include "check.h"
+
+
+namespace {
+
+	const unsigned Channels = 2;
+	const unsigned BitsPerSample = 16;
+	const unsigned Blocksize = 4096;
+	const unsigned TotalSamples = 50000;
+
+	FLAC__int32 sample_at(unsigned i, unsigned channel)
+	{
+		const FLAC__uint32 hash = i * 2654435761u + channel * 40503u;
+		/* a ramp with a little noise, so frames are not all verbatim */
+		return (FLAC__int32)((i * (channel + 3)) & 0x3FFF) - 0x2000 + (FLAC__int32)(hash >> 28);
+	}
+
+	FLAC__StreamEncoderWriteStatus encoder_write(const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes, unsigned, unsigned, void *client_data)
+	{
+		std::vector<FLAC__byte> *data = static_cast<std::vector<FLAC__byte> *>(client_data);
+		data->insert(data->end(), buffer, buffer + bytes);
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	}
+
+	/* a stream with a picture far larger than any read buffer */
+	std::vector<FLAC__byte> encode(unsigned picture_length, bool ogg)
+	{
+		std::vector<FLAC__byte> data;
+		FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+		FLAC__StreamMetadata *picture = FLAC__metadata_object_new(FLAC__METADATA_TYPE_PICTURE);
+		std::vector<FLAC__byte> picture_data(picture_length);
+		for (unsigned i = 0; i < picture_length; i++) {
+			picture_data[i] = (FLAC__byte)(i * 31 + 7);
+		}
+		CHECK(FLAC__metadata_object_picture_set_mime_type(picture, const_cast<char *>("image/png"), /*copy=*/true));
+		CHECK(FLAC__metadata_object_picture_set_data(picture, &picture_data[0], picture_length, /*copy=*/true));
+
+		FLAC__stream_encoder_set_channels(encoder, Channels);
+		FLAC__stream_encoder_set_bits_per_sample(encoder, BitsPerSample);
+		FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+		FLAC__stream_encoder_set_blocksize(encoder, Blocksize);
+		/* the write callback can't seek back to fill it in */
+		FLAC__stream_encoder_set_total_samples_estimate(encoder, TotalSamples);
+		FLAC__stream_encoder_set_metadata(encoder, &picture, 1);
+		if (ogg) {
+			CHECK(FLAC__STREAM_ENCODER_INIT_STATUS_OK == FLAC__stream_encoder_init_ogg_stream(encoder, 0, encoder_write, 0, 0, 0, &data));
+		}
+		else {
+			CHECK(FLAC__STREAM_ENCODER_INIT_STATUS_OK == FLAC__stream_encoder_init_stream(encoder, encoder_write, 0, 0, 0, &data));
+		}
+
+		std::vector<FLAC__int32> interleaved;
+		for (unsigned i = 0; i < TotalSamples; i++) {
+			for (unsigned c = 0; c < Channels; c++) {
+				interleaved.push_back(sample_at(i, c));
+			}
+		}
+		CHECK(FLAC__stream_encoder_process_interleaved(encoder, &interleaved[0], TotalSamples));
+		CHECK(FLAC__stream_encoder_finish(encoder));
+		FLAC__stream_encoder_delete(encoder);
+		FLAC__metadata_object_delete(picture);
+		return data;
+	}
+
+	/* an in-memory client whose seek callback may refuse to seek */
+	struct Client {
+		Client(const std::vector<FLAC__byte> &data, bool can_seek) :
+			data(data), position(0), can_seek(can_seek), failing_tells(0), seeks(0), samples(0), mismatches(0), pictures(0), picture_length(0) { }
+
+		const std::vector<FLAC__byte> &data;
+		size_t position;
+		bool can_seek;
+		unsigned failing_tells;
+		unsigned seeks;
+
+		unsigned samples;
+		unsigned mismatches;
+		unsigned pictures;
+		FLAC__uint32 picture_length;
+	};
+
+	FLAC__StreamDecoderReadStatus decoder_read(const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *client_data)
+	{
+		Client *client = static_cast<Client *>(client_data);
+		const size_t left = client->data.size() - client->position;
+		if (*bytes > left) {
+			*bytes = left;
+		}
+		if (0 == *bytes) {
+			return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+		}
+		memcpy(buffer, &client->data[client->position], *bytes);
+		client->position += *bytes;
+		return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+
+	FLAC__StreamDecoderSeekStatus decoder_seek(const FLAC__StreamDecoder *, FLAC__uint64 offset, void *client_data)
+	{
+		Client *client = static_cast<Client *>(client_data);
+		client->seeks++;
+		if (!client->can_seek) {
+			return FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED;
+		}
+		if (offset > client->data.size()) {
+			return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+		}
+		client->position = (size_t)offset;
+		return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+	}
+
+	FLAC__StreamDecoderTellStatus decoder_tell(const FLAC__StreamDecoder *, FLAC__uint64 *offset, void *client_data)
+	{
+		Client *client = static_cast<Client *>(client_data);
+		if (client->failing_tells > 0) {
+			client->failing_tells--;
+			return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
+		}
+		*offset = client->position;
+		return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+	}
+
+	FLAC__StreamDecoderLengthStatus decoder_length(const FLAC__StreamDecoder *, FLAC__uint64 *length, void *client_data)
+	{
+		*length = static_cast<Client *>(client_data)->data.size();
+		return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+	}
+
+	FLAC__bool decoder_eof(const FLAC__StreamDecoder *, void *client_data)
+	{
+		Client *client = static_cast<Client *>(client_data);
+		return client->position == client->data.size();
+	}
+
+	FLAC__StreamDecoderWriteStatus decoder_write(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+	{
+		Client *client = static_cast<Client *>(client_data);
+		for (unsigned i = 0; i < frame->header.blocksize; i++) {
+			for (unsigned c = 0; c < frame->header.channels; c++) {
+				if (buffer[c][i] != sample_at(client->samples + i, c)) {
+					client->mismatches++;
+				}
+			}
+		}
+		client->samples += frame->header.blocksize;
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+
+	void decoder_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data)
+	{
+		Client *client = static_cast<Client *>(client_data);
+		if (FLAC__METADATA_TYPE_PICTURE == metadata->type) {
+			client->pictures++;
+			client->picture_length = metadata->data.picture.data_length;
+		}
+	}
+
+	void decoder_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client_data)
+	{
+		static_cast<Client *>(client_data)->mismatches++;
+	}
+
+	FLAC__StreamDecoder *open(Client &client, unsigned read_buffer_size)
+	{
+		FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+		FLAC__stream_decoder_set_md5_checking(decoder, true);
+		FLAC__stream_decoder_set_metadata_respond(decoder, FLAC__METADATA_TYPE_PICTURE);
+		CHECK(FLAC__stream_decoder_set_read_buffer_size(decoder, read_buffer_size));
+		CHECK(FLAC__stream_decoder_set_lazy_pictures(decoder, true));
+		CHECK(FLAC__STREAM_DECODER_INIT_STATUS_OK == FLAC__stream_decoder_init_stream(decoder, decoder_read, decoder_seek, decoder_tell, decoder_length, decoder_eof, decoder_write, decoder_metadata, decoder_error, &client));
+		return decoder;
+	}
+
+	/* an unsupported seek past a lazy picture falls back to reading past
+	 * it, which has to start with the bytes already in the read buffer */
+	void test_lazy_picture(const std::vector<FLAC__byte> &data, bool can_seek, unsigned read_buffer_size)
+	{
+		Client client(data, can_seek);
+		FLAC__StreamDecoder *decoder = open(client, read_buffer_size);
+
+		CHECK(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+		CHECK(FLAC__STREAM_DECODER_END_OF_STREAM == FLAC__stream_decoder_get_state(decoder));
+		CHECK(FLAC__stream_decoder_finish(decoder));
+		FLAC__stream_decoder_delete(decoder);
+
+		CHECK(1 == client.pictures);
+		CHECK(200000 == client.picture_length);
+		CHECK(TotalSamples == client.samples);
+		CHECK(0 == client.mismatches);
+	}
+
+	/* decodes \a samples from \a start, interleaved or planar, checks
+	 * them and returns how many there were */
+	unsigned decode_range(FLAC__StreamDecoder *decoder, FLAC__uint64 start, unsigned samples, bool interleaved)
+	{
+		std::vector<FLAC__int32> out(samples * Channels + 1, 0x7FFFFFFF);
+		FLAC__int32 *buffer[Channels];
+		unsigned decoded = 0;
+
+		for (unsigned c = 0; c < Channels; c++) {
+			buffer[c] = &out[0] + (interleaved ? c : c * samples);
+		}
+		CHECK(FLAC__stream_decoder_decode_range(decoder, start, samples, buffer, interleaved ? Channels : 1, &decoded));
+		CHECK(decoded <= samples);
+		for (unsigned i = 0; i < decoded; i++) {
+			for (unsigned c = 0; c < Channels; c++) {
+				if (buffer[c][i * (interleaved ? Channels : 1)] != sample_at((unsigned)start + i, c)) {
+					printf("FAILED: sample %u of channel %u of a range at %u\n", i, c, (unsigned)start);
+					failures++;
+					return decoded;
+				}
+			}
+		}
+		/* nothing past what was decoded is touched */
+		CHECK(0x7FFFFFFF == out[samples * Channels]);
+		if (decoded < samples) {
+			CHECK(0x7FFFFFFF == buffer[Channels - 1][decoded * (interleaved ? Channels : 1)]);
+		}
+		return decoded;
+	}
+
+	void test_decode_range(const std::vector<FLAC__byte> &data)
+	{
+		Client client(data, /*can_seek=*/true);
+		FLAC__StreamDecoder *decoder = open(client, 4096);
+
+		/* the first range has to seek; each one after it carries on,
+		 * from inside the last frame or from right after it */
+		CHECK(decode_range(decoder, 0, 1000, /*interleaved=*/true) == 1000);
+		const unsigned seeks = client.seeks;
+		CHECK(decode_range(decoder, 1000, 5000, /*interleaved=*/false) == 5000);
+		CHECK(decode_range(decoder, 6000, 2 * Blocksize - 6000, /*interleaved=*/true) == 2 * Blocksize - 6000);
+		CHECK(decode_range(decoder, 2 * Blocksize, 3, /*interleaved=*/false) == 3);
+		CHECK(decode_range(decoder, 2 * Blocksize + 3, Blocksize - 3, /*interleaved=*/true) == Blocksize - 3);
+		CHECK(decode_range(decoder, 3 * Blocksize, Blocksize, /*interleaved=*/true) == Blocksize);
+		CHECK(client.seeks == seeks);
+
+		/* a range behind the last frame or past the next one seeks, and is
+		 * trimmed at both ends, within one frame or across several */
+		CHECK(decode_range(decoder, 100, 50, /*interleaved=*/true) == 50);
+		CHECK(client.seeks > seeks);
+		CHECK(decode_range(decoder, 5 * Blocksize + 17, 3 * Blocksize + 100, /*interleaved=*/false) == 3 * Blocksize + 100);
+		CHECK(decode_range(decoder, Blocksize - 1, 2, /*interleaved=*/true) == 2);
+
+		/* the end of the stream cuts a range short; at or past it there is nothing */
+		CHECK(decode_range(decoder, TotalSamples - 10, 100, /*interleaved=*/true) == 10);
+		CHECK(decode_range(decoder, TotalSamples, 100, /*interleaved=*/false) == 0);
+		CHECK(decode_range(decoder, TotalSamples + 5000, 1, /*interleaved=*/true) == 0);
+		CHECK(decode_range(decoder, TotalSamples - 1, 1, /*interleaved=*/false) == 1);
+
+		/* and the write callback saw none of it */
+		CHECK(0 == client.samples);
+		CHECK(0 == client.mismatches);
+
+		CHECK(FLAC__stream_decoder_finish(decoder));
+		FLAC__stream_decoder_delete(decoder);
+	}
+
+	/* every indexed page has to start where the index says */
+	bool index_is_exact(const FLAC__StreamDecoder *decoder, const std::vector<FLAC__byte> &data)
+	{
+		const FLAC__OggPageIndexEntry *entries;
+		const unsigned count = FLAC__stream_decoder_get_ogg_page_index(decoder, &entries);
+		for (unsigned i = 0; i < count; i++) {
+			if (entries[i].stream_offset + 4 > data.size() || 0 != memcmp(&data[(size_t)entries[i].stream_offset], "OggS", 4)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/* without an offset for the first read the decoder cannot know where
+	 * the pages it sees are, so it indexes none until the next flush,
+	 * even once the tell callback works again */
+	void test_ogg_index_without_tell(const std::vector<FLAC__byte> &data)
+	{
+		const FLAC__OggPageIndexEntry *entries;
+		Client client(data, /*can_seek=*/true);
+		FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+
+		client.failing_tells = 1;
+		FLAC__stream_decoder_set_md5_checking(decoder, true);
+		CHECK(FLAC__stream_decoder_set_ogg_page_indexing(decoder, true));
+		CHECK(FLAC__STREAM_DECODER_INIT_STATUS_OK == FLAC__stream_decoder_init_ogg_stream(decoder, decoder_read, decoder_seek, decoder_tell, decoder_length, decoder_eof, decoder_write, decoder_metadata, decoder_error, &client));
+
+		CHECK(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+		CHECK(0 == client.failing_tells);
+		CHECK(0 == FLAC__stream_decoder_get_ogg_page_index(decoder, &entries));
+		CHECK(TotalSamples == client.samples);
+		CHECK(0 == client.mismatches);
+
+		/* the seek flushes, and indexing picks up from there */
+		client.samples = TotalSamples / 2;
+		CHECK(FLAC__stream_decoder_seek_absolute(decoder, TotalSamples / 2));
+		CHECK(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+		CHECK(0 < FLAC__stream_decoder_get_ogg_page_index(decoder, &entries));
+		CHECK(index_is_exact(decoder, data));
+		CHECK(TotalSamples == client.samples);
+		CHECK(0 == client.mismatches);
+
+		CHECK(FLAC__stream_decoder_finish(decoder));
+		FLAC__stream_decoder_delete(decoder);
+	}
+
+}
+
+int main()
+{
+	const std::vector<FLAC__byte> data = encode(200000, /*ogg=*/false);
+	const unsigned read_buffer_sizes[] = { 0, 4096, 65536, 1 << 20 };
+
+	for (unsigned i = 0; i < sizeof(read_buffer_sizes) / sizeof(read_buffer_sizes[0]); i++) {
+		test_lazy_picture(data, /*can_seek=*/true, read_buffer_sizes[i]);
+		test_lazy_picture(data, /*can_seek=*/false, read_buffer_sizes[i]);
+	}
+
+	test_decode_range(data);
+	test_ogg_index_without_tell(encode(1000, /*ogg=*/true));
+
+	return check_summary();
+}
@@ -0,0 +1,298 @@
+/* libFLAC_winrt - FLAC library for Windows Runtime
+ * Copyright (C) 2014-2015  Alexander Ovchinnikov
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of copyright holder nor the names of project's
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Stream splicer: aligned and unaligned ranges, out of one source and
+ * out of two.  Every splice is decoded with MD5 checking on and
+ * compared with a reference decode of the sources.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "FLAC/stream_decoder.h"
+#include "FLAC/stream_encoder.h"
+#include "FLAC/stream_splicer.h"
+#include "check.h"
+
+
+namespace {
+
+	const unsigned Channels = 2;
+	const unsigned Blocksize = 4096;
+	const unsigned TotalSamples = 10 * Blocksize + 1234;
+
+	FLAC__int32 sample_at(unsigned seed, unsigned i, unsigned channel)
+	{
+		const FLAC__uint32 hash = (i + seed) * 2654435761u + channel * 40503u;
+		return (FLAC__int32)(((i + seed) * (channel + 3)) & 0x3FFF) - 0x2000 + (FLAC__int32)(hash >> 28);
+	}
+
+	size_t file_read(void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+	{
+		return fread(ptr, size, nmemb, static_cast<FILE *>(handle));
+	}
+
+	size_t file_write(const void *ptr, size_t size, size_t nmemb, FLAC__IOHandle handle)
+	{
+		return fwrite(ptr, size, nmemb, static_cast<FILE *>(handle));
+	}
+
+	int file_seek(FLAC__IOHandle handle, FLAC__int64 offset, int whence)
+	{
+		return fseek(static_cast<FILE *>(handle), (long)offset, whence);
+	}
+
+	FLAC__int64 file_tell(FLAC__IOHandle handle)
+	{
+		return ftell(static_cast<FILE *>(handle));
+	}
+
+	int file_eof(FLAC__IOHandle handle)
+	{
+		return feof(static_cast<FILE *>(handle));
+	}
+
+	const FLAC__IOCallbacks file_callbacks = { file_read, file_write, file_seek, file_tell, file_eof, 0 };
+
+	FILE *temporary_file()
+	{
+		FILE *file = tmpfile();
+		if (nullptr == file) {
+			perror("tmpfile");
+			exit(1);
+		}
+		return file;
+	}
+
+	/* the encoder and decoder close a FILE they were given, so the files
+	 * here go through their stream callbacks instead */
+	FLAC__StreamEncoderWriteStatus encoder_write(const FLAC__StreamEncoder *, const FLAC__byte buffer[], size_t bytes, unsigned, unsigned, void *client_data)
+	{
+		return bytes == fwrite(buffer, 1, bytes, static_cast<FILE *>(client_data)) ? FLAC__STREAM_ENCODER_WRITE_STATUS_OK : FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+
+	FLAC__StreamEncoderSeekStatus encoder_seek(const FLAC__StreamEncoder *, FLAC__uint64 absolute_byte_offset, void *client_data)
+	{
+		return 0 == fseek(static_cast<FILE *>(client_data), (long)absolute_byte_offset, SEEK_SET) ? FLAC__STREAM_ENCODER_SEEK_STATUS_OK : FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	}
+
+	FLAC__StreamEncoderTellStatus encoder_tell(const FLAC__StreamEncoder *, FLAC__uint64 *absolute_byte_offset, void *client_data)
+	{
+		*absolute_byte_offset = (FLAC__uint64)ftell(static_cast<FILE *>(client_data));
+		return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+	}
+
+	/* a fixed-blocksize source; \a seed tells the sources apart */
+	FILE *encode(unsigned seed)
+	{
+		FILE *file = temporary_file();
+		FLAC__StreamEncoder *encoder = FLAC__stream_encoder_new();
+		std::vector<FLAC__int32> interleaved;
+
+		FLAC__stream_encoder_set_channels(encoder, Channels);
+		FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+		FLAC__stream_encoder_set_sample_rate(encoder, 44100);
+		FLAC__stream_encoder_set_blocksize(encoder, Blocksize);
+		CHECK(FLAC__STREAM_ENCODER_INIT_STATUS_OK == FLAC__stream_encoder_init_stream(encoder, encoder_write, encoder_seek, encoder_tell, 0, file));
+		for (unsigned i = 0; i < TotalSamples; i++) {
+			for (unsigned c = 0; c < Channels; c++) {
+				interleaved.push_back(sample_at(seed, i, c));
+			}
+		}
+		CHECK(FLAC__stream_encoder_process_interleaved(encoder, &interleaved[0], TotalSamples));
+		CHECK(FLAC__stream_encoder_finish(encoder));
+		FLAC__stream_encoder_delete(encoder);
+		return file;
+	}
+
+	struct Decoded {
+		Decoded() : file(nullptr), min_blocksize(0), max_blocksize(0), total_samples(0), has_md5(false), errors(0) { }
+
+		FILE *file;
+		std::vector<FLAC__int32> samples;  // interleaved
+		unsigned min_blocksize, max_blocksize;
+		FLAC__uint64 total_samples;
+		bool has_md5;  // all zeroes would turn the check off
+		unsigned errors;
+	};
+
+	FLAC__StreamDecoderReadStatus decoder_read(const FLAC__StreamDecoder *, FLAC__byte buffer[], size_t *bytes, void *client_data)
+	{
+		FILE *file = static_cast<Decoded *>(client_data)->file;
+		*bytes = fread(buffer, 1, *bytes, file);
+		if (ferror(file)) {
+			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		}
+		return 0 == *bytes ? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+
+	FLAC__StreamDecoderWriteStatus decoder_write(const FLAC__StreamDecoder *, const FLAC__Frame *frame, const FLAC__int32 *const buffer[], void *client_data)
+	{
+		Decoded *decoded = static_cast<Decoded *>(client_data);
+		for (unsigned i = 0; i < frame->header.blocksize; i++) {
+			for (unsigned c = 0; c < frame->header.channels; c++) {
+				decoded->samples.push_back(buffer[c][i]);
+			}
+		}
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+
+	void decoder_metadata(const FLAC__StreamDecoder *, const FLAC__StreamMetadata *metadata, void *client_data)
+	{
+		Decoded *decoded = static_cast<Decoded *>(client_data);
+		if (FLAC__METADATA_TYPE_STREAMINFO == metadata->type) {
+			decoded->min_blocksize = metadata->data.stream_info.min_blocksize;
+			decoded->max_blocksize = metadata->data.stream_info.max_blocksize;
+			decoded->total_samples = metadata->data.stream_info.total_samples;
+			for (unsigned i = 0; i < 16; i++) {
+				decoded->has_md5 = decoded->has_md5 || 0 != metadata->data.stream_info.md5sum[i];
+			}
+		}
+	}
+
+	void decoder_error(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client_data)
+	{
+		static_cast<Decoded *>(client_data)->errors++;
+	}
+
+	/* decodes all of \a file from the start; finishing fails on an MD5 mismatch */
+	Decoded decode(FILE *file)
+	{
+		Decoded decoded;
+		FLAC__StreamDecoder *decoder = FLAC__stream_decoder_new();
+
+		rewind(file);
+		decoded.file = file;
+		FLAC__stream_decoder_set_md5_checking(decoder, true);
+		CHECK(FLAC__STREAM_DECODER_INIT_STATUS_OK == FLAC__stream_decoder_init_stream(decoder, decoder_read, 0, 0, 0, 0, decoder_write, decoder_metadata, decoder_error, &decoded));
+		CHECK(FLAC__stream_decoder_process_until_end_of_stream(decoder));
+		CHECK(FLAC__stream_decoder_finish(decoder));
+		FLAC__stream_decoder_delete(decoder);
+		CHECK(0 == decoded.errors);
+		CHECK(decoded.has_md5);
+		return decoded;
+	}
+
+	struct Range {
+		unsigned source;
+		FLAC__uint64 start_sample;
+		FLAC__uint64 samples;  // 0 for up to the end
+	};
+
+	/* splices \a ranges of \a sources, checks the result against
+	 * \a references and returns whether it kept a fixed blocksize */
+	bool splice_and_check(FILE *const sources[], const Decoded references[], const Range ranges[], unsigned count)
+	{
+		FILE *output = temporary_file();
+		FLAC__StreamSplicer *splicer = FLAC__stream_splicer_new();
+		std::vector<FLAC__int32> expected;
+
+		for (unsigned i = 0; i < count; i++) {
+			const std::vector<FLAC__int32> &reference = references[ranges[i].source].samples;
+			const size_t begin = (size_t)ranges[i].start_sample * Channels;
+			size_t end = reference.size();
+			if (0 != ranges[i].samples && begin + (size_t)ranges[i].samples * Channels < end) {
+				end = begin + (size_t)ranges[i].samples * Channels;
+			}
+			expected.insert(expected.end(), reference.begin() + begin, reference.begin() + end);
+			CHECK(FLAC__stream_splicer_add_segment(splicer, sources[ranges[i].source], file_callbacks, ranges[i].start_sample, ranges[i].samples));
+		}
+		CHECK(FLAC__stream_splicer_splice(splicer, output, file_callbacks));
+		CHECK(FLAC__STREAM_SPLICER_OK == FLAC__stream_splicer_get_status(splicer));
+		FLAC__stream_splicer_delete(splicer);
+
+		fflush(output);
+		const Decoded spliced = decode(output);
+		fclose(output);
+
+		CHECK(spliced.total_samples * Channels == expected.size());
+		CHECK(spliced.samples == expected);
+		return spliced.min_blocksize == spliced.max_blocksize;
+	}
+
+	void test_one_source(FILE *const sources[], const Decoded references[])
+	{
+		/* whole frames, out of order and repeated */
+		const Range aligned[] = {
+			{ 0, 4 * Blocksize, 2 * Blocksize },
+			{ 0, 0, Blocksize },
+			{ 0, 4 * Blocksize, 3 * Blocksize }
+		};
+		/* cuts inside frames, including a range within one frame and one running past the end */
+		const Range unaligned[] = {
+			{ 0, 1000, 5000 },
+			{ 0, 3 * Blocksize + 7, 100 },
+			{ 0, 20001, 7777 },
+			{ 0, TotalSamples - 500, 2000 }
+		};
+
+		CHECK(splice_and_check(sources, references, aligned, 3));
+		CHECK(!splice_and_check(sources, references, unaligned, 4));
+	}
+
+	void test_two_sources(FILE *const sources[], const Decoded references[])
+	{
+		/* the last range may end anywhere and still keep the blocksize fixed */
+		const Range aligned[] = {
+			{ 0, 0, 2 * Blocksize },
+			{ 1, 3 * Blocksize, Blocksize },
+			{ 0, 8 * Blocksize, 0 }
+		};
+		const Range unaligned[] = {
+			{ 1, 123, 10000 },
+			{ 0, 777, 1 },
+			{ 1, 9 * Blocksize - 1, 0 }
+		};
+
+		CHECK(splice_and_check(sources, references, aligned, 3));
+		CHECK(!splice_and_check(sources, references, unaligned, 3));
+	}
+
+}
+
+int main()
+{
+	FILE *const sources[] = { encode(0), encode(99991) };
+	const Decoded references[] = { decode(sources[0]), decode(sources[1]) };
+
+	CHECK(references[0].samples.size() == TotalSamples * Channels);
+	CHECK(references[0].samples != references[1].samples);
+
+	test_one_source(sources, references);
+	test_two_sources(sources, references);
+
+	fclose(sources[0]);
+	fclose(sources[1]);
+	return check_summary();
+}